@@ -0,0 +1,31 @@
+#!/bin/sh
+#
+# Training workload for profile-guided builds (make pgo).
+#
+# Starts the instrumented server from the given build directory, replays a
+# fixed-seed ttweetbench mix plus a short interactive client session, then
+# stops the server with SIGTERM so every process writes its profile.
+#
+# Usage: ./bench/pgo_training.sh <BuildDir>
+
+set -e
+
+BUILD_DIR=${1:?Usage: $0 <BuildDir>}
+PORT=${PGO_PORT:-19100}
+
+"$BUILD_DIR/ttweetsrv" "$PORT" > /dev/null &
+SRV_PID=$!
+trap 'kill -TERM $SRV_PID 2>/dev/null || true' EXIT
+sleep 1
+
+"$BUILD_DIR/ttweetbench" -s 1 -c 4 -r 2000 -d 3 -H 64 -z 1.0 -n 2 \
+  -m tweet=40,timeline=30,subscribe=12,unsubscribe=10,validate=8 \
+  127.0.0.1 "$PORT" > /dev/null
+
+printf '%s\n' 'subscribe #pgo' 'tweet "profile guided" #pgo' 'timeline' \
+  'getusers' 'gettweets pgotrainer' 'unsubscribe #pgo' 'exit' |
+  "$BUILD_DIR/ttweetcli" 127.0.0.1 "$PORT" pgotrainer > /dev/null || true
+
+kill -TERM $SRV_PID
+wait $SRV_PID || true
+trap - EXIT
@@ -0,0 +1,690 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweetbench.c
+  * @date 18 October 2026
+  * @brief ttweetbench generates open-loop load against a ttweetsrv server.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  *
+  * ttweetbench opens many non-blocking connections speaking the real ttweet
+  * protocol and drives them from a single epoll loop. Requests arrive at a
+  * fixed (or Poisson) rate regardless of how fast the server answers, and
+  * latency is measured from the time a request was scheduled rather than
+  * sent, so a slow server cannot hide its queueing delay (no coordinated
+  * omission).
+  *
+  * Usage: ./ttweetbench [options] <ServerIP> <ServerPort>
+  *   -c <n>     concurrent connections (default 100)
+  *   -r <n>     target requests per second (default 100)
+  *   -d <s>     measured duration in seconds (default 10)
+  *   -m <mix>   operation weights, e.g. tweet=40,timeline=40,subscribe=10,unsubscribe=10,validate=0
+  *   -H <n>     number of distinct hashtags (default 100)
+  *   -z <s>     zipf exponent of hashtag popularity, 0 for uniform (default 1.0)
+  *   -n <n>     hashtags per tweet (default 1)
+  *   -u <name>  username prefix (default "b")
+  *   -S <s>     seconds allowed for connection setup (default 30)
+  *   -D <s>     seconds allowed to drain outstanding responses (default 10)
+  *   -P         Poisson arrivals instead of a fixed interval
+  *   -s <n>     random seed, so a workload can be repeated exactly
+  *   -j         print the report as JSON
+  */
+
+#include "ttweetbench.h"
+#include <math.h>         /* for pow() and log() */
+#include <fcntl.h>        /* for fcntl() */
+#include <sys/epoll.h>    /* for epoll_wait() */
+#include <sys/resource.h> /* for setrlimit() */
+
+/* Function prototypes */
+
+/* functions to configure the benchmark */
+void parse_bench_options(int argc, char *argv[], BenchConfig *config); /* Parses command line options */
+int parse_bench_mix(char *mixString, int mix[]);                       /* Parses an operation mix */
+void build_hashtag_distribution();                                     /* Precomputes hashtag popularity */
+int sample_hashtag();                                                  /* Draws a hashtag index */
+
+/* functions to drive connections */
+void open_bench_connection(BenchConn *conn, uint64_t intendedNs, int measure); /* Opens a connection and queues validation */
+void kill_bench_connection(BenchConn *conn);                                   /* Closes a connection */
+void dispatch_operation(uint64_t intendedNs);                                  /* Schedules one operation */
+int queue_request(BenchConn *conn, int op, uint64_t intendedNs, int measure);  /* Encodes and queues a request */
+void flush_bench_connection(BenchConn *conn);                                  /* Writes pending output */
+void drain_bench_connection(BenchConn *conn);                                  /* Reads complete responses */
+
+/* functions to report results */
+void print_bench_report(uint64_t elapsedNs); /* Prints the final report */
+
+/* Static helpers */
+static uint64_t next_random();
+static double next_uniform();
+static void update_epoll_interest(BenchConn *conn);
+
+/* Global variables */
+static BenchConfig config;        /* Benchmark configuration */
+static BenchConn *conns;          /* All connections */
+static BenchStats stats;          /* Results of the measured phase */
+static int epollFd;               /* Event loop */
+static struct sockaddr_in servAddr; /* ttweet server address */
+static double *hashtagCdf;        /* Cumulative hashtag popularity */
+static int mixTotal;              /* Sum of all mix weights */
+static int nextConnIdx = 0;       /* Round-robin dispatch cursor */
+static int inflightTotal = 0;     /* Requests awaiting a response */
+static uint64_t rngState = 0x9E3779B97F4A7C15ULL;
+
+static const char *opNames[BENCH_OP_COUNT] = {"validate", "tweet", "subscribe", "unsubscribe", "timeline"};
+static const int opRequestCodes[BENCH_OP_COUNT] = {REQ_VALIDATE_USER, REQ_TWEET, REQ_SUBSCRIBE, REQ_UNSUBSCRIBE, REQ_TIMELINE};
+
+int main(int argc, char *argv[])
+{
+  struct epoll_event events[1024];
+  struct rlimit fileLimit;
+  uint64_t startNs;
+  uint64_t nowNs;
+  uint64_t endNs;
+  uint64_t nextArrivalNs;
+  uint64_t nextProgressNs;
+  uint64_t lastCompleted = 0;
+  double intervalNs;
+  int numReady;
+  int timeoutMs;
+
+  parse_bench_options(argc, argv, &config);
+  build_hashtag_distribution();
+  signal(SIGPIPE, SIG_IGN);
+
+  /* Thousands of connections need more than the default 1024 descriptors */
+  if (getrlimit(RLIMIT_NOFILE, &fileLimit) == 0 && fileLimit.rlim_cur < fileLimit.rlim_max)
+  {
+    fileLimit.rlim_cur = fileLimit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &fileLimit);
+  }
+
+  memset(&servAddr, 0, sizeof(servAddr));
+  servAddr.sin_family = AF_INET;
+  servAddr.sin_addr.s_addr = inet_addr(config.servIP);
+  servAddr.sin_port = htons(config.port);
+
+  if ((epollFd = epoll_create1(0)) < 0)
+    die_with_error("epoll_create1() failed");
+  if ((conns = calloc(config.numConns, sizeof(BenchConn))) == NULL)
+    die_with_error("calloc() failed");
+
+  /* Setup phase: connect and validate every user, not measured */
+  startNs = histogram_now_ns();
+  for (int connIdx = 0; connIdx < config.numConns; connIdx++)
+  {
+    conns[connIdx].idx = connIdx;
+    open_bench_connection(&conns[connIdx], startNs, 0);
+  }
+  while (inflightTotal > 0 && histogram_now_ns() - startNs < config.setupTimeout * 1e9)
+  {
+    numReady = epoll_wait(epollFd, events, 1024, 100);
+    for (int eventIdx = 0; eventIdx < numReady; eventIdx++)
+    {
+      BenchConn *conn = events[eventIdx].data.ptr;
+      if (events[eventIdx].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+        flush_bench_connection(conn);
+      if (events[eventIdx].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+        drain_bench_connection(conn);
+    }
+  }
+  numReady = 0;
+  for (int connIdx = 0; connIdx < config.numConns; connIdx++)
+    numReady += conns[connIdx].state == CONN_READY;
+  fprintf(stderr, "setup: %d/%d connections ready in %.2fs\n", numReady, config.numConns, (histogram_now_ns() - startNs) / 1e9);
+  memset(&stats, 0, sizeof(stats));
+
+  /* Measured phase: open-loop arrivals */
+  intervalNs = 1e9 / config.rate;
+  startNs = histogram_now_ns();
+  endNs = startNs + (uint64_t)(config.duration * 1e9);
+  nextArrivalNs = startNs;
+  nextProgressNs = startNs + 1000000000ULL;
+
+  while (1)
+  {
+    nowNs = histogram_now_ns();
+    if (nowNs < endNs)
+    { /* Dispatch every arrival that is due */
+      while (nextArrivalNs <= nowNs)
+      {
+        dispatch_operation(nextArrivalNs);
+        nextArrivalNs += config.poisson ? (uint64_t)(-log(1.0 - next_uniform()) * intervalNs) : (uint64_t)intervalNs;
+      }
+      timeoutMs = (int)((nextArrivalNs - nowNs + 999999) / 1000000);
+    }
+    else if (inflightTotal == 0 || nowNs - endNs > config.drainTimeout * 1e9)
+    { /* Load finished and drained (or gave up draining) */
+      break;
+    }
+    else
+    {
+      timeoutMs = 100;
+    }
+
+    if (nowNs >= nextProgressNs)
+    { /* Progress line once per second */
+      uint64_t completed = 0;
+      for (int op = 0; op < BENCH_OP_COUNT; op++)
+        completed += stats.completed[op];
+      fprintf(stderr, "t=%.0fs completed/s=%llu inflight=%d\n", (nowNs - startNs) / 1e9,
+              (unsigned long long)(completed - lastCompleted), inflightTotal);
+      lastCompleted = completed;
+      nextProgressNs += 1000000000ULL;
+    }
+
+    numReady = epoll_wait(epollFd, events, 1024, timeoutMs);
+    for (int eventIdx = 0; eventIdx < numReady; eventIdx++)
+    {
+      BenchConn *conn = events[eventIdx].data.ptr;
+      if (events[eventIdx].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+        flush_bench_connection(conn);
+      if (events[eventIdx].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+        drain_bench_connection(conn);
+    }
+  }
+
+  print_bench_report((endNs < histogram_now_ns() ? endNs : histogram_now_ns()) - startNs);
+  return 0;
+}
+
+/** \copydoc parse_bench_options */
+void parse_bench_options(int argc, char *argv[], BenchConfig *config)
+{
+  int opt;
+  char *usage = "Usage: ./ttweetbench [-c conns] [-r rate] [-d secs] [-m mix] [-H hashtags] [-z zipf] [-n tagsPerTweet] [-u prefix] [-S secs] [-D secs] [-P] [-s seed] [-j] <ServerIP> <ServerPort>\n";
+
+  memset(config, 0, sizeof(*config));
+  config->numConns = 100;
+  config->rate = 100;
+  config->duration = 10;
+  config->setupTimeout = 30;
+  config->drainTimeout = 10;
+  config->numHashtags = 100;
+  config->zipfExponent = 1.0;
+  config->hashtagsPerTweet = 1;
+  config->userPrefix = "b";
+  parse_bench_mix("tweet=40,timeline=40,subscribe=10,unsubscribe=10", config->mix);
+
+  while ((opt = getopt(argc, argv, "c:r:d:m:H:z:n:u:S:D:Ps:j")) != -1)
+  {
+    switch (opt)
+    {
+    case 'c':
+      config->numConns = atoi(optarg);
+      break;
+    case 'r':
+      config->rate = atof(optarg);
+      break;
+    case 'd':
+      config->duration = atof(optarg);
+      break;
+    case 'm':
+      if (!parse_bench_mix(optarg, config->mix))
+        die_with_error("Invalid mix. Expected op=weight pairs with ops validate, tweet, subscribe, unsubscribe, timeline.\n");
+      break;
+    case 'H':
+      config->numHashtags = atoi(optarg);
+      break;
+    case 'z':
+      config->zipfExponent = atof(optarg);
+      break;
+    case 'n':
+      config->hashtagsPerTweet = atoi(optarg);
+      break;
+    case 'u':
+      config->userPrefix = optarg;
+      break;
+    case 'S':
+      config->setupTimeout = atof(optarg);
+      break;
+    case 'D':
+      config->drainTimeout = atof(optarg);
+      break;
+    case 'P':
+      config->poisson = 1;
+      break;
+    case 's':
+      rngState = strtoull(optarg, NULL, 10) * 0x9E3779B97F4A7C15ULL + 1; /* never 0 */
+      break;
+    case 'j':
+      config->jsonOutput = 1;
+      break;
+    default:
+      die_with_error(usage);
+    }
+  }
+
+  if (argc - optind != 2)
+    die_with_error(usage);
+  config->servIP = argv[optind];
+  config->port = atoi(argv[optind + 1]);
+
+  if (config->numConns <= 0 || config->rate <= 0 || config->duration <= 0 || config->numHashtags <= 0)
+    die_with_error("Connections, rate, duration and hashtags must be positive.\n");
+  if (config->hashtagsPerTweet < 1 || config->hashtagsPerTweet > MAX_HASHTAG_CNT || config->hashtagsPerTweet > config->numHashtags)
+    die_with_error("Hashtags per tweet must be between 1 and MAX_HASHTAG_CNT and not exceed the number of hashtags.\n");
+  if (strlen(config->userPrefix) > 8)
+    die_with_error("Username prefix must be at most 8 characters.\n");
+}
+
+/** \copydoc parse_bench_mix */
+int parse_bench_mix(char *mixString, int mix[])
+{
+  char buffer[256];
+  char *saveptr;
+  char *pair;
+
+  strncpy(buffer, mixString, sizeof(buffer) - 1);
+  buffer[sizeof(buffer) - 1] = '\0';
+  memset(mix, 0, sizeof(int) * BENCH_OP_COUNT);
+  mixTotal = 0;
+
+  for (pair = strtok_r(buffer, ",", &saveptr); pair != NULL; pair = strtok_r(NULL, ",", &saveptr))
+  {
+    char *equals = strchr(pair, '=');
+    int op;
+    if (equals == NULL)
+      return 0;
+    *equals = '\0';
+    for (op = 0; op < BENCH_OP_COUNT; op++)
+    {
+      if (strcmp(pair, opNames[op]) == 0)
+        break;
+    }
+    if (op == BENCH_OP_COUNT || atoi(equals + 1) < 0)
+      return 0;
+    mix[op] = atoi(equals + 1);
+    mixTotal += mix[op];
+  }
+  return mixTotal > 0;
+}
+
+/** \copydoc build_hashtag_distribution */
+void build_hashtag_distribution()
+{
+  double total = 0;
+
+  hashtagCdf = malloc(sizeof(double) * config.numHashtags);
+  for (int rank = 0; rank < config.numHashtags; rank++)
+  { /* weight of rank r is 1 / (r + 1)^s */
+    total += 1.0 / pow(rank + 1, config.zipfExponent);
+    hashtagCdf[rank] = total;
+  }
+  for (int rank = 0; rank < config.numHashtags; rank++)
+    hashtagCdf[rank] /= total;
+}
+
+/** \copydoc sample_hashtag */
+int sample_hashtag()
+{
+  double target = next_uniform();
+  int low = 0;
+  int high = config.numHashtags - 1;
+
+  while (low < high)
+  { /* first rank whose cumulative weight reaches target */
+    int mid = (low + high) / 2;
+    if (hashtagCdf[mid] < target)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+/** \copydoc open_bench_connection */
+void open_bench_connection(BenchConn *conn, uint64_t intendedNs, int measure)
+{
+  struct epoll_event event;
+
+  payload_reader_reset(&conn->reader);
+  conn->outLen = 0;
+  conn->outOff = 0;
+  conn->inflightHead = 0;
+  conn->inflightCount = 0;
+  snprintf(conn->username, sizeof(conn->username), "%s%dg%d", config.userPrefix, conn->idx, conn->generation);
+
+  if ((conn->sock = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0)
+    die_with_error("socket() failed");
+  fcntl(conn->sock, F_SETFL, fcntl(conn->sock, F_GETFL) | O_NONBLOCK);
+  if (connect(conn->sock, (struct sockaddr *)&servAddr, sizeof(servAddr)) < 0 && errno != EINPROGRESS)
+  {
+    kill_bench_connection(conn);
+    return;
+  }
+
+  conn->state = CONN_CONNECTING;
+  event.events = EPOLLIN | EPOLLOUT;
+  event.data.ptr = conn;
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, conn->sock, &event);
+  queue_request(conn, BENCH_OP_VALIDATE, intendedNs, measure);
+}
+
+/** \copydoc kill_bench_connection */
+void kill_bench_connection(BenchConn *conn)
+{
+  if (conn->state != CONN_DEAD)
+    stats.connErrors++;
+  if (conn->sock >= 0)
+  {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->sock, NULL);
+    close(conn->sock);
+  }
+  conn->sock = -1;
+  conn->state = CONN_DEAD;
+  inflightTotal -= conn->inflightCount;
+  conn->inflightCount = 0;
+}
+
+/** \copydoc dispatch_operation */
+void dispatch_operation(uint64_t intendedNs)
+{
+  int pick = (int)(next_random() % mixTotal);
+  int op = 0;
+
+  while (pick >= config.mix[op])
+  { /* weighted choice of operation */
+    pick -= config.mix[op];
+    op++;
+  }
+
+  for (int attempt = 0; attempt < config.numConns; attempt++)
+  { /* round-robin over connections that can take the request */
+    BenchConn *conn = &conns[nextConnIdx];
+    nextConnIdx = (nextConnIdx + 1) % config.numConns;
+    if (conn->state != CONN_READY || conn->inflightCount == BENCH_MAX_INFLIGHT)
+      continue;
+
+    if (op == BENCH_OP_VALIDATE)
+    { /* Churn: leave cleanly and come back as a fresh user */
+      char exitPayload[256];
+      cJSON *jobjToSend;
+      int exitLen;
+      if (conn->inflightCount > 0)
+        continue;
+      jobjToSend = cJSON_CreateObject();
+      cJSON_AddItemToObject(jobjToSend, "requestCode", cJSON_CreateNumber(REQ_EXIT));
+      cJSON_AddItemToObject(jobjToSend, "username", cJSON_CreateString(conn->username));
+      exitLen = encode_payload(jobjToSend, exitPayload, sizeof(exitPayload));
+      cJSON_Delete(jobjToSend);
+      send(conn->sock, exitPayload, exitLen, 0);
+      epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->sock, NULL);
+      close(conn->sock);
+      conn->generation++;
+      stats.sent[op]++;
+      open_bench_connection(conn, intendedNs, 1);
+      return;
+    }
+
+    if (queue_request(conn, op, intendedNs, 1))
+    {
+      stats.sent[op]++;
+      flush_bench_connection(conn);
+      return;
+    }
+  }
+  stats.skipped++;
+}
+
+/** \copydoc queue_request */
+int queue_request(BenchConn *conn, int op, uint64_t intendedNs, int measure)
+{
+  cJSON *jobjToSend = cJSON_CreateObject();
+  char hashtag[MAX_HASHTAG_LEN];
+  int encodedLen;
+  int slot;
+
+  cJSON_AddItemToObject(jobjToSend, "requestCode", cJSON_CreateNumber(opRequestCodes[op]));
+  cJSON_AddItemToObject(jobjToSend, "username", cJSON_CreateString(conn->username));
+
+  switch (op)
+  { /* Same request shapes as create_json_client_payload() */
+  case BENCH_OP_TWEET:
+  {
+    cJSON *jarray = cJSON_CreateArray();
+    int chosen[MAX_HASHTAG_CNT];
+    int numChosen = 0;
+    while (numChosen < config.hashtagsPerTweet)
+    { /* distinct hashtags, as the client enforces */
+      int candidate = sample_hashtag();
+      int duplicate = 0;
+      for (int chosenIdx = 0; chosenIdx < numChosen; chosenIdx++)
+        duplicate |= chosen[chosenIdx] == candidate;
+      if (duplicate)
+        continue;
+      chosen[numChosen++] = candidate;
+      snprintf(hashtag, sizeof(hashtag), "tag%d", candidate);
+      cJSON_AddItemToArray(jarray, cJSON_CreateString(hashtag));
+    }
+    cJSON_AddItemToObject(jobjToSend, "ttweetString", cJSON_CreateString("ttweetbench load generator message"));
+    cJSON_AddItemToObject(jobjToSend, "numValidHashtags", cJSON_CreateNumber(numChosen));
+    cJSON_AddItemToObject(jobjToSend, "ttweetHashtags", jarray);
+    break;
+  }
+  case BENCH_OP_SUBSCRIBE:
+  case BENCH_OP_UNSUBSCRIBE:
+    snprintf(hashtag, sizeof(hashtag), "tag%d", sample_hashtag());
+    cJSON_AddItemToObject(jobjToSend, "subscriptionHashtag", cJSON_CreateString(hashtag));
+    break;
+  default:
+    break;
+  }
+
+  encodedLen = encode_payload(jobjToSend, conn->outBuf + conn->outLen, BENCH_OUT_BUF_SIZE - conn->outLen);
+  cJSON_Delete(jobjToSend);
+  if (encodedLen == 0)
+    return 0;
+
+  conn->outLen += encodedLen;
+  slot = (conn->inflightHead + conn->inflightCount) % BENCH_MAX_INFLIGHT;
+  conn->inflightOps[slot] = measure ? op : -1;
+  conn->inflightStart[slot] = intendedNs;
+  conn->inflightCount++;
+  inflightTotal++;
+  update_epoll_interest(conn);
+  return 1;
+}
+
+/** \copydoc flush_bench_connection */
+void flush_bench_connection(BenchConn *conn)
+{
+  int bytesSent;
+
+  if (conn->state == CONN_DEAD)
+    return;
+
+  if (conn->state == CONN_CONNECTING)
+  { /* First writability event completes connect() */
+    int error = 0;
+    socklen_t errorLen = sizeof(error);
+    getsockopt(conn->sock, SOL_SOCKET, SO_ERROR, &error, &errorLen);
+    if (error != 0)
+    {
+      kill_bench_connection(conn);
+      return;
+    }
+    conn->state = CONN_VALIDATING;
+  }
+
+  while (conn->outOff < conn->outLen)
+  {
+    bytesSent = send(conn->sock, conn->outBuf + conn->outOff, conn->outLen - conn->outOff, 0);
+    if (bytesSent < 0)
+    {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        kill_bench_connection(conn);
+      break;
+    }
+    conn->outOff += bytesSent;
+    stats.bytesOut += bytesSent;
+  }
+
+  if (conn->state != CONN_DEAD && conn->outOff == conn->outLen)
+  { /* Everything sent: reuse the buffer from the start */
+    conn->outOff = 0;
+    conn->outLen = 0;
+  }
+  if (conn->state != CONN_DEAD)
+    update_epoll_interest(conn);
+}
+
+/** \copydoc drain_bench_connection */
+void drain_bench_connection(BenchConn *conn)
+{
+  int status;
+
+  while (conn->state != CONN_DEAD && conn->state != CONN_CONNECTING)
+  {
+    status = receive_payload_nonblocking(conn->sock, &conn->reader);
+    if (status == 0)
+      return;
+    if (status < 0)
+    { /* Closed by server */
+      kill_bench_connection(conn);
+      return;
+    }
+
+    uint64_t nowNs = histogram_now_ns();
+    cJSON *jobjReceived = cJSON_Parse(conn->reader.payload);
+    cJSON *responseCode = cJSON_GetObjectItemCaseSensitive(jobjReceived, "responseCode");
+
+    stats.bytesIn += RCV_BUF_SIZE + conn->reader.payloadSize;
+    if (cJSON_IsNumber(responseCode) && responseCode->valueint == RES_PING)
+    { /* Heartbeat of a quiet connection, not a response to a request */
+      payload_reader_reset(&conn->reader);
+      cJSON_Delete(jobjReceived);
+      continue;
+    }
+    if (conn->inflightCount == 0)
+    { /* An unsolicited response */
+      cJSON_Delete(jobjReceived);
+      kill_bench_connection(conn);
+      return;
+    }
+
+    int op = conn->inflightOps[conn->inflightHead];
+    uint64_t intendedNs = conn->inflightStart[conn->inflightHead];
+    conn->inflightHead = (conn->inflightHead + 1) % BENCH_MAX_INFLIGHT;
+    conn->inflightCount--;
+    inflightTotal--;
+    payload_reader_reset(&conn->reader);
+
+    if (op >= 0)
+    {
+      stats.completed[op]++;
+      histogram_record(&stats.latency[op], nowNs - intendedNs);
+    }
+
+    if (conn->state == CONN_VALIDATING)
+    {
+      if (cJSON_IsNumber(responseCode) && responseCode->valueint == RES_USER_VALID)
+        conn->state = CONN_READY;
+      else
+      {
+        stats.rejected++;
+        cJSON_Delete(jobjReceived);
+        kill_bench_connection(conn);
+        return;
+      }
+    }
+    cJSON_Delete(jobjReceived);
+  }
+}
+
+/** \copydoc print_bench_report */
+void print_bench_report(uint64_t elapsedNs)
+{
+  static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+  static const char *quantileNames[] = {"p50", "p90", "p99", "p999"};
+  uint64_t sentTotal = 0;
+  uint64_t completedTotal = 0;
+  double seconds = elapsedNs / 1e9;
+  Histogram overall;
+
+  memset(&overall, 0, sizeof(overall));
+  for (int op = 0; op < BENCH_OP_COUNT; op++)
+  {
+    sentTotal += stats.sent[op];
+    completedTotal += stats.completed[op];
+    histogram_merge(&overall, &stats.latency[op]);
+  }
+
+  if (config.jsonOutput)
+  {
+    printf("{\"connections\":%d,\"targetRate\":%.1f,\"durationSec\":%.3f,\"sent\":%llu,\"completed\":%llu,"
+           "\"throughput\":%.1f,\"skipped\":%llu,\"unanswered\":%d,\"connErrors\":%llu,\"rejected\":%llu,"
+           "\"bytesOut\":%llu,\"bytesIn\":%llu,\"latencyUs\":{",
+           config.numConns, config.rate, seconds, (unsigned long long)sentTotal, (unsigned long long)completedTotal,
+           completedTotal / seconds, (unsigned long long)stats.skipped, inflightTotal, (unsigned long long)stats.connErrors,
+           (unsigned long long)stats.rejected, (unsigned long long)stats.bytesOut, (unsigned long long)stats.bytesIn);
+    for (int op = -1; op < BENCH_OP_COUNT; op++)
+    {
+      Histogram *histogram = op < 0 ? &overall : &stats.latency[op];
+      if (op >= 0 && histogram->count == 0)
+        continue;
+      printf("%s\"%s\":{\"count\":%llu", op < 0 ? "" : ",", op < 0 ? "all" : opNames[op], (unsigned long long)histogram->count);
+      for (int quantileIdx = 0; quantileIdx < 4; quantileIdx++)
+        printf(",\"%s\":%.1f", quantileNames[quantileIdx], histogram_quantile(histogram, quantiles[quantileIdx]) / 1e3);
+      printf(",\"max\":%.1f,\"mean\":%.1f}", histogram->max / 1e3, histogram->count ? histogram->sum / 1e3 / histogram->count : 0);
+    }
+    printf("}}\n");
+    return;
+  }
+
+  printf("connections: %d  target rate: %.1f/s  duration: %.2fs\n", config.numConns, config.rate, seconds);
+  printf("sent: %llu  completed: %llu  throughput: %.1f/s\n", (unsigned long long)sentTotal, (unsigned long long)completedTotal, completedTotal / seconds);
+  printf("skipped: %llu  unanswered: %d  connection errors: %llu  rejected: %llu\n", (unsigned long long)stats.skipped,
+         inflightTotal, (unsigned long long)stats.connErrors, (unsigned long long)stats.rejected);
+  printf("bytes out: %llu  bytes in: %llu\n", (unsigned long long)stats.bytesOut, (unsigned long long)stats.bytesIn);
+  printf("%-12s %10s %10s %10s %10s %10s %10s %10s\n", "latency(us)", "count", "p50", "p90", "p99", "p99.9", "max", "mean");
+  for (int op = -1; op < BENCH_OP_COUNT; op++)
+  {
+    Histogram *histogram = op < 0 ? &overall : &stats.latency[op];
+    if (histogram->count == 0)
+      continue;
+    printf("%-12s %10llu", op < 0 ? "all" : opNames[op], (unsigned long long)histogram->count);
+    for (int quantileIdx = 0; quantileIdx < 4; quantileIdx++)
+      printf(" %10.1f", histogram_quantile(histogram, quantiles[quantileIdx]) / 1e3);
+    printf(" %10.1f %10.1f\n", histogram->max / 1e3, histogram->sum / 1e3 / histogram->count);
+  }
+}
+
+/* xorshift64* generator */
+static uint64_t next_random()
+{
+  rngState ^= rngState >> 12;
+  rngState ^= rngState << 25;
+  rngState ^= rngState >> 27;
+  return rngState * 0x2545F4914F6CDD1DULL;
+}
+
+/* Uniform double in [0, 1) */
+static double next_uniform()
+{
+  return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Only ask for writability while output is pending */
+static void update_epoll_interest(BenchConn *conn)
+{
+  struct epoll_event event;
+
+  if (conn->sock < 0)
+    return;
+  event.events = EPOLLIN;
+  if (conn->state == CONN_CONNECTING || conn->outOff < conn->outLen)
+    event.events |= EPOLLOUT;
+  event.data.ptr = conn;
+  epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->sock, &event);
+}
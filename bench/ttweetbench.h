@@ -0,0 +1,190 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweetbench.h
+  * @date 18 October 2026
+  * @brief Documentation for functions in ttweetbench.c.
+  *
+  * This header file has been created to describe the functions in ttweetbench.c.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  */
+
+#ifndef TTWEET_COMMON_H
+#define TTWEET_COMMON_H
+#include "../dependencies/ttweet_common.h"
+void die_with_error(char *errorMessage);
+int persist_with_error(char *errorMessage);
+int send_payload(int sock, cJSON *jobjToSend);
+int receive_response(int sock, char *objReceived);
+#endif
+
+#include "../dependencies/ttweet_histogram.h"
+
+/* Benchmark operations */
+#define BENCH_OP_VALIDATE 0 /* Reconnect and validate a fresh username */
+#define BENCH_OP_TWEET 1
+#define BENCH_OP_SUBSCRIBE 2
+#define BENCH_OP_UNSUBSCRIBE 3
+#define BENCH_OP_TIMELINE 4
+#define BENCH_OP_COUNT 5
+
+/* Connection states */
+#define CONN_CONNECTING 0 /* Non-blocking connect() in progress */
+#define CONN_VALIDATING 1 /* Username sent, waiting for validation */
+#define CONN_READY 2      /* Accepting requests */
+#define CONN_DEAD 3       /* Closed by server or failed */
+
+/* Limits */
+#define BENCH_MAX_INFLIGHT 64   /* Pipelined requests per connection */
+#define BENCH_OUT_BUF_SIZE 4096 /* Unsent bytes per connection */
+
+typedef struct BenchConfig
+{
+  char *servIP;          /* Server IP address (dotted quad) */
+  unsigned short port;   /* Server port */
+  int numConns;          /* Concurrent connections */
+  double rate;           /* Target requests per second across all connections */
+  double duration;       /* Seconds of measured load */
+  double setupTimeout;   /* Seconds to wait for all connections to validate */
+  double drainTimeout;   /* Seconds to wait for outstanding responses after load */
+  int poisson;           /* Exponential inter-arrival times instead of fixed */
+  int mix[BENCH_OP_COUNT]; /* Relative weight of each operation */
+  int numHashtags;       /* Distinct hashtags to draw from */
+  double zipfExponent;   /* 0 for uniform hashtag popularity */
+  int hashtagsPerTweet;  /* Hashtags attached to every tweet */
+  char *userPrefix;      /* Username prefix */
+  int jsonOutput;        /* Print report as a JSON object */
+} BenchConfig;
+
+typedef struct BenchConn
+{
+  int sock;
+  int state;
+  int idx;                                 /* Index of connection, part of username */
+  int generation;                          /* Number of reconnects, part of username */
+  char username[MAX_USERNAME_LEN];         /* Username validated on this connection */
+  PayloadReader reader;                    /* Partial response */
+  char outBuf[BENCH_OUT_BUF_SIZE];         /* Bytes waiting to be sent */
+  int outLen;                              /* Bytes used in outBuf */
+  int outOff;                              /* Bytes of outBuf already sent */
+  int inflightOps[BENCH_MAX_INFLIGHT];     /* Operations awaiting a response, in order */
+  uint64_t inflightStart[BENCH_MAX_INFLIGHT]; /* Intended send time of each operation */
+  int inflightHead;
+  int inflightCount;
+} BenchConn;
+
+typedef struct BenchStats
+{
+  Histogram latency[BENCH_OP_COUNT]; /* Nanoseconds from intended send to response */
+  uint64_t sent[BENCH_OP_COUNT];
+  uint64_t completed[BENCH_OP_COUNT];
+  uint64_t skipped;       /* Arrivals with no eligible connection */
+  uint64_t connErrors;    /* Connections closed or refused */
+  uint64_t rejected;      /* Validations refused by the server */
+  uint64_t bytesOut;
+  uint64_t bytesIn;
+} BenchStats;
+
+/**
+ * @brief Parses command line options into config
+ *
+ * @param argc Argument count
+ * @param argv Argument vector
+ * @param config Benchmark configuration to fill
+ * @return void
+ */
+void parse_bench_options(int argc, char *argv[], BenchConfig *config);
+
+/**
+ * @brief Parses an operation mix such as "tweet=50,timeline=50"
+ *
+ * @param mixString Comma separated op=weight pairs
+ * @param mix Weights indexed by BENCH_OP_*
+ * @return int 1 if valid, 0 otherwise
+ */
+int parse_bench_mix(char *mixString, int mix[]);
+
+/**
+ * @brief Precomputes the cumulative hashtag popularity distribution
+ *
+ * @return void
+ */
+void build_hashtag_distribution();
+
+/**
+ * @brief Draws a hashtag index from the configured distribution
+ *
+ * @return int Hashtag index in [0, numHashtags)
+ */
+int sample_hashtag();
+
+/**
+ * @brief Opens a non-blocking connection and queues username validation
+ *
+ * @param conn Connection to open
+ * @param intendedNs Time at which the validation was scheduled
+ * @param measure Record latency of the validation when 1
+ * @return void
+ */
+void open_bench_connection(BenchConn *conn, uint64_t intendedNs, int measure);
+
+/**
+ * @brief Closes a connection and marks it dead
+ *
+ * @param conn Connection to close
+ * @return void
+ */
+void kill_bench_connection(BenchConn *conn);
+
+/**
+ * @brief Schedules one operation on an eligible connection
+ *
+ * @param intendedNs Time at which the operation was scheduled
+ * @return void
+ */
+void dispatch_operation(uint64_t intendedNs);
+
+/**
+ * @brief Encodes a request for op and appends it to conn's output buffer
+ *
+ * @param conn Connection to send on
+ * @param op Operation (BENCH_OP_*)
+ * @param intendedNs Time at which the operation was scheduled
+ * @param measure Record latency of the operation when 1
+ * @return int 1 if queued, 0 if the output buffer is full
+ */
+int queue_request(BenchConn *conn, int op, uint64_t intendedNs, int measure);
+
+/**
+ * @brief Writes as much of conn's output buffer as the socket accepts
+ *
+ * @param conn Connection to flush
+ * @return void
+ */
+void flush_bench_connection(BenchConn *conn);
+
+/**
+ * @brief Reads and accounts for every complete response on conn
+ *
+ * @param conn Connection to read from
+ * @return void
+ */
+void drain_bench_connection(BenchConn *conn);
+
+/**
+ * @brief Prints the final report
+ *
+ * @param elapsedNs Length of the measured phase in nanoseconds
+ * @return void
+ */
+void print_bench_report(uint64_t elapsedNs);
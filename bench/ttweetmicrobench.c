@@ -0,0 +1,1624 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweetmicrobench.c
+  * @date 18 October 2026
+  * @brief ttweetmicrobench measures the protocol and fan-out hot paths.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  *
+  * The server functions are linked in directly (ttweetsrv.c built with
+  * TTWEETSRV_NO_MAIN) and run against a private, heap allocated user table.
+  * Allocations are counted by wrapping malloc() and friends at link time
+  * (-Wl,--wrap=malloc,...), and CPU cycles and instructions come from
+  * perf_event_open() when the kernel allows it.
+  *
+  * Results are printed to stdout as JSON so they can be kept per commit.
+  * Before measuring, the SSE4.2 and AVX2 validators and matchers are
+  * compared with the scalar ones on random inputs, and the program fails
+  * if they disagree.
+  *
+  * Usage: ./ttweetmicrobench [-f <filter>] [-t <ms per run>] [-c <baseline.json>] [-s <seed>]
+  */
+
+#include "ttweetmicrobench.h"
+#include <linux/perf_event.h> /* for perf_event_attr */
+#include <sys/ioctl.h>        /* for ioctl() */
+#include <sys/syscall.h>      /* for SYS_perf_event_open */
+
+#ifndef BENCH_COMMIT
+#define BENCH_COMMIT "unknown"
+#endif
+
+/* Function prototypes */
+
+/* functions to measure benchmarks */
+void bench_timer_start();                                                              /* Resumes measurement */
+void bench_timer_stop();                                                               /* Pauses measurement */
+void run_microbench(MicroBench *bench, uint64_t iterations, MicroBenchResult *result); /* Runs a fixed number of iterations */
+void measure_microbench(MicroBench *bench, uint64_t targetNs, MicroBenchResult *result); /* Calibrates and runs a benchmark */
+int open_perf_counters();                                                              /* Opens hardware counters */
+void compare_with_baseline(cJSON *results, char *baselinePath);                        /* Compares with an earlier report */
+
+/* functions to check implementations */
+int check_simd_levels(uint64_t seed); /* Compares every instruction set with scalar */
+
+/* Allocation counting, see -Wl,--wrap in the makefile */
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t count, size_t size);
+void *__wrap_realloc(void *ptr, size_t size);
+
+/* Benchmarks */
+static void setup_payload(int numTweets, int unused);
+static void run_payload_roundtrip(uint64_t iterations);
+static void teardown_payload();
+static void setup_tcp(int numTweets, int coalesce);
+static void run_tcp_roundtrip(uint64_t iterations);
+static void run_tcp_pipelined(uint64_t iterations);
+static void teardown_tcp();
+static void setup_json(int numTweets, int unused);
+static void run_encode_tweet_request(uint64_t iterations);
+static void run_decode_tweet_request(uint64_t iterations);
+static void run_encode_timeline_response(uint64_t iterations);
+static void run_decode_timeline_response(uint64_t iterations);
+static void teardown_json();
+static void setup_compress(int numTweets, int warm);
+static void run_compress_payload(uint64_t iterations);
+static void run_decompress_payload(uint64_t iterations);
+static void teardown_compress();
+static void setup_users(int numUsers, int numSubscriptions);
+static void run_handle_tweet_updates(uint64_t iterations);
+static void run_fanout_scan(uint64_t iterations);
+static void setup_match(int simdLevel, int numUsers);
+static void run_match_signatures(uint64_t iterations);
+static void setup_trie(int numPrefixes, int unused);
+static void run_prefix_trie_match(uint64_t iterations);
+static void run_prefix_scan(uint64_t iterations);
+static void run_prefix_trie_insert_remove(uint64_t iterations);
+static void teardown_trie();
+static void setup_keywords(int numKeywords, int unused);
+static void run_keyword_matcher_scan(uint64_t iterations);
+static void run_keyword_strstr(uint64_t iterations);
+static void teardown_keywords();
+static void setup_search(int numTweets, int queryIdx);
+static void run_search_index_query(uint64_t iterations);
+static void run_search_index_add(uint64_t iterations);
+static void teardown_search();
+static void setup_trending(int numHashtags, int unused);
+static void run_trending_tracker_add(uint64_t iterations);
+static void run_trending_tracker_top(uint64_t iterations);
+static void teardown_trending();
+static void setup_follow(int numFollowers, int isOnRead);
+static void setup_follow_pull(int numFollowed, int numOnRead);
+static void run_follow_graph_publish(uint64_t iterations);
+static void run_follow_graph_pull(uint64_t iterations);
+static void run_follow_graph_pull_oldest(uint64_t iterations);
+static void teardown_follow();
+
+static void setup_mailbox(int numMailboxes, int numTweets);
+static void run_mailbox_store_save(uint64_t iterations);
+static void run_mailbox_store_load(uint64_t iterations);
+static void teardown_mailbox();
+static void setup_spill(int numQueues, int numRecords);
+static void run_spill_store_append(uint64_t iterations);
+static void run_spill_store_pop(uint64_t iterations);
+static void teardown_spill();
+static void run_add_tweet_to_user(uint64_t iterations);
+static void run_add_pending_tweets_to_jobj(uint64_t iterations);
+static void run_add_pending_tweets_to_jobj_cursor(uint64_t iterations);
+static void teardown_users();
+static void setup_validate(int simdLevel, int unused);
+static void run_legacy_parse_hashtags(uint64_t iterations);
+static void run_split_hashtag_list(uint64_t iterations);
+static void run_is_valid_tweet_text(uint64_t iterations);
+
+/* Static helpers */
+static void clear_all_pending_tweets();
+static void fill_latest_tweet(int variant);
+static cJSON *create_tweet_request();
+static cJSON *create_timeline_response(int numTweets);
+static int legacy_parse_hashtags(char *validHashtags[], int *numValidHashtags, char *inputHashtags);
+static void count_prefix_match(int32_t value, void *count)
+{
+  (*(int *)count)++;
+}
+
+/* Deterministic alphanumeric words, the same every run */
+static void fill_random_words(char (*words)[PREFIX_TRIE_MAX_KEY_LEN + 1], int numWords, int minLen, int maxLen)
+{
+  static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+  uint32_t seed = 12345;
+  int len;
+
+  for (int wordIdx = 0; wordIdx < numWords; wordIdx++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    len = minLen + (seed >> 16) % (maxLen - minLen + 1);
+    for (int charIdx = 0; charIdx < len; charIdx++)
+    {
+      seed = seed * 1103515245u + 12345u;
+      words[wordIdx][charIdx] = alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+    }
+    words[wordIdx][len] = '\0';
+  }
+}
+
+static void report_signature_false_positives();
+static void count_prefix_match(int32_t value, void *count);
+static void fill_random_words(char (*words)[PREFIX_TRIE_MAX_KEY_LEN + 1], int numWords, int minLen, int maxLen);
+static void fill_search_tweet(char *text, int textLen, uint32_t *seed);
+static uint64_t next_check_random(uint64_t *seed);
+static void fill_check_text(char *text, int len, uint64_t *seed);
+static void fill_simd_check_input(SimdCheckInput *input, uint64_t *seed);
+static void compute_simd_check_outcome(SimdCheckInput *input, SimdCheckOutcome *outcome);
+static void report_simd_mismatch(int level, uint64_t round, SimdCheckOutcome *expected, SimdCheckOutcome *outcome);
+
+/* Measurement state */
+static uint64_t allocCount = 0;   /* Allocations since program start */
+static int measuring = 0;         /* Timer running */
+static uint64_t timerStartNs;     /* Start of current measured section */
+static uint64_t timerElapsedNs;   /* Measured time in this run */
+static uint64_t allocStart;       /* allocCount at start of current section */
+static uint64_t allocMeasured;    /* Allocations in this run */
+static int perfLeaderFd = -1;     /* Cycle counter, group leader */
+static int perfInstructionsFd = -1;
+
+/* Benchmark state */
+static int payloadSocks[2];
+static int tcpSocks[2]; /* Client and server ends of a loopback connection */
+static int tcpCoalesce;
+static cJSON *requestObject;
+static char payloadBuffer[MAX_RESP_LEN];
+static cJSON *payloadObject;
+static char *encodedJson;
+static CompressStream *benchCompressor;
+static CompressStream *benchDecompressor;
+static int benchCompressWarm; /* Streams keep their history between iterations */
+static char compressedJson[COMPRESS_BOUND(COMPRESS_MAX_INPUT)];
+static int compressedLen;
+static PrefixTrie *benchTrie;
+static char (*benchPrefixes)[PREFIX_TRIE_MAX_KEY_LEN + 1];
+static int numBenchPrefixes;
+static char benchPrefixHashtag[MAX_HASHTAG_LEN]; /* Longest hashtag, extending one of benchPrefixes */
+static KeywordMatcher *benchMatcher;
+static char (*benchKeywords)[PREFIX_TRIE_MAX_KEY_LEN + 1];
+static int numBenchKeywords;
+#define BENCH_SEARCH_WORDS 50000 /* Vocabulary of the search benchmarks */
+#define BENCH_SEARCH_TWEETS 4096 /* Distinct tweets added by run_search_index_add() */
+static SearchIndex *benchSearchIndex;
+static char benchSearchQuery[MAX_SEARCH_QUERY_LEN + 1];
+static char (*benchSearchTweets)[MAX_TWEET_LEN + 1]; /* Added in turn by run_search_index_add() */
+static char benchSearchHashtags[1][MAX_HASHTAG_LEN] = {"news"};
+static TrendingTracker *benchTrending;
+static char (*benchTrendingHashtags)[MAX_HASHTAG_LEN]; /* Every two are a tweet */
+static uint64_t benchTrendingNowMs; /* Advanced by 1 ms per tweet */
+static FollowGraph *benchFollows;
+static int32_t benchFollowAccount; /* Author of run_follow_graph_publish(), reader of run_follow_graph_pull() */
+static MailboxStore *benchMailboxes;
+static Mailbox benchMailbox;
+static char (*benchMailboxUsernames)[MAX_USERNAME_LEN]; /* Saved and loaded in turn */
+static int benchNumMailboxes;
+static SpillStore *benchSpill;
+static SpillQueue *benchSpillQueues;
+static int benchNumSpillQueues;
+static int benchSpillRecords; /* Records each queue starts with, and is refilled to once empty */
+static char benchSpillDir[] = "/tmp/ttweetmicrobench.XXXXXX";
+static char benchSpillItem[MAX_TWEET_ITEM_LEN];
+static char *benchHashtags = "#cats#dogs#news#tech#art"; /* 24 chars, 5 hashtags */
+static char *benchTweetText = "A tweet at the full one hundred and fifty character limit, which is what the validator has to scan "
+                              "on every tweet request the server receives now.";
+
+static MicroBench benches[] = {
+    {"send_payload+receive_response", "validate request", 0, 0, setup_payload, run_payload_roundtrip, teardown_payload},
+    {"send_payload+receive_response", "timeline response, 14 tweets", 14, 0, setup_payload, run_payload_roundtrip, teardown_payload},
+    {"tcp_roundtrip", "validate request and response", 0, 1, setup_tcp, run_tcp_roundtrip, teardown_tcp},
+    {"tcp_pipelined", "validate responses, 16 in flight, coalesce=0", 0, 0, setup_tcp, run_tcp_pipelined, teardown_tcp},
+    {"tcp_pipelined", "validate responses, 16 in flight, coalesce=1", 0, 1, setup_tcp, run_tcp_pipelined, teardown_tcp},
+    {"tcp_pipelined", "timeline responses (14 tweets), 16 in flight, coalesce=0", 14, 0, setup_tcp, run_tcp_pipelined, teardown_tcp},
+    {"tcp_pipelined", "timeline responses (14 tweets), 16 in flight, coalesce=1", 14, 1, setup_tcp, run_tcp_pipelined, teardown_tcp},
+    {"cjson_encode", "tweet request", 0, 0, setup_json, run_encode_tweet_request, teardown_json},
+    {"cjson_decode", "tweet request", 0, 0, setup_json, run_decode_tweet_request, teardown_json},
+    {"cjson_encode", "timeline response, 14 tweets", 14, 0, setup_json, run_encode_timeline_response, teardown_json},
+    {"cjson_decode", "timeline response, 14 tweets", 14, 0, setup_json, run_decode_timeline_response, teardown_json},
+    {"compress_payload", "timeline response, 14 tweets, first of connection", 14, 0, setup_compress, run_compress_payload, teardown_compress},
+    {"compress_payload", "timeline response, 14 tweets, repeated", 14, 1, setup_compress, run_compress_payload, teardown_compress},
+    {"decompress_payload", "timeline response, 14 tweets, first of connection", 14, 0, setup_compress, run_decompress_payload, teardown_compress},
+    {"handle_tweet_updates", "users=5 subscriptions=1", 5, 1, setup_users, run_handle_tweet_updates, teardown_users},
+    {"handle_tweet_updates", "users=5 subscriptions=3", 5, 3, setup_users, run_handle_tweet_updates, teardown_users},
+    {"handle_tweet_updates", "users=100 subscriptions=3", 100, 3, setup_users, run_handle_tweet_updates, teardown_users},
+    {"handle_tweet_updates", "users=1000 subscriptions=1", 1000, 1, setup_users, run_handle_tweet_updates, teardown_users},
+    {"handle_tweet_updates", "users=1000 subscriptions=3", 1000, 3, setup_users, run_handle_tweet_updates, teardown_users},
+    {"handle_tweet_updates", "users=10000 subscriptions=3", 10000, 3, setup_users, run_handle_tweet_updates, teardown_users},
+    {"fanout_scan", "users=10000 subscriptions=3, no recipients", 10000, 3, setup_users, run_fanout_scan, teardown_users},
+    {"fanout_scan", "scalar, users=10000 subscriptions=3, no recipients", SIMD_LEVEL_SCALAR, 10000, setup_match, run_fanout_scan, teardown_users},
+    {"fanout_scan", "sse4.2, users=10000 subscriptions=3, no recipients", SIMD_LEVEL_SSE42, 10000, setup_match, run_fanout_scan, teardown_users},
+    {"match_signatures", "scalar, 10000 signatures, 2 keys", SIMD_LEVEL_SCALAR, 10000, setup_match, run_match_signatures, teardown_users},
+    {"match_signatures", "sse4.2, 10000 signatures, 2 keys", SIMD_LEVEL_SSE42, 10000, setup_match, run_match_signatures, teardown_users},
+    {"match_signatures", "avx2, 10000 signatures, 2 keys", SIMD_LEVEL_AVX2, 10000, setup_match, run_match_signatures, teardown_users},
+    {"prefix_trie_match", "100000 prefixes, 24 char hashtag", 100000, 0, setup_trie, run_prefix_trie_match, teardown_trie},
+    {"prefix_scan", "naive, 100000 prefixes, 24 char hashtag", 100000, 0, setup_trie, run_prefix_scan, teardown_trie},
+    {"prefix_trie_insert+remove", "100000 prefixes", 100000, 0, setup_trie, run_prefix_trie_insert_remove, teardown_trie},
+    {"keyword_matcher_scan", "30000 keywords, 150 char tweet", 30000, 0, setup_keywords, run_keyword_matcher_scan, teardown_keywords},
+    {"keyword_scan", "naive strstr, 30000 keywords, 150 char tweet", 30000, 0, setup_keywords, run_keyword_strstr, teardown_keywords},
+    {"search_index_query", "1M tweet window, common word", 1000000, 0, setup_search, run_search_index_query, teardown_search},
+    {"search_index_query", "1M tweet window, rare AND common word", 1000000, 1, setup_search, run_search_index_query, teardown_search},
+    {"search_index_query", "1M tweet window, 3 alternatives", 1000000, 2, setup_search, run_search_index_query, teardown_search},
+    {"search_index_add", "1M tweet window, 12 words", 1000000, 0, setup_search, run_search_index_add, teardown_search},
+    {"trending_tracker_add", "100000 hashtags, 2 per tweet", 100000, 0, setup_trending, run_trending_tracker_add, teardown_trending},
+    {"trending_tracker_top", "100000 hashtags, top 10", 100000, 0, setup_trending, run_trending_tracker_top, teardown_trending},
+    {"follow_graph_publish", "on write, 10000 followers, 100 logged in", 10000, 0, setup_follow, run_follow_graph_publish, teardown_follow},
+    {"follow_graph_publish", "on read, 10000 followers", 10000, 1, setup_follow, run_follow_graph_publish, teardown_follow},
+    {"follow_graph_pull", "1000 followed, 10 on read, 15 newest", 1000, 10, setup_follow_pull, run_follow_graph_pull, teardown_follow},
+    {"follow_graph_pull", "1000 followed, 100 on read, 15 newest", 1000, 100, setup_follow_pull, run_follow_graph_pull, teardown_follow},
+    {"follow_graph_pull", "1000 followed, 1000 on read, 15 newest", 1000, 1000, setup_follow_pull, run_follow_graph_pull, teardown_follow},
+    {"follow_graph_pull_oldest", "1000 followed, 100 on read, 15 oldest", 1000, 100, setup_follow_pull, run_follow_graph_pull_oldest, teardown_follow},
+    {"mailbox_store_save", "10000 usernames, no pending tweets", 10000, 0, setup_mailbox, run_mailbox_store_save, teardown_mailbox},
+    {"mailbox_store_save", "10000 usernames, 15 pending tweets", 10000, MAX_TWEET_QUEUE, setup_mailbox, run_mailbox_store_save, teardown_mailbox},
+    {"mailbox_store_load", "10000 usernames, 15 pending tweets", 10000, MAX_TWEET_QUEUE, setup_mailbox, run_mailbox_store_load, teardown_mailbox},
+    {"spill_store_append", "1000 queues", 1000, 0, setup_spill, run_spill_store_append, teardown_spill},
+    {"spill_store_pop", "1000 queues, 100 tweets each", 1000, 100, setup_spill, run_spill_store_pop, teardown_spill},
+    {"add_tweet_to_user", "empty queue", 1, 0, setup_users, run_add_tweet_to_user, teardown_users},
+    {"add_pending_tweets_to_jobj", "14 pending tweets", 1, 0, setup_users, run_add_pending_tweets_to_jobj, teardown_users},
+    {"add_pending_tweets_to_jobj", "cursor, 7 acked, 7 new", 1, 0, setup_users, run_add_pending_tweets_to_jobj_cursor, teardown_users},
+    {"parse_hashtags", "legacy, 5 hashtags", SIMD_LEVEL_SCALAR, 0, setup_validate, run_legacy_parse_hashtags, NULL},
+    {"split_hashtag_list", "scalar, 5 hashtags", SIMD_LEVEL_SCALAR, 0, setup_validate, run_split_hashtag_list, NULL},
+    {"split_hashtag_list", "sse4.2, 5 hashtags", SIMD_LEVEL_SSE42, 0, setup_validate, run_split_hashtag_list, NULL},
+    {"split_hashtag_list", "avx2, 5 hashtags", SIMD_LEVEL_AVX2, 0, setup_validate, run_split_hashtag_list, NULL},
+    {"is_valid_tweet_text", "scalar, 150 chars", SIMD_LEVEL_SCALAR, 0, setup_validate, run_is_valid_tweet_text, NULL},
+    {"is_valid_tweet_text", "sse4.2, 150 chars", SIMD_LEVEL_SSE42, 0, setup_validate, run_is_valid_tweet_text, NULL},
+    {"is_valid_tweet_text", "avx2, 150 chars", SIMD_LEVEL_AVX2, 0, setup_validate, run_is_valid_tweet_text, NULL},
+};
+
+int main(int argc, char *argv[])
+{
+  int opt;
+  char *filter = NULL;
+  char *baselinePath = NULL;
+  uint64_t targetNs = 200000000ULL;
+  uint64_t seed = histogram_now_ns();
+  int hasPerf;
+  cJSON *report = cJSON_CreateObject();
+  cJSON *results = cJSON_CreateArray();
+  char *reportString;
+
+  while ((opt = getopt(argc, argv, "f:t:c:s:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'f':
+      filter = optarg;
+      break;
+    case 't':
+      targetNs = (uint64_t)atoi(optarg) * 1000000ULL;
+      break;
+    case 'c':
+      baselinePath = optarg;
+      break;
+    case 's':
+      seed = strtoull(optarg, NULL, 10);
+      break;
+    default:
+      die_with_error("Usage: ./ttweetmicrobench [-f <filter>] [-t <ms per run>] [-c <baseline.json>] [-s <seed>]\n");
+    }
+  }
+
+  if (!check_simd_levels(seed))
+    return 1;
+
+  hasPerf = open_perf_counters();
+  fprintf(stderr, "%-32s %-30s %12s %10s %10s\n", "benchmark", "params", "ns/op", "allocs/op", "cycles/op");
+
+  for (unsigned int benchIdx = 0; benchIdx < sizeof(benches) / sizeof(benches[0]); benchIdx++)
+  {
+    MicroBench *bench = &benches[benchIdx];
+    MicroBenchResult result;
+    cJSON *entry;
+
+    if (filter != NULL && strstr(bench->name, filter) == NULL)
+      continue;
+
+    bench->setup(bench->param, bench->param2);
+    measure_microbench(bench, targetNs, &result);
+    if (bench->teardown != NULL)
+      bench->teardown();
+
+    fprintf(stderr, "%-32s %-30s %12.1f %10.2f %10.0f\n", bench->name, bench->params, result.nsPerOp, result.allocsPerOp, result.cyclesPerOp);
+    entry = cJSON_CreateObject();
+    cJSON_AddItemToObject(entry, "name", cJSON_CreateString(bench->name));
+    cJSON_AddItemToObject(entry, "params", cJSON_CreateString(bench->params));
+    cJSON_AddItemToObject(entry, "iterations", cJSON_CreateNumber(result.iterations));
+    cJSON_AddItemToObject(entry, "nsPerOp", cJSON_CreateNumber(result.nsPerOp));
+    cJSON_AddItemToObject(entry, "allocsPerOp", cJSON_CreateNumber(result.allocsPerOp));
+    cJSON_AddItemToObject(entry, "cyclesPerOp", hasPerf ? cJSON_CreateNumber(result.cyclesPerOp) : cJSON_CreateNull());
+    cJSON_AddItemToObject(entry, "instructionsPerOp", hasPerf ? cJSON_CreateNumber(result.instructionsPerOp) : cJSON_CreateNull());
+    cJSON_AddItemToArray(results, entry);
+  }
+
+  if (baselinePath != NULL)
+    compare_with_baseline(results, baselinePath);
+
+  cJSON_AddItemToObject(report, "commit", cJSON_CreateString(BENCH_COMMIT));
+  cJSON_AddItemToObject(report, "perfCounters", cJSON_CreateBool(hasPerf));
+  cJSON_AddItemToObject(report, "benchmarks", results);
+  reportString = cJSON_Print(report);
+  printf("%s\n", reportString);
+  free(reportString);
+  cJSON_Delete(report);
+  return 0;
+}
+
+/** \copydoc bench_timer_start */
+void bench_timer_start()
+{
+  measuring = 1;
+  allocStart = allocCount;
+  if (perfLeaderFd >= 0)
+    ioctl(perfLeaderFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  timerStartNs = histogram_now_ns();
+}
+
+/** \copydoc bench_timer_stop */
+void bench_timer_stop()
+{
+  uint64_t nowNs = histogram_now_ns();
+
+  if (perfLeaderFd >= 0)
+    ioctl(perfLeaderFd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  if (!measuring)
+    return;
+  timerElapsedNs += nowNs - timerStartNs;
+  allocMeasured += allocCount - allocStart;
+  measuring = 0;
+}
+
+/** \copydoc run_microbench */
+void run_microbench(MicroBench *bench, uint64_t iterations, MicroBenchResult *result)
+{
+  uint64_t perfValues[3] = {0}; /* nr, cycles, instructions */
+
+  timerElapsedNs = 0;
+  allocMeasured = 0;
+  if (perfLeaderFd >= 0)
+    ioctl(perfLeaderFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+
+  bench_timer_start();
+  bench->run(iterations);
+  bench_timer_stop();
+
+  result->iterations = iterations;
+  result->nsPerOp = (double)timerElapsedNs / iterations;
+  result->allocsPerOp = (double)allocMeasured / iterations;
+  result->cyclesPerOp = -1;
+  result->instructionsPerOp = -1;
+  if (perfLeaderFd >= 0 && read(perfLeaderFd, perfValues, sizeof(perfValues)) == sizeof(perfValues))
+  {
+    result->cyclesPerOp = (double)perfValues[1] / iterations;
+    result->instructionsPerOp = (double)perfValues[2] / iterations;
+  }
+}
+
+/** \copydoc measure_microbench */
+void measure_microbench(MicroBench *bench, uint64_t targetNs, MicroBenchResult *result)
+{
+  MicroBenchResult runs[MICROBENCH_REPETITIONS];
+  uint64_t iterations = 1;
+
+  do
+  { /* Grow iterations until a run is long enough to scale from */
+    run_microbench(bench, iterations, result);
+    if (timerElapsedNs >= MICROBENCH_MIN_CALIBRATION_NS)
+      break;
+    iterations *= 4;
+  } while (1);
+  iterations = (uint64_t)(iterations * ((double)targetNs / timerElapsedNs));
+  if (iterations == 0)
+    iterations = 1;
+
+  for (int runIdx = 0; runIdx < MICROBENCH_REPETITIONS; runIdx++)
+  { /* Insertion sort by ns/op while running */
+    MicroBenchResult current;
+    int insertIdx = runIdx;
+    run_microbench(bench, iterations, &current);
+    while (insertIdx > 0 && runs[insertIdx - 1].nsPerOp > current.nsPerOp)
+    {
+      runs[insertIdx] = runs[insertIdx - 1];
+      insertIdx--;
+    }
+    runs[insertIdx] = current;
+  }
+  *result = runs[MICROBENCH_REPETITIONS / 2];
+}
+
+/** \copydoc open_perf_counters */
+int open_perf_counters()
+{
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_CPU_CYCLES;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  perfLeaderFd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  if (perfLeaderFd < 0)
+  {
+    fprintf(stderr, "perf counters unavailable, cycles will not be reported\n");
+    return 0;
+  }
+
+  attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+  attr.disabled = 0;
+  perfInstructionsFd = syscall(SYS_perf_event_open, &attr, 0, -1, perfLeaderFd, 0);
+  if (perfInstructionsFd < 0)
+  {
+    close(perfLeaderFd);
+    perfLeaderFd = -1;
+    fprintf(stderr, "perf counters unavailable, cycles will not be reported\n");
+    return 0;
+  }
+  return 1;
+}
+
+/** \copydoc compare_with_baseline */
+void compare_with_baseline(cJSON *results, char *baselinePath)
+{
+  FILE *baselineFile = fopen(baselinePath, "r");
+  char *contents;
+  long fileLen;
+  cJSON *baseline;
+  cJSON *baselineEntry;
+  cJSON *entry;
+
+  if (baselineFile == NULL)
+  {
+    persist_with_error("Could not open baseline");
+    return;
+  }
+  fseek(baselineFile, 0, SEEK_END);
+  fileLen = ftell(baselineFile);
+  fseek(baselineFile, 0, SEEK_SET);
+  contents = malloc(fileLen + 1);
+  contents[fread(contents, 1, fileLen, baselineFile)] = '\0';
+  fclose(baselineFile);
+  baseline = cJSON_Parse(contents);
+  free(contents);
+
+  fprintf(stderr, "\nchange against %s (commit %s)\n", baselinePath,
+          cJSON_IsString(cJSON_GetObjectItemCaseSensitive(baseline, "commit")) ? cJSON_GetObjectItemCaseSensitive(baseline, "commit")->valuestring : "unknown");
+  cJSON_ArrayForEach(entry, results)
+  {
+    char *name = cJSON_GetObjectItemCaseSensitive(entry, "name")->valuestring;
+    char *params = cJSON_GetObjectItemCaseSensitive(entry, "params")->valuestring;
+    double nsPerOp = cJSON_GetObjectItemCaseSensitive(entry, "nsPerOp")->valuedouble;
+
+    cJSON_ArrayForEach(baselineEntry, cJSON_GetObjectItemCaseSensitive(baseline, "benchmarks"))
+    {
+      cJSON *baselineName = cJSON_GetObjectItemCaseSensitive(baselineEntry, "name");
+      cJSON *baselineParams = cJSON_GetObjectItemCaseSensitive(baselineEntry, "params");
+      cJSON *baselineNs = cJSON_GetObjectItemCaseSensitive(baselineEntry, "nsPerOp");
+      if (cJSON_IsString(baselineName) && cJSON_IsString(baselineParams) && cJSON_IsNumber(baselineNs) &&
+          strcmp(baselineName->valuestring, name) == 0 && strcmp(baselineParams->valuestring, params) == 0)
+      {
+        fprintf(stderr, "%-32s %-30s %12.1f -> %12.1f ns/op (%+.1f%%)\n", name, params, baselineNs->valuedouble, nsPerOp,
+                100.0 * (nsPerOp - baselineNs->valuedouble) / baselineNs->valuedouble);
+        break;
+      }
+    }
+  }
+  cJSON_Delete(baseline);
+}
+
+/** \copydoc check_simd_levels */
+int check_simd_levels(uint64_t seed)
+{
+  SimdCheckInput input;
+  SimdCheckOutcome expected;
+  SimdCheckOutcome outcome;
+  uint64_t randomState = seed | 1; /* xorshift stays at 0 */
+  int numMismatches = 0;
+  int bestLevel;
+
+  for (uint64_t round = 0; round < SIMD_CHECK_ROUNDS; round++)
+  {
+    fill_simd_check_input(&input, &randomState);
+    set_validate_simd_level(SIMD_LEVEL_SCALAR);
+    set_match_simd_level(SIMD_LEVEL_SCALAR);
+    compute_simd_check_outcome(&input, &expected);
+    for (int level = SIMD_LEVEL_SSE42; level <= SIMD_LEVEL_AVX2; level++)
+    {
+      if (set_validate_simd_level(level) != level || set_match_simd_level(level) != level)
+        continue;
+      compute_simd_check_outcome(&input, &outcome);
+      if (memcmp(&outcome, &expected, sizeof(outcome)) != 0)
+      {
+        if (numMismatches++ < 10)
+          report_simd_mismatch(level, round, &expected, &outcome);
+      }
+    }
+  }
+
+  bestLevel = set_validate_simd_level(SIMD_LEVEL_AVX2);
+  set_match_simd_level(SIMD_LEVEL_AVX2);
+  if (numMismatches > 0)
+  {
+    fprintf(stderr, "%d SIMD results differ from scalar; replay with -s %llu\n", numMismatches, (unsigned long long)seed);
+    return 0;
+  }
+  fprintf(stderr, "scalar up to %s agree on %d random inputs\n", simd_level_name(bestLevel), SIMD_CHECK_ROUNDS);
+  return 1;
+}
+
+/* xorshift64*, so every bit of the result is usable */
+static uint64_t next_check_random(uint64_t *seed)
+{
+  *seed ^= *seed >> 12;
+  *seed ^= *seed << 25;
+  *seed ^= *seed >> 27;
+  return *seed * 0x2545f4914f6cdd1dULL;
+}
+
+/* Letters, digits and # with a varying share of the bytes the scanners
+ * must reject: control characters, DEL, bytes above 0x7f and the
+ * punctuation just outside each range */
+static void fill_check_text(char *text, int len, uint64_t *seed)
+{
+  static const char common[] = "aczAZ09#mQ5";
+  static const char edges[] = "/:@[`{ ~";
+  int noise = 4 + next_check_random(seed) % 300;
+  int kind;
+
+  for (int charIdx = 0; charIdx < len; charIdx++)
+  {
+    kind = next_check_random(seed) % noise;
+    if (kind == 0)
+      text[charIdx] = (char)(next_check_random(seed) % 0x20);
+    else if (kind == 1)
+      text[charIdx] = 0x7f;
+    else if (kind == 2)
+      text[charIdx] = (char)(0x80 + next_check_random(seed) % 0x80);
+    else if (kind == 3)
+      text[charIdx] = edges[next_check_random(seed) % (sizeof(edges) - 1)];
+    else
+      text[charIdx] = common[next_check_random(seed) % (sizeof(common) - 1)];
+  }
+}
+
+static void fill_simd_check_input(SimdCheckInput *input, uint64_t *seed)
+{
+  int numBits;
+
+  input->hashtagListLen = next_check_random(seed) % (MAX_HASHTAG_LEN + 2);
+  fill_check_text(input->hashtagList, input->hashtagListLen, seed);
+  if (input->hashtagListLen > 0 && next_check_random(seed) % 4 != 0)
+    input->hashtagList[0] = '#'; /* Most lists get past the first checks */
+  input->hashtagLen = next_check_random(seed) % (MAX_HASHTAG_LEN + 1);
+  fill_check_text(input->hashtag, input->hashtagLen, seed);
+  input->tweetTextLen = next_check_random(seed) % (MAX_TWEET_LEN + 2);
+  fill_check_text(input->tweetText, input->tweetTextLen, seed);
+  input->usernameLen = next_check_random(seed) % (MAX_USERNAME_LEN + 1);
+  fill_check_text(input->username, input->usernameLen, seed);
+
+  input->numKeys = next_check_random(seed) % (MAX_MATCH_KEYS + 1);
+  for (int keyIdx = 0; keyIdx < input->numKeys; keyIdx++)
+  { /* Two bits, as hashtag_signature() sets, or now and then 0 */
+    input->keys[keyIdx] = next_check_random(seed) % 16 == 0 ? 0 : 1ULL << (next_check_random(seed) % 64) | 1ULL << (next_check_random(seed) % 64);
+  }
+  input->numSignatures = next_check_random(seed) % (SIMD_CHECK_MAX_ELEMENTS + 1);
+  for (int signatureIdx = 0; signatureIdx < input->numSignatures; signatureIdx++)
+  {
+    input->signatures[signatureIdx] = 0;
+    numBits = next_check_random(seed) % 24;
+    for (int bitIdx = 0; bitIdx < numBits; bitIdx++)
+      input->signatures[signatureIdx] |= 1ULL << (next_check_random(seed) % 64);
+  }
+  input->numBytes = next_check_random(seed) % (SIMD_CHECK_MAX_ELEMENTS + 1);
+  for (int byteIdx = 0; byteIdx < input->numBytes; byteIdx++)
+    input->bytes[byteIdx] = next_check_random(seed) % 3 == 0 ? next_check_random(seed) % 256 : 0;
+}
+
+/* Runs every function with the instruction sets currently selected */
+static void compute_simd_check_outcome(SimdCheckInput *input, SimdCheckOutcome *outcome)
+{
+  TextView hashtags[MAX_HASHTAG_CNT];
+
+  memset(outcome, 0, sizeof(*outcome));
+  outcome->splitResult = split_hashtag_list(input->hashtagList, input->hashtagListLen, hashtags, MAX_HASHTAG_CNT, &outcome->numHashtags);
+  for (int hashtagIdx = 0; hashtagIdx < outcome->numHashtags; hashtagIdx++)
+  {
+    outcome->hashtagOffsets[hashtagIdx] = hashtags[hashtagIdx].start - input->hashtagList;
+    outcome->hashtagLens[hashtagIdx] = hashtags[hashtagIdx].len;
+  }
+  outcome->isValidHashtag = is_valid_hashtag(input->hashtag, input->hashtagLen);
+  outcome->isValidTweetText = is_valid_tweet_text(input->tweetText, input->tweetTextLen);
+  outcome->isValidUsername = is_valid_username(input->username, input->usernameLen);
+  outcome->numSignatureMatches = match_signatures(input->signatures, input->numSignatures, input->keys, input->numKeys, outcome->signatureMask);
+  outcome->numNonZeroBytes = match_nonzero_bytes(input->bytes, input->numBytes, outcome->nonZeroMask);
+}
+
+static void report_simd_mismatch(int level, uint64_t round, SimdCheckOutcome *expected, SimdCheckOutcome *outcome)
+{
+  fprintf(stderr, "input %llu, %s differs from scalar in:", (unsigned long long)round, simd_level_name(level));
+  if (outcome->splitResult != expected->splitResult || outcome->numHashtags != expected->numHashtags ||
+      memcmp(outcome->hashtagOffsets, expected->hashtagOffsets, sizeof(outcome->hashtagOffsets)) != 0 ||
+      memcmp(outcome->hashtagLens, expected->hashtagLens, sizeof(outcome->hashtagLens)) != 0)
+    fprintf(stderr, " split_hashtag_list");
+  if (outcome->isValidHashtag != expected->isValidHashtag)
+    fprintf(stderr, " is_valid_hashtag");
+  if (outcome->isValidTweetText != expected->isValidTweetText)
+    fprintf(stderr, " is_valid_tweet_text");
+  if (outcome->isValidUsername != expected->isValidUsername)
+    fprintf(stderr, " is_valid_username");
+  if (outcome->numSignatureMatches != expected->numSignatureMatches ||
+      memcmp(outcome->signatureMask, expected->signatureMask, sizeof(outcome->signatureMask)) != 0)
+    fprintf(stderr, " match_signatures");
+  if (outcome->numNonZeroBytes != expected->numNonZeroBytes ||
+      memcmp(outcome->nonZeroMask, expected->nonZeroMask, sizeof(outcome->nonZeroMask)) != 0)
+    fprintf(stderr, " match_nonzero_bytes");
+  fprintf(stderr, "\n");
+}
+
+void *__wrap_malloc(size_t size)
+{
+  allocCount++;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+  allocCount++;
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+  allocCount++;
+  return __real_realloc(ptr, size);
+}
+
+/* send_payload()/receive_response() over a socketpair */
+static void setup_payload(int numTweets, int unused)
+{
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, payloadSocks) < 0)
+    die_with_error("socketpair() failed");
+  payloadObject = numTweets ? create_timeline_response(numTweets) : cJSON_CreateObject();
+  if (!numTweets)
+  { /* Same shape as the client's username validation */
+    cJSON_AddItemToObject(payloadObject, "requestCode", cJSON_CreateNumber(REQ_VALIDATE_USER));
+    cJSON_AddItemToObject(payloadObject, "username", cJSON_CreateString("microbench"));
+  }
+}
+
+static void run_payload_roundtrip(uint64_t iterations)
+{
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    send_payload(payloadSocks[0], payloadObject);
+    receive_response(payloadSocks[1], payloadBuffer);
+  }
+}
+
+static void teardown_payload()
+{
+  close(payloadSocks[0]);
+  close(payloadSocks[1]);
+  cJSON_Delete(payloadObject);
+}
+
+/* Requests and responses over loopback TCP with the server's socket profile */
+static void setup_tcp(int numTweets, int coalesce)
+{
+  struct sockaddr_in addr;
+  socklen_t addrLen = sizeof(addr);
+  SocketProfile profile = socketProfile;
+  int listenSock = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+  profile.deferAccept = 0; /* the client connects before it sends anything */
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  apply_listener_socket_profile(listenSock, &profile);
+  if (bind(listenSock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listenSock, 1) < 0 ||
+      getsockname(listenSock, (struct sockaddr *)&addr, &addrLen) < 0)
+    die_with_error("loopback listener failed");
+  tcpSocks[0] = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (connect(tcpSocks[0], (struct sockaddr *)&addr, sizeof(addr)) < 0 || (tcpSocks[1] = accept(listenSock, NULL, NULL)) < 0)
+    die_with_error("loopback connection failed");
+  close(listenSock);
+  apply_connection_socket_profile(tcpSocks[1], &profile);
+  tcpCoalesce = coalesce;
+
+  requestObject = cJSON_CreateObject();
+  cJSON_AddItemToObject(requestObject, "requestCode", cJSON_CreateNumber(REQ_VALIDATE_USER));
+  cJSON_AddItemToObject(requestObject, "username", cJSON_CreateString("microbench"));
+  payloadObject = numTweets ? create_timeline_response(numTweets) : cJSON_Duplicate(requestObject, 1);
+}
+
+static void run_tcp_roundtrip(uint64_t iterations)
+{
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    send_payload(tcpSocks[0], requestObject);
+    receive_response(tcpSocks[1], payloadBuffer);
+    send_payload(tcpSocks[1], payloadObject);
+    receive_response(tcpSocks[0], payloadBuffer);
+  }
+}
+
+static void run_tcp_pipelined(uint64_t iterations)
+{
+  for (uint64_t done = 0; done < iterations; done += MICROBENCH_TCP_PIPELINE)
+  { /* Client sends a burst, the server answers as handle_client_response() does */
+    int burst = iterations - done < MICROBENCH_TCP_PIPELINE ? iterations - done : MICROBENCH_TCP_PIPELINE;
+    for (int i = 0; i < burst; i++)
+      send_payload(tcpSocks[0], requestObject);
+    for (int i = 0; i < burst; i++)
+    {
+      receive_response(tcpSocks[1], payloadBuffer);
+      send_payload_flags(tcpSocks[1], payloadObject, tcpCoalesce && has_pending_request(tcpSocks[1]) ? MSG_MORE : 0);
+    }
+    for (int i = 0; i < burst; i++)
+      receive_response(tcpSocks[0], payloadBuffer);
+  }
+}
+
+static void teardown_tcp()
+{
+  close(tcpSocks[0]);
+  close(tcpSocks[1]);
+  cJSON_Delete(requestObject);
+  cJSON_Delete(payloadObject);
+}
+
+/* cJSON encode/decode of real request and response shapes */
+static void setup_json(int numTweets, int unused)
+{
+  payloadObject = numTweets ? create_timeline_response(numTweets) : create_tweet_request();
+  encodedJson = cJSON_PrintUnformatted(payloadObject);
+}
+
+static void run_encode_tweet_request(uint64_t iterations)
+{
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    cJSON *jobjToSend = create_tweet_request();
+    char *request = cJSON_PrintUnformatted(jobjToSend);
+    free(request);
+    cJSON_Delete(jobjToSend);
+  }
+}
+
+static void run_decode_tweet_request(uint64_t iterations)
+{
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    cJSON *jobjReceived = cJSON_Parse(encodedJson);
+    cJSON *jarray = cJSON_GetObjectItemCaseSensitive(jobjReceived, "ttweetHashtags");
+    for (int hashtagIdx = 0; hashtagIdx < cJSON_GetArraySize(jarray); hashtagIdx++)
+      (void)cJSON_GetArrayItem(jarray, hashtagIdx)->valuestring;
+    cJSON_Delete(jobjReceived);
+  }
+}
+
+static void run_encode_timeline_response(uint64_t iterations)
+{
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    cJSON *jobjToSend = create_timeline_response(14);
+    char *response = cJSON_PrintUnformatted(jobjToSend);
+    free(response);
+    cJSON_Delete(jobjToSend);
+  }
+}
+
+static void run_decode_timeline_response(uint64_t iterations)
+{
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    cJSON *jobjReceived = cJSON_Parse(encodedJson);
+    cJSON *jarray = cJSON_GetObjectItemCaseSensitive(jobjReceived, "storedTweets");
+    for (int tweetIdx = 0; tweetIdx < cJSON_GetArraySize(jarray); tweetIdx++)
+      (void)cJSON_GetArrayItem(jarray, tweetIdx)->valuestring;
+    cJSON_Delete(jobjReceived);
+  }
+}
+
+static void teardown_json()
+{
+  free(encodedJson);
+  cJSON_Delete(payloadObject);
+}
+
+/* Response compression, with or without earlier responses in the history */
+static void setup_compress(int numTweets, int warm)
+{
+  setup_json(numTweets, 0);
+  benchCompressor = malloc(sizeof(CompressStream));
+  benchDecompressor = malloc(sizeof(CompressStream));
+  benchCompressWarm = warm;
+  compress_stream_reset(benchCompressor);
+  compress_stream_reset(benchDecompressor);
+  compressedLen = compress_payload(benchCompressor, encodedJson, strlen(encodedJson) + 1, compressedJson, sizeof(compressedJson));
+  compress_stream_reset(benchCompressor);
+}
+
+static void run_compress_payload(uint64_t iterations)
+{
+  int encodedLen = strlen(encodedJson) + 1;
+
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    if (!benchCompressWarm)
+    {
+      bench_timer_stop();
+      compress_stream_reset(benchCompressor);
+      bench_timer_start();
+    }
+    compress_payload(benchCompressor, encodedJson, encodedLen, compressedJson, sizeof(compressedJson));
+  }
+}
+
+static void run_decompress_payload(uint64_t iterations)
+{
+  char decoded[MAX_RESP_LEN];
+
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    bench_timer_stop();
+    compress_stream_reset(benchDecompressor);
+    bench_timer_start();
+    decompress_payload(benchDecompressor, compressedJson, compressedLen, decoded, strlen(encodedJson) + 1);
+  }
+}
+
+static void teardown_compress()
+{
+  free(benchCompressor);
+  free(benchDecompressor);
+  teardown_json();
+}
+
+/* Fan-out over a private user table: user u subscribes to tag(u*7+k) mod 1000 */
+static void setup_users(int numUsers, int numSubscriptions)
+{
+  maxActiveUsers = numUsers;
+  allocate_user_table(numUsers);
+  latestTweet = calloc(1, sizeof(LatestTweet));
+  undeliveredBytes = calloc(1, sizeof(int64_t));
+  admissionProfile.memoryBytes = 0; /* Queues are cleared directly, outside the budget */
+  initialize_user_array();
+  initialize_latest_tweet();
+  for (int userIdx = 0; userIdx < numUsers; userIdx++)
+  {
+    userTable.isOccupied[userIdx] = 1;
+    snprintf(activeUsers[userIdx].username, MAX_USERNAME_LEN, "user%d", userIdx);
+    for (int subscriptionIdx = 0; subscriptionIdx < numSubscriptions; subscriptionIdx++)
+    {
+      snprintf(activeUsers[userIdx].subscriptions[subscriptionIdx], MAX_HASHTAG_LEN, "tag%d", (userIdx * 7 + subscriptionIdx) % 1000);
+      userTable.subscriptionIds[userIdx][subscriptionIdx] = hashtag_id(activeUsers[userIdx].subscriptions[subscriptionIdx]);
+    }
+    update_subscription_signature(userIdx);
+  }
+  fill_latest_tweet(0);
+}
+
+static void run_handle_tweet_updates(uint64_t iterations)
+{
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    if (iteration % (MAX_TWEET_QUEUE - 1) == 0)
+    { /* Keep queues from filling up; not measured */
+      bench_timer_stop();
+      clear_all_pending_tweets();
+      fill_latest_tweet(iteration);
+      bench_timer_start();
+    }
+    handle_tweet_updates();
+  }
+}
+
+/* Matching cost alone: the tweet's hashtags are outside every subscription,
+ * so ns/op divided by the user count is the scan cost per user */
+static void run_fanout_scan(uint64_t iterations)
+{
+  static int isReported = 0;
+
+  strcpy(latestTweet->hashtags[0], "nobody");
+  strcpy(latestTweet->hashtags[1], "follows");
+  if (!isReported)
+  { /* Every user that passes the signature filter is a false positive */
+    bench_timer_stop();
+    report_signature_false_positives();
+    isReported = 1;
+    bench_timer_start();
+  }
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+    handle_tweet_updates();
+}
+
+/* Users as in setup_users(), matched with a forced instruction set */
+static void setup_match(int simdLevel, int numUsers)
+{
+  setup_users(numUsers, 3);
+  if (set_match_simd_level(simdLevel) != simdLevel)
+    fprintf(stderr, "%s not supported, measuring %s\n", simd_level_name(simdLevel), simd_level_name(get_match_simd_level()));
+}
+
+static void run_match_signatures(uint64_t iterations)
+{
+  static uint64_t matchMask[MATCH_MASK_WORDS(10000)];
+  uint64_t keys[2] = {hashtag_signature(hashtag_id("nobody")), hashtag_signature(hashtag_id("follows"))};
+  int numSignatures = maxActiveUsers < 10000 ? maxActiveUsers : 10000;
+
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+    match_signatures(userTable.subscriptionSignatures, numSignatures, keys, 2, matchMask);
+}
+
+/* Pseudo-random alphanumeric prefixes of 3 to 12 chars, the same every run */
+static void setup_trie(int numPrefixes, int unused)
+{
+  benchTrie = prefix_trie_create(numPrefixes + 1);
+  benchPrefixes = malloc(sizeof(*benchPrefixes) * numPrefixes);
+  if (benchTrie == NULL || benchPrefixes == NULL)
+    die_with_error("Prefix benchmark allocation failed");
+  numBenchPrefixes = numPrefixes;
+  fill_random_words(benchPrefixes, numPrefixes, 3, 12);
+  for (int prefixIdx = 0; prefixIdx < numPrefixes; prefixIdx++)
+    prefix_trie_insert(benchTrie, benchPrefixes[prefixIdx], strlen(benchPrefixes[prefixIdx]), prefixIdx);
+  snprintf(benchPrefixHashtag, sizeof(benchPrefixHashtag), "%s%s", benchPrefixes[0], "abcdefghijklmnopqrstuvwx");
+}
+
+static void run_prefix_trie_match(uint64_t iterations)
+{
+  int count = 0;
+  int len = strlen(benchPrefixHashtag);
+
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+    prefix_trie_match(benchTrie, benchPrefixHashtag, len, count_prefix_match, &count);
+}
+
+/* What fan-out would do without the trie: test every prefix */
+static void run_prefix_scan(uint64_t iterations)
+{
+  volatile int count = 0;
+
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    for (int prefixIdx = 0; prefixIdx < numBenchPrefixes; prefixIdx++)
+    {
+      if (strncmp(benchPrefixes[prefixIdx], benchPrefixHashtag, strlen(benchPrefixes[prefixIdx])) == 0)
+        count++;
+    }
+  }
+}
+
+static void run_prefix_trie_insert_remove(uint64_t iterations)
+{
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    prefix_trie_insert(benchTrie, benchPrefixHashtag, strlen(benchPrefixHashtag) - iteration % 8, -1);
+    prefix_trie_remove(benchTrie, benchPrefixHashtag, strlen(benchPrefixHashtag) - iteration % 8, -1);
+  }
+}
+
+static void teardown_trie()
+{
+  prefix_trie_destroy(benchTrie);
+  free(benchPrefixes);
+}
+
+/* Pseudo-random keywords of 4 to 10 chars, scanned for in benchTweetText */
+static void setup_keywords(int numKeywords, int unused)
+{
+  int count = 0;
+
+  benchMatcher = keyword_matcher_create(numKeywords, PREFIX_TRIE_MAX_KEY_LEN);
+  benchKeywords = malloc(sizeof(*benchKeywords) * numKeywords);
+  if (benchMatcher == NULL || benchKeywords == NULL)
+    die_with_error("Keyword benchmark allocation failed");
+  numBenchKeywords = numKeywords;
+  fill_random_words(benchKeywords, numKeywords, 4, 10);
+  strcpy(benchKeywords[0], "character"); /* Some keywords occur in the text */
+  strcpy(benchKeywords[1], "tweet");
+  for (int keywordIdx = 0; keywordIdx < numKeywords; keywordIdx++)
+    keyword_matcher_insert(benchMatcher, benchKeywords[keywordIdx], strlen(benchKeywords[keywordIdx]), keywordIdx);
+  keyword_matcher_scan(benchMatcher, benchTweetText, strlen(benchTweetText), count_prefix_match, &count); /* Builds the fail links */
+}
+
+static void run_keyword_matcher_scan(uint64_t iterations)
+{
+  int count = 0;
+  int len = strlen(benchTweetText);
+
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+    keyword_matcher_scan(benchMatcher, benchTweetText, len, count_prefix_match, &count);
+}
+
+/* What store_latest_tweet() would do without the automaton: search for every keyword */
+static void run_keyword_strstr(uint64_t iterations)
+{
+  volatile int count = 0;
+
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    for (int keywordIdx = 0; keywordIdx < numBenchKeywords; keywordIdx++)
+    {
+      if (strcasestr(benchTweetText, benchKeywords[keywordIdx]) != NULL)
+        count++;
+    }
+  }
+}
+
+static void teardown_keywords()
+{
+  keyword_matcher_destroy(benchMatcher);
+  free(benchKeywords);
+}
+
+/* Fills a window of numTweets tweets of 12 words each, drawn from a
+ * vocabulary where low word numbers are far more common, like real text */
+static void setup_search(int numTweets, int queryIdx)
+{
+  char text[MAX_TWEET_LEN + 1];
+  uint32_t seed = 12345;
+
+  benchSearchIndex = search_index_create(numTweets);
+  benchKeywords = malloc(sizeof(*benchKeywords) * BENCH_SEARCH_WORDS);
+  benchSearchTweets = malloc(sizeof(*benchSearchTweets) * BENCH_SEARCH_TWEETS);
+  if (benchSearchIndex == NULL || benchKeywords == NULL || benchSearchTweets == NULL)
+    die_with_error("Search benchmark allocation failed");
+  fill_random_words(benchKeywords, BENCH_SEARCH_WORDS, 3, 10);
+  for (int tweetIdx = 0; tweetIdx < numTweets; tweetIdx++)
+  {
+    fill_search_tweet(text, sizeof(text), &seed);
+    search_index_add(benchSearchIndex, "bench", text, benchSearchHashtags, 1);
+  }
+  for (int tweetIdx = 0; tweetIdx < BENCH_SEARCH_TWEETS; tweetIdx++)
+    fill_search_tweet(benchSearchTweets[tweetIdx], sizeof(benchSearchTweets[tweetIdx]), &seed);
+
+  switch (queryIdx)
+  {
+  case 0: /* In about one tweet in ten */
+    snprintf(benchSearchQuery, sizeof(benchSearchQuery), "%s", benchKeywords[10]);
+    break;
+  case 1: /* The rare word leads, the common one is checked against it */
+    snprintf(benchSearchQuery, sizeof(benchSearchQuery), "%s %s", benchKeywords[10], benchKeywords[20000]);
+    break;
+  default:
+    snprintf(benchSearchQuery, sizeof(benchSearchQuery), "%s %s OR %s OR #news %s", benchKeywords[100], benchKeywords[200], benchKeywords[30000], benchKeywords[5000]);
+    break;
+  }
+}
+
+/* Twelve words of benchKeywords, word n drawn with probability falling as 1/n */
+static void fill_search_tweet(char *text, int textLen, uint32_t *seed)
+{
+  int used = 0;
+  int wordIdx;
+  int octave;
+
+  text[0] = '\0';
+  for (int wordNum = 0; wordNum < 12; wordNum++)
+  { /* Each power of two range of word numbers is equally likely */
+    *seed = *seed * 1103515245u + 12345u;
+    octave = (*seed >> 16) % 16;
+    *seed = *seed * 1103515245u + 12345u;
+    wordIdx = ((1 << octave) + (*seed >> 16) % (1 << octave)) % BENCH_SEARCH_WORDS;
+    used += snprintf(text + used, textLen - used, "%s%s", wordNum ? " " : "", benchKeywords[wordIdx]);
+    if (used >= textLen - 1)
+    {
+      text[textLen - 1] = '\0';
+      break;
+    }
+  }
+}
+
+static void run_search_index_query(uint64_t iterations)
+{
+  static char results[MAX_SEARCH_RESULTS][MAX_TWEET_ITEM_LEN];
+
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+    search_index_query(benchSearchIndex, benchSearchQuery, results, MAX_SEARCH_RESULTS);
+}
+
+static void run_search_index_add(uint64_t iterations)
+{
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+    search_index_add(benchSearchIndex, "bench", benchSearchTweets[iteration % BENCH_SEARCH_TWEETS], benchSearchHashtags, 1);
+}
+
+static void teardown_search()
+{
+  search_index_destroy(benchSearchIndex);
+  free(benchKeywords);
+  free(benchSearchTweets);
+}
+
+/* A full hour of tweets with two hashtags each, hashtag n of numHashtags
+ * drawn with probability falling as 1/n */
+static void setup_trending(int numHashtags, int unused)
+{
+  uint32_t seed = 12345;
+  int octave;
+
+  benchTrending = trending_tracker_create(0);
+  benchKeywords = malloc(sizeof(*benchKeywords) * numHashtags);
+  benchTrendingHashtags = malloc(sizeof(*benchTrendingHashtags) * numHashtags);
+  if (benchTrending == NULL || benchKeywords == NULL || benchTrendingHashtags == NULL)
+    die_with_error("Trending benchmark allocation failed");
+  fill_random_words(benchKeywords, numHashtags, 4, 12);
+  for (int hashtagIdx = 0; hashtagIdx < numHashtags; hashtagIdx++)
+  { /* Each power of two range of hashtag numbers is equally likely */
+    seed = seed * 1103515245u + 12345u;
+    octave = (seed >> 16) % 17;
+    seed = seed * 1103515245u + 12345u;
+    strcpy(benchTrendingHashtags[hashtagIdx], benchKeywords[((1 << octave) + (seed >> 8) % (1 << octave)) % numHashtags]);
+  }
+  numBenchKeywords = numHashtags / 2 * 2;
+  for (benchTrendingNowMs = 0; benchTrendingNowMs < 3600000; benchTrendingNowMs += 10)
+    trending_tracker_add(benchTrending, &benchTrendingHashtags[benchTrendingNowMs / 5 % numBenchKeywords], 2, benchTrendingNowMs);
+}
+
+static void run_trending_tracker_add(uint64_t iterations)
+{
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+    trending_tracker_add(benchTrending, &benchTrendingHashtags[iteration * 2 % numBenchKeywords], 2, ++benchTrendingNowMs);
+}
+
+static void run_trending_tracker_top(uint64_t iterations)
+{
+  TrendingEntry entries[MAX_TRENDING_RESULTS];
+
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+    trending_tracker_top(benchTrending, iteration % TRENDING_WINDOWS, benchTrendingNowMs, entries, MAX_TRENDING_RESULTS);
+}
+
+static void teardown_trending()
+{
+  trending_tracker_destroy(benchTrending);
+  free(benchKeywords);
+  free(benchTrendingHashtags);
+}
+
+/* One author followed by numFollowers accounts, every hundredth logged in */
+static void setup_follow(int numFollowers, int isOnRead)
+{
+  char username[MAX_USERNAME_LEN];
+  int32_t follower;
+
+  benchFollows = follow_graph_create(numFollowers + 1, numFollowers, isOnRead ? numFollowers : 0);
+  if (benchFollows == NULL)
+    die_with_error("Follow benchmark allocation failed");
+  benchFollowAccount = follow_graph_login(benchFollows, "author", FOLLOW_NIL);
+  for (int followerIdx = 0; followerIdx < numFollowers; followerIdx++)
+  {
+    snprintf(username, sizeof(username), "follower%d", followerIdx);
+    follower = follow_graph_login(benchFollows, username, followerIdx % 100 == 0 ? followerIdx / 100 : FOLLOW_NIL);
+    follow_graph_follow(benchFollows, follower, "author");
+  }
+}
+
+/* A reader following numFollowed authors, numOnRead of which have a second
+ * follower and so are fanned out on read, each with a full log */
+static void setup_follow_pull(int numFollowed, int numOnRead)
+{
+  char username[MAX_USERNAME_LEN];
+  int32_t fan;
+  int count = 0;
+
+  benchFollows = follow_graph_create(numFollowed + 2, numFollowed + numOnRead, 2);
+  if (benchFollows == NULL)
+    die_with_error("Follow benchmark allocation failed");
+  benchFollowAccount = follow_graph_login(benchFollows, "reader", FOLLOW_NIL);
+  fan = follow_graph_login(benchFollows, "fan", FOLLOW_NIL);
+  for (int authorIdx = 0; authorIdx < numFollowed; authorIdx++)
+  {
+    snprintf(username, sizeof(username), "author%d", authorIdx);
+    follow_graph_follow(benchFollows, benchFollowAccount, username);
+    if (authorIdx < numOnRead)
+      follow_graph_follow(benchFollows, fan, username);
+  }
+  for (int postIdx = 0; postIdx < FOLLOW_LOG_LEN * numOnRead; postIdx++)
+  { /* Round robin, so the newest posts are spread over every log */
+    snprintf(username, sizeof(username), "author%d", postIdx % numOnRead);
+    follow_graph_publish(benchFollows, follow_graph_login(benchFollows, username, FOLLOW_NIL), benchTweetText, "news", count_prefix_match, &count);
+  }
+}
+
+static void run_follow_graph_publish(uint64_t iterations)
+{
+  int count = 0;
+
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+    follow_graph_publish(benchFollows, benchFollowAccount, benchTweetText, "news", count_prefix_match, &count);
+}
+
+/* Each pull finds the same 64 new posts and keeps the newest 15 */
+static void run_follow_graph_pull(uint64_t iterations)
+{
+  FollowPost posts[MAX_TWEET_QUEUE];
+  uint64_t sinceSeq;
+
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    sinceSeq = follow_graph_last_post_seq(benchFollows) - FOLLOW_LOG_LEN;
+    follow_graph_pull(benchFollows, benchFollowAccount, &sinceSeq, posts, MAX_TWEET_QUEUE);
+  }
+}
+
+/* Each pull finds the same 64 new posts and keeps the oldest 15 */
+static void run_follow_graph_pull_oldest(uint64_t iterations)
+{
+  FollowPost posts[MAX_TWEET_QUEUE];
+  uint64_t sinceSeq;
+
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    sinceSeq = follow_graph_last_post_seq(benchFollows) - FOLLOW_LOG_LEN;
+    follow_graph_pull_oldest(benchFollows, benchFollowAccount, &sinceSeq, posts, MAX_TWEET_QUEUE);
+  }
+}
+
+static void teardown_follow()
+{
+  follow_graph_destroy(benchFollows);
+}
+
+/* numMailboxes usernames already saved, each with numTweets pending tweets,
+ * in a file that is removed as soon as it is open */
+static void setup_mailbox(int numMailboxes, int numTweets)
+{
+  char path[] = "/tmp/ttweetmicrobench.XXXXXX";
+  int fd = mkstemp(path);
+
+  if (fd < 0 || (benchMailboxes = mailbox_store_open(path, numMailboxes)) == NULL)
+    die_with_error("Mailbox benchmark file could not be created");
+  close(fd);
+  unlink(path);
+  benchMailboxUsernames = malloc(sizeof(*benchMailboxUsernames) * numMailboxes);
+  benchNumMailboxes = numMailboxes;
+
+  memset(&benchMailbox, 0, sizeof(benchMailbox));
+  strcpy(benchMailbox.subscriptions[0], "news");
+  strcpy(benchMailbox.subscriptions[1], "deploy*");
+  strcpy(benchMailbox.keywords[0], "outage");
+  benchMailbox.numTweets = numTweets;
+  for (int tweetIdx = 0; tweetIdx < numTweets; tweetIdx++)
+    snprintf(benchMailbox.pendingTweets[tweetIdx], MAX_TWEET_ITEM_LEN, "reader author: %s #news", benchTweetText);
+  for (int mailboxIdx = 0; mailboxIdx < numMailboxes; mailboxIdx++)
+  {
+    snprintf(benchMailboxUsernames[mailboxIdx], MAX_USERNAME_LEN, "user%d", mailboxIdx);
+    strcpy(benchMailbox.username, benchMailboxUsernames[mailboxIdx]);
+    mailbox_store_save(benchMailboxes, &benchMailbox, NULL);
+  }
+}
+
+static void run_mailbox_store_save(uint64_t iterations)
+{
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    strcpy(benchMailbox.username, benchMailboxUsernames[iteration % benchNumMailboxes]);
+    mailbox_store_save(benchMailboxes, &benchMailbox, NULL);
+  }
+}
+
+static void run_mailbox_store_load(uint64_t iterations)
+{
+  Mailbox mailbox;
+
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+    mailbox_store_load(benchMailboxes, benchMailboxUsernames[iteration % benchNumMailboxes], &mailbox);
+}
+
+static void teardown_mailbox()
+{
+  mailbox_store_close(benchMailboxes);
+  free(benchMailboxUsernames);
+}
+
+/* numQueues users with numRecords spilled tweets each, interleaved in the
+ * segments as fan-out writes them */
+static void setup_spill(int numQueues, int numRecords)
+{
+  char username[MAX_USERNAME_LEN];
+
+  strcpy(benchSpillDir + strlen(benchSpillDir) - 6, "XXXXXX");
+  if (mkdtemp(benchSpillDir) == NULL || (benchSpill = spill_store_open(benchSpillDir)) == NULL)
+    die_with_error("Spill benchmark directory could not be created");
+  benchSpillQueues = malloc(sizeof(SpillQueue) * numQueues);
+  benchNumSpillQueues = numQueues;
+  benchSpillRecords = numRecords;
+  snprintf(benchSpillItem, MAX_TWEET_ITEM_LEN, "reader author: %s #news", benchTweetText);
+  for (int queueIdx = 0; queueIdx < numQueues; queueIdx++)
+  {
+    snprintf(username, MAX_USERNAME_LEN, "user%d", queueIdx);
+    spill_queue_init(&benchSpillQueues[queueIdx], username);
+  }
+  for (int recordIdx = 0; recordIdx < numRecords; recordIdx++)
+  {
+    for (int queueIdx = 0; queueIdx < numQueues; queueIdx++)
+      spill_store_append(benchSpill, &benchSpillQueues[queueIdx], benchSpillItem);
+  }
+}
+
+static void run_spill_store_append(uint64_t iterations)
+{
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    if (iteration % 100000 == 0)
+    { /* Bounds the disk the run takes */
+      bench_timer_stop();
+      for (int queueIdx = 0; queueIdx < benchNumSpillQueues; queueIdx++)
+        spill_store_clear(benchSpill, &benchSpillQueues[queueIdx]);
+      bench_timer_start();
+    }
+    spill_store_append(benchSpill, &benchSpillQueues[iteration % benchNumSpillQueues], benchSpillItem);
+  }
+}
+
+static void run_spill_store_pop(uint64_t iterations)
+{
+  char tweetItem[MAX_TWEET_ITEM_LEN];
+  SpillQueue *queue;
+
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    queue = &benchSpillQueues[iteration % benchNumSpillQueues];
+    if (queue->numRecords == 0)
+    {
+      bench_timer_stop();
+      for (int recordIdx = 0; recordIdx < benchSpillRecords; recordIdx++)
+        spill_store_append(benchSpill, queue, benchSpillItem);
+      bench_timer_start();
+    }
+    spill_store_pop(benchSpill, queue, tweetItem);
+  }
+}
+
+static void teardown_spill()
+{
+  spill_store_close(benchSpill);
+  rmdir(benchSpillDir);
+  free(benchSpillQueues);
+}
+
+static void run_add_tweet_to_user(uint64_t iterations)
+{
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    if (iteration % MAX_TWEET_QUEUE == 0)
+    {
+      bench_timer_stop();
+      clear_all_pending_tweets();
+      bench_timer_start();
+    }
+    add_tweet_to_user(0, latestTweet->username, latestTweet->ttweetString, latestTweet->hashtags[0]);
+  }
+}
+
+static void run_add_pending_tweets_to_jobj(uint64_t iterations)
+{
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    cJSON *jobjToSend;
+    bench_timer_stop();
+    for (int tweetIdx = 0; tweetIdx < MAX_TWEET_QUEUE - 1; tweetIdx++)
+      add_tweet_to_user(0, latestTweet->username, latestTweet->ttweetString, latestTweet->hashtags[0]);
+    jobjToSend = cJSON_CreateObject();
+    bench_timer_start();
+    add_pending_tweets_to_jobj(jobjToSend, 0, NO_TIMELINE_CURSOR, MAX_TWEET_QUEUE);
+    bench_timer_stop();
+    cJSON_Delete(jobjToSend);
+    bench_timer_start();
+  }
+}
+
+/* Each page acknowledges the previous one, as a client resuming from its cursor does */
+static void run_add_pending_tweets_to_jobj_cursor(uint64_t iterations)
+{
+  uint64_t cursor = activeUsers[0].lastTweetSeq;
+
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    cJSON *jobjToSend;
+    bench_timer_stop();
+    for (int tweetIdx = 0; tweetIdx < MAX_TWEET_QUEUE / 2; tweetIdx++)
+      add_tweet_to_user(0, latestTweet->username, latestTweet->ttweetString, latestTweet->hashtags[0]);
+    jobjToSend = cJSON_CreateObject();
+    bench_timer_start();
+    add_pending_tweets_to_jobj(jobjToSend, 0, cursor, MAX_TWEET_QUEUE);
+    bench_timer_stop();
+    cursor = activeUsers[0].lastTweetSeq;
+    cJSON_Delete(jobjToSend);
+    bench_timer_start();
+  }
+}
+
+static void teardown_users()
+{
+  free_user_table(maxActiveUsers);
+  free(latestTweet);
+  free(undeliveredBytes);
+}
+
+/* Levels the CPU lacks fall back to the best one it has */
+static void setup_validate(int simdLevel, int unused)
+{
+  if (set_validate_simd_level(simdLevel) != simdLevel)
+    fprintf(stderr, "%s not supported, measuring %s\n", simd_level_name(simdLevel), simd_level_name(get_validate_simd_level()));
+}
+
+static void run_legacy_parse_hashtags(uint64_t iterations)
+{
+  char inputHashtags[MAX_HASHTAG_LEN + 1];
+  char *validHashtags[MAX_HASHTAG_CNT];
+  int numValidHashtags;
+
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    strcpy(inputHashtags, benchHashtags);
+    legacy_parse_hashtags(validHashtags, &numValidHashtags, inputHashtags);
+    for (int hashtagIdx = 0; hashtagIdx < numValidHashtags; hashtagIdx++)
+      free(validHashtags[hashtagIdx]);
+  }
+}
+
+static void run_split_hashtag_list(uint64_t iterations)
+{
+  char inputHashtags[MAX_HASHTAG_LEN + 1];
+  TextView validHashtags[MAX_HASHTAG_CNT];
+  int numValidHashtags;
+
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    strcpy(inputHashtags, benchHashtags);
+    split_hashtag_list(inputHashtags, strlen(inputHashtags), validHashtags, MAX_HASHTAG_CNT, &numValidHashtags);
+  }
+}
+
+static void run_is_valid_tweet_text(uint64_t iterations)
+{
+  int len = strlen(benchTweetText);
+  int valid = 0;
+
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    valid += is_valid_tweet_text(benchTweetText, len);
+    __asm__ volatile("" : "+r"(valid)); /* keep the call in the loop */
+  }
+}
+
+static void clear_all_pending_tweets()
+{
+  for (int userIdx = 0; userIdx < maxActiveUsers; userIdx++)
+    for (int pendingTweetIdx = 0; pendingTweetIdx < MAX_TWEET_QUEUE; pendingTweetIdx++)
+      activeUsers[userIdx].pendingTweets[pendingTweetIdx][0] = '\0';
+}
+
+/* Two hashtags per tweet, rotating through the hashtag space */
+static void fill_latest_tweet(int variant)
+{
+  strcpy(latestTweet->username, "microbench");
+  strcpy(latestTweet->ttweetString, "A reasonably sized tweet body used by the fan-out microbenchmarks.");
+  latestTweet->numValidHashtags = 2;
+  snprintf(latestTweet->hashtags[0], MAX_HASHTAG_LEN, "tag%d", (variant * 13) % 1000);
+  snprintf(latestTweet->hashtags[1], MAX_HASHTAG_LEN, "tag%d", (variant * 13 + 500) % 1000);
+}
+
+static cJSON *create_tweet_request()
+{
+  cJSON *jobjToSend = cJSON_CreateObject();
+  cJSON *jarray = cJSON_CreateArray();
+
+  cJSON_AddItemToObject(jobjToSend, "requestCode", cJSON_CreateNumber(REQ_TWEET));
+  cJSON_AddItemToObject(jobjToSend, "username", cJSON_CreateString("microbench"));
+  cJSON_AddItemToArray(jarray, cJSON_CreateString("deploy"));
+  cJSON_AddItemToArray(jarray, cJSON_CreateString("outage"));
+  cJSON_AddItemToObject(jobjToSend, "ttweetString", cJSON_CreateString("A reasonably sized tweet body used by the fan-out microbenchmarks."));
+  cJSON_AddItemToObject(jobjToSend, "numValidHashtags", cJSON_CreateNumber(2));
+  cJSON_AddItemToObject(jobjToSend, "ttweetHashtags", jarray);
+  return jobjToSend;
+}
+
+static cJSON *create_timeline_response(int numTweets)
+{
+  cJSON *jobjToSend = cJSON_CreateObject();
+  cJSON *jarray = cJSON_CreateArray();
+  char tweetItem[MAX_TWEET_ITEM_LEN];
+
+  cJSON_AddItemToObject(jobjToSend, "responseCode", cJSON_CreateNumber(RES_TIMELINE));
+  cJSON_AddItemToObject(jobjToSend, "clientUserIdx", cJSON_CreateNumber(0));
+  cJSON_AddItemToObject(jobjToSend, "detailedMessage", cJSON_CreateString(""));
+  for (int tweetIdx = 0; tweetIdx < numTweets; tweetIdx++)
+  {
+    snprintf(tweetItem, sizeof(tweetItem), "microbench sender%d: A reasonably sized tweet body used by the fan-out microbenchmarks. #tag%d", tweetIdx, tweetIdx);
+    cJSON_AddItemToArray(jarray, cJSON_CreateString(tweetItem));
+  }
+  cJSON_AddItemToObject(jobjToSend, "storedTweets", jarray);
+  return jobjToSend;
+}
+
+/* parse_hashtags() as ttweetcli had it before ttweet_validate.c, kept as
+ * the baseline for split_hashtag_list() */
+static int legacy_parse_hashtags(char *validHashtags[], int *numValidHashtags, char *inputHashtags)
+{
+  int inputHashtagsCharIdx = 1;
+  int numConsecutiveHashes = 1;
+  int lenInputHashtags = strlen(inputHashtags);
+  char currentHashtagBuffer[MAX_HASHTAG_LEN];
+  int currentHashtagBufferIdx = 0;
+
+  *numValidHashtags = 0;
+  if (inputHashtags[0] != '#' || inputHashtags[lenInputHashtags - 1] == '#' || lenInputHashtags < 2 || lenInputHashtags > 25)
+    return 0;
+
+  while (inputHashtags[inputHashtagsCharIdx] != '\0')
+  {
+    if (inputHashtags[inputHashtagsCharIdx] == '#')
+    {
+      numConsecutiveHashes++;
+      if (numConsecutiveHashes > 1 || *numValidHashtags == MAX_HASHTAG_CNT)
+        return 0;
+      currentHashtagBuffer[currentHashtagBufferIdx] = '\0';
+      validHashtags[*numValidHashtags] = (char *)malloc((currentHashtagBufferIdx + 1) * sizeof(char));
+      strcpy(validHashtags[*numValidHashtags], currentHashtagBuffer);
+      currentHashtagBufferIdx = 0;
+      (*numValidHashtags)++;
+    }
+    else if (isalnum(inputHashtags[inputHashtagsCharIdx]) != 0)
+    {
+      currentHashtagBuffer[currentHashtagBufferIdx] = inputHashtags[inputHashtagsCharIdx];
+      currentHashtagBufferIdx++;
+      numConsecutiveHashes = 0;
+    }
+    else
+      return 0;
+    inputHashtagsCharIdx++;
+  }
+
+  if (*numValidHashtags == MAX_HASHTAG_CNT)
+    return 0;
+  currentHashtagBuffer[currentHashtagBufferIdx] = '\0';
+  validHashtags[*numValidHashtags] = (char *)malloc((currentHashtagBufferIdx + 1) * sizeof(char));
+  strcpy(validHashtags[*numValidHashtags], currentHashtagBuffer);
+  (*numValidHashtags)++;
+
+  for (int i = 0; i < *numValidHashtags - 1; i++)
+    for (int j = i + 1; j < *numValidHashtags; j++)
+      if (strcmp(validHashtags[i], validHashtags[j]) == 0)
+        return 0;
+  return 1;
+}
+
+/* Prints how many users the latest tweet's signatures let through */
+static void report_signature_false_positives()
+{
+  uint64_t keys[MAX_HASHTAG_CNT];
+  uint64_t matchMask[MATCH_MASK_WORDS(FANOUT_BLOCK_USERS)];
+  int numPassed = 0;
+  int numUsers;
+
+  for (int hashtagIdx = 0; hashtagIdx < latestTweet->numValidHashtags; hashtagIdx++)
+    keys[hashtagIdx] = hashtag_signature(hashtag_id(latestTweet->hashtags[hashtagIdx]));
+  for (int firstUser = 0; firstUser < maxActiveUsers; firstUser += FANOUT_BLOCK_USERS)
+  {
+    numUsers = maxActiveUsers - firstUser < FANOUT_BLOCK_USERS ? maxActiveUsers - firstUser : FANOUT_BLOCK_USERS;
+    numPassed += match_signatures(&userTable.subscriptionSignatures[firstUser], numUsers, keys, latestTweet->numValidHashtags, matchMask);
+  }
+  fprintf(stderr, "fanout_scan: %d of %d users passed the signature filter, false positive rate %.2f%%\n",
+          numPassed, maxActiveUsers, 100.0 * numPassed / maxActiveUsers);
+}
@@ -0,0 +1,162 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweetmicrobench.h
+  * @date 18 October 2026
+  * @brief Documentation for functions in ttweetmicrobench.c.
+  *
+  * This header file has been created to describe the functions in ttweetmicrobench.c.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  */
+
+#include "../server/ttweetsrv.h"
+
+/* Server state, defined in ttweetsrv.c */
+extern LatestTweet *latestTweet;
+extern User *activeUsers;
+extern UserTable userTable;
+extern int maxActiveUsers;
+extern SocketProfile socketProfile;
+extern AdmissionProfile admissionProfile;
+extern int64_t *undeliveredBytes;
+
+/* Harness settings */
+#define MICROBENCH_REPETITIONS 5  /* Runs per benchmark, the median is reported */
+#define MICROBENCH_MIN_CALIBRATION_NS 20000000ULL
+#define MICROBENCH_TCP_PIPELINE 16 /* Requests in flight in the pipelined TCP benchmarks */
+#define SIMD_CHECK_ROUNDS 20000      /* Random inputs every instruction set is compared with scalar on */
+#define SIMD_CHECK_MAX_ELEMENTS 300  /* Longest array given to the matchers, several mask words */
+
+typedef struct MicroBench
+{
+  char *name;                       /* Function or path being measured */
+  char *params;                     /* Human readable parameters */
+  int param;                        /* Parameter passed to setup */
+  int param2;                       /* Second parameter passed to setup */
+  void (*setup)(int param, int param2); /* Prepares state, not measured */
+  void (*run)(uint64_t iterations);     /* Runs iterations operations */
+  void (*teardown)();                   /* Releases state, not measured, may be NULL */
+} MicroBench;
+
+typedef struct MicroBenchResult
+{
+  double nsPerOp;
+  double allocsPerOp;
+  double cyclesPerOp;       /* Negative if perf counters are unavailable */
+  double instructionsPerOp; /* Negative if perf counters are unavailable */
+  uint64_t iterations;
+} MicroBenchResult;
+
+/* One random input for every function that picks an instruction set at run time */
+typedef struct SimdCheckInput
+{
+  char hashtagList[MAX_HASHTAG_LEN + 1];
+  int hashtagListLen; /* Up to one past the longest valid list */
+  char hashtag[MAX_HASHTAG_LEN];
+  int hashtagLen;
+  char tweetText[MAX_TWEET_LEN + 1];
+  int tweetTextLen;
+  char username[MAX_USERNAME_LEN];
+  int usernameLen;
+  uint64_t signatures[SIMD_CHECK_MAX_ELEMENTS];
+  int numSignatures;
+  uint64_t keys[MAX_MATCH_KEYS];
+  int numKeys;
+  uint8_t bytes[SIMD_CHECK_MAX_ELEMENTS];
+  int numBytes;
+} SimdCheckInput;
+
+/* What those functions return for a SimdCheckInput, compared byte for byte */
+typedef struct SimdCheckOutcome
+{
+  int splitResult;
+  int numHashtags;
+  int hashtagOffsets[MAX_HASHTAG_CNT];
+  int hashtagLens[MAX_HASHTAG_CNT];
+  int isValidHashtag;
+  int isValidTweetText;
+  int isValidUsername;
+  int numSignatureMatches;
+  uint64_t signatureMask[MATCH_MASK_WORDS(SIMD_CHECK_MAX_ELEMENTS)];
+  int numNonZeroBytes;
+  uint64_t nonZeroMask[MATCH_MASK_WORDS(SIMD_CHECK_MAX_ELEMENTS)];
+} SimdCheckOutcome;
+
+/**
+ * @brief Resumes measurement of time, allocations and perf counters
+ *
+ * Benchmarks call bench_timer_stop()/bench_timer_start() around work
+ * that must not be measured, such as refilling a queue.
+ *
+ * @return void
+ */
+void bench_timer_start();
+
+/**
+ * @brief Pauses measurement of time, allocations and perf counters
+ *
+ * @return void
+ */
+void bench_timer_stop();
+
+/**
+ * @brief Runs a benchmark with a fixed number of iterations
+ *
+ * @param bench Benchmark to run
+ * @param iterations Operations to perform
+ * @param result Measured cost per operation
+ * @return void
+ */
+void run_microbench(MicroBench *bench, uint64_t iterations, MicroBenchResult *result);
+
+/**
+ * @brief Calibrates and repeatedly runs a benchmark
+ *
+ * The iteration count is scaled until one run lasts about targetNs,
+ * then MICROBENCH_REPETITIONS runs are made and the median is kept.
+ *
+ * @param bench Benchmark to run
+ * @param targetNs Desired duration of one run in nanoseconds
+ * @param result Median cost per operation
+ * @return void
+ */
+void measure_microbench(MicroBench *bench, uint64_t targetNs, MicroBenchResult *result);
+
+/**
+ * @brief Opens hardware cycle and instruction counters for this thread
+ *
+ * @return int 1 if counters are available, 0 otherwise
+ */
+int open_perf_counters();
+
+/**
+ * @brief Prints the change of every benchmark against an earlier JSON report
+ *
+ * @param results JSON array produced by this run
+ * @param baselinePath Path to an earlier report
+ * @return void
+ */
+void compare_with_baseline(cJSON *results, char *baselinePath);
+
+/**
+ * @brief Checks that every instruction set gives the same results as scalar code
+ *
+ * The validators and matchers each have a scalar, SSE4.2 and AVX2
+ * implementation, of which the CPU normally runs only the best. Each level
+ * the CPU supports is forced in turn on SIMD_CHECK_ROUNDS random inputs of
+ * every length the functions accept, and any difference is printed.
+ *
+ * @param seed Seed of the random inputs, printed so a failure can be replayed with -s
+ * @return int 1 if every level agrees with scalar, 0 otherwise.
+ */
+int check_simd_levels(uint64_t seed);
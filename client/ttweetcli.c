@@ -39,66 +39,113 @@
   */
 
 #include "ttweetcli.h"
+#include <fcntl.h> /* for fcntl() */
+#include <poll.h>  /* for poll() */
+#include <getopt.h> /* for getopt_long() */
 
 /* Function prototypes */
 
+/* functions to drive the connection */
+int fill_line_reader(int fd, LineReader *reader);              /* Reads available input */
+int next_client_line(LineReader *reader, char *clientInput);   /* Returns the next complete line */
+int handle_client_line(ClientConn *conn, char *clientInput);   /* Parses a line and queues the request */
+int queue_client_request(ClientConn *conn, cJSON *jobjToSend); /* Appends a request to the output buffer */
+int flush_client_output(ClientConn *conn);                     /* Sends buffered requests */
+int drain_server_responses(ClientConn *conn);                  /* Handles received responses */
+
+/* functions for batch mode */
+void queue_batch_line(ClientConn *conn, char *clientInput); /* Queues a line of batch input */
+void print_completed_batch_lines(BatchState *batch);        /* Prints finished lines in order */
+void record_batch_error(char *errorMessage);                /* Keeps a local error for its line */
+
 /* functions to handle and validate user input */
-int get_client_input(char *clientInput);                                                                                           /* Reads user input from stdin */
-int parse_client_command(char inputHashtags[], char ttweetString[]);                                                               /* Parses command from user input */
-int parse_hashtags(char *validHashtags[], int *numValidHashtags, char *inputHashtags);                                             /* Parses hashtags from user command */
-int has_duplicate_string(char *stringArray[], int numStringsInArray);                                                              /* Checks for duplicates in string array */
-int is_hashtag_all_exists(char *validHashtags[], int numValidHashtags);                                                            /* Checks if hashtag #ALL exists */
-void reset_client_variables(int *clientCommandSuccess, char *validHashtags[], int *numValidHashtags, cJSON *jobjToSend);           /* Resets client variables for next command */
-void deallocate_string_array(char *stringArray[], int numStringsInArray);                                                          /* Deallocates memory from a dynamic string array */
-void save_current_hashtag(char *currentHashtagBuffer, int *currentHashtagBufferIdx, char *validHashtags[], int *numValidHashtags); /* Save current hashtag buffer */
+int parse_client_command(char clientInput[], char inputHashtags[], char ttweetString[]);                                           /* Parses command from user input */
+int parse_hashtags(TextView validHashtags[], int *numValidHashtags, char *inputHashtags);                                           /* Parses hashtags from user command */
+int parse_subscription(TextView validHashtags[], int *numValidHashtags, char *inputHashtags);                                       /* Parses a hashtag or prefix */
+int is_hashtag_all_exists(TextView validHashtags[], int numValidHashtags);                                                          /* Checks if hashtag #ALL exists */
 
 /* functions to support transmission of data */
-void create_json_client_payload(cJSON *jobjToSend, int commandCode, char *username, int userIdx, char *ttweetString, char *validHashtags[], int numValidHashtags); /* Creates payload to send to server */
-void handle_server_response(cJSON *jobjReceived, int *userIdx);                                                                                                    /* Handles server response */
+void create_json_client_payload(cJSON *jobjToSend, int commandCode, char *username, int userIdx, char *ttweetString, TextView validHashtags[], int numValidHashtags); /* Creates payload to send to server */
+void handle_server_response(cJSON *jobjReceived, ClientConn *conn);                                                                                                   /* Handles server response */
 
 /* functions to parse and validate user commands */
 int check_tweet_cmd(char clientInput[], int charIdx, char inputHashtags[], char ttweetString[]); /* Parses and validates tweet command */
 int check_subscribe_cmd(char clientInput[], int charIdx, char inputHashtags[]);                  /* Parses and validates subscribe command */
 int check_unsubscribe_cmd(char clientInput[], int charIdx, char inputHashtags[]);                /* Parses and validates unsubscribe command */
-int check_timeline_cmd(int endOfCmd);                                                            /* Parses and validates timeline command */
+int check_keyword_cmd(char clientInput[], int charIdx, char keyword[], int requestCode);         /* Parses and validates keyword commands */
+int check_follow_cmd(char clientInput[], int charIdx, int endOfCmd, char followUsername[], int requestCode); /* Parses and validates follow commands */
+int check_search_cmd(char clientInput[], int charIdx, int endOfCmd, char searchQuery[]);         /* Parses and validates search command */
+int check_trending_cmd(char clientInput[], int charIdx, int endOfCmd, char trendingWindow[]);    /* Parses and validates trending command */
+int check_timeline_cmd(char clientInput[], int charIdx, int endOfCmd, char maxTweets[]);         /* Parses and validates timeline command */
 int check_exit_cmd(int endOfCmd);                                                                /* Parses and validates exit command */
 
+static BatchEntry *currentBatchEntry = NULL; /* Line being parsed in batch mode */
+
+static struct option clientOptions[] = {
+    {"batch", required_argument, NULL, 'b'},
+    {"window", required_argument, NULL, 'w'},
+    {"compress", no_argument, NULL, 'z'},
+    {NULL, 0, NULL, 0}};
+
 int main(int argc, char *argv[])
 {
   /* Socket variables */
-  int sock;                          /* Socket descriptor */
   struct sockaddr_in ttweetServAddr; /* ttweet server address */
   unsigned short ttweetServPort;     /* ttweet server port */
   char *servIP;                      /* Server IP address (dotted quad) */
 
   /* Variables for user input */
-  int clientCommandCode;                /* Request code recognized by server */
-  int clientCommandSuccess;             /* Boolean to track command validity */
-  int numValidHashtags = 0;             /* Number of valid hashtags */
-  char ttweetString[MAX_TWEET_LEN];     /* String to be send to ttweet server */
-  char *username;                       /* Client username */
-  char inputHashtags[MAX_HASHTAG_LEN];  /* Array of all hashtags submitted */
-  char *validHashtags[MAX_HASHTAG_CNT]; /* Array of valid hashtags */
+  static LineReader lineReader;        /* Buffered stdin or batch file */
+  int inputFd = STDIN_FILENO;          /* Where commands are read from */
+  char *batchPath = NULL;              /* --batch argument, "-" for stdin */
+  int batchWindow = BATCH_DEFAULT_WINDOW;
+  int askCompression = 0;              /* --compress given */
+  static BatchState batch;             /* Outstanding batch lines */
+  struct timespec batchStart, batchEnd;
+  double batchSecs;
+  int opt;
+  char clientInput[MAX_CLI_INPUT_LEN]; /* Current line */
+  int lineStatus;                      /* Result of next_client_line() */
 
   /* Variables to handle transfer of data over TCP */
-  cJSON *jobjToSend;              /* JSON payload to be sent */
-  cJSON *jobjReceived;            /* JSON response received */
-  char objReceived[MAX_RESP_LEN]; /* String response received */
+  static ClientConn conn;   /* Connection state, too large for the stack */
+  cJSON *jobjToSend;        /* JSON payload to be sent */
+  struct pollfd pollFds[2]; /* Server socket and stdin */
+  int numPollFds;
 
-  /* Variables for server to recognize client */
-  int userIdx = INVALID_USER_INDEX;
+  while ((opt = getopt_long(argc, argv, "", clientOptions, NULL)) != -1)
+  {
+    switch (opt)
+    {
+    case 'b':
+      batchPath = optarg;
+      break;
+    case 'w':
+      batchWindow = atoi(optarg);
+      if (batchWindow < 1 || batchWindow > BATCH_MAX_WINDOW)
+        die_with_error("--window must be between 1 and 65536.");
+      break;
+    case 'z':
+      askCompression = 1;
+      break;
+    default:
+      die_with_error("Command not recognized!\nUsage: $./ttweetcli [--batch <File|->] [--window <Lines>] [--compress] <ServerIP> <ServerPort> <Username>");
+    }
+  }
 
-  if (argc != 4) /* Test for correct number of arguments */
+  if (argc - optind != 3) /* Test for correct number of arguments */
   {
-    die_with_error("Command not recognized!\nUsage: $./ttweetcli <ServerIP> <ServerPort> <Username>");
+    die_with_error("Command not recognized!\nUsage: $./ttweetcli [--batch <File|->] [--window <Lines>] [--compress] <ServerIP> <ServerPort> <Username>");
   }
 
-  servIP = argv[1];               /* Server IP address (dotted quad) */
-  ttweetServPort = atoi(argv[2]); /* Use given port, if any */
-  username = argv[3];             /* Parse username */
+  servIP = argv[optind];                   /* Server IP address (dotted quad) */
+  ttweetServPort = atoi(argv[optind + 1]); /* Use given port, if any */
+  conn.username = argv[optind + 2];        /* Parse username */
+  conn.userIdx = INVALID_USER_INDEX;
+  payload_reader_reset(&conn.reader);
 
   /* Create a reliable, stream socket using TCP */
-  if ((sock = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0)
+  if ((conn.sock = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0)
     die_with_error("socket() failed");
 
   /* Construct the server address structure */
@@ -108,214 +155,399 @@ int main(int argc, char *argv[])
   ttweetServAddr.sin_port = htons(ttweetServPort);    /* Server port */
 
   /* Establish the connection to the ttweet server */
-  if (connect(sock, (struct sockaddr *)&ttweetServAddr, sizeof(ttweetServAddr)) < 0)
+  if (connect(conn.sock, (struct sockaddr *)&ttweetServAddr, sizeof(ttweetServAddr)) < 0)
     die_with_error("connect() failed");
-
-  /* Upload username to server for validation */
+  if (fcntl(conn.sock, F_SETFL, fcntl(conn.sock, F_GETFL) | O_NONBLOCK) < 0)
+    die_with_error("fcntl() failed");
+  signal(SIGPIPE, SIG_IGN);
+
+  if (batchPath != NULL)
+  { /* Results are printed in input order, local errors included */
+    if (strcmp(batchPath, "-") != 0 && (inputFd = open(batchPath, O_RDONLY)) < 0)
+      die_with_error("open() failed");
+    if ((batch.entries = calloc(batchWindow, sizeof(BatchEntry))) == NULL)
+      die_with_error("calloc() failed");
+    batch.window = batchWindow;
+    batch.count = 1; /* Username validation is the first outstanding request */
+    batch.entries[0].awaitingResponse = 1;
+    conn.batch = &batch;
+    set_persist_error_handler(record_batch_error);
+    clock_gettime(CLOCK_MONOTONIC, &batchStart);
+  }
+
+  /* Upload username to server for validation. Commands typed before the
+   * answer arrives queue up behind it; the server handles them in order. */
   jobjToSend = cJSON_CreateObject();
-  create_json_client_payload(jobjToSend, REQ_VALIDATE_USER, username, INVALID_USER_INDEX, ttweetString, validHashtags, numValidHashtags);
-  send_payload(sock, jobjToSend);
-
-  /* Process username validation code from server */
-  receive_response(sock, objReceived);
-  jobjReceived = cJSON_Parse(objReceived);
-  handle_server_response(jobjReceived, &userIdx);
+  create_json_client_payload(jobjToSend, REQ_VALIDATE_USER, conn.username, INVALID_USER_INDEX, NULL, NULL, 0);
+  if (askCompression)
+  { /* Granted in the login response, for the responses after it */
+    cJSON_AddItemToObject(jobjToSend, "compression", cJSON_CreateString(COMPRESS_CODEC_NAME));
+  }
+  queue_client_request(&conn, jobjToSend);
+  cJSON_Delete(jobjToSend);
 
   while (1)
-  { /* Loop continuously */
-
-    /* Resets variables for next command */
-    reset_client_variables(&clientCommandSuccess, validHashtags, &numValidHashtags, jobjToSend);
-    jobjToSend = cJSON_CreateObject();
+  { /* Wait for the server, the user, or room to send */
+    pollFds[0].fd = conn.sock;
+    pollFds[0].events = POLLIN | (conn.outOff < conn.outLen ? POLLOUT : 0);
+    numPollFds = 1;
+    if (!lineReader.eof && !conn.exitQueued && CLIENT_OUT_BUF_SIZE - conn.outLen >= CLIENT_MAX_REQUEST_LEN &&
+        (conn.batch == NULL || batch.count < batch.window))
+    { /* Only accept input while there is room to queue its request */
+      pollFds[1].fd = inputFd;
+      pollFds[1].events = POLLIN;
+      numPollFds = 2;
+    }
 
-    /* Parse client command */
-    clientCommandCode = parse_client_command(inputHashtags, ttweetString);
+    if (poll(pollFds, numPollFds, -1) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      die_with_error("poll() failed");
+    }
 
-    switch (clientCommandCode)
-    { /* Further processing of client commands */
-    case REQ_TWEET:
-      clientCommandSuccess = parse_hashtags(validHashtags, &numValidHashtags, inputHashtags);
-      clientCommandSuccess = is_hashtag_all_exists(validHashtags, numValidHashtags);
-      break;
-    case REQ_SUBSCRIBE:
-    case REQ_UNSUBSCRIBE:
-      clientCommandSuccess = parse_hashtags(validHashtags, &numValidHashtags, inputHashtags);
-      if (numValidHashtags != 1)
+    if (pollFds[0].revents & (POLLIN | POLLHUP | POLLERR))
+    { /* Responses (or a closed connection) from the server */
+      if (!drain_server_responses(&conn))
       {
-        clientCommandSuccess = persist_with_error("Subscribe/Unsubscribe only accepts one hashtag as the argument.");
-        break;
+        if (conn.exitQueued)
+        { /* Server closes the connection once it has handled exit */
+          close(conn.sock);
+          if (conn.batch != NULL)
+          {
+            print_completed_batch_lines(&batch);
+            fflush(stdout);
+            clock_gettime(CLOCK_MONOTONIC, &batchEnd);
+            batchSecs = (batchEnd.tv_sec - batchStart.tv_sec) + (batchEnd.tv_nsec - batchStart.tv_nsec) / 1e9;
+            fprintf(stderr, "Batch: %ld lines, %ld sent, %ld rejected in %.3fs (%.0f lines/s)\n",
+                    batch.lineNo, batch.sent, batch.rejected, batchSecs, batchSecs > 0 ? batch.lineNo / batchSecs : 0.0);
+          }
+          exit(0);
+        }
+        die_with_error("Server closed the connection.");
       }
-      break;
-    case REQ_TIMELINE:
-    case REQ_EXIT:
-      break;
-    case REQ_INVALID:
-      clientCommandSuccess = persist_with_error("Invalid command entered.");
-      break;
-    default:
-      die_with_error("An error occured. Exiting client...");
-      break;
     }
 
-    if (clientCommandSuccess)
-    { /* No errors when processing client command */
-      create_json_client_payload(jobjToSend, clientCommandCode, username, userIdx, ttweetString, validHashtags, numValidHashtags);
-      clientCommandSuccess = send_payload(sock, jobjToSend);
+    if (numPollFds == 2 && (pollFds[1].revents & (POLLIN | POLLHUP | POLLERR)))
+    { /* New input from the user */
+      if (fill_line_reader(inputFd, &lineReader) < 0)
+        die_with_error("read() failed");
     }
 
-    if (clientCommandCode == REQ_EXIT)
-    { /* Client entered exit command */
-      printf("Exiting client...\n");
-      wait_for(3);
-      close(sock);
-      exit(0);
+    /* Lines left over from an earlier read are queued once there is room,
+     * even after input has ended */
+    while (!conn.exitQueued && CLIENT_OUT_BUF_SIZE - conn.outLen >= CLIENT_MAX_REQUEST_LEN &&
+           (conn.batch == NULL || batch.count < batch.window) &&
+           (lineStatus = next_client_line(&lineReader, clientInput)) != 0)
+    {
+      if (conn.batch != NULL)
+        queue_batch_line(&conn, lineStatus < 0 ? NULL : clientInput);
+      else if (lineStatus < 0)
+        persist_with_error("Input is too long. Please try again.\n");
+      else
+        handle_client_line(&conn, clientInput);
     }
-
-    if (clientCommandSuccess)
-    { /* Payload sent successfully. Note that all valid commands except exit will trigger this if block. */
-      receive_response(sock, objReceived);
-      jobjReceived = cJSON_Parse(objReceived);
-      /* Handles server response accordingly */
-      handle_server_response(jobjReceived, &userIdx);
+    if (lineReader.eof && lineReader.start == lineReader.end && !conn.exitQueued)
+    { /* Input ended without exit, leave as if exit was typed */
+      handle_client_line(&conn, "exit");
     }
+
+    if (conn.outOff < conn.outLen && !flush_client_output(&conn))
+      die_with_error("Server closed the connection.");
   }
 }
 
-/** \copydoc parse_hashtags */
-int parse_hashtags(char *validHashtags[], int *numValidHashtags, char *inputHashtags)
+/** \copydoc fill_line_reader */
+int fill_line_reader(int fd, LineReader *reader)
 {
-  int inputHashtagsCharIdx = 1;               /* Track char index in inputHashtags string */
-  int numConsecutiveHashes = 1;               /* Check for duplicate # within hashtag */
-  int lenInputHashtags;                       /* Length of inputHashtags string */
-  char currentHashtagBuffer[MAX_HASHTAG_LEN]; /* Current hashtag being parsed */
-  int currentHashtagBufferIdx;                /* char index of current hashtag being parsed */
-
-  *numValidHashtags = 0;       /* Initialize number of valid hashtags */
-  currentHashtagBufferIdx = 0; /* Initialize buffer index */
-
-  lenInputHashtags = strlen(inputHashtags); /* Assign length of input hashtags */
+  int bytesRead;
+
+  if (reader->start > 0)
+  { /* Move the unfinished line to the front */
+    memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+    reader->end -= reader->start;
+    reader->start = 0;
+  }
+  if (reader->end == CLIENT_IN_BUF_SIZE)
+  { /* One line fills the whole buffer, drop it and skip to its end */
+    reader->discarding = 1;
+    reader->end = 0;
+  }
+
+  bytesRead = read(fd, reader->buffer + reader->end, CLIENT_IN_BUF_SIZE - reader->end);
+  if (bytesRead < 0)
+    return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+  if (bytesRead == 0)
+    reader->eof = 1;
+  reader->end += bytesRead;
+  return bytesRead;
+}
 
-  if (inputHashtags[0] != '#')
-  { /* Hashtag must begin with # */
-    return persist_with_error("Invalid hashtag(s)! Hashtag(s) must begin with #.");
-  }
+/** \copydoc next_client_line */
+int next_client_line(LineReader *reader, char *clientInput)
+{
+  char *newline;
+  int lineLen;
+
+  newline = memchr(reader->buffer + reader->start, '\n', reader->end - reader->start);
+  if (newline != NULL)
+    lineLen = newline - (reader->buffer + reader->start);
+  else if (reader->eof && reader->start < reader->end)
+    lineLen = reader->end - reader->start; /* Last line has no newline */
+  else
+    return 0;
 
-  if (inputHashtags[lenInputHashtags - 1] == '#')
-  { /* Hashtag cannot end with # */
-    return persist_with_error("Invalid hashtag(s)! Hashtag(s) cannot end with #.");
+  if (reader->discarding || lineLen > MAX_CLI_INPUT_LEN - 5)
+  { /* clientInput buffer exceeded */
+    reader->discarding = 0;
+    reader->start += lineLen + (newline != NULL);
+    return -1;
   }
 
-  if (lenInputHashtags < 2 || lenInputHashtags > 25)
-  { /* Hashtag must be between 2 to 25 chars long */
-    return persist_with_error("Invalid hashtag(s)! Hashtag(s) must be between 2 to 25 chars long.");
-  }
+  memcpy(clientInput, reader->buffer + reader->start, lineLen);
+  clientInput[lineLen] = '\0';
+  reader->start += lineLen + (newline != NULL);
+  return 1;
+}
 
-  while (inputHashtags[inputHashtagsCharIdx] != '\0')
-  { /* Not yet reached end of inputHashtags */
-    if (inputHashtags[inputHashtagsCharIdx] == '#')
+/** \copydoc handle_client_line */
+int handle_client_line(ClientConn *conn, char *clientInput)
+{
+  int clientCommandCode;                   /* Request code recognized by server */
+  int clientCommandSuccess = 1;            /* Boolean to track command validity */
+  char ttweetString[MAX_TWEET_LEN + 1];    /* String to be send to ttweet server */
+  char inputHashtags[MAX_HASHTAG_LEN + 1]; /* Array of all hashtags submitted */
+  TextView validHashtags[MAX_HASHTAG_CNT]; /* Views of valid hashtags in inputHashtags */
+  int numValidHashtags = 0;                /* Number of valid hashtags */
+  cJSON *jobjToSend;                       /* JSON payload to be sent */
+
+  /* Parse client command */
+  clientCommandCode = parse_client_command(clientInput, inputHashtags, ttweetString);
+
+  switch (clientCommandCode)
+  { /* Further processing of client commands */
+  case REQ_TWEET:
+    clientCommandSuccess = parse_hashtags(validHashtags, &numValidHashtags, inputHashtags) &&
+                           is_hashtag_all_exists(validHashtags, numValidHashtags);
+    break;
+  case REQ_SUBSCRIBE:
+  case REQ_UNSUBSCRIBE:
+    clientCommandSuccess = parse_subscription(validHashtags, &numValidHashtags, inputHashtags);
+    if (clientCommandSuccess && numValidHashtags != 1)
     {
-      numConsecutiveHashes++;
-      if (numConsecutiveHashes > 1)
-      { /* Hashtag contains consecutive # */
-        return persist_with_error("Invalid hashtag(s)! Hashtag(s) cannot contain consecutive #.");
-      }
-      else
-      { /* Reached end of current hashtag. Save and prepare to parse next hashtag. */
-        if (*numValidHashtags == MAX_HASHTAG_CNT)
-        { /* Hashtag limit exceeded */
-          return persist_with_error("Invalid hashtag(s)! Hashtag limit exceeded.");
-        }
-        else
-        { /* Save the current hashtag */
-          save_current_hashtag(currentHashtagBuffer, &currentHashtagBufferIdx, validHashtags, numValidHashtags);
-        }
-      }
+      clientCommandSuccess = persist_with_error("Subscribe/Unsubscribe only accepts one hashtag as the argument.");
     }
-    else if (isalnum(inputHashtags[inputHashtagsCharIdx]) != 0)
-    { /* char is alphanumeric */
-      currentHashtagBuffer[currentHashtagBufferIdx] = inputHashtags[inputHashtagsCharIdx];
-      currentHashtagBufferIdx++;
-      numConsecutiveHashes = 0;
-    }
-    else
-    { /* char is not alphanumeric or # */
-      return persist_with_error("Invalid hashtag(s)! Hashtag(s) contains invalid characters.");
-    }
-    inputHashtagsCharIdx++;
+    break;
+  case REQ_SUBSCRIBE_KEYWORD:
+  case REQ_UNSUBSCRIBE_KEYWORD:
+    /* check_keyword_cmd() validated the keyword, sent like a single hashtag */
+    validHashtags[0].start = inputHashtags;
+    validHashtags[0].len = strlen(inputHashtags);
+    numValidHashtags = 1;
+    break;
+  case REQ_FOLLOW:
+  case REQ_UNFOLLOW:
+  case REQ_SEARCH:
+  case REQ_TRENDING:
+  case REQ_TIMELINE:
+  case REQ_EXIT:
+    break;
+  case REQ_INVALID:
+    clientCommandSuccess = persist_with_error("Invalid command entered.");
+    break;
+  default:
+    die_with_error("An error occured. Exiting client...");
+    break;
   }
 
-  /* Reached end of inputHashtags (reached char \0) */
-  if (*numValidHashtags == MAX_HASHTAG_CNT)
-  { /* Hashtag limit exceeded */
-    return persist_with_error("Invalid hashtag(s)! Hashtag limit exceeded.");
+  if (!clientCommandSuccess)
+    return REQ_INVALID;
+
+  jobjToSend = cJSON_CreateObject();
+  create_json_client_payload(jobjToSend, clientCommandCode, conn->username, conn->userIdx, ttweetString, validHashtags, numValidHashtags);
+  if (clientCommandCode == REQ_TIMELINE)
+  { /* Acknowledges the tweets printed so far, so only later ones are sent */
+    cJSON_AddItemToObject(jobjToSend, "timelineCursor", cJSON_CreateNumber(conn->timelineCursor));
+  }
+  queue_client_request(conn, jobjToSend);
+  cJSON_Delete(jobjToSend);
+
+  if (clientCommandCode == REQ_EXIT)
+  { /* Client entered exit command. Responses to earlier commands are still
+     * printed until the server closes the connection. */
+    if (conn->batch == NULL)
+      printf("Exiting client...\n");
+    conn->exitQueued = 1;
   }
-  else
+  return clientCommandCode;
+}
+
+/** \copydoc queue_client_request */
+int queue_client_request(ClientConn *conn, cJSON *jobjToSend)
+{
+  int encodedLen = encode_payload(jobjToSend, conn->outBuf + conn->outLen, CLIENT_OUT_BUF_SIZE - conn->outLen);
+
+  conn->outLen += encodedLen;
+  return encodedLen > 0;
+}
+
+/** \copydoc flush_client_output */
+int flush_client_output(ClientConn *conn)
+{
+  int bytesSent;
+
+  while (conn->outOff < conn->outLen)
   {
-    save_current_hashtag(currentHashtagBuffer, &currentHashtagBufferIdx, validHashtags, numValidHashtags);
+    bytesSent = send(conn->sock, conn->outBuf + conn->outOff, conn->outLen - conn->outOff, 0);
+    if (bytesSent < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    conn->outOff += bytesSent;
   }
 
-  if (has_duplicate_string(validHashtags, *numValidHashtags))
-  { /* validHashtags contain duplicate hashtags */
-    return persist_with_error("Invalid hashtag(s)! Duplicate hashtags detected.");
-  }
+  /* Everything was sent, reuse the buffer from the start */
+  conn->outOff = 0;
+  conn->outLen = 0;
   return 1;
 }
 
-/** \copydoc save_current_hashtag */
-void save_current_hashtag(char *currentHashtagBuffer, int *currentHashtagBufferIdx, char *validHashtags[], int *numValidHashtags)
+/** \copydoc drain_server_responses */
+int drain_server_responses(ClientConn *conn)
 {
-  currentHashtagBuffer[*currentHashtagBufferIdx] = '\0';
-  validHashtags[*numValidHashtags] = (char *)malloc((*currentHashtagBufferIdx + 1) * sizeof(char));
-  strcpy(validHashtags[*numValidHashtags], currentHashtagBuffer);
-  *currentHashtagBufferIdx = 0;
-  (*numValidHashtags)++;
-}
+  int status;
+  cJSON *jobjReceived;
+  cJSON *responseCode;
+  cJSON *jobjToSend;
 
-/** \copydoc has_duplicate_string */
-int has_duplicate_string(char *stringArray[], int numStringsInArray)
-{
-  for (int i = 0; i < numStringsInArray - 1; i++)
+  while ((status = receive_payload_nonblocking(conn->sock, &conn->reader)) == 1)
   {
-    for (int j = i + 1; j < numStringsInArray; j++)
-    {
-      if (strcmp(stringArray[i], stringArray[j]) == 0)
+    jobjReceived = cJSON_Parse(conn->reader.payload);
+    payload_reader_reset(&conn->reader);
+    responseCode = cJSON_GetObjectItemCaseSensitive(jobjReceived, "responseCode");
+    if (cJSON_IsNumber(responseCode) && responseCode->valueint == RES_PING)
+    { /* Heartbeat, answered without a response of its own */
+      if (!conn->exitQueued)
       {
-        return 1;
+        jobjToSend = cJSON_CreateObject();
+        create_json_client_payload(jobjToSend, REQ_PING, conn->username, conn->userIdx, NULL, NULL, 0);
+        queue_client_request(conn, jobjToSend);
+        cJSON_Delete(jobjToSend);
       }
+      cJSON_Delete(jobjReceived);
+      continue;
     }
-  }
-  return 0;
+    if (conn->batch != NULL)
+    { /* The response belongs to the oldest line still awaiting one */
+      print_completed_batch_lines(conn->batch);
+      if (conn->batch->count == 0)
+        die_with_error("Error! Server sent an unexpected response.");
+      conn->batch->head = (conn->batch->head + 1) % conn->batch->window;
+      conn->batch->count--;
+    }
+    /* Handles server response accordingly */
+    handle_server_response(jobjReceived, conn);
+    cJSON_Delete(jobjReceived);
+  }
+  if (conn->batch != NULL)
+    print_completed_batch_lines(conn->batch);
+  fflush(stdout);
+  return status == 0;
 }
 
-/** \copydoc reset_client_variables */
-void reset_client_variables(int *clientCommandSuccess, char *validHashtags[], int *numValidHashtags, cJSON *jobjToSend)
+/** \copydoc queue_batch_line */
+void queue_batch_line(ClientConn *conn, char *clientInput)
 {
-  *clientCommandSuccess = 1;
-  deallocate_string_array(validHashtags, *numValidHashtags);
-  *numValidHashtags = 0;
-  if (!jobjToSend)
-  { /* jobjToSend still exists */
-    cJSON_Delete(jobjToSend);
+  BatchState *batch = conn->batch;
+  BatchEntry *entry = &batch->entries[(batch->head + batch->count) % batch->window];
+  int clientCommandCode;
+
+  batch->count++;
+  entry->lineNo = ++batch->lineNo;
+  entry->awaitingResponse = 0;
+  entry->error[0] = '\0';
+
+  currentBatchEntry = entry;
+  if (clientInput == NULL)
+  {
+    persist_with_error("Input is too long.");
+    clientCommandCode = REQ_INVALID;
+  }
+  else
+    clientCommandCode = handle_client_line(conn, clientInput);
+  currentBatchEntry = NULL;
+
+  if (clientCommandCode == REQ_INVALID)
+    batch->rejected++;
+  else if (clientCommandCode != REQ_EXIT)
+  { /* The server does not answer exit, it closes the connection */
+    entry->awaitingResponse = 1;
+    batch->sent++;
   }
 }
 
-/** \copydoc deallocate_string_array */
-void deallocate_string_array(char *stringArray[], int numStringsInArray)
+/** \copydoc print_completed_batch_lines */
+void print_completed_batch_lines(BatchState *batch)
 {
-  if (!numStringsInArray)
+  BatchEntry *entry;
+
+  while (batch->count > 0 && !(entry = &batch->entries[batch->head])->awaitingResponse)
   {
+    if (entry->error[0] != '\0')
+      printf("line %ld: %s\n", entry->lineNo, entry->error);
+    batch->head = (batch->head + 1) % batch->window;
+    batch->count--;
+  }
+}
+
+/** \copydoc record_batch_error */
+void record_batch_error(char *errorMessage)
+{
+  int len;
+
+  if (currentBatchEntry == NULL)
+  { /* Not parsing a batch line, report as usual */
+    fprintf(stderr, "%s\n", errorMessage);
     return;
   }
-  for (int i = 0; i < numStringsInArray; i++)
+  snprintf(currentBatchEntry->error, BATCH_ERROR_LEN, "%s", errorMessage);
+  len = strlen(currentBatchEntry->error);
+  while (len > 0 && currentBatchEntry->error[len - 1] == '\n')
+    currentBatchEntry->error[--len] = '\0';
+}
+
+/** \copydoc parse_hashtags */
+int parse_hashtags(TextView validHashtags[], int *numValidHashtags, char *inputHashtags)
+{
+  int result = split_hashtag_list(inputHashtags, strlen(inputHashtags), validHashtags, MAX_HASHTAG_CNT, numValidHashtags);
+
+  if (result != VALIDATE_OK)
+  { /* Hashtags are malformed */
+    return persist_with_error(validate_error_message(result));
+  }
+  return 1;
+}
+
+/** \copydoc parse_subscription */
+int parse_subscription(TextView validHashtags[], int *numValidHashtags, char *inputHashtags)
+{
+  int len = strlen(inputHashtags);
+  int isPrefix = len > 2 && inputHashtags[len - 1] == PREFIX_WILDCARD;
+  int result;
+
+  if (isPrefix)
+    inputHashtags[len - 1] = '\0'; /* Validate the prefix as a hashtag */
+  result = parse_hashtags(validHashtags, numValidHashtags, inputHashtags);
+  if (isPrefix)
   {
-    free(stringArray[i]);
+    inputHashtags[len - 1] = PREFIX_WILDCARD;
+    if (result && *numValidHashtags == 1)
+      validHashtags[0].len++; /* The view now ends with the wildcard */
   }
+  return result;
 }
 
 /** \copydoc parse_client_command */
-int parse_client_command(char inputHashtags[], char ttweetString[])
+int parse_client_command(char clientInput[], char inputHashtags[], char ttweetString[])
 {
-  char clientInput[MAX_CLI_INPUT_LEN]; /* Buffer to store client input */
   char clientCommand[20];              /* Buffer to store client command */
   int charIdx = 0;                     /* Tracks index in clientInput */
   int endOfCmd = 0;                    /* Tracks when end of clientInput reached */
@@ -324,13 +556,14 @@ int parse_client_command(char inputHashtags[], char ttweetString[])
                         1. tweet​ \"<150 char max tweet>\" <Hashtag>\n\
                         2. subscribe​ <Hashtag>\n\
                         3. unsubscribe​ <Hashtag>\n\
-                        4. timeline\n\
-                        5. exit\n";
-
-  if (!get_client_input(clientInput))
-  { /* Client input exceeds MAX_CLI_INPUT_LEN */
-    return persist_with_error("Input is too long. Please try again.\n");
-  }
+                        4. subscribe-keyword <Keyword>\n\
+                        5. unsubscribe-keyword <Keyword>\n\
+                        6. follow <Username>\n\
+                        7. unfollow <Username>\n\
+                        8. search <Query>\n\
+                        9. trending [1m|5m|1h]\n\
+                        10. timeline [<1-15 tweets>]\n\
+                        11. exit\n";
 
   /* Parse client input */
   while (clientInput[charIdx] != ' ')
@@ -344,7 +577,7 @@ int parse_client_command(char inputHashtags[], char ttweetString[])
     { /* None of the valid commands exceed 19 chars */
       return persist_with_error(unknownCmdMsg);
     }
-    strncpy(clientCommand + charIdx, clientInput + charIdx, sizeof(char));
+    clientCommand[charIdx] = clientInput[charIdx];
     charIdx++;
   }
 
@@ -365,9 +598,33 @@ int parse_client_command(char inputHashtags[], char ttweetString[])
   {
     return check_unsubscribe_cmd(clientInput, charIdx, inputHashtags);
   }
+  else if (strcmp(clientCommand, "subscribe-keyword") == 0)
+  {
+    return check_keyword_cmd(clientInput, charIdx, inputHashtags, REQ_SUBSCRIBE_KEYWORD);
+  }
+  else if (strcmp(clientCommand, "unsubscribe-keyword") == 0)
+  {
+    return check_keyword_cmd(clientInput, charIdx, inputHashtags, REQ_UNSUBSCRIBE_KEYWORD);
+  }
+  else if (strcmp(clientCommand, "follow") == 0)
+  {
+    return check_follow_cmd(clientInput, charIdx, endOfCmd, ttweetString, REQ_FOLLOW);
+  }
+  else if (strcmp(clientCommand, "unfollow") == 0)
+  {
+    return check_follow_cmd(clientInput, charIdx, endOfCmd, ttweetString, REQ_UNFOLLOW);
+  }
+  else if (strcmp(clientCommand, "search") == 0)
+  {
+    return check_search_cmd(clientInput, charIdx, endOfCmd, ttweetString);
+  }
+  else if (strcmp(clientCommand, "trending") == 0)
+  {
+    return check_trending_cmd(clientInput, charIdx, endOfCmd, ttweetString);
+  }
   else if (strcmp(clientCommand, "timeline") == 0)
   {
-    return check_timeline_cmd(endOfCmd);
+    return check_timeline_cmd(clientInput, charIdx, endOfCmd, ttweetString);
   }
   else if (strcmp(clientCommand, "exit") == 0)
   {
@@ -382,8 +639,9 @@ int parse_client_command(char inputHashtags[], char ttweetString[])
 /** \copydoc check_tweet_cmd */
 int check_tweet_cmd(char clientInput[], int charIdx, char inputHashtags[], char ttweetString[])
 {
-  int ttweetStringIdx = 0;
+  int ttweetStringLen;
   int inputHashtagsIdx = 0;
+  char *closingQuote;
   char *invalidTweetCmdMsg = "tweet command not formatted correctly. Please try again.";
 
   if (clientInput[charIdx] != '\"')
@@ -398,21 +656,26 @@ int check_tweet_cmd(char clientInput[], int charIdx, char inputHashtags[], char
     return persist_with_error("Tweet message cannot be empty!");
   }
 
-  while (clientInput[charIdx] != '\"')
-  { /* Loop between double quotes to save ttweetString */
-    if (ttweetStringIdx > MAX_TWEET_LEN - 1)
-    {
-      return persist_with_error("Tweet message is too long. Please try again");
-    }
-    strncpy(ttweetString + ttweetStringIdx, clientInput + charIdx, sizeof(char));
-    charIdx++;
-    ttweetStringIdx++;
+  closingQuote = strchr(clientInput + charIdx, '\"');
+  if (closingQuote == NULL)
+  { /* Message never ends */
+    return persist_with_error(invalidTweetCmdMsg);
   }
 
-  charIdx++;
+  ttweetStringLen = closingQuote - (clientInput + charIdx);
+  if (ttweetStringLen > MAX_TWEET_LEN)
+  {
+    return persist_with_error("Tweet message is too long. Please try again");
+  }
+  if (!is_valid_tweet_text(clientInput + charIdx, ttweetStringLen))
+  {
+    return persist_with_error("Tweet message contains invalid characters.");
+  }
 
-  /* Mark end of ttweetString */
-  ttweetString[ttweetStringIdx] = '\0';
+  /* Save ttweetString */
+  memcpy(ttweetString, clientInput + charIdx, ttweetStringLen);
+  ttweetString[ttweetStringLen] = '\0';
+  charIdx += ttweetStringLen + 1;
 
   if (clientInput[charIdx] != ' ')
   { /* Expected whitespace after tweet message */
@@ -427,13 +690,13 @@ int check_tweet_cmd(char clientInput[], int charIdx, char inputHashtags[], char
     {
       return persist_with_error("Invalid hashtag(s)! Hashtag cannot contain whitespaces.");
     }
-    if (inputHashtagsIdx > 25)
+    if (inputHashtagsIdx > MAX_HASHTAG_LEN - 1)
     {
       return persist_with_error("Invalid hashtag(s)! Hashtag cannot exceed 25 chars.");
     }
 
     /* Save clientInput char to inputHashtags */
-    strncpy(inputHashtags + inputHashtagsIdx, clientInput + charIdx, sizeof(char));
+    inputHashtags[inputHashtagsIdx] = clientInput[charIdx];
     charIdx++;
     inputHashtagsIdx++;
   }
@@ -454,13 +717,13 @@ int check_subscribe_cmd(char clientInput[], int charIdx, char inputHashtags[])
     {
       return persist_with_error(invalidSubscribeCmdMsg);
     }
-    if (inputHashtagsIdx > 25)
+    if (inputHashtagsIdx > MAX_HASHTAG_LEN - 1)
     {
       return persist_with_error("Invalid hashtag(s)! Hashtag cannot exceed 25 chars.");
     }
 
     /* Save clientInput char to inputHashtags */
-    strncpy(inputHashtags + inputHashtagsIdx, clientInput + charIdx, sizeof(char));
+    inputHashtags[inputHashtagsIdx] = clientInput[charIdx];
     charIdx++;
     inputHashtagsIdx++;
   }
@@ -481,7 +744,7 @@ int check_unsubscribe_cmd(char clientInput[], int charIdx, char inputHashtags[])
     {
       return persist_with_error(invalidUnsubscribeCmdMsg);
     }
-    if (inputHashtagsIdx > 25)
+    if (inputHashtagsIdx > MAX_HASHTAG_LEN - 1)
     {
       return persist_with_error("Invalid hashtag(s)! Hashtag cannot exceed 25 chars.");
     }
@@ -495,15 +758,84 @@ int check_unsubscribe_cmd(char clientInput[], int charIdx, char inputHashtags[])
   return REQ_UNSUBSCRIBE;
 }
 
+/** \copydoc check_keyword_cmd */
+int check_keyword_cmd(char clientInput[], int charIdx, char keyword[], int requestCode)
+{
+  int keywordLen = strlen(clientInput + charIdx);
+
+  if (!is_valid_hashtag(clientInput + charIdx, keywordLen))
+  {
+    return persist_with_error("Invalid keyword! Keywords are a single word of 1 to 24 letters or digits.");
+  }
+  memcpy(keyword, clientInput + charIdx, keywordLen + 1);
+  return requestCode;
+}
+
+/** \copydoc check_follow_cmd */
+int check_follow_cmd(char clientInput[], int charIdx, int endOfCmd, char followUsername[], int requestCode)
+{
+  int usernameLen = endOfCmd ? 0 : strnlen(clientInput + charIdx, MAX_USERNAME_LEN);
+
+  if (!is_valid_username(clientInput + charIdx, usernameLen))
+  {
+    return persist_with_error("Invalid username! Usernames are 1 to 29 characters.");
+  }
+  memcpy(followUsername, clientInput + charIdx, usernameLen + 1);
+  return requestCode;
+}
+
+/** \copydoc check_search_cmd */
+int check_search_cmd(char clientInput[], int charIdx, int endOfCmd, char searchQuery[])
+{
+  int searchQueryLen;
+
+  if (endOfCmd || clientInput[charIdx] == '\0')
+  { /* Nothing after the command word */
+    return persist_with_error("Search query cannot be empty!");
+  }
+  searchQueryLen = strlen(clientInput + charIdx);
+  if (searchQueryLen > MAX_SEARCH_QUERY_LEN)
+  {
+    return persist_with_error("Search query is too long. Please try again");
+  }
+  memcpy(searchQuery, clientInput + charIdx, searchQueryLen + 1);
+  return REQ_SEARCH;
+}
+
+/** \copydoc check_trending_cmd */
+int check_trending_cmd(char clientInput[], int charIdx, int endOfCmd, char trendingWindow[])
+{
+  if (endOfCmd)
+  { /* No window given */
+    strcpy(trendingWindow, DEFAULT_TRENDING_WINDOW);
+    return REQ_TRENDING;
+  }
+  if (strcmp(clientInput + charIdx, "1m") != 0 && strcmp(clientInput + charIdx, "5m") != 0 && strcmp(clientInput + charIdx, "1h") != 0)
+  {
+    return persist_with_error("trending takes one window: 1m, 5m or 1h.");
+  }
+  strcpy(trendingWindow, clientInput + charIdx);
+  return REQ_TRENDING;
+}
+
 /** \copydoc check_timeline_cmd */
-int check_timeline_cmd(int endOfCmd)
+int check_timeline_cmd(char clientInput[], int charIdx, int endOfCmd, char maxTweets[])
 {
   char *invalidTimelineCmdMsg = "timeline command not formatted correctly. Please try again.";
+  int numDigits = strspn(clientInput + charIdx, "0123456789");
+  int pageSize;
 
-  if (!endOfCmd)
-  { /* timeline is a single word command */
+  if (endOfCmd)
+  { /* No page size given */
+    strcpy(maxTweets, "");
+    return REQ_TIMELINE;
+  }
+  pageSize = numDigits > 0 && numDigits <= 2 ? atoi(clientInput + charIdx) : 0;
+  if (clientInput[charIdx + numDigits] != '\0' || pageSize < 1 || pageSize > MAX_TWEET_QUEUE)
+  {
     return persist_with_error(invalidTimelineCmdMsg);
   }
+  strcpy(maxTweets, clientInput + charIdx);
   return REQ_TIMELINE;
 }
 
@@ -520,8 +852,10 @@ int check_exit_cmd(int endOfCmd)
 }
 
 /** \copydoc create_json_client_payload */
-void create_json_client_payload(cJSON *jobjToSend, int commandCode, char *username, int userIdx, char *ttweetString, char *validHashtags[], int numValidHashtags)
+void create_json_client_payload(cJSON *jobjToSend, int commandCode, char *username, int userIdx, char *ttweetString, TextView validHashtags[], int numValidHashtags)
 {
+  char hashtag[MAX_HASHTAG_LEN]; /* NUL terminated copy of a hashtag view */
+
   cJSON_AddItemToObject(jobjToSend, "requestCode", cJSON_CreateNumber(commandCode)); /*Add command request code to JSON object*/
   cJSON_AddItemToObject(jobjToSend, "username", cJSON_CreateString(username));       /*Add username to JSON object*/
 
@@ -532,7 +866,7 @@ void create_json_client_payload(cJSON *jobjToSend, int commandCode, char *userna
     cJSON *jarray = cJSON_CreateArray(); /*Creating a json array*/
     for (int i = 0; i < numValidHashtags; i++)
     { /*Add hashtags to array*/
-      cJSON_AddItemToArray(jarray, cJSON_CreateString(validHashtags[i]));
+      cJSON_AddItemToArray(jarray, cJSON_CreateString(copy_text_view(validHashtags[i], hashtag, sizeof(hashtag))));
     }
     cJSON_AddItemToObject(jobjToSend, "ttweetString", cJSON_CreateString(ttweetString));         /*Add ttweetString to JSON object*/
     cJSON_AddItemToObject(jobjToSend, "numValidHashtags", cJSON_CreateNumber(numValidHashtags)); /*Add numValidHashtags to JSON object*/
@@ -541,11 +875,29 @@ void create_json_client_payload(cJSON *jobjToSend, int commandCode, char *userna
   }
   case REQ_SUBSCRIBE:
   case REQ_UNSUBSCRIBE:
-    cJSON_AddItemToObject(jobjToSend, "subscriptionHashtag", cJSON_CreateString(validHashtags[0])); /*Add target hashtag to JSON object*/
+    cJSON_AddItemToObject(jobjToSend, "subscriptionHashtag", cJSON_CreateString(copy_text_view(validHashtags[0], hashtag, sizeof(hashtag)))); /*Add target hashtag to JSON object*/
+    break;
+  case REQ_SUBSCRIBE_KEYWORD:
+  case REQ_UNSUBSCRIBE_KEYWORD:
+    cJSON_AddItemToObject(jobjToSend, "subscriptionKeyword", cJSON_CreateString(copy_text_view(validHashtags[0], hashtag, sizeof(hashtag)))); /*Add target keyword to JSON object*/
+    break;
+  case REQ_FOLLOW:
+  case REQ_UNFOLLOW:
+    cJSON_AddItemToObject(jobjToSend, "followUsername", cJSON_CreateString(ttweetString)); /*Add target username to JSON object*/
+    break;
+  case REQ_SEARCH:
+    cJSON_AddItemToObject(jobjToSend, "searchQuery", cJSON_CreateString(ttweetString)); /*Add search query to JSON object*/
+    break;
+  case REQ_TRENDING:
+    cJSON_AddItemToObject(jobjToSend, "trendingWindow", cJSON_CreateString(ttweetString)); /*Add trending window to JSON object*/
     break;
   case REQ_TIMELINE:
+    if (ttweetString[0] != '\0')
+      cJSON_AddItemToObject(jobjToSend, "timelineMaxTweets", cJSON_CreateNumber(atoi(ttweetString))); /*Add page size to JSON object*/
+    break;
   case REQ_VALIDATE_USER:
   case REQ_EXIT:
+  case REQ_PING:
     break;
   default:
     die_with_error("Error! Client attempted to create an invalid JSON payload.");
@@ -554,7 +906,7 @@ void create_json_client_payload(cJSON *jobjToSend, int commandCode, char *userna
 }
 
 /** \copydoc handle_server_response */
-void handle_server_response(cJSON *jobjReceived, int *userIdx)
+void handle_server_response(cJSON *jobjReceived, ClientConn *conn)
 {
   int responseCode = cJSON_GetObjectItemCaseSensitive(jobjReceived, "responseCode")->valueint; /* Extract server response code */
 
@@ -565,13 +917,21 @@ void handle_server_response(cJSON *jobjReceived, int *userIdx)
     break;
   case RES_USER_VALID:
   {
-    *userIdx = cJSON_GetObjectItemCaseSensitive(jobjReceived, "clientUserIdx")->valueint;
+    cJSON *jobjCompression = cJSON_GetObjectItemCaseSensitive(jobjReceived, "compression");
+    conn->userIdx = cJSON_GetObjectItemCaseSensitive(jobjReceived, "clientUserIdx")->valueint;
+    if (cJSON_IsString(jobjCompression) && strcmp(jobjCompression->valuestring, COMPRESS_CODEC_NAME) == 0 && conn->reader.decompressor == NULL)
+    { /* Every later response is decoded against the same history the server keeps */
+      if ((conn->reader.decompressor = malloc(sizeof(CompressStream))) == NULL)
+        die_with_error("malloc() failed");
+      compress_stream_reset(conn->reader.decompressor);
+    }
     printf("Username legal. Connection established.\n");
     break;
   }
   case RES_SUBSCRIBE:
   case RES_UNSUBSCRIBE:
   case RES_TWEET:
+  case RES_RATE_LIMITED:
   {
     printf("Server response: %s", cJSON_GetObjectItemCaseSensitive(jobjReceived, "detailedMessage")->valuestring);
     break;
@@ -579,43 +939,57 @@ void handle_server_response(cJSON *jobjReceived, int *userIdx)
   case RES_TIMELINE:
   {
     cJSON *jarray = cJSON_GetObjectItemCaseSensitive(jobjReceived, "storedTweets");
+    uint64_t tweetSeq = (uint64_t)cJSON_GetObjectItemCaseSensitive(jobjReceived, "firstTweetSeq")->valuedouble;
+    int moreTweets = cJSON_GetObjectItemCaseSensitive(jobjReceived, "moreTweets")->valueint;
+    int numPrinted = 0;
+    for (int i = 0; i < cJSON_GetArraySize(jarray); i++, tweetSeq++)
+    { /* Print tweets not printed by an earlier response */
+      if (tweetSeq <= conn->timelineCursor)
+        continue;
+      printf("%s\n", cJSON_GetArrayItem(jarray, i)->valuestring);
+      conn->timelineCursor = tweetSeq;
+      numPrinted++;
+    }
+    if (numPrinted == 0 && moreTweets == 0)
+      printf("No tweets available\n");
+    if (moreTweets > 0)
+      printf("%d more tweets pending. Enter timeline to see them.\n", moreTweets);
+    break;
+  }
+  case RES_SEARCH:
+  {
+    cJSON *jarray = cJSON_GetObjectItemCaseSensitive(jobjReceived, "searchResults");
+    printf("Server response: %s", cJSON_GetObjectItemCaseSensitive(jobjReceived, "detailedMessage")->valuestring);
     for (int i = 0; i < cJSON_GetArraySize(jarray); i++)
-    { /* Print all pending tweets */
+    { /* Print matching tweets, newest first */
       printf("%s\n", cJSON_GetArrayItem(jarray, i)->valuestring);
     }
     break;
   }
+  case RES_TRENDING:
+  {
+    cJSON *jarray = cJSON_GetObjectItemCaseSensitive(jobjReceived, "trendingHashtags");
+    cJSON *jobjEntry;
+    printf("Server response: %s", cJSON_GetObjectItemCaseSensitive(jobjReceived, "detailedMessage")->valuestring);
+    cJSON_ArrayForEach(jobjEntry, jarray)
+    { /* Print hashtags, most used first */
+      printf("%d\t#%s\n", cJSON_GetObjectItemCaseSensitive(jobjEntry, "count")->valueint,
+             cJSON_GetObjectItemCaseSensitive(jobjEntry, "hashtag")->valuestring);
+    }
+    break;
+  }
   default:
     die_with_error("Error! Server sent an invalid response code.");
     break;
   }
 }
 
-/** \copydoc get_client_input */
-int get_client_input(char *clientInput)
-{
-  int i = 0;
-  while (1)
-  { /* Loop continuously to scan characters */
-    if (i > (MAX_CLI_INPUT_LEN - 5))
-    { /* clientInput buffer exceeded */
-      return 0;
-    }
-    scanf("%c", &clientInput[i]);
-    if (clientInput[i] == '\n')
-      break;
-    i++;
-  }
-  /* Mark end of clientInput */
-  clientInput[i] = '\0';
-  return 1;
-}
-
-int is_hashtag_all_exists(char *validHashtags[], int numValidHashtags)
+/** \copydoc is_hashtag_all_exists */
+int is_hashtag_all_exists(TextView validHashtags[], int numValidHashtags)
 {
   for (int hashtagIdx = 0; hashtagIdx < numValidHashtags; hashtagIdx++)
   {
-    if (strcmp(validHashtags[hashtagIdx], "ALL") == 0)
+    if (text_view_equals(validHashtags[hashtagIdx], "ALL"))
       return persist_with_error("Invalid hashtag(s)! Hashtag #ALL is not allowed when tweeting.");
   }
   return 1;
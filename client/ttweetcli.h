@@ -30,106 +30,205 @@
 #include "../dependencies/ttweet_common.h"
 void die_with_error(char *errorMessage);
 int persist_with_error(char *errorMessage);
+void set_persist_error_handler(void (*handler)(char *errorMessage));
 int send_payload(int sock, cJSON *jobjToSend);
-void wait_for(unsigned int secs);
-void receive_response(int sock, char *objReceived);
+int receive_response(int sock, char *objReceived);
 #endif
 
+#include "../dependencies/ttweet_validate.h"
+
+/* Buffer sizes */
+#define CLIENT_IN_BUF_SIZE 65536                              /* stdin bytes read per read() call */
+#define CLIENT_OUT_BUF_SIZE 65536                             /* Encoded requests waiting to be sent */
+#define CLIENT_MAX_REQUEST_LEN (RCV_BUF_SIZE + MAX_RESP_LEN) /* Space reserved before parsing a line */
+
+/* Batch mode */
+#define BATCH_DEFAULT_WINDOW 256 /* Lines outstanding at once unless --window is given */
+#define BATCH_MAX_WINDOW 65536
+#define BATCH_ERROR_LEN 200 /* Longest local error kept per line */
+
+/* Buffered reader splitting stdin into lines */
+typedef struct LineReader
+{
+  char buffer[CLIENT_IN_BUF_SIZE];
+  int start;      /* First byte not yet returned as a line */
+  int end;        /* One past the last byte read */
+  int discarding; /* Skipping the rest of an over-long line */
+  int eof;        /* read() reported end of input */
+} LineReader;
+
+/* Connection to the server, driven by poll() */
+typedef struct ClientConn
+{
+  int sock;
+  char *username;
+  int userIdx;                      /* Index assigned by the server */
+  PayloadReader reader;             /* Partial response */
+  char outBuf[CLIENT_OUT_BUF_SIZE]; /* Requests not yet sent */
+  int outLen;                       /* Bytes used in outBuf */
+  int outOff;                       /* Bytes of outBuf already sent */
+  int exitQueued;                   /* exit sent; waiting for the server to close */
+  uint64_t timelineCursor;          /* Sequence number of the newest tweet printed, sent with every timeline request */
+  struct BatchState *batch;         /* Ordered results in batch mode, NULL when interactive */
+} ClientConn;
+
+/* A line of batch input whose result has not been printed yet */
+typedef struct BatchEntry
+{
+  long lineNo;                 /* Line number in the input, 0 for username validation */
+  int awaitingResponse;        /* Request sent, server has not answered yet */
+  char error[BATCH_ERROR_LEN]; /* Reason the line was rejected locally, empty otherwise */
+} BatchEntry;
+
+/* Window of outstanding lines, printed strictly in input order */
+typedef struct BatchState
+{
+  BatchEntry *entries; /* Ring of window entries */
+  int window;          /* Capacity of entries */
+  int head;            /* Oldest outstanding line */
+  int count;           /* Outstanding lines */
+  long lineNo;         /* Lines read so far */
+  long sent;           /* Requests sent to the server */
+  long rejected;       /* Lines rejected before sending */
+} BatchState;
+
 /**
- * @brief Reads user input from stdin
+ * @brief Reads whatever stdin has available into reader
  *
- * This function checks if user input exceeds maximum buffer size.
+ * Called when poll() reports fd readable, so it never blocks.
  *
- * @param clientInput Buffer to store user input.
- * @return int 0 if error occurred, 1 otherwise.
+ * @param fd Descriptor to read from
+ * @param reader Line reader to fill
+ * @return int Bytes read, 0 at end of input, -1 on error.
  */
-int get_client_input(char *clientInput);
+int fill_line_reader(int fd, LineReader *reader);
 
 /**
- * @brief Parses command from user input
+ * @brief Returns the next complete line from reader
  *
- * Hashtag and tweet message fields are saved accordingly.
+ * Lines of MAX_CLI_INPUT_LEN - 4 chars or more are skipped and reported
+ * once. A final line without a newline is returned at end of input.
  *
- * @param ttweetString Tweet message to be sent.
- * @param inputHashtags Raw hashtag input from the user.
- * @return int Request code of corresponding command, or error code if error thrown.
+ * @param reader Line reader
+ * @param clientInput Buffer of MAX_CLI_INPUT_LEN bytes to store the line
+ * @return int 1 if a line was stored, 0 if no complete line is buffered, -1 if a line was too long.
  */
-int parse_client_command(char inputHashtags[], char ttweetString[]);
+int next_client_line(LineReader *reader, char *clientInput);
 
 /**
- * @brief Parses hashtags from user command
- * 
- * Valid hashtags are stored in the string array validHashtags. 
- * Hashtag count is tracked using numValidHashtags.
+ * @brief Parses a line of user input and queues the request
  *
- * @param validHashtags Valid hashtags
- * @param numValidHashtags Number of hashtags in validHashtags
- * @param inputHashtags Hashatag input from the user.
- * @return void
+ * @param conn Connection to the server
+ * @param clientInput Line typed by the user
+ * @return int Request code queued, or REQ_INVALID if the line was rejected.
  */
-int parse_hashtags(char *validHashtags[], int *numValidHashtags, char *inputHashtags);
+int handle_client_line(ClientConn *conn, char *clientInput);
 
 /**
- * @brief Checks for duplicates in string array
+ * @brief Encodes a request and appends it to the output buffer
  *
- * If a hashtag appears more than once, an error is thrown.
+ * @param conn Connection to the server
+ * @param jobjToSend cJSON object to be sent
+ * @return int 1 if queued, 0 if it did not fit.
+ */
+int queue_client_request(ClientConn *conn, cJSON *jobjToSend);
+
+/**
+ * @brief Sends as much of the output buffer as the socket accepts
  *
- * @param stringArray Strings in an array
- * @param numStringsInArray Number of strings in stringArray
- * @return int 1 if duplicates exist; 0 otherwise. 
+ * @param conn Connection to the server
+ * @return int 1 on success, 0 if the connection failed.
  */
-int has_duplicate_string(char *stringArray[], int numStringsInArray); /* Checks for duplicates in string array */
+int flush_client_output(ClientConn *conn);
 
 /**
- * @brief Checks if hashtag #ALL exists
+ * @brief Handles every complete response waiting on the socket
  *
- * Checks if hashtag #ALL exists in validHashtags.
- * This is necessary since users cannot tweet with #ALL.
+ * @param conn Connection to the server
+ * @return int 1 while the connection is open, 0 once the server closed it.
+ */
+int drain_server_responses(ClientConn *conn);
+
+/**
+ * @brief Queues one line of batch input
  *
- * @param validHashtags Valid hashtags
- * @param numValidHashtags Number of hashtags in validHashtags
- * @return int 0 if exists; 1 otherwise.
+ * The line takes a slot in the window until its result, a server
+ * response or a local error, has been printed in order.
+ *
+ * @param conn Connection to the server, in batch mode
+ * @param clientInput Line read from the batch input, NULL if it was too long
+ * @return void
+ */
+void queue_batch_line(ClientConn *conn, char *clientInput);
+
+/**
+ * @brief Prints results at the head of the batch window that are complete
+ *
+ * @param batch Batch state
+ * @return void
+ */
+void print_completed_batch_lines(BatchState *batch);
+
+/**
+ * @brief Records a local error against the batch line being parsed
+ *
+ * Installed with set_persist_error_handler() in batch mode.
+ *
+ * @param errorMessage Error message
+ * @return void
  */
-int is_hashtag_all_exists(char *validHashtags[], int numValidHashtags);
+void record_batch_error(char *errorMessage);
 
 /**
- * @brief  Resets client variables for next command 
+ * @brief Parses command from user input
+ *
+ * Hashtag and tweet message fields are saved accordingly.
  *
- * Variables relating to a particular ttweet command
- * are cleared/reset to prepare for next command.
+ * @param clientInput Line typed by the user.
+ * @param ttweetString Tweet message to be sent.
+ * @param inputHashtags Raw hashtag input from the user.
+ * @return int Request code of corresponding command, or error code if error thrown.
+ */
+int parse_client_command(char clientInput[], char inputHashtags[], char ttweetString[]);
+
+/**
+ * @brief Parses hashtags from user command
+ * 
+ * Valid hashtags are stored as views into inputHashtags, so inputHashtags
+ * must outlive validHashtags. Hashtag count is tracked using numValidHashtags.
  *
- * @param clientCommandSuccess Boolean to check command validity.
  * @param validHashtags Valid hashtags
  * @param numValidHashtags Number of hashtags in validHashtags
- * @param jobjToSend cJSON object to be sent
- * @return void
+ * @param inputHashtags Hashatag input from the user.
+ * @return int 1 if valid, 0 otherwise.
  */
-void reset_client_variables(int *clientCommandSuccess, char *validHashtags[], int *numValidHashtags, cJSON *jobjToSend);
+int parse_hashtags(TextView validHashtags[], int *numValidHashtags, char *inputHashtags);
 
 /**
- * @brief Deallocates memory from a dynamic string array
+ * @brief Parses the argument of subscribe or unsubscribe
  *
- * First numStringsInArray elements from stringArray are freed.
+ * Accepts what parse_hashtags() accepts, and also a single hashtag ending
+ * with PREFIX_WILDCARD, e.g. #deploy* for every hashtag starting with deploy.
+ * The wildcard is kept at the end of the view.
  *
- * @param stringArray String array which memory is to be deallocated
- * @param numStringsInArray Number of elements to free in the array
- * @return void
+ * @param validHashtags Views of the hashtags found
+ * @param numValidHashtags Number of views stored in validHashtags
+ * @param inputHashtags Hashtag input from the user.
+ * @return int 1 if valid, 0 otherwise.
  */
-void deallocate_string_array(char *stringArray[], int numStringsInArray);
+int parse_subscription(TextView validHashtags[], int *numValidHashtags, char *inputHashtags);
 
 /**
- * @brief Save current hashtag buffer
+ * @brief Checks if hashtag #ALL exists
  *
- * Allocates memory to validHashtag and stores the current hashtag buffer.
- * Prepare the hashtag buffer to receive the next hashtag.
+ * Checks if hashtag #ALL exists in validHashtags.
+ * This is necessary since users cannot tweet with #ALL.
  *
- * @param currentHashtagBuffer Buffer to store the current hashtag
- * @param currentHashtagBufferIndex Index of the last known char in hashtag buffer
  * @param validHashtags Valid hashtags
  * @param numValidHashtags Number of hashtags in validHashtags
- * @return void
+ * @return int 0 if exists; 1 otherwise.
  */
-void save_current_hashtag(char *currentHashtagBuffer, int *currentHashtagBufferIdx, char *validHashtags[], int *numValidHashtags);
+int is_hashtag_all_exists(TextView validHashtags[], int numValidHashtags);
 
 /**
  * @brief Creates payload to send to server
@@ -146,18 +245,21 @@ void save_current_hashtag(char *currentHashtagBuffer, int *currentHashtagBufferI
  * @param numValidHashtags Number of hashtags in validHashtags
  * @return void
  */
-void create_json_client_payload(cJSON *jobjToSend, int commandCode, char *username, int userIdx, char *ttweetString, char *validHashtags[], int numValidHashtags);
+void create_json_client_payload(cJSON *jobjToSend, int commandCode, char *username, int userIdx, char *ttweetString, TextView validHashtags[], int numValidHashtags);
 
 /**
  * @brief Handles server response
  *
  * Handles server response according to response code.
+ * Timeline tweets at or below conn->timelineCursor were printed by an
+ * earlier response and are skipped, so pipelined timeline requests never
+ * print a tweet twice.
  *
  * @param jobjReceived cJSON object received from server
- * @param userIdx Client user index
+ * @param conn Connection the response arrived on
  * @return void
  */
-void handle_server_response(cJSON *jobjReceived, int *userIdx);
+void handle_server_response(cJSON *jobjReceived, ClientConn *conn);
 
 /**
  * @brief Parses and validates tweet command 
@@ -199,16 +301,77 @@ int check_subscribe_cmd(char clientInput[], int charIdx, char inputHashtags[]);
  */
 int check_unsubscribe_cmd(char clientInput[], int charIdx, char inputHashtags[]);
 
+/**
+ * @brief Parses and validates subscribe-keyword and unsubscribe-keyword commands
+ *
+ * Saves the target keyword, a single word of letters and digits.
+ * Also checks for errors in user input.
+ *
+ * @param clientInput Buffer to store user input.
+ * @param charIdx Index of character in clientInput
+ * @param keyword Keyword from the user.
+ * @param requestCode REQ_SUBSCRIBE_KEYWORD or REQ_UNSUBSCRIBE_KEYWORD
+ * @return int requestCode if command valid; 0 otherwise.
+ */
+int check_keyword_cmd(char clientInput[], int charIdx, char keyword[], int requestCode);
+
+/**
+ * @brief Parses and validates follow and unfollow commands
+ *
+ * Saves the target username, the rest of the line.
+ * Also checks for errors in user input.
+ *
+ * @param clientInput Buffer to store user input.
+ * @param charIdx Index of character in clientInput
+ * @param endOfCmd Whether clientInput ended after the command word
+ * @param followUsername Username from the user.
+ * @param requestCode REQ_FOLLOW or REQ_UNFOLLOW
+ * @return int requestCode if command valid; 0 otherwise.
+ */
+int check_follow_cmd(char clientInput[], int charIdx, int endOfCmd, char followUsername[], int requestCode);
+
+/**
+ * @brief Parses and validates search command
+ *
+ * Saves the rest of the line as the search query. Terms are checked by the
+ * server, which explains a malformed query in its response.
+ *
+ * @param clientInput Buffer to store user input.
+ * @param charIdx Index of character in clientInput
+ * @param endOfCmd Whether the command word ended the input
+ * @param searchQuery Search query from the user.
+ * @return int REQ_SEARCH if command valid; 0 otherwise.
+ */
+int check_search_cmd(char clientInput[], int charIdx, int endOfCmd, char searchQuery[]);
+
+/**
+ * @brief Parses and validates trending command
+ *
+ * Saves the window to report on: 1m, 5m or 1h, and
+ * DEFAULT_TRENDING_WINDOW if none is given.
+ *
+ * @param clientInput Buffer to store user input.
+ * @param charIdx Index of character in clientInput
+ * @param endOfCmd Whether the command word ended the input
+ * @param trendingWindow Window from the user.
+ * @return int REQ_TRENDING if command valid; 0 otherwise.
+ */
+int check_trending_cmd(char clientInput[], int charIdx, int endOfCmd, char trendingWindow[]);
+
 /**
  * @brief Parses and validates timeline command 
  *
- * Parses timeline command.
+ * Parses timeline command, with an optional page size of 1 to
+ * MAX_TWEET_QUEUE tweets.
  * Also checks for errors in user input.
  *
+ * @param clientInput Input entered by user
+ * @param charIdx Index of the first character after the command word
  * @param endOfCmd Boolean to check if end of command reached.
+ * @param maxTweets Receives the page size, empty if none was given
  * @return int Timeline command request code if command valid; 0 otherwise.
  */
-int check_timeline_cmd(int endOfCmd);
+int check_timeline_cmd(char clientInput[], int charIdx, int endOfCmd, char maxTweets[]);
 
 /**
  * @brief Parses and validates exit command 
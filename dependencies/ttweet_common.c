@@ -21,12 +21,23 @@
   */
 
 #include "ttweet_common.h"
+#include <sched.h> /* for sched_yield() */
 
 void die_with_error(char *errorMessage);
 int persist_with_error(char *errorMessage);
+void set_persist_error_handler(void (*handler)(char *errorMessage));
 int send_payload(int sock, cJSON *jobjToSend);
+int send_payload_flags(int sock, cJSON *jobjToSend, int flags);
+int send_payload_compressed(int sock, cJSON *jobjToSend, int flags, PayloadCompressor *compressor);
 void wait_for(unsigned int secs);
-void receive_response(int sock, char *objReceived);
+int receive_response(int sock, char *objReceived);
+int encode_payload(cJSON *jobjToSend, char *buffer, int bufferLen);
+void payload_reader_reset(PayloadReader *reader);
+int receive_payload_nonblocking(int sock, PayloadReader *reader);
+void spin_lock(int *lock);
+void spin_unlock(int *lock);
+
+static void (*persistErrorHandler)(char *errorMessage) = NULL; /* See set_persist_error_handler() */
 
 /** \copydoc die_with_error */
 void die_with_error(char *errorMessage)
@@ -38,23 +49,81 @@ void die_with_error(char *errorMessage)
 /** \copydoc persist_with_error */
 int persist_with_error(char *errorMessage)
 {
-  perror(errorMessage);
+  if (persistErrorHandler != NULL)
+    persistErrorHandler(errorMessage);
+  else
+    perror(errorMessage);
   return 0;
 }
 
+/** \copydoc set_persist_error_handler */
+void set_persist_error_handler(void (*handler)(char *errorMessage))
+{
+  persistErrorHandler = handler;
+}
+
 /** \copydoc send_payload */
 int send_payload(int sock, cJSON *jobjToSend)
+{
+  return send_payload_flags(sock, jobjToSend, 0);
+}
+
+/** \copydoc send_payload_flags */
+int send_payload_flags(int sock, cJSON *jobjToSend, int flags)
+{
+  return send_payload_compressed(sock, jobjToSend, flags, NULL);
+}
+
+/** \copydoc send_payload_compressed */
+int send_payload_compressed(int sock, cJSON *jobjToSend, int flags, PayloadCompressor *compressor)
 {
   char buffer[RCV_BUF_SIZE];
   char *request = cJSON_PrintUnformatted(jobjToSend);
   int requestSize = strlen(request) + 1;
+  char packed[COMPRESS_BOUND(COMPRESS_MAX_INPUT)];
+  int packedSize = 0; /* 0 if sent as it is */
+  struct timespec startTime, endTime;
+  struct iovec blocks[2];
+  struct msghdr message;
+  int bytesSent;
 
-  sprintf(buffer, "%d", requestSize);
-  if (send(sock, buffer, RCV_BUF_SIZE, 0) != RCV_BUF_SIZE)
-    return persist_with_error("Block size: send() sent a different number of bytes than expected.\n");
-  if (send(sock, request, requestSize, 0) != requestSize)
-    return persist_with_error("Block contents: send() sent a different number of bytes than expected.\n");
-  return 1;
+  if (compressor != NULL && requestSize >= compressor->minBytes)
+  {
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    packedSize = compress_payload(&compressor->stream, request, requestSize, packed, sizeof(packed));
+    clock_gettime(CLOCK_MONOTONIC, &endTime);
+    compressor->compressNs += (endTime.tv_sec - startTime.tv_sec) * 1000000000LL + endTime.tv_nsec - startTime.tv_nsec;
+    compressor->rawBytes += requestSize;
+    compressor->packedBytes += packedSize ? packedSize : requestSize;
+  }
+  else if (compressor != NULL)
+  { /* Too small to gain much, but later payloads may copy from it */
+    compress_stream_append(&compressor->stream, request, requestSize);
+  }
+
+  memset(buffer, 0, RCV_BUF_SIZE);
+  if (packedSize)
+    sprintf(buffer, "%d %d", packedSize, requestSize);
+  else
+    sprintf(buffer, "%d", requestSize);
+
+  /* Size block and contents leave in one segment, so Nagle's algorithm
+   * never holds the contents back waiting for the size block's ACK */
+  blocks[0].iov_base = buffer;
+  blocks[0].iov_len = RCV_BUF_SIZE;
+  blocks[1].iov_base = packedSize ? packed : request;
+  blocks[1].iov_len = packedSize ? packedSize : requestSize;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = blocks;
+  message.msg_iovlen = 2;
+
+  bytesSent = sendmsg(sock, &message, MSG_NOSIGNAL | flags);
+  free(request);
+  if (bytesSent != RCV_BUF_SIZE + (int)blocks[1].iov_len)
+  {
+    return persist_with_error("send_payload: sendmsg() sent a different number of bytes than expected.\n");
+  }
+  return bytesSent;
 }
 
 /** \copydoc waitFor */
@@ -66,35 +135,121 @@ void wait_for(unsigned int secs)
 }
 
 /** \copydoc receive_response */
-void receive_response(int sock, char *objReceived)
+int receive_response(int sock, char *objReceived)
+{
+  int bytesToRecv;
+  char buffer[RCV_BUF_SIZE]; /* Size block */
+
+  if (recv(sock, buffer, RCV_BUF_SIZE, MSG_WAITALL) != RCV_BUF_SIZE)
+    return 0; /* Peer closed the connection or an error occurred */
+  buffer[RCV_BUF_SIZE - 1] = '\0';
+
+  bytesToRecv = atoi(buffer);
+  if (bytesToRecv <= 0 || bytesToRecv > MAX_RESP_LEN)
+    return persist_with_error("receive_response() received an invalid block size.\n");
+
+  if (recv(sock, objReceived, bytesToRecv, MSG_WAITALL) != bytesToRecv)
+    return 0;
+  objReceived[bytesToRecv - 1] = '\0';
+  return bytesToRecv;
+}
+
+/** \copydoc encode_payload */
+int encode_payload(cJSON *jobjToSend, char *buffer, int bufferLen)
 {
-  int bytesToRecv = 0;
-  int responseIdx = 0;
-  char buffer[RCV_BUF_SIZE];   /* Buffer for ttweet string */
-  char response[MAX_RESP_LEN]; /* Stores the entire response */
+  char *request = cJSON_PrintUnformatted(jobjToSend);
+  int requestSize = strlen(request) + 1;
+
+  if (RCV_BUF_SIZE + requestSize > bufferLen)
+  { /* Payload does not fit */
+    free(request);
+    return 0;
+  }
+  memset(buffer, 0, RCV_BUF_SIZE);
+  sprintf(buffer, "%d", requestSize);
+  memcpy(buffer + RCV_BUF_SIZE, request, requestSize);
+  free(request);
+  return RCV_BUF_SIZE + requestSize;
+}
+
+/** \copydoc payload_reader_reset */
+void payload_reader_reset(PayloadReader *reader)
+{
+  reader->headerLen = 0;
+  reader->payloadLen = 0;
+  reader->payloadSize = 0;
+  reader->rawSize = 0;
+}
+
+/** \copydoc receive_payload_nonblocking */
+int receive_payload_nonblocking(int sock, PayloadReader *reader)
+{
+  int bytesRecv;
 
-  while (bytesToRecv <= 0)
+  while (reader->headerLen < RCV_BUF_SIZE)
+  { /* Size block not complete yet */
+    bytesRecv = recv(sock, reader->header + reader->headerLen, RCV_BUF_SIZE - reader->headerLen, 0);
+    if (bytesRecv == 0)
+      return -1;
+    if (bytesRecv < 0)
+      return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    reader->headerLen += bytesRecv;
+  }
+
+  if (reader->payloadSize == 0)
+  { /* Size block just completed */
+    reader->header[RCV_BUF_SIZE - 1] = '\0';
+    reader->payloadSize = atoi(reader->header);
+    if (reader->payloadSize <= 0 || reader->payloadSize > MAX_RESP_LEN)
+      return -1;
+    if (strchr(reader->header, ' ') != NULL)
+    { /* Compressed payload, followed by its size before compression */
+      reader->rawSize = atoi(strchr(reader->header, ' ') + 1);
+      if (reader->decompressor == NULL || reader->rawSize <= 0 || reader->rawSize > MAX_RESP_LEN)
+        return -1;
+    }
+  }
+
+  while (reader->payloadLen < reader->payloadSize)
+  { /* Payload not complete yet */
+    bytesRecv = recv(sock, reader->payload + reader->payloadLen, reader->payloadSize - reader->payloadLen, 0);
+    if (bytesRecv == 0)
+      return -1;
+    if (bytesRecv < 0)
+      return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    reader->payloadLen += bytesRecv;
+  }
+
+  if (reader->rawSize > 0)
   {
-    recv(sock, buffer, RCV_BUF_SIZE, 0);
-    bytesToRecv = atoi(buffer);
-    wait_for(3);
+    if (decompress_payload(reader->decompressor, reader->payload, reader->payloadSize, reader->payload, reader->rawSize) < 0)
+      return -1;
+    reader->payload[reader->rawSize - 1] = '\0';
+    return 1;
   }
+  if (reader->decompressor != NULL)
+    compress_stream_append(reader->decompressor, reader->payload, reader->payloadSize);
+  reader->payload[reader->payloadSize - 1] = '\0';
+  return 1;
+}
 
-  while (bytesToRecv > 0)
+/** \copydoc spin_lock */
+void spin_lock(int *lock)
+{
+  int spins = 0;
+
+  while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE))
   {
-    if (bytesToRecv > RCV_BUF_SIZE)
-    {
-      recv(sock, buffer, RCV_BUF_SIZE, 0);
-      strncpy(response + responseIdx, buffer, RCV_BUF_SIZE);
-      responseIdx += RCV_BUF_SIZE;
-    }
-    else
+    while (__atomic_load_n(lock, __ATOMIC_RELAXED))
     {
-      recv(sock, buffer, bytesToRecv, 0);
-      strncpy(response + responseIdx, buffer, bytesToRecv);
-      responseIdx += bytesToRecv;
+      if (++spins % 64 == 0)
+        sched_yield(); /* The holder may have been descheduled */
     }
-    bytesToRecv -= RCV_BUF_SIZE;
   }
-  strncpy(objReceived, response, sizeof(response));
+}
+
+/** \copydoc spin_unlock */
+void spin_unlock(int *lock)
+{
+  __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
 }
@@ -24,18 +24,25 @@
 /* Connections */
 #define MAX_PENDING 5   /* Maximum outstanding connection requests */
 #define MAX_CONC_CONN 5 /* Maximum number of concurrent connections */
+#define MAX_MUX_SESSIONS 4096 /* Session ids available on one multiplexed connection */
 
 /* Restrictions on user input */
 #define MAX_USERNAME_LEN 30
 #define MAX_SUBSCRIPTIONS 3
+#define MAX_KEYWORD_SUBSCRIPTIONS 3 /* Keywords are letters and digits, 1 to MAX_HASHTAG_LEN - 1 chars */
 #define MAX_TWEET_LEN 150
 #define MAX_HASHTAG_CNT 8
 #define MAX_HASHTAG_LEN 25
+#define PREFIX_WILDCARD '*' /* Ends a subscription to every hashtag starting with what precedes it */
 #define RCV_BUF_SIZE 32   /* Size of receive buffer */
 #define MAX_RESP_LEN 5000 /* Maximum number of characters in response */
 #define MAX_TWEET_QUEUE 15
 #define MAX_TWEET_ITEM_LEN 250
 #define MAX_CLI_INPUT_LEN 300
+#define MAX_SEARCH_QUERY_LEN MAX_TWEET_LEN /* Terms and hashtags, space separated, with OR between alternatives */
+#define MAX_SEARCH_RESULTS 10              /* Newest matching tweets returned by a search */
+#define MAX_TRENDING_RESULTS 10            /* Hashtags returned by a trending request */
+#define DEFAULT_TRENDING_WINDOW "5m"       /* Also "1m" or "1h" */
 
 /* Request codes */
 #define REQ_INVALID 0
@@ -45,6 +52,13 @@
 #define REQ_TIMELINE 4
 #define REQ_EXIT 5
 #define REQ_VALIDATE_USER 6
+#define REQ_PING 7 /* Answers RES_PING, or keeps an idle connection open; never answered */
+#define REQ_SUBSCRIBE_KEYWORD 8   /* Answered with RES_SUBSCRIBE */
+#define REQ_UNSUBSCRIBE_KEYWORD 9 /* Answered with RES_UNSUBSCRIBE */
+#define REQ_SEARCH 10             /* Request codes and response codes travel in different fields */
+#define REQ_TRENDING 11
+#define REQ_FOLLOW 12              /* Answered with RES_SUBSCRIBE */
+#define REQ_UNFOLLOW 13            /* Answered with RES_UNSUBSCRIBE */
 
 /* Response codes */
 #define RES_INVALID 10
@@ -55,13 +69,20 @@
 #define RES_EXIT 15
 #define RES_USER_VALID 16
 #define RES_USER_INVALID 17
+#define RES_PING 18 /* Heartbeat sent by the server to an idle connection */
+#define RES_RATE_LIMITED 19 /* Request refused by a rate limit; the connection stays open */
+#define RES_SEARCH 20
+#define RES_TRENDING 21
 
 /* Other constants */
-#define INVALID_USER_INDEX 72
+#define INVALID_USER_INDEX -1 /* Never a valid index, whatever the size of activeUsers */
+#define NO_SESSION_ID -1      /* Request without a sessionId, for the connection's own user */
+#define INVALID_SESSION_ID -2 /* sessionId present but not in [0, MAX_MUX_SESSIONS) */
 
 /* Standard libraries */
 #define _GNU_SOURCE
 #include <stdio.h>      /* for printf() and fprintf() */
+#include <errno.h>      /* for errno */
 #include <stdlib.h>     /* for atoi() and exit() */
 #include <string.h>     /* for memset() */
 #include <unistd.h>     /* for close() */
@@ -70,11 +91,35 @@
 #include <time.h>       /* for waitFor() */
 #include <sys/mman.h>   /* to create shared memory across child processes */
 #include <sys/socket.h> /* for socket(), bind(), and connect() */
+#include <sys/uio.h>    /* for struct iovec */
 #include <sys/wait.h>   /* for waitpid() */
 #include <arpa/inet.h>  /* for sockaddr_in and inet_ntoa() */
 
 /* External libraries */
 #include "./cJSON.h"
+#include "./ttweet_compress.h"
+
+/* Incremental decoder for send_payload formatted data on non-blocking sockets */
+typedef struct PayloadReader
+{
+  char header[RCV_BUF_SIZE];    /* Size block received so far */
+  int headerLen;                /* Bytes of header received */
+  char payload[MAX_RESP_LEN];   /* Payload received so far */
+  int payloadLen;               /* Bytes of payload received */
+  int payloadSize;              /* Payload size announced by header, 0 until header complete */
+  int rawSize;                  /* Size before compression announced by header, 0 if not compressed */
+  CompressStream *decompressor; /* History of the payloads received once compression was negotiated, NULL before */
+} PayloadReader;
+
+/* Compression of the payloads a connection sends, see send_payload_compressed() */
+typedef struct PayloadCompressor
+{
+  CompressStream stream;
+  int minBytes;         /* Smaller payloads are sent as they are */
+  uint64_t rawBytes;    /* Bytes of payloads compression was tried on */
+  uint64_t packedBytes; /* Bytes they were sent as, their own size if they did not shrink */
+  uint64_t compressNs;  /* Time spent compressing them */
+} PayloadCompressor;
 
 /**
  * @brief Prints error message and closes the connection and program.
@@ -92,6 +137,17 @@ void die_with_error(char *errorMessage);
  */
 int persist_with_error(char *errorMessage);
 
+/**
+ * @brief Redirects messages of persist_with_error()
+ *
+ * Lets a caller collect errors instead of printing them, e.g. to report
+ * them in order with other output. Pass NULL to print them again.
+ *
+ * @param handler Function receiving each error message, or NULL.
+ * @return void
+ */
+void set_persist_error_handler(void (*handler)(char *errorMessage));
+
 /**
  * @brief Accepts a cJSON object and sends its string representation over a socket.
  *
@@ -104,14 +160,44 @@ int persist_with_error(char *errorMessage);
  *
  * @param sock Client socket assigned to the connection.
  * @param jobjToSend cJSON object to be sent.
- * @return int 0 if error occurred, 1 otherwise.
+ * @return int 0 if error occurred, number of bytes sent otherwise.
  */
 int send_payload(int sock, cJSON *jobjToSend);
 
+/**
+ * @brief Sends a cJSON object in send_payload format with extra send() flags
+ *
+ * With MSG_MORE the kernel may hold the payload back to share a segment
+ * with the next one, so a later send without it must follow.
+ *
+ * @param sock Client socket assigned to the connection.
+ * @param jobjToSend cJSON object to be sent.
+ * @param flags Flags added to MSG_NOSIGNAL, e.g. MSG_MORE
+ * @return int 0 if error occurred, number of bytes sent otherwise.
+ */
+int send_payload_flags(int sock, cJSON *jobjToSend, int flags);
+
+/**
+ * @brief Sends a cJSON object in send_payload format, compressed if that helps
+ *
+ * Payloads of at least compressor->minBytes are compressed with
+ * compress_payload() and sent with a size block of "<size> <rawSize>";
+ * those that do not shrink, and smaller ones, are sent as they are and
+ * only added to the history. The receiver must decode every payload
+ * after negotiation with the same history, see PayloadReader.decompressor.
+ *
+ * @param sock Client socket assigned to the connection.
+ * @param jobjToSend cJSON object to be sent.
+ * @param flags Flags added to MSG_NOSIGNAL, e.g. MSG_MORE
+ * @param compressor Compression state of the connection, or NULL to send as send_payload_flags() does
+ * @return int 0 if error occurred, number of bytes sent otherwise.
+ */
+int send_payload_compressed(int sock, cJSON *jobjToSend, int flags, PayloadCompressor *compressor);
+
 /**
  * @brief Receives a send_payload formatted response and saves it to objReceived.
  *
- * The socket listens for a send_payload formatted response.
+ * The socket blocks until a full send_payload formatted response arrives.
  * It then saves the response to an objReceived string.
  * 
  * This reponse adopts the following structure:
@@ -119,10 +205,10 @@ int send_payload(int sock, cJSON *jobjToSend);
  * The remaining bytes contain the actual cJSON string representation payload.
  *
  * @param sock Client socket assigned to the connection.
- * @param objReceived String to save the response recieved.
- * @return void
+ * @param objReceived String of at least MAX_RESP_LEN bytes to save the response recieved.
+ * @return int Size of the payload received, or 0 if the peer closed the connection or an error occurred.
  */
-void receive_response(int sock, char *objReceived);
+int receive_response(int sock, char *objReceived);
 
 /**
  * @brief Waits for secs amount of seconds.
@@ -131,3 +217,59 @@ void receive_response(int sock, char *objReceived);
  * @return void
  */
 void wait_for(unsigned int secs);
+
+/**
+ * @brief Serializes a cJSON object in send_payload format into a buffer.
+ *
+ * Produces exactly the bytes send_payload() would put on the wire, so the
+ * caller can queue them on a non-blocking socket.
+ *
+ * @param jobjToSend cJSON object to be sent.
+ * @param buffer Buffer to store the encoded payload.
+ * @param bufferLen Size of buffer in bytes.
+ * @return int Number of bytes written to buffer, 0 if buffer is too small.
+ */
+int encode_payload(cJSON *jobjToSend, char *buffer, int bufferLen);
+
+/**
+ * @brief Prepares a PayloadReader to decode the next payload.
+ *
+ * @param reader PayloadReader to reset.
+ * @return void
+ */
+void payload_reader_reset(PayloadReader *reader);
+
+/**
+ * @brief Reads as much of one payload as is available without blocking.
+ *
+ * Bytes are accumulated in reader across calls. Once a full payload has
+ * been received it is left in reader->payload (null terminated) and the
+ * caller must call payload_reader_reset() before decoding the next one.
+ * Compressed payloads are decompressed in place when reader->decompressor
+ * is set, and are an error otherwise.
+ *
+ * @param sock Non-blocking socket to read from.
+ * @param reader PayloadReader holding partial state.
+ * @return int 1 if a full payload is available, 0 if more data is needed, -1 if the peer closed or an error occurred.
+ */
+int receive_payload_nonblocking(int sock, PayloadReader *reader);
+
+/**
+ * @brief Takes a spinlock shared between processes.
+ *
+ * For the short critical sections of the structures kept in shared memory
+ * (MAP_SHARED), which every child process may lock. Yields the CPU every
+ * 64 spins, as the holder may have been descheduled.
+ *
+ * @param lock Lock word, 0 when free.
+ * @return void
+ */
+void spin_lock(int *lock);
+
+/**
+ * @brief Releases a spinlock taken with spin_lock().
+ *
+ * @param lock Lock word.
+ * @return void
+ */
+void spin_unlock(int *lock);
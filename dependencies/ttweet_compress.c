@@ -0,0 +1,270 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_compress.c
+  * @date 18 October 2026
+  * @brief LZ4 block compression of payloads against a connection's history.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  *
+  * A compressed payload is a sequence of LZ4 sequences: a token whose high
+  * nibble is the number of literals and whose low nibble is the match
+  * length minus 4 (15 meaning more length bytes follow), the literals, and
+  * a 2 byte little endian offset back to the match. The last sequence has
+  * literals only. Offsets may reach back past the payload into the earlier
+  * payloads of the connection, which is where the repeated usernames,
+  * hashtags and field names of timeline responses are found.
+  *
+  * The window keeps the history followed by the payload being worked on.
+  * When it fills up, the last COMPRESS_HISTORY_SIZE bytes move to the
+  * front. Hash table entries are stream positions rather than indices, so
+  * they stay valid across the move; entries pointing out of the window
+  * are rejected when the bytes they point at are checked.
+  */
+
+#include "ttweet_compress.h"
+#include <string.h> /* for memcpy() and memmove() */
+
+#define MIN_MATCH 4     /* Shortest match worth an offset */
+#define LAST_LITERALS 5 /* The last bytes of a payload are always literals, as in LZ4 */
+#define MATCH_LIMIT 12  /* No match starts this close to the end of a payload */
+#define SKIP_TRIGGER 6  /* Each 2^SKIP_TRIGGER misses in a row step one byte further */
+
+void compress_stream_reset(CompressStream *stream);                                                /* Starts a stream with the built-in dictionary */
+void compress_stream_append(CompressStream *stream, const char *src, int srcLen);                  /* Adds an uncompressed payload to the history */
+int compress_payload(CompressStream *stream, const char *src, int srcLen, char *dst, int dstLen);  /* Compresses a payload against the history */
+int decompress_payload(CompressStream *stream, const char *src, int srcLen, char *dst, int rawLen); /* Decompresses a payload against the history */
+
+static void make_room(CompressStream *stream, int len);
+static void hash_positions(CompressStream *stream, int start, int end);
+static uint8_t *write_length(uint8_t *op, int len);
+static uint32_t read32(const uint8_t *p);
+static uint32_t hash4(const uint8_t *p);
+
+/* Field names and fixed text of every response, so the first payload of a
+ * connection compresses as well as later ones */
+static const char compressDictionary[] =
+    "{\"responseCode\":16,\"clientUserIdx\":0,\"detailedMessage\":\"Username is valid.\",\"username\":\"\",\"compression\":\"lz4\"}"
+    "{\"responseCode\":11,\"clientUserIdx\":0,\"detailedMessage\":\"Tweeted successfully.\\n\",\"username\":\"\"}"
+    "{\"responseCode\":12,\"clientUserIdx\":0,\"detailedMessage\":\"Successfully subscribed.\\n\",\"username\":\"\"}"
+    "{\"responseCode\":20,\"clientUserIdx\":0,\"detailedMessage\":\"\",\"username\":\"\",\"searchResults\":[\"\"]}"
+    "{\"responseCode\":21,\"clientUserIdx\":0,\"detailedMessage\":\"\",\"username\":\"\",\"trendingHashtags\":[{\"hashtag\":\"\",\"count\":1}]}"
+    "{\"responseCode\":14,\"clientUserIdx\":0,\"detailedMessage\":\"\",\"storedTweets\":[\"\",\"\"],\"firstTweetSeq\":1,\"moreTweets\":0}";
+
+/** \copydoc compress_stream_reset */
+void compress_stream_reset(CompressStream *stream)
+{
+  stream->windowLen = 0;
+  stream->windowBase = 0;
+  memset(stream->hashTable, 0, sizeof(stream->hashTable));
+  compress_stream_append(stream, compressDictionary, sizeof(compressDictionary) - 1);
+}
+
+/** \copydoc compress_stream_append */
+void compress_stream_append(CompressStream *stream, const char *src, int srcLen)
+{
+  int chunkLen;
+
+  while (srcLen > 0)
+  { /* Only the tail of a long payload can stay in the history anyway */
+    chunkLen = srcLen < COMPRESS_MAX_INPUT ? srcLen : COMPRESS_MAX_INPUT;
+    make_room(stream, chunkLen);
+    memcpy(stream->window + stream->windowLen, src, chunkLen);
+    hash_positions(stream, stream->windowLen > 3 ? stream->windowLen - 3 : 0, stream->windowLen + chunkLen);
+    stream->windowLen += chunkLen;
+    src += chunkLen;
+    srcLen -= chunkLen;
+  }
+}
+
+/** \copydoc compress_payload */
+int compress_payload(CompressStream *stream, const char *src, int srcLen, char *dst, int dstLen)
+{
+  uint8_t *window = stream->window;
+  uint8_t *op = (uint8_t *)dst;
+  uint8_t *opEnd = (uint8_t *)dst + (dstLen < srcLen ? dstLen : srcLen); /* No use unless it shrinks */
+  int start, end, ip, anchor, matchIdx, matchLen, literalLen, lowest, misses = 0;
+  uint32_t distance, *slot;
+
+  if (srcLen > COMPRESS_MAX_INPUT)
+  {
+    compress_stream_append(stream, src, srcLen);
+    return 0;
+  }
+  make_room(stream, srcLen);
+  start = stream->windowLen;
+  end = start + srcLen;
+  memcpy(window + start, src, srcLen);
+  stream->windowLen = end;
+  lowest = start > COMPRESS_HISTORY_SIZE ? start - COMPRESS_HISTORY_SIZE : 0; /* The receiver may keep no more */
+
+  ip = start;
+  anchor = start;
+  while (ip < end - MATCH_LIMIT)
+  {
+    slot = &stream->hashTable[hash4(window + ip)];
+    distance = stream->windowBase + ip - *slot;
+    *slot = stream->windowBase + ip;
+    if (distance == 0 || distance > (uint32_t)(ip - lowest) || read32(window + ip - distance) != read32(window + ip))
+    { /* Incompressible data is skipped over faster the longer it lasts */
+      ip += 1 + (misses++ >> SKIP_TRIGGER);
+      continue;
+    }
+    misses = 0;
+    matchIdx = ip - distance;
+    while (ip > anchor && matchIdx > lowest && window[ip - 1] == window[matchIdx - 1])
+    { /* Extend backwards over literals */
+      ip--;
+      matchIdx--;
+    }
+    matchLen = MIN_MATCH;
+    while (ip + matchLen < end - LAST_LITERALS && window[matchIdx + matchLen] == window[ip + matchLen])
+      matchLen++;
+
+    literalLen = ip - anchor;
+    if (op + 1 + literalLen + literalLen / 255 + 2 + (matchLen - MIN_MATCH) / 255 + 1 > opEnd)
+      return 0;
+    *op = (literalLen < 15 ? literalLen : 15) << 4 | (matchLen - MIN_MATCH < 15 ? matchLen - MIN_MATCH : 15);
+    op = write_length(op + 1, literalLen);
+    memcpy(op, window + anchor, literalLen);
+    op += literalLen;
+    *op++ = distance & 0xff;
+    *op++ = distance >> 8;
+    op = write_length(op, matchLen - MIN_MATCH);
+
+    ip += matchLen;
+    anchor = ip;
+    if (ip < end - MATCH_LIMIT)
+      stream->hashTable[hash4(window + ip - 2)] = stream->windowBase + ip - 2;
+  }
+
+  literalLen = end - anchor;
+  if (op + 1 + literalLen + literalLen / 255 + 1 > opEnd)
+    return 0;
+  *op = (literalLen < 15 ? literalLen : 15) << 4;
+  op = write_length(op + 1, literalLen);
+  memcpy(op, window + anchor, literalLen);
+  op += literalLen;
+  return op < opEnd ? op - (uint8_t *)dst : 0;
+}
+
+/** \copydoc decompress_payload */
+int decompress_payload(CompressStream *stream, const char *src, int srcLen, char *dst, int rawLen)
+{
+  const uint8_t *ip = (const uint8_t *)src;
+  const uint8_t *ipEnd = ip + srcLen;
+  uint8_t *window = stream->window;
+  int op, opEnd, token, len, distance;
+
+  if (rawLen <= 0 || rawLen > COMPRESS_MAX_INPUT)
+    return -1;
+  make_room(stream, rawLen);
+  op = stream->windowLen;
+  opEnd = op + rawLen;
+
+  while (ip < ipEnd)
+  {
+    token = *ip++;
+    len = token >> 4;
+    if (len == 15)
+    {
+      do
+      {
+        if (ip >= ipEnd)
+          return -1;
+        len += *ip;
+      } while (*ip++ == 255 && len <= rawLen);
+    }
+    if (len > ipEnd - ip || len > opEnd - op)
+      return -1;
+    memcpy(window + op, ip, len);
+    ip += len;
+    op += len;
+    if (ip == ipEnd)
+      break; /* Last sequence, literals only */
+
+    if (ipEnd - ip < 2)
+      return -1;
+    distance = ip[0] | ip[1] << 8;
+    ip += 2;
+    len = (token & 15) + MIN_MATCH;
+    if ((token & 15) == 15)
+    {
+      do
+      {
+        if (ip >= ipEnd)
+          return -1;
+        len += *ip;
+      } while (*ip++ == 255 && len <= rawLen);
+    }
+    if (distance == 0 || distance > op || len > opEnd - op)
+      return -1;
+    if (distance >= len)
+      memcpy(window + op, window + op - distance, len);
+    else
+    { /* Byte by byte, as the match overlaps what it produces */
+      for (int byteIdx = 0; byteIdx < len; byteIdx++)
+        window[op + byteIdx] = window[op - distance + byteIdx];
+    }
+    op += len;
+  }
+  if (op != opEnd)
+    return -1;
+
+  memmove(dst, window + stream->windowLen, rawLen);
+  stream->windowLen = opEnd;
+  return rawLen;
+}
+
+/* Moves the history to the front of the window if len more bytes would not fit */
+static void make_room(CompressStream *stream, int len)
+{
+  int shift;
+
+  if (stream->windowLen + len <= (int)sizeof(stream->window))
+    return;
+  shift = stream->windowLen - COMPRESS_HISTORY_SIZE;
+  memmove(stream->window, stream->window + shift, COMPRESS_HISTORY_SIZE);
+  stream->windowLen = COMPRESS_HISTORY_SIZE;
+  stream->windowBase += shift;
+}
+
+/* Records every position in [start, end) with 4 bytes of window after it */
+static void hash_positions(CompressStream *stream, int start, int end)
+{
+  for (int windowIdx = start; windowIdx + 4 <= end; windowIdx++)
+    stream->hashTable[hash4(stream->window + windowIdx)] = stream->windowBase + windowIdx;
+}
+
+/* Bytes after a 15 in the token: 255 while more remains, then the rest */
+static uint8_t *write_length(uint8_t *op, int len)
+{
+  if (len < 15)
+    return op;
+  for (len -= 15; len >= 255; len -= 255)
+    *op++ = 255;
+  *op++ = len;
+  return op;
+}
+
+static uint32_t read32(const uint8_t *p)
+{
+  uint32_t value;
+
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static uint32_t hash4(const uint8_t *p)
+{
+  return (read32(p) * 2654435761u) >> (32 - COMPRESS_HASH_BITS);
+}
@@ -0,0 +1,99 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_compress.h
+  * @date 18 October 2026
+  * @brief Documentation for functions in ttweet_compress.c.
+  *
+  * This header file has been created to describe the functions
+  * and declare constants in ttweet_compress.c.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  */
+
+#ifndef TTWEET_COMPRESS_H
+#define TTWEET_COMPRESS_H
+
+#include <stdint.h> /* for uint32_t */
+
+#define COMPRESS_CODEC_NAME "lz4"    /* Negotiated at login, see REQ_VALIDATE_USER */
+#define COMPRESS_HISTORY_SIZE 32768  /* Earlier bytes of the stream a match may copy from */
+#define COMPRESS_MAX_INPUT 8192      /* Largest payload compressed at once */
+#define COMPRESS_HASH_BITS 12
+#define COMPRESS_BOUND(len) ((len) + (len) / 255 + 16) /* Worst case output for len input bytes */
+
+/* One direction of a connection. Both ends see the same payloads in the
+ * same order, so their windows hold the same bytes and a compressed
+ * payload may copy from any of the last COMPRESS_HISTORY_SIZE of them. */
+typedef struct CompressStream
+{
+  uint8_t window[2 * COMPRESS_HISTORY_SIZE + COMPRESS_MAX_INPUT];
+  int windowLen;                               /* Bytes in window; the history is the last COMPRESS_HISTORY_SIZE */
+  uint32_t windowBase;                         /* Stream position of window[0] */
+  uint32_t hashTable[1 << COMPRESS_HASH_BITS]; /* Stream position of the last 4 bytes with each hash; used to compress only */
+} CompressStream;
+
+/**
+ * @brief Starts a stream with only the built-in dictionary as history
+ *
+ * The dictionary holds the field names of every response, so even the
+ * first payload of a connection has something to copy from.
+ *
+ * @param stream Stream to reset
+ * @return void
+ */
+void compress_stream_reset(CompressStream *stream);
+
+/**
+ * @brief Adds a payload that was sent as it is to a stream's history
+ *
+ * Both ends must call this for every payload not passed through
+ * compress_payload() or decompress_payload().
+ *
+ * @param stream Stream to add to
+ * @param src Payload bytes
+ * @param srcLen Length of src, any size
+ * @return void
+ */
+void compress_stream_append(CompressStream *stream, const char *src, int srcLen);
+
+/**
+ * @brief Compresses a payload in LZ4 block format against a stream's history
+ *
+ * Matches are found greedily through a hash of the next 4 bytes, as LZ4
+ * does. src is added to the history whether or not it shrank.
+ *
+ * @param stream Stream the payload belongs to
+ * @param src Payload bytes
+ * @param srcLen Length of src, at most COMPRESS_MAX_INPUT
+ * @param dst Buffer receiving the compressed bytes
+ * @param dstLen Size of dst in bytes
+ * @return int Compressed length; 0 if it would not be smaller than srcLen, so src should be sent as it is.
+ */
+int compress_payload(CompressStream *stream, const char *src, int srcLen, char *dst, int dstLen);
+
+/**
+ * @brief Decompresses a payload made by compress_payload()
+ *
+ * Every length and offset is checked, so a corrupt payload is reported
+ * rather than read or written out of bounds.
+ *
+ * @param stream Stream the payload belongs to
+ * @param src Compressed bytes
+ * @param srcLen Length of src
+ * @param dst Buffer of at least rawLen bytes receiving the payload; may be src
+ * @param rawLen Length of the payload before compression
+ * @return int rawLen; -1 if src is corrupt, after which the stream is unusable.
+ */
+int decompress_payload(CompressStream *stream, const char *src, int srcLen, char *dst, int rawLen);
+
+#endif
@@ -0,0 +1,121 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_histogram.c
+  * @date 18 October 2026
+  * @brief Log-linear latency histograms shared by ttweetsrv and ttweetbench.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  *
+  * Histograms are log-linear (HDR style): values below 2^(SUB_BITS + 1) get
+  * their own bucket, larger values are split into SUB_COUNT buckets per
+  * power of two, giving a relative error of at most 1/SUB_COUNT.
+  */
+
+#include "ttweet_histogram.h"
+#include <time.h> /* for clock_gettime() */
+
+void histogram_record(Histogram *histogram, uint64_t value);         /* Records a value in a histogram */
+void histogram_merge(Histogram *dest, Histogram *src);               /* Adds all counts of src to dest */
+uint64_t histogram_quantile(Histogram *histogram, double quantile); /* Estimates a quantile from a histogram */
+uint64_t histogram_now_ns();                                         /* Returns a monotonic timestamp in ns */
+
+static int histogram_bucket_index(uint64_t value);
+static uint64_t histogram_bucket_upper(int bucketIdx);
+
+/** \copydoc histogram_record */
+void histogram_record(Histogram *histogram, uint64_t value)
+{
+  uint64_t max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+
+  __atomic_fetch_add(&histogram->buckets[histogram_bucket_index(value)], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&histogram->sum, value, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&histogram->count, 1, __ATOMIC_RELAXED);
+  while (value > max && !__atomic_compare_exchange_n(&histogram->max, &max, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ; /* retry until max is at least value */
+}
+
+/** \copydoc histogram_merge */
+void histogram_merge(Histogram *dest, Histogram *src)
+{
+  uint64_t srcMax;
+
+  if (__atomic_load_n(&src->count, __ATOMIC_RELAXED) == 0)
+    return;
+  for (int bucketIdx = 0; bucketIdx < HIST_BUCKETS; bucketIdx++)
+    dest->buckets[bucketIdx] += __atomic_load_n(&src->buckets[bucketIdx], __ATOMIC_RELAXED);
+  dest->sum += __atomic_load_n(&src->sum, __ATOMIC_RELAXED);
+  dest->count += __atomic_load_n(&src->count, __ATOMIC_RELAXED);
+  srcMax = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+  if (srcMax > dest->max)
+    dest->max = srcMax;
+}
+
+/** \copydoc histogram_quantile */
+uint64_t histogram_quantile(Histogram *histogram, double quantile)
+{
+  uint64_t total = 0;
+  uint64_t seen = 0;
+  uint64_t rank;
+
+  for (int bucketIdx = 0; bucketIdx < HIST_BUCKETS; bucketIdx++)
+    total += histogram->buckets[bucketIdx]; /* bucket totals may run ahead of count while being written */
+  if (total == 0)
+    return 0;
+  rank = (uint64_t)(quantile * total);
+  if (rank >= total)
+    rank = total - 1;
+  for (int bucketIdx = 0; bucketIdx < HIST_BUCKETS; bucketIdx++)
+  {
+    seen += histogram->buckets[bucketIdx];
+    if (seen > rank)
+    { /* never report more than the largest value seen */
+      uint64_t upper = histogram_bucket_upper(bucketIdx);
+      return (histogram->max && upper > histogram->max) ? histogram->max : upper;
+    }
+  }
+  return histogram->max;
+}
+
+/** \copydoc histogram_now_ns */
+uint64_t histogram_now_ns()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/* Returns the bucket for value */
+static int histogram_bucket_index(uint64_t value)
+{
+  int msb;
+
+  if (value < 2 * HIST_SUB_COUNT)
+    return (int)value;
+  msb = 63 - __builtin_clzll(value);
+  if (msb > HIST_MAX_MSB)
+    return HIST_BUCKETS - 1;
+  return (msb - HIST_SUB_BITS) * HIST_SUB_COUNT + (int)(value >> (msb - HIST_SUB_BITS));
+}
+
+/* Returns the largest value that falls into bucketIdx */
+static uint64_t histogram_bucket_upper(int bucketIdx)
+{
+  int msb;
+  uint64_t subBucket;
+
+  if (bucketIdx < 2 * HIST_SUB_COUNT)
+    return (uint64_t)bucketIdx;
+  msb = bucketIdx / HIST_SUB_COUNT + HIST_SUB_BITS - 1;
+  subBucket = bucketIdx % HIST_SUB_COUNT + HIST_SUB_COUNT;
+  return ((subBucket + 1) << (msb - HIST_SUB_BITS)) - 1;
+}
@@ -0,0 +1,82 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_histogram.h
+  * @date 18 October 2026
+  * @brief Documentation for functions in ttweet_histogram.c.
+  *
+  * This header file has been created to describe the functions
+  * and declare constants in ttweet_histogram.c.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  */
+
+#ifndef TTWEET_HISTOGRAM_H
+#define TTWEET_HISTOGRAM_H
+
+#include <stdint.h> /* for uint64_t */
+
+/* Histogram layout (log-linear, 2^HIST_SUB_BITS sub-buckets per power of two) */
+#define HIST_SUB_BITS 3
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_MAX_MSB 39 /* Largest tracked value is ~2^40 (about 18 minutes in ns) */
+#define HIST_BUCKETS ((HIST_MAX_MSB - HIST_SUB_BITS + 2) * HIST_SUB_COUNT)
+
+typedef struct Histogram
+{
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+  uint64_t buckets[HIST_BUCKETS];
+} Histogram;
+
+/**
+ * @brief Records a value in a histogram
+ *
+ * Uses relaxed atomic adds, so a histogram in shared memory may be
+ * read by another process while it is being written.
+ *
+ * @param histogram Histogram to update
+ * @param value Value to record
+ * @return void
+ */
+void histogram_record(Histogram *histogram, uint64_t value);
+
+/**
+ * @brief Adds all counts of src to dest
+ *
+ * @param dest Histogram receiving the counts
+ * @param src Histogram to read from
+ * @return void
+ */
+void histogram_merge(Histogram *dest, Histogram *src);
+
+/**
+ * @brief Estimates a quantile from a histogram
+ *
+ * The estimate is the upper bound of the bucket containing the quantile,
+ * so it overstates the true value by at most 1/HIST_SUB_COUNT.
+ *
+ * @param histogram Histogram to read from
+ * @param quantile Quantile between 0 and 1
+ * @return uint64_t Estimated value at the quantile, 0 if the histogram is empty
+ */
+uint64_t histogram_quantile(Histogram *histogram, double quantile);
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds
+ *
+ * @return uint64_t Current CLOCK_MONOTONIC time in nanoseconds
+ */
+uint64_t histogram_now_ns();
+
+#endif
@@ -0,0 +1,447 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_validate.c
+  * @date 18 October 2026
+  * @brief Hashtag, tweet and username validation shared by ttweetcli and ttweetsrv.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  *
+  * Two scanners do the per-character work: one classifies a hashtag list
+  * (first byte that is neither # nor alphanumeric, plus a bitmask of the #
+  * positions), the other finds the first control character in free text.
+  * Each has a scalar, an SSE4.2 (PCMPESTRI range match) and an AVX2 (32
+  * bytes per compare) version; the best one the CPU supports is picked at
+  * runtime, so the binaries still run on older machines. Blocks shorter than
+  * a vector are copied into a zeroed buffer, so nothing is read past the
+  * caller's input.
+  */
+
+#include "ttweet_common.h"
+#include "ttweet_validate.h"
+#include <stdint.h> /* for uint64_t */
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> /* for SSE4.2 and AVX2 intrinsics */
+#define VALIDATE_X86 1
+#endif
+
+/* Hashtag lists longer than this cannot be described by a 64-bit # mask */
+#define MAX_HASHTAG_LIST_SCAN 64
+
+int split_hashtag_list(const char *input, int inputLen, TextView hashtags[], int maxHashtags, int *numHashtags); /* Splits a hashtag list into views */
+int is_valid_hashtag(const char *hashtag, int len);                                                             /* Checks a single hashtag */
+int is_valid_subscription(const char *subscription, int len);                                                   /* Checks a hashtag or prefix */
+int is_valid_tweet_text(const char *text, int len);                                                             /* Checks a tweet message */
+int is_valid_username(const char *username, int len);                                                           /* Checks a username */
+int has_duplicate_view(TextView views[], int numViews);                                                         /* Checks for duplicate views */
+int text_view_equals(TextView view, const char *string);                                                        /* Compares a view with a string */
+char *copy_text_view(TextView view, char *buffer, int bufferLen);                                               /* Copies a view into a buffer */
+char *validate_error_message(int errorCode);                                                                    /* Describes a validation error */
+int set_validate_simd_level(int level);                                                                         /* Selects the scanner instruction set */
+int get_validate_simd_level();                                                                                  /* Returns the scanner instruction set */
+char *simd_level_name(int level);                                                                               /* Names an instruction set */
+
+static int detect_simd_level();
+static void select_scanners(int level);
+static int scan_hashtag_list_scalar(const char *input, int len, uint64_t *hashMask);
+static int scan_control_chars_scalar(const char *text, int len);
+#ifdef VALIDATE_X86
+static int scan_hashtag_list_sse42(const char *input, int len, uint64_t *hashMask);
+static int scan_control_chars_sse42(const char *text, int len);
+static int scan_hashtag_list_avx2(const char *input, int len, uint64_t *hashMask);
+static int scan_control_chars_avx2(const char *text, int len);
+#endif
+
+/* Scanners in use. A hashtag list scanner returns the index of the first
+ * byte that is neither # nor alphanumeric (len if none) and sets hashMask
+ * to the positions of # before it. A control character scanner returns the
+ * index of the first byte below 0x20 or equal to 0x7f (len if none). */
+static int simdLevel = -1;
+static int (*scanHashtagList)(const char *input, int len, uint64_t *hashMask) = scan_hashtag_list_scalar;
+static int (*scanControlChars)(const char *text, int len) = scan_control_chars_scalar;
+
+/** \copydoc split_hashtag_list */
+int split_hashtag_list(const char *input, int inputLen, TextView hashtags[], int maxHashtags, int *numHashtags)
+{
+  uint64_t hashMask;
+  int invalidIdx;
+  int hashtagStart;
+  int hashtagEnd;
+
+  *numHashtags = 0;
+  if (simdLevel < 0)
+    set_validate_simd_level(SIMD_LEVEL_AVX2);
+
+  if (inputLen < 1 || input[0] != '#')
+  { /* Hashtag must begin with # */
+    return VALIDATE_ERR_NO_LEADING_HASH;
+  }
+  if (input[inputLen - 1] == '#')
+  { /* Hashtag cannot end with # */
+    return VALIDATE_ERR_TRAILING_HASH;
+  }
+  if (inputLen < 2 || inputLen > MAX_HASHTAG_LEN || inputLen > MAX_HASHTAG_LIST_SCAN)
+  { /* Hashtag list must be between 2 to MAX_HASHTAG_LEN chars long */
+    return VALIDATE_ERR_LENGTH;
+  }
+
+  invalidIdx = scanHashtagList(input, inputLen, &hashMask);
+  if (hashMask & (hashMask >> 1))
+  { /* Two adjacent # before any invalid character */
+    return VALIDATE_ERR_CONSECUTIVE_HASH;
+  }
+  if (invalidIdx < inputLen)
+  {
+    return VALIDATE_ERR_CHARSET;
+  }
+  if (__builtin_popcountll(hashMask) > maxHashtags)
+  {
+    return VALIDATE_ERR_LIMIT;
+  }
+
+  while (hashMask)
+  { /* Each hashtag runs from just after its # to the next # or the end */
+    hashtagStart = __builtin_ctzll(hashMask) + 1;
+    hashMask &= hashMask - 1;
+    hashtagEnd = hashMask ? __builtin_ctzll(hashMask) : inputLen;
+    hashtags[*numHashtags].start = input + hashtagStart;
+    hashtags[*numHashtags].len = hashtagEnd - hashtagStart;
+    (*numHashtags)++;
+  }
+
+  if (has_duplicate_view(hashtags, *numHashtags))
+  {
+    *numHashtags = 0;
+    return VALIDATE_ERR_DUPLICATE;
+  }
+  return VALIDATE_OK;
+}
+
+/** \copydoc is_valid_hashtag */
+int is_valid_hashtag(const char *hashtag, int len)
+{
+  uint64_t hashMask;
+
+  if (len < 1 || len > MAX_HASHTAG_LEN - 1)
+    return 0;
+  if (simdLevel < 0)
+    set_validate_simd_level(SIMD_LEVEL_AVX2);
+  return scanHashtagList(hashtag, len, &hashMask) == len && hashMask == 0;
+}
+
+/** \copydoc is_valid_subscription */
+int is_valid_subscription(const char *subscription, int len)
+{
+  if (len >= 2 && len <= MAX_HASHTAG_LEN - 1 && subscription[len - 1] == PREFIX_WILDCARD)
+    len--;
+  return is_valid_hashtag(subscription, len);
+}
+
+/** \copydoc is_valid_tweet_text */
+int is_valid_tweet_text(const char *text, int len)
+{
+  if (len < 1 || len > MAX_TWEET_LEN)
+    return 0;
+  if (simdLevel < 0)
+    set_validate_simd_level(SIMD_LEVEL_AVX2);
+  return scanControlChars(text, len) == len;
+}
+
+/** \copydoc is_valid_username */
+int is_valid_username(const char *username, int len)
+{
+  if (len < 1 || len > MAX_USERNAME_LEN - 1)
+    return 0;
+  if (simdLevel < 0)
+    set_validate_simd_level(SIMD_LEVEL_AVX2);
+  return scanControlChars(username, len) == len;
+}
+
+/** \copydoc has_duplicate_view */
+int has_duplicate_view(TextView views[], int numViews)
+{
+  /* At most MAX_HASHTAG_CNT views, so pairwise is cheapest; the length and
+   * first character reject almost every pair before memcmp() */
+  for (int i = 0; i < numViews - 1; i++)
+  {
+    for (int j = i + 1; j < numViews; j++)
+    {
+      if (views[i].len == views[j].len && views[i].start[0] == views[j].start[0] &&
+          memcmp(views[i].start, views[j].start, views[i].len) == 0)
+      {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+/** \copydoc text_view_equals */
+int text_view_equals(TextView view, const char *string)
+{
+  return strncmp(view.start, string, view.len) == 0 && string[view.len] == '\0';
+}
+
+/** \copydoc copy_text_view */
+char *copy_text_view(TextView view, char *buffer, int bufferLen)
+{
+  int len = view.len < bufferLen - 1 ? view.len : bufferLen - 1;
+
+  memcpy(buffer, view.start, len);
+  buffer[len] = '\0';
+  return buffer;
+}
+
+/** \copydoc validate_error_message */
+char *validate_error_message(int errorCode)
+{
+  switch (errorCode)
+  {
+  case VALIDATE_ERR_NO_LEADING_HASH:
+    return "Invalid hashtag(s)! Hashtag(s) must begin with #.";
+  case VALIDATE_ERR_TRAILING_HASH:
+    return "Invalid hashtag(s)! Hashtag(s) cannot end with #.";
+  case VALIDATE_ERR_LENGTH:
+    return "Invalid hashtag(s)! Hashtag(s) must be between 2 to 25 chars long.";
+  case VALIDATE_ERR_CONSECUTIVE_HASH:
+    return "Invalid hashtag(s)! Hashtag(s) cannot contain consecutive #.";
+  case VALIDATE_ERR_CHARSET:
+    return "Invalid hashtag(s)! Hashtag(s) contains invalid characters.";
+  case VALIDATE_ERR_LIMIT:
+    return "Invalid hashtag(s)! Hashtag limit exceeded.";
+  case VALIDATE_ERR_DUPLICATE:
+    return "Invalid hashtag(s)! Duplicate hashtags detected.";
+  default:
+    return "Invalid hashtag(s)!";
+  }
+}
+
+/** \copydoc set_validate_simd_level */
+int set_validate_simd_level(int level)
+{
+  int supported = detect_simd_level();
+
+  simdLevel = level < supported ? level : supported;
+  select_scanners(simdLevel);
+  return simdLevel;
+}
+
+/** \copydoc get_validate_simd_level */
+int get_validate_simd_level()
+{
+  if (simdLevel < 0)
+    set_validate_simd_level(SIMD_LEVEL_AVX2);
+  return simdLevel;
+}
+
+/** \copydoc simd_level_name */
+char *simd_level_name(int level)
+{
+  switch (level)
+  {
+  case SIMD_LEVEL_AVX2:
+    return "avx2";
+  case SIMD_LEVEL_SSE42:
+    return "sse4.2";
+  default:
+    return "scalar";
+  }
+}
+
+static int detect_simd_level()
+{
+#ifdef VALIDATE_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return SIMD_LEVEL_AVX2;
+  if (__builtin_cpu_supports("sse4.2"))
+    return SIMD_LEVEL_SSE42;
+#endif
+  return SIMD_LEVEL_SCALAR;
+}
+
+static void select_scanners(int level)
+{
+  scanHashtagList = scan_hashtag_list_scalar;
+  scanControlChars = scan_control_chars_scalar;
+#ifdef VALIDATE_X86
+  if (level == SIMD_LEVEL_AVX2)
+  {
+    scanHashtagList = scan_hashtag_list_avx2;
+    scanControlChars = scan_control_chars_avx2;
+  }
+  else if (level == SIMD_LEVEL_SSE42)
+  {
+    scanHashtagList = scan_hashtag_list_sse42;
+    scanControlChars = scan_control_chars_sse42;
+  }
+#endif
+}
+
+static int scan_hashtag_list_scalar(const char *input, int len, uint64_t *hashMask)
+{
+  *hashMask = 0;
+  for (int charIdx = 0; charIdx < len; charIdx++)
+  {
+    unsigned char c = input[charIdx];
+    if (c == '#')
+      *hashMask |= 1ULL << charIdx;
+    else if (!((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')))
+      return charIdx;
+  }
+  return len;
+}
+
+static int scan_control_chars_scalar(const char *text, int len)
+{
+  for (int charIdx = 0; charIdx < len; charIdx++)
+  {
+    unsigned char c = text[charIdx];
+    if (c < 0x20 || c == 0x7f)
+      return charIdx;
+  }
+  return len;
+}
+
+#ifdef VALIDATE_X86
+
+__attribute__((target("sse4.2"))) static int scan_hashtag_list_sse42(const char *input, int len, uint64_t *hashMask)
+{
+  const __m128i ranges = _mm_setr_epi8('0', '9', 'A', 'Z', 'a', 'z', '#', '#', 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i hash = _mm_set1_epi8('#');
+  char tail[16];
+  __m128i block;
+  int blockLen;
+  int invalidIdx;
+
+  *hashMask = 0;
+  for (int offset = 0; offset < len && offset < MAX_HASHTAG_LIST_SCAN; offset += 16)
+  {
+    blockLen = len - offset < 16 ? len - offset : 16;
+    if (blockLen == 16)
+      block = _mm_loadu_si128((const __m128i *)(input + offset));
+    else
+    { /* Never read past the caller's buffer */
+      memset(tail, 0, sizeof(tail));
+      memcpy(tail, input + offset, blockLen);
+      block = _mm_loadu_si128((const __m128i *)tail);
+    }
+    /* Index of the first byte of block outside the ranges, 16 if none */
+    invalidIdx = _mm_cmpestri(ranges, 8, block, blockLen,
+                              _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_MASKED_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT);
+    *hashMask |= (uint64_t)(_mm_movemask_epi8(_mm_cmpeq_epi8(block, hash)) & ((1 << invalidIdx) - 1)) << offset;
+    if (invalidIdx < blockLen)
+      return offset + invalidIdx;
+  }
+  return len;
+}
+
+__attribute__((target("sse4.2"))) static int scan_control_chars_sse42(const char *text, int len)
+{
+  const __m128i ranges = _mm_setr_epi8(0x00, 0x1f, 0x7f, 0x7f, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  char tail[16];
+  __m128i block;
+  int blockLen;
+  int controlIdx;
+
+  for (int offset = 0; offset < len; offset += 16)
+  {
+    blockLen = len - offset < 16 ? len - offset : 16;
+    if (blockLen == 16)
+      block = _mm_loadu_si128((const __m128i *)(text + offset));
+    else
+    { /* Never read past the caller's buffer */
+      memset(tail, 0, sizeof(tail));
+      memcpy(tail, text + offset, blockLen);
+      block = _mm_loadu_si128((const __m128i *)tail);
+    }
+    /* Padding lies beyond blockLen, so it never matches */
+    controlIdx = _mm_cmpestri(ranges, 4, block, blockLen, _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+    if (controlIdx < blockLen)
+      return offset + controlIdx;
+  }
+  return len;
+}
+
+__attribute__((target("avx2"))) static int scan_hashtag_list_avx2(const char *input, int len, uint64_t *hashMask)
+{
+  char tail[32];
+  __m256i block;
+  __m256i letter;
+  __m256i digit;
+  __m256i valid;
+  uint32_t hashBits;
+  uint32_t invalidBits;
+  int blockLen;
+
+  *hashMask = 0;
+  for (int offset = 0; offset < len && offset < MAX_HASHTAG_LIST_SCAN; offset += 32)
+  {
+    blockLen = len - offset < 32 ? len - offset : 32;
+    if (blockLen == 32)
+      block = _mm256_loadu_si256((const __m256i *)(input + offset));
+    else
+    { /* Never read past the caller's buffer */
+      memset(tail, 0, sizeof(tail));
+      memcpy(tail, input + offset, blockLen);
+      block = _mm256_loadu_si256((const __m256i *)tail);
+    }
+    /* (c | 0x20) - 'a' <= 25 for letters and c - '0' <= 9 for digits, unsigned */
+    letter = _mm256_sub_epi8(_mm256_or_si256(block, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    digit = _mm256_sub_epi8(block, _mm256_set1_epi8('0'));
+    valid = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(25)), letter),
+                            _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit));
+    hashBits = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('#')));
+    invalidBits = ~((uint32_t)_mm256_movemask_epi8(valid) | hashBits);
+    if (blockLen < 32)
+      invalidBits &= (1U << blockLen) - 1;
+    if (invalidBits)
+    {
+      *hashMask |= (uint64_t)(hashBits & ((1U << __builtin_ctz(invalidBits)) - 1)) << offset;
+      return offset + __builtin_ctz(invalidBits);
+    }
+    *hashMask |= (uint64_t)hashBits << offset;
+  }
+  return len;
+}
+
+__attribute__((target("avx2"))) static int scan_control_chars_avx2(const char *text, int len)
+{
+  char tail[32];
+  __m256i block;
+  uint32_t controlBits;
+  int blockLen;
+
+  for (int offset = 0; offset < len; offset += 32)
+  {
+    blockLen = len - offset < 32 ? len - offset : 32;
+    if (blockLen == 32)
+      block = _mm256_loadu_si256((const __m256i *)(text + offset));
+    else
+    { /* Never read past the caller's buffer */
+      memset(tail, 0, sizeof(tail));
+      memcpy(tail, text + offset, blockLen);
+      block = _mm256_loadu_si256((const __m256i *)tail);
+    }
+    controlBits = _mm256_movemask_epi8(_mm256_or_si256(
+        _mm256_cmpeq_epi8(_mm256_min_epu8(block, _mm256_set1_epi8(0x1f)), block),
+        _mm256_cmpeq_epi8(block, _mm256_set1_epi8(0x7f))));
+    if (blockLen < 32)
+      controlBits &= (1U << blockLen) - 1;
+    if (controlBits)
+      return offset + __builtin_ctz(controlBits);
+  }
+  return len;
+}
+
+#endif
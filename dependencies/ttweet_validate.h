@@ -0,0 +1,162 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_validate.h
+  * @date 18 October 2026
+  * @brief Documentation for functions in ttweet_validate.c.
+  *
+  * This header file has been created to describe the functions
+  * and declare constants in ttweet_validate.c.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  */
+
+#ifndef TTWEET_VALIDATE_H
+#define TTWEET_VALIDATE_H
+
+/* Validation results */
+#define VALIDATE_OK 1
+#define VALIDATE_ERR_NO_LEADING_HASH -1
+#define VALIDATE_ERR_TRAILING_HASH -2
+#define VALIDATE_ERR_LENGTH -3
+#define VALIDATE_ERR_CONSECUTIVE_HASH -4
+#define VALIDATE_ERR_CHARSET -5
+#define VALIDATE_ERR_LIMIT -6
+#define VALIDATE_ERR_DUPLICATE -7
+
+/* Instruction sets used by the scanners */
+#define SIMD_LEVEL_SCALAR 0
+#define SIMD_LEVEL_SSE42 1
+#define SIMD_LEVEL_AVX2 2
+
+/* A run of characters inside a caller-owned buffer, not NUL terminated */
+typedef struct TextView
+{
+  const char *start;
+  int len;
+} TextView;
+
+/**
+ * @brief Splits a hashtag list such as "#cats#dogs" into views
+ *
+ * The list must start with #, be 2 to MAX_HASHTAG_LEN chars long and contain
+ * at most maxHashtags alphanumeric hashtags separated by single #. Each view
+ * points into input (without the #), so nothing is allocated.
+ *
+ * @param input Hashtag list typed by the user
+ * @param inputLen Length of input
+ * @param hashtags Views of the hashtags found
+ * @param maxHashtags Capacity of hashtags
+ * @param numHashtags Number of views stored in hashtags
+ * @return int VALIDATE_OK, or a VALIDATE_ERR_* code.
+ */
+int split_hashtag_list(const char *input, int inputLen, TextView hashtags[], int maxHashtags, int *numHashtags);
+
+/**
+ * @brief Checks a single hashtag, without its leading #
+ *
+ * @param hashtag Hashtag to check
+ * @param len Length of hashtag
+ * @return int 1 if alphanumeric and 1 to MAX_HASHTAG_LEN - 1 chars long, 0 otherwise.
+ */
+int is_valid_hashtag(const char *hashtag, int len);
+
+/**
+ * @brief Checks a subscription: a hashtag, or a hashtag prefix followed by PREFIX_WILDCARD
+ *
+ * @param subscription Subscription to check, without its leading #
+ * @param len Length of subscription
+ * @return int 1 if a valid hashtag, with or without a trailing PREFIX_WILDCARD; 0 otherwise.
+ */
+int is_valid_subscription(const char *subscription, int len);
+
+/**
+ * @brief Checks a tweet message
+ *
+ * @param text Tweet message
+ * @param len Length of text
+ * @return int 1 if 1 to MAX_TWEET_LEN chars long without control characters, 0 otherwise.
+ */
+int is_valid_tweet_text(const char *text, int len);
+
+/**
+ * @brief Checks a username
+ *
+ * @param username Username to check
+ * @param len Length of username
+ * @return int 1 if 1 to MAX_USERNAME_LEN - 1 chars long without control characters, 0 otherwise.
+ */
+int is_valid_username(const char *username, int len);
+
+/**
+ * @brief Checks whether any two views hold the same characters
+ *
+ * @param views Views to compare
+ * @param numViews Number of views
+ * @return int 1 if duplicates exist; 0 otherwise.
+ */
+int has_duplicate_view(TextView views[], int numViews);
+
+/**
+ * @brief Checks whether a view holds exactly the given string
+ *
+ * @param view View to compare
+ * @param string NUL terminated string
+ * @return int 1 if equal; 0 otherwise.
+ */
+int text_view_equals(TextView view, const char *string);
+
+/**
+ * @brief Copies a view into a NUL terminated buffer
+ *
+ * @param view View to copy
+ * @param buffer Destination, truncated to bufferLen - 1 chars
+ * @param bufferLen Size of buffer
+ * @return char* buffer
+ */
+char *copy_text_view(TextView view, char *buffer, int bufferLen);
+
+/**
+ * @brief Describes a VALIDATE_ERR_* code
+ *
+ * @param errorCode Result of split_hashtag_list()
+ * @return char* Message suitable for persist_with_error().
+ */
+char *validate_error_message(int errorCode);
+
+/**
+ * @brief Selects the instruction set used by the scanners
+ *
+ * The best level supported by the CPU is chosen on first use. Lower levels
+ * can be forced, e.g. to compare implementations.
+ *
+ * @param level SIMD_LEVEL_* to use, capped at what the CPU supports
+ * @return int Level now in use.
+ */
+int set_validate_simd_level(int level);
+
+/**
+ * @brief Returns the instruction set used by the scanners
+ *
+ * @return int SIMD_LEVEL_* in use.
+ */
+int get_validate_simd_level();
+
+/**
+ * @brief Names a SIMD_LEVEL_* value
+ *
+ * @param level SIMD_LEVEL_* value
+ * @return char* "scalar", "sse4.2" or "avx2".
+ */
+char *simd_level_name(int level);
+
+#endif
@@ -0,0 +1,498 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_follow.c
+  * @date 18 October 2026
+  * @brief Follow graph and author logs, shared by all server processes.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  *
+  * Delivery is hybrid. A post by an ordinary author is copied to the queue
+  * of each follower that is logged in, which costs one write per follower
+  * but leaves nothing to do when the followers read. An author with
+  * fanoutThreshold followers would make every post a burst of thousands
+  * of writes, so its posts are appended once to its own log instead, and
+  * each follower merges the logs of the authors it follows when it asks
+  * for its timeline. An author never goes back to fan-out on write, so a
+  * follower never has to look for a post in both places.
+  *
+  * A pull is a k-way merge of the followed logs, newest first. Each log
+  * with anything new is one entry of a binary max-heap keyed by its newest
+  * post not merged yet; taking a post replaces the entry's key with the
+  * log's next older post and sifts it down. Collecting the newest N posts
+  * of k logs costs O(k + N log k), and no post beyond the N is touched.
+  *
+  * Accounts are found by username and edges by (follower, followee)
+  * through chained hash tables, so following, unfollowing and checking a
+  * follow do not depend on how many follows an account has.
+  */
+
+#include "ttweet_follow.h"
+#include <sys/mman.h> /* for mmap() */
+
+/* Function prototypes */
+FollowGraph *follow_graph_create(int maxAccounts, int maxEdges, int fanoutThreshold);                 /* Creates an empty graph */
+void follow_graph_destroy(FollowGraph *graph);                                                        /* Releases a graph */
+int32_t follow_graph_login(FollowGraph *graph, const char *username, int32_t userIdx);                /* Marks an account as logged in */
+void follow_graph_logout(FollowGraph *graph, int32_t account);                                        /* Marks an account as logged out */
+int follow_graph_follow(FollowGraph *graph, int32_t follower, const char *followeeUsername);          /* Adds a follow */
+int follow_graph_unfollow(FollowGraph *graph, int32_t follower, const char *followeeUsername);        /* Removes a follow */
+int follow_graph_is_following(FollowGraph *graph, int32_t follower, int32_t followee);                /* Checks a follow */
+int follow_graph_publish(FollowGraph *graph, int32_t author, const char *ttweetString, const char *hashtag,
+                         void (*visit)(int32_t userIdx, void *arg), void *arg);                       /* Delivers a post */
+int follow_graph_pull(FollowGraph *graph, int32_t account, uint64_t *sinceSeq, FollowPost *posts, int maxPosts); /* Collects posts fanned out on read */
+int follow_graph_pull_oldest(FollowGraph *graph, int32_t account, uint64_t *sinceSeq, FollowPost *posts, int maxPosts); /* Collects the oldest posts fanned out on read */
+uint64_t follow_graph_last_post_seq(FollowGraph *graph);                                              /* Returns the newest post number */
+
+/* A log being merged by follow_graph_pull() or follow_graph_pull_oldest() */
+typedef struct MergeEntry
+{
+  uint64_t seq;     /* Sequence number of posts[postIdx % FOLLOW_LOG_LEN], the heap key; complemented when merging oldest first */
+  uint64_t postIdx; /* Next post of the log to merge */
+  FollowLog *log;
+} MergeEntry;
+
+/* Static helpers */
+static void sift_down(MergeEntry *heap, int numEntries, int entryIdx);
+static size_t graph_size(int maxAccounts, int maxEdges, int accountBucketBits, int edgeBucketBits);
+static int bucket_bits(int numEntries);
+static uint32_t account_bucket(FollowGraph *graph, const char *username);
+static uint32_t edge_bucket(FollowGraph *graph, int32_t follower, int32_t followee);
+static int32_t find_account(FollowGraph *graph, const char *username, int create);
+static int32_t find_edge(FollowGraph *graph, int32_t follower, int32_t followee);
+
+/** \copydoc follow_graph_create */
+FollowGraph *follow_graph_create(int maxAccounts, int maxEdges, int fanoutThreshold)
+{
+  int accountBucketBits = bucket_bits(maxAccounts);
+  int edgeBucketBits = bucket_bits(maxEdges);
+  char *region;
+  FollowGraph *graph;
+
+  region = mmap(NULL, graph_size(maxAccounts, maxEdges, accountBucketBits, edgeBucketBits), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (region == MAP_FAILED)
+    return NULL;
+  graph = (FollowGraph *)region;
+  graph->lock = 0;
+  graph->maxAccounts = maxAccounts;
+  graph->maxEdges = maxEdges;
+  graph->fanoutThreshold = fanoutThreshold;
+  graph->numAccounts = 0;
+  graph->numEdges = 0;
+  graph->numEdgesUsed = 0;
+  graph->numLogs = 0;
+  graph->freeEdges = FOLLOW_NIL;
+  graph->accountBucketBits = accountBucketBits;
+  graph->edgeBucketBits = edgeBucketBits;
+  graph->lastPostSeq = 0;
+  graph->logs = (FollowLog *)(region + sizeof(FollowGraph));
+  graph->accounts = (FollowAccount *)(graph->logs + FOLLOW_MAX_LOGS);
+  graph->edges = (FollowEdge *)(graph->accounts + maxAccounts);
+  graph->accountBuckets = (int32_t *)(graph->edges + maxEdges);
+  graph->edgeBuckets = graph->accountBuckets + (1 << accountBucketBits);
+
+  memset(graph->accountBuckets, 0xff, sizeof(int32_t) << accountBucketBits); /* FOLLOW_NIL */
+  memset(graph->edgeBuckets, 0xff, sizeof(int32_t) << edgeBucketBits);
+  return graph;
+}
+
+/** \copydoc follow_graph_destroy */
+void follow_graph_destroy(FollowGraph *graph)
+{
+  munmap(graph, graph_size(graph->maxAccounts, graph->maxEdges, graph->accountBucketBits, graph->edgeBucketBits));
+}
+
+/** \copydoc follow_graph_login */
+int32_t follow_graph_login(FollowGraph *graph, const char *username, int32_t userIdx)
+{
+  int32_t account;
+
+  spin_lock(&graph->lock);
+  account = find_account(graph, username, 1);
+  if (account != FOLLOW_NIL)
+    graph->accounts[account].userIdx = userIdx;
+  spin_unlock(&graph->lock);
+  return account;
+}
+
+/** \copydoc follow_graph_logout */
+void follow_graph_logout(FollowGraph *graph, int32_t account)
+{
+  spin_lock(&graph->lock);
+  graph->accounts[account].userIdx = FOLLOW_NIL;
+  spin_unlock(&graph->lock);
+}
+
+/** \copydoc follow_graph_follow */
+int follow_graph_follow(FollowGraph *graph, int32_t follower, const char *followeeUsername)
+{
+  FollowAccount *accounts = graph->accounts;
+  FollowEdge *edge;
+  int32_t followee;
+  int32_t edgeIdx;
+  uint32_t bucket;
+
+  spin_lock(&graph->lock);
+  followee = find_account(graph, followeeUsername, 1);
+  if (followee == FOLLOW_NIL)
+  { /* No room for the followee's account */
+    spin_unlock(&graph->lock);
+    return -1;
+  }
+  if (find_edge(graph, follower, followee) != FOLLOW_NIL)
+  {
+    spin_unlock(&graph->lock);
+    return 0;
+  }
+  if (graph->freeEdges != FOLLOW_NIL)
+  {
+    edgeIdx = graph->freeEdges;
+    graph->freeEdges = graph->edges[edgeIdx].hashNext;
+  }
+  else if (graph->numEdgesUsed < graph->maxEdges)
+  {
+    edgeIdx = graph->numEdgesUsed++;
+  }
+  else
+  { /* Full */
+    spin_unlock(&graph->lock);
+    return -1;
+  }
+
+  edge = &graph->edges[edgeIdx];
+  edge->follower = follower;
+  edge->followee = followee;
+  bucket = edge_bucket(graph, follower, followee);
+  edge->hashNext = graph->edgeBuckets[bucket];
+  graph->edgeBuckets[bucket] = edgeIdx;
+  edge->prevFollower = FOLLOW_NIL;
+  edge->nextFollower = accounts[followee].firstFollower;
+  if (edge->nextFollower != FOLLOW_NIL)
+    graph->edges[edge->nextFollower].prevFollower = edgeIdx;
+  accounts[followee].firstFollower = edgeIdx;
+  edge->prevFollowee = FOLLOW_NIL;
+  edge->nextFollowee = accounts[follower].firstFollowee;
+  if (edge->nextFollowee != FOLLOW_NIL)
+    graph->edges[edge->nextFollowee].prevFollowee = edgeIdx;
+  accounts[follower].firstFollowee = edgeIdx;
+  graph->numEdges++;
+
+  if (++accounts[followee].numFollowers == graph->fanoutThreshold && accounts[followee].logIdx == FOLLOW_NIL &&
+      graph->numLogs < FOLLOW_MAX_LOGS)
+  { /* Posts made from now on wait in the log; earlier ones were already copied */
+    accounts[followee].logIdx = graph->numLogs++;
+    graph->logs[accounts[followee].logIdx].numPosts = 0;
+  }
+  spin_unlock(&graph->lock);
+  return 1;
+}
+
+/** \copydoc follow_graph_unfollow */
+int follow_graph_unfollow(FollowGraph *graph, int32_t follower, const char *followeeUsername)
+{
+  FollowAccount *accounts = graph->accounts;
+  FollowEdge *edges = graph->edges;
+  int32_t followee;
+  int32_t edgeIdx;
+  int32_t *link;
+
+  spin_lock(&graph->lock);
+  followee = find_account(graph, followeeUsername, 0);
+  edgeIdx = followee == FOLLOW_NIL ? FOLLOW_NIL : find_edge(graph, follower, followee);
+  if (edgeIdx == FOLLOW_NIL)
+  {
+    spin_unlock(&graph->lock);
+    return 0;
+  }
+
+  for (link = &graph->edgeBuckets[edge_bucket(graph, follower, followee)]; *link != edgeIdx; link = &edges[*link].hashNext)
+    ;
+  *link = edges[edgeIdx].hashNext;
+  if (edges[edgeIdx].prevFollower != FOLLOW_NIL)
+    edges[edges[edgeIdx].prevFollower].nextFollower = edges[edgeIdx].nextFollower;
+  else
+    accounts[followee].firstFollower = edges[edgeIdx].nextFollower;
+  if (edges[edgeIdx].nextFollower != FOLLOW_NIL)
+    edges[edges[edgeIdx].nextFollower].prevFollower = edges[edgeIdx].prevFollower;
+  if (edges[edgeIdx].prevFollowee != FOLLOW_NIL)
+    edges[edges[edgeIdx].prevFollowee].nextFollowee = edges[edgeIdx].nextFollowee;
+  else
+    accounts[follower].firstFollowee = edges[edgeIdx].nextFollowee;
+  if (edges[edgeIdx].nextFollowee != FOLLOW_NIL)
+    edges[edges[edgeIdx].nextFollowee].prevFollowee = edges[edgeIdx].prevFollowee;
+
+  edges[edgeIdx].hashNext = graph->freeEdges;
+  graph->freeEdges = edgeIdx;
+  graph->numEdges--;
+  accounts[followee].numFollowers--;
+  spin_unlock(&graph->lock);
+  return 1;
+}
+
+/** \copydoc follow_graph_is_following */
+int follow_graph_is_following(FollowGraph *graph, int32_t follower, int32_t followee)
+{
+  int isFollowing;
+
+  if (follower == FOLLOW_NIL || followee == FOLLOW_NIL)
+    return 0;
+  spin_lock(&graph->lock);
+  isFollowing = find_edge(graph, follower, followee) != FOLLOW_NIL;
+  spin_unlock(&graph->lock);
+  return isFollowing;
+}
+
+/** \copydoc follow_graph_publish */
+int follow_graph_publish(FollowGraph *graph, int32_t author, const char *ttweetString, const char *hashtag,
+                         void (*visit)(int32_t userIdx, void *arg), void *arg)
+{
+  FollowAccount *accounts = graph->accounts;
+  FollowLog *log;
+  FollowPost *post;
+  int numVisited = 0;
+
+  spin_lock(&graph->lock);
+  if (accounts[author].logIdx != FOLLOW_NIL)
+  { /* One write, however many follow */
+    log = &graph->logs[accounts[author].logIdx];
+    post = &log->posts[log->numPosts++ % FOLLOW_LOG_LEN];
+    post->seq = ++graph->lastPostSeq;
+    strcpy(post->username, accounts[author].username);
+    strcpy(post->ttweetString, ttweetString);
+    strcpy(post->hashtag, hashtag);
+    spin_unlock(&graph->lock);
+    return FOLLOW_ON_READ;
+  }
+
+  for (int32_t edgeIdx = accounts[author].firstFollower; edgeIdx != FOLLOW_NIL; edgeIdx = graph->edges[edgeIdx].nextFollower)
+  {
+    if (accounts[graph->edges[edgeIdx].follower].userIdx != FOLLOW_NIL)
+    {
+      visit(accounts[graph->edges[edgeIdx].follower].userIdx, arg);
+      numVisited++;
+    }
+  }
+  spin_unlock(&graph->lock);
+  return numVisited;
+}
+
+/** \copydoc follow_graph_pull */
+int follow_graph_pull(FollowGraph *graph, int32_t account, uint64_t *sinceSeq, FollowPost *posts, int maxPosts)
+{
+  MergeEntry heap[FOLLOW_MAX_LOGS]; /* heap[0] holds the newest post not merged yet */
+  MergeEntry *top = &heap[0];
+  int numEntries = 0;
+  int numPosts = 0;
+  int32_t logIdx;
+  FollowLog *log;
+
+  spin_lock(&graph->lock);
+  for (int32_t edgeIdx = graph->accounts[account].firstFollowee; edgeIdx != FOLLOW_NIL; edgeIdx = graph->edges[edgeIdx].nextFollowee)
+  { /* Only authors fanned out on read with posts after *sinceSeq have anything to merge */
+    logIdx = graph->accounts[graph->edges[edgeIdx].followee].logIdx;
+    if (logIdx == FOLLOW_NIL)
+      continue;
+    log = &graph->logs[logIdx];
+    if (log->numPosts == 0 || log->posts[(log->numPosts - 1) % FOLLOW_LOG_LEN].seq <= *sinceSeq)
+      continue;
+    heap[numEntries].postIdx = log->numPosts - 1;
+    heap[numEntries].seq = log->posts[heap[numEntries].postIdx % FOLLOW_LOG_LEN].seq;
+    heap[numEntries].log = log;
+    numEntries++;
+  }
+  for (int entryIdx = numEntries / 2 - 1; entryIdx >= 0; entryIdx--)
+    sift_down(heap, numEntries, entryIdx);
+
+  while (numPosts < maxPosts && numEntries > 0)
+  { /* Newest first, so only the posts that are kept are copied */
+    posts[maxPosts - 1 - numPosts++] = top->log->posts[top->postIdx % FOLLOW_LOG_LEN];
+    if (top->postIdx > 0 && top->postIdx + FOLLOW_LOG_LEN > top->log->numPosts &&
+        top->log->posts[(top->postIdx - 1) % FOLLOW_LOG_LEN].seq > *sinceSeq)
+    { /* The log's next older post takes its place */
+      top->postIdx--;
+      top->seq = top->log->posts[top->postIdx % FOLLOW_LOG_LEN].seq;
+    }
+    else
+    { /* Nothing older is left in the ring, or it was collected before */
+      *top = heap[--numEntries];
+    }
+    sift_down(heap, numEntries, 0);
+  }
+  *sinceSeq = graph->lastPostSeq;
+  spin_unlock(&graph->lock);
+
+  memmove(posts, posts + maxPosts - numPosts, sizeof(FollowPost) * numPosts); /* Oldest first */
+  return numPosts;
+}
+
+/** \copydoc follow_graph_pull_oldest */
+int follow_graph_pull_oldest(FollowGraph *graph, int32_t account, uint64_t *sinceSeq, FollowPost *posts, int maxPosts)
+{
+  MergeEntry heap[FOLLOW_MAX_LOGS]; /* heap[0] holds the oldest post not merged yet */
+  MergeEntry *top = &heap[0];
+  int numEntries = 0;
+  int numPosts = 0;
+  uint64_t lowIdx;
+  uint64_t highIdx;
+  uint64_t midIdx;
+  int32_t logIdx;
+  FollowLog *log;
+
+  spin_lock(&graph->lock);
+  for (int32_t edgeIdx = graph->accounts[account].firstFollowee; edgeIdx != FOLLOW_NIL; edgeIdx = graph->edges[edgeIdx].nextFollowee)
+  {
+    logIdx = graph->accounts[graph->edges[edgeIdx].followee].logIdx;
+    if (logIdx == FOLLOW_NIL)
+      continue;
+    log = &graph->logs[logIdx];
+    if (log->numPosts == 0 || log->posts[(log->numPosts - 1) % FOLLOW_LOG_LEN].seq <= *sinceSeq)
+      continue;
+    lowIdx = log->numPosts > FOLLOW_LOG_LEN ? log->numPosts - FOLLOW_LOG_LEN : 0;
+    highIdx = log->numPosts - 1;
+    while (lowIdx < highIdx)
+    { /* The oldest post in the ring after *sinceSeq */
+      midIdx = lowIdx + (highIdx - lowIdx) / 2;
+      if (log->posts[midIdx % FOLLOW_LOG_LEN].seq > *sinceSeq)
+        highIdx = midIdx;
+      else
+        lowIdx = midIdx + 1;
+    }
+    heap[numEntries].postIdx = lowIdx;
+    heap[numEntries].seq = ~log->posts[lowIdx % FOLLOW_LOG_LEN].seq;
+    heap[numEntries].log = log;
+    numEntries++;
+  }
+  for (int entryIdx = numEntries / 2 - 1; entryIdx >= 0; entryIdx--)
+    sift_down(heap, numEntries, entryIdx);
+
+  while (numPosts < maxPosts && numEntries > 0)
+  {
+    posts[numPosts++] = top->log->posts[top->postIdx % FOLLOW_LOG_LEN];
+    if (top->postIdx + 1 < top->log->numPosts)
+    { /* The log's next newer post takes its place */
+      top->postIdx++;
+      top->seq = ~top->log->posts[top->postIdx % FOLLOW_LOG_LEN].seq;
+    }
+    else
+    {
+      *top = heap[--numEntries];
+    }
+    sift_down(heap, numEntries, 0);
+  }
+  /* Posts are merged in the order they were made, so every one up to the last copied was collected */
+  *sinceSeq = numEntries > 0 ? posts[numPosts - 1].seq : graph->lastPostSeq;
+  spin_unlock(&graph->lock);
+  return numPosts;
+}
+
+/** \copydoc follow_graph_last_post_seq */
+uint64_t follow_graph_last_post_seq(FollowGraph *graph)
+{
+  uint64_t lastPostSeq;
+
+  spin_lock(&graph->lock);
+  lastPostSeq = graph->lastPostSeq;
+  spin_unlock(&graph->lock);
+  return lastPostSeq;
+}
+
+/* Moves heap[entryIdx] down until neither child has a larger key, a newer post unless complemented */
+static void sift_down(MergeEntry *heap, int numEntries, int entryIdx)
+{
+  MergeEntry entry = heap[entryIdx];
+  int childIdx;
+
+  while ((childIdx = 2 * entryIdx + 1) < numEntries)
+  {
+    if (childIdx + 1 < numEntries && heap[childIdx + 1].seq > heap[childIdx].seq)
+      childIdx++;
+    if (heap[childIdx].seq <= entry.seq)
+      break;
+    heap[entryIdx] = heap[childIdx];
+    entryIdx = childIdx;
+  }
+  heap[entryIdx] = entry;
+}
+
+static size_t graph_size(int maxAccounts, int maxEdges, int accountBucketBits, int edgeBucketBits)
+{
+  return sizeof(FollowGraph) + sizeof(FollowLog) * FOLLOW_MAX_LOGS + sizeof(FollowAccount) * maxAccounts +
+         sizeof(FollowEdge) * maxEdges + (sizeof(int32_t) << accountBucketBits) + (sizeof(int32_t) << edgeBucketBits);
+}
+
+/* Smallest power of two holding numEntries, as a number of bits */
+static int bucket_bits(int numEntries)
+{
+  int bits = 1;
+
+  while ((1 << bits) < numEntries)
+    bits++;
+  return bits;
+}
+
+/* FNV-1a of the username, its high bits picked multiplicatively */
+static uint32_t account_bucket(FollowGraph *graph, const char *username)
+{
+  uint32_t hash = 2166136261u;
+
+  while (*username)
+  {
+    hash ^= (unsigned char)*username++;
+    hash *= 16777619u;
+  }
+  return (hash * 2654435761u) >> (32 - graph->accountBucketBits);
+}
+
+static uint32_t edge_bucket(FollowGraph *graph, int32_t follower, int32_t followee)
+{
+  return (((uint32_t)follower * 2654435761u) ^ ((uint32_t)followee * 2246822519u)) * 2654435761u >> (32 - graph->edgeBucketBits);
+}
+
+/* Account of a username; with create, a new account if there is none and room for one */
+static int32_t find_account(FollowGraph *graph, const char *username, int create)
+{
+  uint32_t bucket = account_bucket(graph, username);
+  FollowAccount *account;
+  int32_t accountIdx;
+
+  for (accountIdx = graph->accountBuckets[bucket]; accountIdx != FOLLOW_NIL; accountIdx = graph->accounts[accountIdx].hashNext)
+  {
+    if (strcmp(graph->accounts[accountIdx].username, username) == 0)
+      return accountIdx;
+  }
+  if (!create || graph->numAccounts == graph->maxAccounts)
+    return FOLLOW_NIL;
+
+  accountIdx = graph->numAccounts++;
+  account = &graph->accounts[accountIdx];
+  account->hashNext = graph->accountBuckets[bucket];
+  account->firstFollower = FOLLOW_NIL;
+  account->firstFollowee = FOLLOW_NIL;
+  account->numFollowers = 0;
+  account->userIdx = FOLLOW_NIL;
+  account->logIdx = FOLLOW_NIL;
+  strcpy(account->username, username);
+  graph->accountBuckets[bucket] = accountIdx;
+  return accountIdx;
+}
+
+static int32_t find_edge(FollowGraph *graph, int32_t follower, int32_t followee)
+{
+  int32_t edgeIdx;
+
+  for (edgeIdx = graph->edgeBuckets[edge_bucket(graph, follower, followee)]; edgeIdx != FOLLOW_NIL; edgeIdx = graph->edges[edgeIdx].hashNext)
+  {
+    if (graph->edges[edgeIdx].follower == follower && graph->edges[edgeIdx].followee == followee)
+      break;
+  }
+  return edgeIdx;
+}
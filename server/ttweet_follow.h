@@ -0,0 +1,256 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_follow.h
+  * @date 18 October 2026
+  * @brief Documentation for functions in ttweet_follow.c.
+  *
+  * This header file has been created to describe the functions
+  * and declare constants in ttweet_follow.c.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  */
+
+#ifndef TTWEET_COMMON_H
+#define TTWEET_COMMON_H
+#include "../dependencies/ttweet_common.h"
+void die_with_error(char *errorMessage);
+int persist_with_error(char *errorMessage);
+int send_payload(int sock, cJSON *jobjToSend);
+int receive_response(int sock, char *objReceived);
+void spin_lock(int *lock);
+void spin_unlock(int *lock);
+#endif
+
+#ifndef TTWEET_FOLLOW_H
+#define TTWEET_FOLLOW_H
+
+#include <stdint.h>
+
+#define FOLLOW_NIL -1        /* No account, edge or log */
+#define FOLLOW_ON_READ -1    /* follow_graph_publish(): the post went to the author's log */
+#define FOLLOW_LOG_LEN 64    /* Newest posts kept per author fanned out on read */
+#define FOLLOW_MAX_LOGS 1024 /* Authors fanned out on read at once */
+
+/* A username that has logged in or been followed. Accounts outlive the
+ * sessions of their users, so follows survive logging out. */
+typedef struct FollowAccount
+{
+  int32_t hashNext;      /* Next account in the same bucket */
+  int32_t firstFollower; /* Edge of the newest follower, FOLLOW_NIL if none */
+  int32_t firstFollowee; /* Edge of the newest account followed, FOLLOW_NIL if none */
+  int32_t numFollowers;
+  int32_t userIdx;       /* Index in activeUsers while logged in, FOLLOW_NIL otherwise */
+  int32_t logIdx;        /* Log of posts fanned out on read, FOLLOW_NIL while fanned out on write */
+  char username[MAX_USERNAME_LEN];
+} FollowAccount;
+
+/* One account following another. Each edge is on the follower list of the
+ * followee and the followee list of the follower, both doubly linked so
+ * unfollowing is constant time, and on a hash chain keyed by the pair. */
+typedef struct FollowEdge
+{
+  int32_t follower;
+  int32_t followee;
+  int32_t hashNext;     /* Next edge in the same bucket; links the free list */
+  int32_t nextFollower; /* Neighbours among the followers of followee */
+  int32_t prevFollower;
+  int32_t nextFollowee; /* Neighbours among the accounts follower follows */
+  int32_t prevFollowee;
+} FollowEdge;
+
+typedef struct FollowPost
+{
+  uint64_t seq; /* Posts of all logs are numbered in the order they were made */
+  char username[MAX_USERNAME_LEN];
+  char ttweetString[MAX_TWEET_LEN + 1];
+  char hashtag[MAX_HASHTAG_LEN]; /* First hashtag of the tweet */
+} FollowPost;
+
+/* Ring of the newest posts of an author fanned out on read */
+typedef struct FollowLog
+{
+  uint64_t numPosts; /* Posts ever added; post i is at posts[i % FOLLOW_LOG_LEN] */
+  FollowPost posts[FOLLOW_LOG_LEN];
+} FollowLog;
+
+/* Fixed capacity follow graph in shared memory. Links are array indices,
+ * so it works the same in every process that inherits the mapping. */
+typedef struct FollowGraph
+{
+  int lock; /* Spinlock held by every operation */
+  int maxAccounts;
+  int maxEdges;
+  int fanoutThreshold; /* Followers at which an author is fanned out on read, 0 for never */
+  int numAccounts;
+  int numEdges;
+  int numEdgesUsed; /* Edges ever allocated; the rest of the pool is untouched */
+  int numLogs;
+  int32_t freeEdges;
+  int accountBucketBits; /* 2^bits buckets, at least one per account */
+  int edgeBucketBits;    /* 2^bits buckets, at least one per edge */
+  uint64_t lastPostSeq;
+  int32_t *accountBuckets;
+  int32_t *edgeBuckets;
+  FollowAccount *accounts;
+  FollowEdge *edges;
+  FollowLog *logs;
+} FollowGraph;
+
+/**
+ * @brief Creates an empty follow graph in shared memory
+ *
+ * Call before fork() so that every child sees the same graph. Pages of the
+ * pools are only touched once accounts and follows need them.
+ *
+ * @param maxAccounts Most usernames known at once
+ * @param maxEdges Most follows at once, over all accounts
+ * @param fanoutThreshold Followers at which an author's posts stop being copied to each follower, 0 for never
+ * @return FollowGraph* The graph, or NULL if mmap() failed.
+ */
+FollowGraph *follow_graph_create(int maxAccounts, int maxEdges, int fanoutThreshold);
+
+/**
+ * @brief Releases a graph from follow_graph_create()
+ *
+ * @param graph Graph to release
+ * @return void
+ */
+void follow_graph_destroy(FollowGraph *graph);
+
+/**
+ * @brief Marks the account of a username as logged in
+ *
+ * The account is created if the username has never logged in or been
+ * followed.
+ *
+ * @param graph Graph of the account
+ * @param username Username that logged in
+ * @param userIdx Index of the user in activeUsers
+ * @return int32_t The account; FOLLOW_NIL if there is no room for it.
+ */
+int32_t follow_graph_login(FollowGraph *graph, const char *username, int32_t userIdx);
+
+/**
+ * @brief Marks an account as logged out
+ *
+ * Its follows are kept for the next time the username logs in.
+ *
+ * @param graph Graph of the account
+ * @param account Account from follow_graph_login()
+ * @return void
+ */
+void follow_graph_logout(FollowGraph *graph, int32_t account);
+
+/**
+ * @brief Makes an account follow a username
+ *
+ * The followee's account is created if needed. An author reaching
+ * fanoutThreshold followers is given a log and fanned out on read from
+ * then on, as long as fewer than FOLLOW_MAX_LOGS authors already are.
+ *
+ * @param graph Graph of the accounts
+ * @param follower Account from follow_graph_login()
+ * @param followeeUsername Username to follow, not that of follower
+ * @return int 1 if followed; 0 if already following; -1 if the graph is full.
+ */
+int follow_graph_follow(FollowGraph *graph, int32_t follower, const char *followeeUsername);
+
+/**
+ * @brief Makes an account stop following a username
+ *
+ * @param graph Graph of the accounts
+ * @param follower Account from follow_graph_login()
+ * @param followeeUsername Username to stop following
+ * @return int 1 if unfollowed; 0 if not following.
+ */
+int follow_graph_unfollow(FollowGraph *graph, int32_t follower, const char *followeeUsername);
+
+/**
+ * @brief Checks whether one account follows another
+ *
+ * @param graph Graph of the accounts
+ * @param follower Account that may follow
+ * @param followee Account that may be followed
+ * @return int 1 if follower follows followee; 0 otherwise.
+ */
+int follow_graph_is_following(FollowGraph *graph, int32_t follower, int32_t followee);
+
+/**
+ * @brief Delivers a post of an author to its followers
+ *
+ * An author below fanoutThreshold is fanned out on write: visit is called
+ * with the activeUsers index of each logged in follower, and the caller
+ * queues the tweet for them. An author with a log is fanned out on read:
+ * the post is added to the log, no follower is visited, and followers
+ * collect it with follow_graph_pull(). The graph is locked while visit
+ * runs, so visit must not call back into it.
+ *
+ * @param graph Graph of the author
+ * @param author Account of the author
+ * @param ttweetString Tweet text
+ * @param hashtag First hashtag of the tweet
+ * @param visit Called once per logged in follower, with arg
+ * @param arg Passed to visit
+ * @return int Number of followers visited; FOLLOW_ON_READ if the post went to the author's log.
+ */
+int follow_graph_publish(FollowGraph *graph, int32_t author, const char *ttweetString, const char *hashtag,
+                         void (*visit)(int32_t userIdx, void *arg), void *arg);
+
+/**
+ * @brief Collects the posts of authors fanned out on read
+ *
+ * Merges the logs of the authors the account follows into the newest
+ * maxPosts posts made after *sinceSeq, oldest first, so the caller can
+ * queue them as if they had been fanned out on write. The logs are merged
+ * through a heap, newest first, so older posts past maxPosts are never
+ * read.
+ *
+ * @param graph Graph of the account
+ * @param account Account of the reader
+ * @param sinceSeq Newest post already collected; advanced past every post made so far
+ * @param posts Array receiving the posts
+ * @param maxPosts Size of posts
+ * @return int Number of posts copied to posts.
+ */
+int follow_graph_pull(FollowGraph *graph, int32_t account, uint64_t *sinceSeq, FollowPost *posts, int maxPosts);
+
+/**
+ * @brief Collects the oldest posts of authors fanned out on read
+ *
+ * Like follow_graph_pull(), but keeps the oldest maxPosts posts made after
+ * *sinceSeq and advances it only past those, so a caller whose queue has
+ * room for every post calls again until fewer than maxPosts come back.
+ * Each log is searched for its oldest post after *sinceSeq and merged from
+ * there through a heap, oldest first.
+ *
+ * @param graph Graph of the account
+ * @param account Account of the reader
+ * @param sinceSeq Newest post already collected; advanced to the newest post copied, or past every post made so far once none is left
+ * @param posts Array receiving the posts, oldest first
+ * @param maxPosts Size of posts, at least 1
+ * @return int Number of posts copied to posts.
+ */
+int follow_graph_pull_oldest(FollowGraph *graph, int32_t account, uint64_t *sinceSeq, FollowPost *posts, int maxPosts);
+
+/**
+ * @brief Returns the number of the newest post of any log
+ *
+ * A user logging in starts collecting after it, as tweets made while it
+ * was logged out are not delivered either.
+ *
+ * @param graph Graph to check
+ * @return uint64_t Sequence number, 0 before the first post.
+ */
+uint64_t follow_graph_last_post_seq(FollowGraph *graph);
+
+#endif
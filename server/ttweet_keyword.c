@@ -0,0 +1,348 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_keyword.c
+  * @date 18 October 2026
+  * @brief Aho-Corasick automaton of keyword subscriptions, shared by all server processes.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  *
+  * Keywords are stored in a trie of single characters. Each node's fail
+  * link points at the node of the longest proper suffix of its path, so a
+  * scan that cannot extend the current match falls back along fail links
+  * instead of restarting, and reads every character of the text once.
+  * dictLink skips straight to the next shorter keyword ending at the same
+  * character. Keywords only hold letters and digits, so any other
+  * character resets the scan to the root.
+  *
+  * Inserting or removing a keyword only touches its own path; the fail
+  * links of the whole trie are recomputed in one breadth first pass by the
+  * first scan after a change.
+  */
+
+#include "ttweet_keyword.h"
+#include <ctype.h>    /* for isalnum() and tolower() */
+#include <sys/mman.h> /* for mmap() */
+
+/* Function prototypes */
+KeywordMatcher *keyword_matcher_create(int maxValues, int maxKeywordLen);                                                   /* Creates an empty matcher */
+void keyword_matcher_destroy(KeywordMatcher *matcher);                                                                       /* Releases a matcher */
+int keyword_matcher_insert(KeywordMatcher *matcher, const char *keyword, int len, int32_t value);                           /* Stores a value under a keyword */
+int keyword_matcher_remove(KeywordMatcher *matcher, const char *keyword, int len, int32_t value);                           /* Removes a value from a keyword */
+int keyword_matcher_scan(KeywordMatcher *matcher, const char *text, int len, void (*visit)(int32_t value, void *arg), void *arg); /* Visits keywords in a text */
+int keyword_matcher_is_empty(KeywordMatcher *matcher);                                                                       /* Checks for values */
+
+/* Static helpers */
+static size_t matcher_size(int maxValues, int maxNodes);
+static int fold_char(char c);
+static int is_valid_keyword(KeywordMatcher *matcher, const char *keyword, int len);
+static int32_t alloc_node(KeywordMatcher *matcher, char c);
+static void free_node(KeywordMatcher *matcher, int32_t nodeIdx);
+static int32_t find_child(KeywordMatcher *matcher, int32_t nodeIdx, int c);
+static void compute_fail_links(KeywordMatcher *matcher);
+
+/** \copydoc keyword_matcher_create */
+KeywordMatcher *keyword_matcher_create(int maxValues, int maxKeywordLen)
+{
+  int maxNodes = maxValues * maxKeywordLen + 1; /* Every keyword on its own path, plus the root */
+  char *region;
+  KeywordMatcher *matcher;
+
+  region = mmap(NULL, matcher_size(maxValues, maxNodes), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (region == MAP_FAILED)
+    return NULL;
+  matcher = (KeywordMatcher *)region;
+  matcher->lock = 0;
+  matcher->isDirty = 0;
+  matcher->numValues = 0;
+  matcher->maxValues = maxValues;
+  matcher->maxKeywordLen = maxKeywordLen;
+  matcher->maxNodes = maxNodes;
+  matcher->numNodesUsed = 1;
+  matcher->numValuesUsed = 0;
+  matcher->freeNodes = KEYWORD_NIL;
+  matcher->freeValues = KEYWORD_NIL;
+  matcher->nodes = (KeywordNode *)(region + sizeof(KeywordMatcher));
+  matcher->values = (KeywordValue *)(matcher->nodes + maxNodes);
+  matcher->queue = (int32_t *)(matcher->values + maxValues);
+
+  matcher->nodes[0].firstChild = KEYWORD_NIL;
+  matcher->nodes[0].nextSibling = KEYWORD_NIL;
+  matcher->nodes[0].fail = 0;
+  matcher->nodes[0].dictLink = KEYWORD_NIL;
+  matcher->nodes[0].firstValue = KEYWORD_NIL;
+  matcher->nodes[0].numKeys = 0;
+  matcher->nodes[0].childMask = 0;
+  return matcher;
+}
+
+/** \copydoc keyword_matcher_destroy */
+void keyword_matcher_destroy(KeywordMatcher *matcher)
+{
+  munmap(matcher, matcher_size(matcher->maxValues, matcher->maxNodes));
+}
+
+/** \copydoc keyword_matcher_insert */
+int keyword_matcher_insert(KeywordMatcher *matcher, const char *keyword, int len, int32_t value)
+{
+  KeywordNode *nodes = matcher->nodes;
+  int32_t nodeIdx = 0;
+  int32_t child;
+  int32_t valueIdx;
+
+  if (!is_valid_keyword(matcher, keyword, len))
+    return 0;
+  spin_lock(&matcher->lock);
+  if (matcher->freeValues != KEYWORD_NIL)
+  {
+    valueIdx = matcher->freeValues;
+    matcher->freeValues = matcher->values[valueIdx].next;
+  }
+  else if (matcher->numValuesUsed < matcher->maxValues)
+  {
+    valueIdx = matcher->numValuesUsed++;
+  }
+  else
+  { /* Full */
+    spin_unlock(&matcher->lock);
+    return 0;
+  }
+
+  /* Nodes cannot run out: each stored value holds at most maxKeywordLen of them */
+  nodes[0].numKeys++;
+  for (int charIdx = 0; charIdx < len; charIdx++)
+  {
+    child = find_child(matcher, nodeIdx, fold_char(keyword[charIdx]));
+    if (child == KEYWORD_NIL)
+    {
+      child = alloc_node(matcher, fold_char(keyword[charIdx]));
+      nodes[child].nextSibling = nodes[nodeIdx].firstChild;
+      nodes[nodeIdx].firstChild = child;
+      nodes[nodeIdx].childMask |= 1ULL << KEYWORD_CHAR_BIT(nodes[child].c);
+    }
+    nodeIdx = child;
+    nodes[nodeIdx].numKeys++;
+  }
+
+  matcher->values[valueIdx].value = value;
+  matcher->values[valueIdx].next = nodes[nodeIdx].firstValue;
+  nodes[nodeIdx].firstValue = valueIdx;
+  matcher->isDirty = 1;
+  __atomic_store_n(&matcher->numValues, matcher->numValues + 1, __ATOMIC_RELEASE);
+  spin_unlock(&matcher->lock);
+  return 1;
+}
+
+/** \copydoc keyword_matcher_remove */
+int keyword_matcher_remove(KeywordMatcher *matcher, const char *keyword, int len, int32_t value)
+{
+  KeywordNode *nodes = matcher->nodes;
+  int32_t nodeIdx = 0;
+  int32_t *valueLink;
+  int32_t *childLink;
+  int32_t child;
+  int32_t next;
+  int32_t valueIdx;
+
+  if (!is_valid_keyword(matcher, keyword, len))
+    return 0;
+  spin_lock(&matcher->lock);
+  for (int charIdx = 0; charIdx < len && nodeIdx != KEYWORD_NIL; charIdx++)
+    nodeIdx = find_child(matcher, nodeIdx, fold_char(keyword[charIdx]));
+  if (nodeIdx == KEYWORD_NIL)
+  { /* Keyword was never inserted */
+    spin_unlock(&matcher->lock);
+    return 0;
+  }
+  valueLink = &nodes[nodeIdx].firstValue;
+  while (*valueLink != KEYWORD_NIL && matcher->values[*valueLink].value != value)
+    valueLink = &matcher->values[*valueLink].next;
+  if (*valueLink == KEYWORD_NIL)
+  {
+    spin_unlock(&matcher->lock);
+    return 0;
+  }
+  valueIdx = *valueLink;
+  *valueLink = matcher->values[valueIdx].next;
+  matcher->values[valueIdx].next = matcher->freeValues;
+  matcher->freeValues = valueIdx;
+
+  /* Walk the path again, dropping the first node no other keyword uses */
+  nodeIdx = 0;
+  nodes[0].numKeys--;
+  for (int charIdx = 0; charIdx < len; charIdx++)
+  {
+    childLink = &nodes[nodeIdx].firstChild;
+    while (nodes[*childLink].c != fold_char(keyword[charIdx]))
+      childLink = &nodes[*childLink].nextSibling;
+    child = *childLink;
+    if (--nodes[child].numKeys == 0)
+    { /* Only this keyword passed through, so below is a single chain */
+      *childLink = nodes[child].nextSibling;
+      nodes[nodeIdx].childMask &= ~(1ULL << KEYWORD_CHAR_BIT(nodes[child].c));
+      for (; child != KEYWORD_NIL; child = next)
+      {
+        next = nodes[child].firstChild;
+        free_node(matcher, child);
+      }
+      break;
+    }
+    nodeIdx = child;
+  }
+  matcher->isDirty = 1;
+  __atomic_store_n(&matcher->numValues, matcher->numValues - 1, __ATOMIC_RELEASE);
+  spin_unlock(&matcher->lock);
+  return 1;
+}
+
+/** \copydoc keyword_matcher_scan */
+int keyword_matcher_scan(KeywordMatcher *matcher, const char *text, int len, void (*visit)(int32_t value, void *arg), void *arg)
+{
+  KeywordNode *nodes = matcher->nodes;
+  int32_t state = 0;
+  int32_t next;
+  int numVisits = 0;
+  int c;
+
+  spin_lock(&matcher->lock);
+  if (matcher->isDirty)
+  {
+    compute_fail_links(matcher);
+    matcher->isDirty = 0;
+  }
+  for (int charIdx = 0; charIdx < len; charIdx++)
+  {
+    if ((c = fold_char(text[charIdx])) < 0)
+    { /* No keyword spans this character */
+      state = 0;
+      continue;
+    }
+    while ((next = find_child(matcher, state, c)) == KEYWORD_NIL && state != 0)
+      state = nodes[state].fail;
+    state = next == KEYWORD_NIL ? 0 : next;
+
+    for (int32_t output = nodes[state].firstValue != KEYWORD_NIL ? state : nodes[state].dictLink; output != KEYWORD_NIL;
+         output = nodes[output].dictLink)
+    { /* Every keyword ending here, longest first */
+      for (int32_t valueIdx = nodes[output].firstValue; valueIdx != KEYWORD_NIL; valueIdx = matcher->values[valueIdx].next)
+      {
+        visit(matcher->values[valueIdx].value, arg);
+        numVisits++;
+      }
+    }
+  }
+  spin_unlock(&matcher->lock);
+  return numVisits;
+}
+
+/** \copydoc keyword_matcher_is_empty */
+int keyword_matcher_is_empty(KeywordMatcher *matcher)
+{
+  return __atomic_load_n(&matcher->numValues, __ATOMIC_ACQUIRE) == 0;
+}
+
+static size_t matcher_size(int maxValues, int maxNodes)
+{
+  return sizeof(KeywordMatcher) + (sizeof(KeywordNode) + sizeof(int32_t)) * maxNodes + sizeof(KeywordValue) * maxValues;
+}
+
+/* Lower case form of a letter or digit, -1 for anything else */
+static int fold_char(char c)
+{
+  return isalnum((unsigned char)c) ? tolower((unsigned char)c) : -1;
+}
+
+static int is_valid_keyword(KeywordMatcher *matcher, const char *keyword, int len)
+{
+  if (len < 1 || len > matcher->maxKeywordLen)
+    return 0;
+  for (int charIdx = 0; charIdx < len; charIdx++)
+  {
+    if (fold_char(keyword[charIdx]) < 0)
+      return 0;
+  }
+  return 1;
+}
+
+static int32_t alloc_node(KeywordMatcher *matcher, char c)
+{
+  int32_t nodeIdx;
+
+  if (matcher->freeNodes != KEYWORD_NIL)
+  {
+    nodeIdx = matcher->freeNodes;
+    matcher->freeNodes = matcher->nodes[nodeIdx].nextSibling;
+  }
+  else
+  {
+    nodeIdx = matcher->numNodesUsed++;
+  }
+  matcher->nodes[nodeIdx].firstChild = KEYWORD_NIL;
+  matcher->nodes[nodeIdx].nextSibling = KEYWORD_NIL;
+  matcher->nodes[nodeIdx].fail = 0;
+  matcher->nodes[nodeIdx].dictLink = KEYWORD_NIL;
+  matcher->nodes[nodeIdx].firstValue = KEYWORD_NIL;
+  matcher->nodes[nodeIdx].numKeys = 0;
+  matcher->nodes[nodeIdx].childMask = 0;
+  matcher->nodes[nodeIdx].c = c;
+  return nodeIdx;
+}
+
+static void free_node(KeywordMatcher *matcher, int32_t nodeIdx)
+{
+  matcher->nodes[nodeIdx].nextSibling = matcher->freeNodes;
+  matcher->freeNodes = nodeIdx;
+}
+
+static int32_t find_child(KeywordMatcher *matcher, int32_t nodeIdx, int c)
+{
+  int32_t child = matcher->nodes[nodeIdx].firstChild;
+
+  if (!(matcher->nodes[nodeIdx].childMask >> KEYWORD_CHAR_BIT(c) & 1))
+    return KEYWORD_NIL;
+  while (child != KEYWORD_NIL && matcher->nodes[child].c != c)
+    child = matcher->nodes[child].nextSibling;
+  return child;
+}
+
+/* Parents come before children in breadth first order, and a fail link
+ * always points at a shallower node, so each node's link can be derived
+ * from its parent's */
+static void compute_fail_links(KeywordMatcher *matcher)
+{
+  KeywordNode *nodes = matcher->nodes;
+  int32_t *queue = matcher->queue;
+  int head = 0;
+  int tail = 0;
+  int32_t fail;
+  int32_t target;
+
+  for (int32_t child = nodes[0].firstChild; child != KEYWORD_NIL; child = nodes[child].nextSibling)
+  { /* Single characters fall back to the root */
+    nodes[child].fail = 0;
+    nodes[child].dictLink = KEYWORD_NIL;
+    queue[tail++] = child;
+  }
+  while (head < tail)
+  {
+    int32_t nodeIdx = queue[head++];
+    for (int32_t child = nodes[nodeIdx].firstChild; child != KEYWORD_NIL; child = nodes[child].nextSibling)
+    {
+      fail = nodes[nodeIdx].fail;
+      while ((target = find_child(matcher, fail, nodes[child].c)) == KEYWORD_NIL && fail != 0)
+        fail = nodes[fail].fail;
+      nodes[child].fail = target == KEYWORD_NIL ? 0 : target;
+      nodes[child].dictLink = nodes[nodes[child].fail].firstValue != KEYWORD_NIL ? nodes[child].fail : nodes[nodes[child].fail].dictLink;
+      queue[tail++] = child;
+    }
+  }
+}
@@ -0,0 +1,158 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_keyword.h
+  * @date 18 October 2026
+  * @brief Documentation for functions in ttweet_keyword.c.
+  *
+  * This header file has been created to describe the functions
+  * and declare constants in ttweet_keyword.c.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  */
+
+#ifndef TTWEET_COMMON_H
+#define TTWEET_COMMON_H
+#include "../dependencies/ttweet_common.h"
+void die_with_error(char *errorMessage);
+int persist_with_error(char *errorMessage);
+int send_payload(int sock, cJSON *jobjToSend);
+int receive_response(int sock, char *objReceived);
+void spin_lock(int *lock);
+void spin_unlock(int *lock);
+#endif
+
+#ifndef TTWEET_KEYWORD_H
+#define TTWEET_KEYWORD_H
+
+#include <stdint.h>
+
+#define KEYWORD_NIL -1 /* No node or value */
+
+/* Bit of a lower case letter or digit in KeywordNode.childMask */
+#define KEYWORD_CHAR_BIT(c) ((c) >= 'a' ? (c) - 'a' : (c) - '0' + 26)
+
+/* A node of the keyword trie, one character below its parent. The fail and
+ * dictLink fields turn the trie into an Aho-Corasick automaton. */
+typedef struct KeywordNode
+{
+  int32_t firstChild;  /* Index of the first child, KEYWORD_NIL if a leaf */
+  int32_t nextSibling; /* Index of the next child of the parent; links the free list */
+  int32_t fail;        /* Node of the longest proper suffix of this node's path */
+  int32_t dictLink;    /* Nearest node with values on the fail chain, KEYWORD_NIL if none */
+  int32_t firstValue;  /* Values of the keyword ending here */
+  int32_t numKeys;     /* Values stored at or below this node; the node is freed at 0 */
+  uint64_t childMask;  /* Bit KEYWORD_CHAR_BIT(c) set for each child, so a missing one costs no list walk */
+  char c;              /* Lower case letter or digit */
+} KeywordNode;
+
+typedef struct KeywordValue
+{
+  int32_t value;
+  int32_t next; /* Next value of the same node; links the free list */
+} KeywordValue;
+
+/* Fixed capacity automaton in shared memory. Links are array indices, so
+ * it works the same in every process that inherits the mapping. */
+typedef struct KeywordMatcher
+{
+  int lock;    /* Spinlock held by every operation */
+  int isDirty; /* Keywords changed since the fail links were computed */
+  int numValues;
+  int maxValues;
+  int maxKeywordLen;
+  int maxNodes;
+  int numNodesUsed; /* Nodes ever allocated; the rest of the pool is untouched */
+  int numValuesUsed;
+  int32_t freeNodes;
+  int32_t freeValues;
+  KeywordNode *nodes; /* nodes[0] is the root */
+  KeywordValue *values;
+  int32_t *queue; /* Breadth first order used while computing fail links */
+} KeywordMatcher;
+
+/**
+ * @brief Creates an empty keyword matcher in shared memory
+ *
+ * Call before fork() so that every child sees the same matcher. Pages of
+ * the pools are only touched once keywords need them.
+ *
+ * @param maxValues Most values stored at once
+ * @param maxKeywordLen Longest keyword; nodes are sized for maxValues keywords of this length
+ * @return KeywordMatcher* The matcher, or NULL if mmap() failed.
+ */
+KeywordMatcher *keyword_matcher_create(int maxValues, int maxKeywordLen);
+
+/**
+ * @brief Releases a matcher from keyword_matcher_create()
+ *
+ * @param matcher Matcher to release
+ * @return void
+ */
+void keyword_matcher_destroy(KeywordMatcher *matcher);
+
+/**
+ * @brief Stores a value under a keyword
+ *
+ * Only the keyword's own path is added to the trie. Fail links are brought
+ * up to date by the next keyword_matcher_scan(), so a burst of changes
+ * costs one pass over the trie.
+ *
+ * @param matcher Matcher to store into
+ * @param keyword Letters and digits, matched without regard to case
+ * @param len Length of keyword, at most the maxKeywordLen of the matcher
+ * @param value Value to store
+ * @return int 1 if stored; 0 if the keyword is invalid or the matcher is full.
+ */
+int keyword_matcher_insert(KeywordMatcher *matcher, const char *keyword, int len, int32_t value);
+
+/**
+ * @brief Removes one copy of a value stored under a keyword
+ *
+ * Nodes no longer on the path of any keyword are freed.
+ *
+ * @param matcher Matcher to remove from
+ * @param keyword Keyword passed to keyword_matcher_insert()
+ * @param len Length of keyword
+ * @param value Value to remove
+ * @return int 1 if removed; 0 if the value was not stored under keyword.
+ */
+int keyword_matcher_remove(KeywordMatcher *matcher, const char *keyword, int len, int32_t value);
+
+/**
+ * @brief Visits the values of every keyword occurring in a text
+ *
+ * Reads the text once, so the cost depends on its length and the number of
+ * occurrences, not on the number of keywords. Keywords match anywhere, case
+ * insensitively; a value is visited once per occurrence of its keyword.
+ * The matcher is locked while visit runs, so visit must not call back into it.
+ *
+ * @param matcher Matcher to scan with
+ * @param text Text to scan, not NUL terminated
+ * @param len Length of text
+ * @param visit Called once per value and occurrence, with arg
+ * @param arg Passed to visit
+ * @return int Number of visits.
+ */
+int keyword_matcher_scan(KeywordMatcher *matcher, const char *text, int len, void (*visit)(int32_t value, void *arg), void *arg);
+
+/**
+ * @brief Checks whether a matcher holds any values
+ *
+ * Does not take the lock, so a concurrent insert may not be seen yet.
+ *
+ * @param matcher Matcher to check
+ * @return int 1 if empty; 0 otherwise.
+ */
+int keyword_matcher_is_empty(KeywordMatcher *matcher);
+
+#endif
@@ -0,0 +1,366 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_mailbox.c
+  * @date 18 October 2026
+  * @brief Mailboxes of usernames between sessions, kept in a file.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  *
+  * The file is an array of MAILBOX_SLOT_SIZE slots, one per username, in
+  * the order the usernames were first saved. Once every slot is taken, the
+  * slot saved longest ago goes to the next new username. A slot holds a record: a
+  * fixed header, then the username, subscriptions, keywords and pending
+  * tweets as consecutive NUL terminated strings. Records only take the
+  * bytes they use, and slots never written are holes in a sparse file.
+  *
+  * A record is rewritten in place, so a crash in the middle of a write can
+  * leave it half old and half new. The header's checksum covers the rest
+  * of the record, and a record that fails it is treated as never written.
+  */
+
+#include "ttweet_mailbox.h"
+#include <fcntl.h>    /* for open() */
+#include <stddef.h>   /* for offsetof() */
+#include <sys/mman.h> /* for mmap() */
+#include <sys/stat.h> /* for fstat() */
+#include <unistd.h>   /* for pread() and pwrite() */
+
+#define MAILBOX_MAGIC 0x334d5454 /* "TTM3" read little endian */
+
+/* Function prototypes */
+MailboxStore *mailbox_store_open(const char *path, int maxMailboxes);                /* Opens a store file */
+void mailbox_store_close(MailboxStore *store);                                       /* Closes a store */
+int mailbox_store_save(MailboxStore *store, const Mailbox *mailbox, Mailbox *displaced); /* Writes a mailbox */
+int mailbox_store_load(MailboxStore *store, const char *username, Mailbox *mailbox); /* Reads a mailbox */
+
+/* Start of every record */
+typedef struct MailboxRecordHeader
+{
+  uint32_t magic;    /* MAILBOX_MAGIC; 0 in a slot never written */
+  uint32_t length;   /* Bytes of the record, this header included */
+  uint32_t checksum; /* FNV-1a of the record after this field */
+  uint32_t numTweets;
+  uint64_t lastTweetSeq;
+  uint64_t requestBuckets[RATE_LIMIT_TYPES]; /* TokenBucket states */
+  uint64_t spillHead;
+  uint64_t spillTail;
+  int64_t numSpilled;
+  uint64_t spillRunId;
+} MailboxRecordHeader;
+
+/* Static helpers */
+static size_t store_size(int maxMailboxes, int bucketBits);
+static int bucket_bits(int numEntries);
+static uint32_t mailbox_bucket(MailboxStore *store, const char *username);
+static int32_t find_entry(MailboxStore *store, const char *username, int create);
+static int32_t oldest_entry(MailboxStore *store);
+static void unindex_entry(MailboxStore *store, int32_t entryIdx);
+static int encode_mailbox(const Mailbox *mailbox, uint8_t *record);
+static int decode_mailbox(const uint8_t *record, int recordLen, Mailbox *mailbox);
+static int read_record(MailboxStore *store, int32_t entryIdx, Mailbox *mailbox);
+static int append_string(uint8_t *record, int recordLen, const char *string);
+static int take_string(const uint8_t *record, int recordLen, int *offset, char *string, int stringSize);
+static uint32_t record_checksum(const uint8_t *record, int recordLen);
+
+/** \copydoc mailbox_store_open */
+MailboxStore *mailbox_store_open(const char *path, int maxMailboxes)
+{
+  int bucketBits = bucket_bits(maxMailboxes);
+  Mailbox mailbox;
+  struct stat fileStat;
+  MailboxStore *store;
+  uint32_t bucket;
+  int numSlots;
+  char *region;
+  int fd;
+
+  fd = open(path, O_RDWR | O_CREAT, 0600);
+  if (fd < 0)
+    return NULL;
+  region = mmap(NULL, store_size(maxMailboxes, bucketBits), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (region == MAP_FAILED || fstat(fd, &fileStat) < 0)
+  {
+    if (region != MAP_FAILED)
+      munmap(region, store_size(maxMailboxes, bucketBits));
+    close(fd);
+    return NULL;
+  }
+  store = (MailboxStore *)region;
+  store->lock = 0;
+  store->fd = fd;
+  store->maxMailboxes = maxMailboxes;
+  store->bucketBits = bucketBits;
+  store->numSaves = 0;
+  store->entries = (MailboxEntry *)(region + sizeof(MailboxStore));
+  store->buckets = (int32_t *)(store->entries + maxMailboxes);
+  memset(store->buckets, 0xff, sizeof(int32_t) << bucketBits); /* MAILBOX_NIL */
+
+  /* The last record may end before its slot does */
+  numSlots = (fileStat.st_size + MAILBOX_SLOT_SIZE - 1) / MAILBOX_SLOT_SIZE;
+  store->numMailboxes = numSlots < maxMailboxes ? numSlots : maxMailboxes;
+  for (int32_t entryIdx = 0; entryIdx < store->numMailboxes; entryIdx++)
+  { /* Slots that do not hold a record stay out of the index */
+    store->entries[entryIdx].hashNext = MAILBOX_NIL;
+    strcpy(store->entries[entryIdx].username, "");
+    store->entries[entryIdx].lastSave = 0;
+    if (!read_record(store, entryIdx, &mailbox) || find_entry(store, mailbox.username, 0) != MAILBOX_NIL)
+      continue;
+    store->entries[entryIdx].lastSave = ++store->numSaves; /* Save order is not kept across restarts, so slot order stands in */
+    bucket = mailbox_bucket(store, mailbox.username);
+    strcpy(store->entries[entryIdx].username, mailbox.username);
+    store->entries[entryIdx].hashNext = store->buckets[bucket];
+    store->buckets[bucket] = entryIdx;
+  }
+  return store;
+}
+
+/** \copydoc mailbox_store_close */
+void mailbox_store_close(MailboxStore *store)
+{
+  close(store->fd);
+  munmap(store, store_size(store->maxMailboxes, store->bucketBits));
+}
+
+/** \copydoc mailbox_store_save */
+int mailbox_store_save(MailboxStore *store, const Mailbox *mailbox, Mailbox *displaced)
+{
+  uint8_t record[MAILBOX_SLOT_SIZE];
+  int recordLen = encode_mailbox(mailbox, record);
+  int32_t entryIdx;
+
+  if (displaced != NULL)
+    strcpy(displaced->username, "");
+  spin_lock(&store->lock);
+  entryIdx = find_entry(store, mailbox->username, 0);
+  if (entryIdx == MAILBOX_NIL && store->numMailboxes == store->maxMailboxes && displaced != NULL)
+  { /* Read before the slot is overwritten; only a full store gets here */
+    int32_t oldestIdx = oldest_entry(store);
+    if (!read_record(store, oldestIdx, displaced) || strcmp(displaced->username, store->entries[oldestIdx].username) != 0)
+      strcpy(displaced->username, "");
+  }
+  if (entryIdx == MAILBOX_NIL)
+    entryIdx = find_entry(store, mailbox->username, 1);
+  store->entries[entryIdx].lastSave = ++store->numSaves;
+  spin_unlock(&store->lock);
+  return pwrite(store->fd, record, recordLen, (off_t)entryIdx * MAILBOX_SLOT_SIZE) == recordLen ? 1 : -1;
+}
+
+/** \copydoc mailbox_store_load */
+int mailbox_store_load(MailboxStore *store, const char *username, Mailbox *mailbox)
+{
+  int32_t entryIdx;
+
+  spin_lock(&store->lock);
+  entryIdx = find_entry(store, username, 0);
+  spin_unlock(&store->lock);
+  /* The slot may have been given to another username since */
+  return entryIdx != MAILBOX_NIL && read_record(store, entryIdx, mailbox) && strcmp(mailbox->username, username) == 0;
+}
+
+static size_t store_size(int maxMailboxes, int bucketBits)
+{
+  return sizeof(MailboxStore) + sizeof(MailboxEntry) * maxMailboxes + (sizeof(int32_t) << bucketBits);
+}
+
+/* Smallest power of two holding numEntries, as a number of bits */
+static int bucket_bits(int numEntries)
+{
+  int bits = 1;
+
+  while ((1 << bits) < numEntries)
+    bits++;
+  return bits;
+}
+
+/* FNV-1a of the username, its high bits picked multiplicatively */
+static uint32_t mailbox_bucket(MailboxStore *store, const char *username)
+{
+  uint32_t hash = 2166136261u;
+
+  while (*username)
+  {
+    hash ^= (unsigned char)*username++;
+    hash *= 16777619u;
+  }
+  return (hash * 2654435761u) >> (32 - store->bucketBits);
+}
+
+/* Entry of a username; with create, a new one if there is none */
+static int32_t find_entry(MailboxStore *store, const char *username, int create)
+{
+  uint32_t bucket = mailbox_bucket(store, username);
+  int32_t entryIdx;
+
+  for (entryIdx = store->buckets[bucket]; entryIdx != MAILBOX_NIL; entryIdx = store->entries[entryIdx].hashNext)
+  {
+    if (strcmp(store->entries[entryIdx].username, username) == 0)
+      return entryIdx;
+  }
+  if (!create)
+    return MAILBOX_NIL;
+
+  if (store->numMailboxes < store->maxMailboxes)
+    entryIdx = store->numMailboxes++;
+  else
+  { /* Full: the slot saved longest ago is given up */
+    entryIdx = oldest_entry(store);
+    unindex_entry(store, entryIdx);
+  }
+  strcpy(store->entries[entryIdx].username, username);
+  store->entries[entryIdx].hashNext = store->buckets[bucket];
+  store->buckets[bucket] = entryIdx;
+  return entryIdx;
+}
+
+/* Entry saved longest ago. Scans every entry, but only a store that is
+ * full pays for it, once per new username. */
+static int32_t oldest_entry(MailboxStore *store)
+{
+  int32_t oldestIdx = 0;
+
+  for (int32_t entryIdx = 1; entryIdx < store->numMailboxes; entryIdx++)
+  {
+    if (store->entries[entryIdx].lastSave < store->entries[oldestIdx].lastSave)
+      oldestIdx = entryIdx;
+  }
+  return oldestIdx;
+}
+
+/* Removes an entry from its bucket, if it holds a username */
+static void unindex_entry(MailboxStore *store, int32_t entryIdx)
+{
+  int32_t *link;
+
+  if (strcmp(store->entries[entryIdx].username, "") == 0)
+    return;
+  link = &store->buckets[mailbox_bucket(store, store->entries[entryIdx].username)];
+  while (*link != entryIdx)
+    link = &store->entries[*link].hashNext;
+  *link = store->entries[entryIdx].hashNext;
+}
+
+/* A full Mailbox is a header and at most MAX_USERNAME_LEN + (MAX_SUBSCRIPTIONS +
+ * MAX_KEYWORD_SUBSCRIPTIONS) * MAX_HASHTAG_LEN + MAX_TWEET_QUEUE * MAX_TWEET_ITEM_LEN
+ * bytes of strings, which fits in MAILBOX_SLOT_SIZE */
+static int encode_mailbox(const Mailbox *mailbox, uint8_t *record)
+{
+  MailboxRecordHeader header;
+  int recordLen = sizeof(header);
+
+  recordLen = append_string(record, recordLen, mailbox->username);
+  for (int subscriptionIdx = 0; subscriptionIdx < MAX_SUBSCRIPTIONS; subscriptionIdx++)
+    recordLen = append_string(record, recordLen, mailbox->subscriptions[subscriptionIdx]);
+  for (int keywordIdx = 0; keywordIdx < MAX_KEYWORD_SUBSCRIPTIONS; keywordIdx++)
+    recordLen = append_string(record, recordLen, mailbox->keywords[keywordIdx]);
+  for (int tweetIdx = 0; tweetIdx < mailbox->numTweets; tweetIdx++)
+    recordLen = append_string(record, recordLen, mailbox->pendingTweets[tweetIdx]);
+
+  header.magic = MAILBOX_MAGIC;
+  header.length = recordLen;
+  header.numTweets = mailbox->numTweets;
+  header.lastTweetSeq = mailbox->lastTweetSeq;
+  for (int bucketIdx = 0; bucketIdx < RATE_LIMIT_TYPES; bucketIdx++)
+    header.requestBuckets[bucketIdx] = mailbox->requestBuckets[bucketIdx].state;
+  header.spillHead = mailbox->spilledTweets.head;
+  header.spillTail = mailbox->spilledTweets.tail;
+  header.numSpilled = mailbox->spilledTweets.numRecords;
+  header.spillRunId = mailbox->spillRunId;
+  memcpy(record, &header, sizeof(header));
+  header.checksum = record_checksum(record, recordLen);
+  memcpy(record, &header, sizeof(header));
+  return recordLen;
+}
+
+/* Returns 1 if the record is whole and every string fits its field */
+static int decode_mailbox(const uint8_t *record, int recordLen, Mailbox *mailbox)
+{
+  MailboxRecordHeader header;
+  int offset = sizeof(header);
+
+  if (recordLen < (int)sizeof(header))
+    return 0;
+  memcpy(&header, record, sizeof(header));
+  if (header.magic != MAILBOX_MAGIC || header.length < sizeof(header) || header.length > (uint32_t)recordLen ||
+      header.numTweets > MAX_TWEET_QUEUE || header.checksum != record_checksum(record, header.length))
+    return 0;
+  recordLen = header.length;
+
+  if (!take_string(record, recordLen, &offset, mailbox->username, MAX_USERNAME_LEN))
+    return 0;
+  for (int subscriptionIdx = 0; subscriptionIdx < MAX_SUBSCRIPTIONS; subscriptionIdx++)
+  {
+    if (!take_string(record, recordLen, &offset, mailbox->subscriptions[subscriptionIdx], MAX_HASHTAG_LEN))
+      return 0;
+  }
+  for (int keywordIdx = 0; keywordIdx < MAX_KEYWORD_SUBSCRIPTIONS; keywordIdx++)
+  {
+    if (!take_string(record, recordLen, &offset, mailbox->keywords[keywordIdx], MAX_HASHTAG_LEN))
+      return 0;
+  }
+  for (uint32_t tweetIdx = 0; tweetIdx < header.numTweets; tweetIdx++)
+  {
+    if (!take_string(record, recordLen, &offset, mailbox->pendingTweets[tweetIdx], MAX_TWEET_ITEM_LEN))
+      return 0;
+  }
+  mailbox->numTweets = header.numTweets;
+  mailbox->lastTweetSeq = header.lastTweetSeq;
+  for (int bucketIdx = 0; bucketIdx < RATE_LIMIT_TYPES; bucketIdx++)
+    mailbox->requestBuckets[bucketIdx].state = header.requestBuckets[bucketIdx];
+  spill_queue_init(&mailbox->spilledTweets, mailbox->username);
+  mailbox->spilledTweets.head = header.spillHead;
+  mailbox->spilledTweets.tail = header.spillTail;
+  mailbox->spilledTweets.numRecords = header.numSpilled;
+  mailbox->spillRunId = header.spillRunId;
+  return 1;
+}
+
+/* One read of the whole slot, however long the record turns out to be */
+static int read_record(MailboxStore *store, int32_t entryIdx, Mailbox *mailbox)
+{
+  uint8_t record[MAILBOX_SLOT_SIZE];
+  ssize_t recordLen = pread(store->fd, record, MAILBOX_SLOT_SIZE, (off_t)entryIdx * MAILBOX_SLOT_SIZE);
+
+  return recordLen > 0 && decode_mailbox(record, recordLen, mailbox);
+}
+
+static int append_string(uint8_t *record, int recordLen, const char *string)
+{
+  int stringLen = strlen(string) + 1;
+
+  memcpy(record + recordLen, string, stringLen);
+  return recordLen + stringLen;
+}
+
+/* Copies the string at *offset and moves past it */
+static int take_string(const uint8_t *record, int recordLen, int *offset, char *string, int stringSize)
+{
+  const uint8_t *end = memchr(record + *offset, '\0', recordLen - *offset);
+
+  if (end == NULL || end - (record + *offset) >= stringSize)
+    return 0;
+  memcpy(string, record + *offset, end - (record + *offset) + 1);
+  *offset += end - (record + *offset) + 1;
+  return 1;
+}
+
+static uint32_t record_checksum(const uint8_t *record, int recordLen)
+{
+  uint32_t hash = 2166136261u;
+
+  for (int byteIdx = offsetof(MailboxRecordHeader, numTweets); byteIdx < recordLen; byteIdx++)
+  {
+    hash ^= record[byteIdx];
+    hash *= 16777619u;
+  }
+  return hash;
+}
@@ -0,0 +1,127 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_mailbox.h
+  * @date 18 October 2026
+  * @brief Documentation for functions in ttweet_mailbox.c.
+  *
+  * This header file has been created to describe the functions
+  * and declare constants in ttweet_mailbox.c.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  */
+
+#ifndef TTWEET_COMMON_H
+#define TTWEET_COMMON_H
+#include "../dependencies/ttweet_common.h"
+void die_with_error(char *errorMessage);
+int persist_with_error(char *errorMessage);
+int send_payload(int sock, cJSON *jobjToSend);
+int receive_response(int sock, char *objReceived);
+void spin_lock(int *lock);
+void spin_unlock(int *lock);
+#endif
+
+#ifndef TTWEET_MAILBOX_H
+#define TTWEET_MAILBOX_H
+
+#include "ttweet_ratelimit.h"
+#include "ttweet_spill.h"
+#include <stdint.h>
+
+#define MAILBOX_NIL -1         /* No mailbox */
+#define MAILBOX_SLOT_SIZE 8192 /* Bytes of the store file reserved per username, enough for a full Mailbox */
+
+/* What a username keeps between sessions */
+typedef struct Mailbox
+{
+  char username[MAX_USERNAME_LEN];
+  char subscriptions[MAX_SUBSCRIPTIONS][MAX_HASHTAG_LEN];
+  char keywords[MAX_KEYWORD_SUBSCRIPTIONS][MAX_HASHTAG_LEN];
+  uint64_t lastTweetSeq; /* Sequence number of the newest pending tweet, so client cursors stay valid */
+  TokenBucket requestBuckets[RATE_LIMIT_TYPES]; /* So logging in again does not refill them */
+  SpillQueue spilledTweets; /* Tweets after pendingTweets, still in the spill directory */
+  uint64_t spillRunId;      /* runId of the SpillStore holding spilledTweets, 0 if none */
+  int numTweets;
+  char pendingTweets[MAX_TWEET_QUEUE][MAX_TWEET_ITEM_LEN]; /* Oldest first */
+} Mailbox;
+
+typedef struct MailboxEntry
+{
+  int32_t hashNext; /* Next entry in the same bucket */
+  char username[MAX_USERNAME_LEN]; /* Empty if the slot holds no record */
+  uint64_t lastSave; /* Number of the slot's latest save; the lowest is reused first once the store is full */
+} MailboxEntry;
+
+/* Index of a store file in shared memory. Entry i is the username saved in
+ * slot i of the file, so a lookup costs no disk access and a load or save
+ * costs one read or write. */
+typedef struct MailboxStore
+{
+  int lock; /* Spinlock held while the index changes */
+  int fd;
+  int maxMailboxes;
+  int numMailboxes; /* Slots in use; the file never has more */
+  int bucketBits;   /* 2^bits buckets, at least one per mailbox */
+  uint64_t numSaves;
+  int32_t *buckets;
+  MailboxEntry *entries;
+} MailboxStore;
+
+/**
+ * @brief Opens a store file, creating it if needed
+ *
+ * Every slot of an existing file is read once to rebuild the index. A slot
+ * left incomplete by a crash is skipped, and its username starts over with
+ * an empty mailbox. Call before fork() so that every child shares the
+ * index and the file descriptor.
+ *
+ * @param path File holding the mailboxes
+ * @param maxMailboxes Most usernames the store can hold
+ * @return MailboxStore* The store, or NULL if the file could not be opened or mmap() failed.
+ */
+MailboxStore *mailbox_store_open(const char *path, int maxMailboxes);
+
+/**
+ * @brief Closes a store from mailbox_store_open()
+ *
+ * @param store Store to close
+ * @return void
+ */
+void mailbox_store_close(MailboxStore *store);
+
+/**
+ * @brief Writes a username's mailbox to its slot
+ *
+ * Only the strings in use are written, so a mailbox with few pending
+ * tweets is a few hundred bytes. The write is not synced: it survives the
+ * server, not the machine. Once maxMailboxes usernames have mailboxes, a
+ * new one takes the slot of the mailbox saved longest ago, which is lost.
+ *
+ * @param store Store to write to
+ * @param mailbox Mailbox to save, replacing any earlier one of the same username
+ * @param displaced If not NULL, receives the mailbox whose slot was taken; its username is empty if none was.
+ * @return int 1 if saved; -1 if the write failed.
+ */
+int mailbox_store_save(MailboxStore *store, const Mailbox *mailbox, Mailbox *displaced);
+
+/**
+ * @brief Reads a username's mailbox
+ *
+ * @param store Store to read from
+ * @param username Username whose mailbox is wanted
+ * @param mailbox Receives the mailbox
+ * @return int 1 if found; 0 if the username has no mailbox, or it could not be read.
+ */
+int mailbox_store_load(MailboxStore *store, const char *username, Mailbox *mailbox);
+
+#endif
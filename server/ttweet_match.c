@@ -0,0 +1,240 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_match.c
+  * @date 18 October 2026
+  * @brief Vectorised matching of subscription signatures for tweet fan-out.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  *
+  * The subscription signatures and subscribe-all flags of all users form
+  * flat arrays, so a single compare covers several users at once. Each matcher
+  * turns its compare results into a bitmask, one bit per element, which the
+  * caller walks to find the few users that need a closer look. Like the
+  * validator's scanners, the instruction set is picked once at run time.
+  */
+
+#include "ttweet_match.h"
+#include "../dependencies/ttweet_validate.h" /* for SIMD_LEVEL_* */
+#include <string.h>                          /* for memset() */
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> /* for SSE and AVX2 intrinsics */
+#define MATCH_X86 1
+#endif
+
+/* Function prototypes */
+int match_signatures(const uint64_t *signatures, int numSignatures, const uint64_t keys[], int numKeys, uint64_t matchMask[]); /* Marks signatures that may hold a key */
+int match_nonzero_bytes(const uint8_t *bytes, int numBytes, uint64_t nonZeroMask[]);                                           /* Marks non-zero bytes */
+int set_match_simd_level(int level);                                                                                           /* Selects the matcher instruction set */
+int get_match_simd_level();                                                                                                    /* Returns the matcher instruction set */
+
+/* Static helpers */
+static int detect_simd_level();
+static void select_matchers(int level);
+static int count_mask_bits(const uint64_t mask[], int numBits);
+static void match_signatures_scalar(const uint64_t *signatures, int firstSignature, int numSignatures, const uint64_t keys[], int numKeys, uint64_t matchMask[]);
+static void match_nonzero_bytes_scalar(const uint8_t *bytes, int firstByte, int numBytes, uint64_t nonZeroMask[]);
+#ifdef MATCH_X86
+static void match_signatures_sse42(const uint64_t *signatures, int firstSignature, int numSignatures, const uint64_t keys[], int numKeys, uint64_t matchMask[]);
+static void match_nonzero_bytes_sse42(const uint8_t *bytes, int firstByte, int numBytes, uint64_t nonZeroMask[]);
+static void match_signatures_avx2(const uint64_t *signatures, int firstSignature, int numSignatures, const uint64_t keys[], int numKeys, uint64_t matchMask[]);
+static void match_nonzero_bytes_avx2(const uint8_t *bytes, int firstByte, int numBytes, uint64_t nonZeroMask[]);
+#endif
+
+/* Matchers for the selected level; -1 until first use */
+static int simdLevel = -1;
+static void (*matchSignatures)(const uint64_t *signatures, int firstSignature, int numSignatures, const uint64_t keys[], int numKeys, uint64_t matchMask[]) = match_signatures_scalar;
+static void (*matchNonZeroBytes)(const uint8_t *bytes, int firstByte, int numBytes, uint64_t nonZeroMask[]) = match_nonzero_bytes_scalar;
+
+/** \copydoc match_signatures */
+int match_signatures(const uint64_t *signatures, int numSignatures, const uint64_t keys[], int numKeys, uint64_t matchMask[])
+{
+  if (simdLevel < 0)
+    set_match_simd_level(SIMD_LEVEL_AVX2);
+  memset(matchMask, 0, MATCH_MASK_WORDS(numSignatures) * sizeof(uint64_t));
+  if (numKeys <= 0)
+    return 0;
+  if (numKeys > MAX_MATCH_KEYS)
+    numKeys = MAX_MATCH_KEYS;
+  matchSignatures(signatures, 0, numSignatures, keys, numKeys, matchMask);
+  return count_mask_bits(matchMask, numSignatures);
+}
+
+/** \copydoc match_nonzero_bytes */
+int match_nonzero_bytes(const uint8_t *bytes, int numBytes, uint64_t nonZeroMask[])
+{
+  if (simdLevel < 0)
+    set_match_simd_level(SIMD_LEVEL_AVX2);
+  memset(nonZeroMask, 0, MATCH_MASK_WORDS(numBytes) * sizeof(uint64_t));
+  matchNonZeroBytes(bytes, 0, numBytes, nonZeroMask);
+  return count_mask_bits(nonZeroMask, numBytes);
+}
+
+/** \copydoc set_match_simd_level */
+int set_match_simd_level(int level)
+{
+  int supported = detect_simd_level();
+
+  simdLevel = level < supported ? level : supported;
+  select_matchers(simdLevel);
+  return simdLevel;
+}
+
+/** \copydoc get_match_simd_level */
+int get_match_simd_level()
+{
+  if (simdLevel < 0)
+    set_match_simd_level(SIMD_LEVEL_AVX2);
+  return simdLevel;
+}
+
+static int detect_simd_level()
+{
+#ifdef MATCH_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return SIMD_LEVEL_AVX2;
+  if (__builtin_cpu_supports("sse4.2"))
+    return SIMD_LEVEL_SSE42;
+#endif
+  return SIMD_LEVEL_SCALAR;
+}
+
+static void select_matchers(int level)
+{
+  matchSignatures = match_signatures_scalar;
+  matchNonZeroBytes = match_nonzero_bytes_scalar;
+#ifdef MATCH_X86
+  if (level == SIMD_LEVEL_AVX2)
+  {
+    matchSignatures = match_signatures_avx2;
+    matchNonZeroBytes = match_nonzero_bytes_avx2;
+  }
+  else if (level == SIMD_LEVEL_SSE42)
+  {
+    matchSignatures = match_signatures_sse42;
+    matchNonZeroBytes = match_nonzero_bytes_sse42;
+  }
+#endif
+}
+
+static int count_mask_bits(const uint64_t mask[], int numBits)
+{
+  int numSet = 0;
+
+  for (int wordIdx = 0; wordIdx < MATCH_MASK_WORDS(numBits); wordIdx++)
+    numSet += __builtin_popcountll(mask[wordIdx]);
+  return numSet;
+}
+
+/* Also finishes the vector matchers, from firstSignature on */
+static void match_signatures_scalar(const uint64_t *signatures, int firstSignature, int numSignatures, const uint64_t keys[], int numKeys, uint64_t matchMask[])
+{
+  for (int signatureIdx = firstSignature; signatureIdx < numSignatures; signatureIdx++)
+  {
+    uint64_t isMatch = 0;
+    for (int keyIdx = 0; keyIdx < numKeys; keyIdx++)
+      isMatch |= (signatures[signatureIdx] & keys[keyIdx]) == keys[keyIdx];
+    matchMask[signatureIdx >> 6] |= isMatch << (signatureIdx & 63);
+  }
+}
+
+static void match_nonzero_bytes_scalar(const uint8_t *bytes, int firstByte, int numBytes, uint64_t nonZeroMask[])
+{
+  for (int byteIdx = firstByte; byteIdx < numBytes; byteIdx++)
+    nonZeroMask[byteIdx >> 6] |= (uint64_t)(bytes[byteIdx] != 0) << (byteIdx & 63);
+}
+
+#ifdef MATCH_X86
+
+/* 2 signatures per step; _mm_cmpeq_epi64 needs SSE4.1 */
+__attribute__((target("sse4.2"))) static void match_signatures_sse42(const uint64_t *signatures, int firstSignature, int numSignatures, const uint64_t keys[], int numKeys, uint64_t matchMask[])
+{
+  __m128i keyVectors[MAX_MATCH_KEYS];
+  __m128i block;
+  __m128i hits;
+  int signatureIdx = firstSignature;
+
+  for (int keyIdx = 0; keyIdx < numKeys; keyIdx++)
+    keyVectors[keyIdx] = _mm_set1_epi64x((long long)keys[keyIdx]);
+
+  for (; signatureIdx + 2 <= numSignatures; signatureIdx += 2)
+  {
+    block = _mm_loadu_si128((const __m128i *)(signatures + signatureIdx));
+    hits = _mm_cmpeq_epi64(_mm_and_si128(block, keyVectors[0]), keyVectors[0]);
+    for (int keyIdx = 1; keyIdx < numKeys; keyIdx++)
+      hits = _mm_or_si128(hits, _mm_cmpeq_epi64(_mm_and_si128(block, keyVectors[keyIdx]), keyVectors[keyIdx]));
+    matchMask[signatureIdx >> 6] |= (uint64_t)_mm_movemask_pd(_mm_castsi128_pd(hits)) << (signatureIdx & 63);
+  }
+  match_signatures_scalar(signatures, signatureIdx, numSignatures, keys, numKeys, matchMask);
+}
+
+__attribute__((target("sse4.2"))) static void match_nonzero_bytes_sse42(const uint8_t *bytes, int firstByte, int numBytes, uint64_t nonZeroMask[])
+{
+  const __m128i zero = _mm_setzero_si128();
+  int byteIdx = firstByte;
+
+  for (; byteIdx + 16 <= numBytes; byteIdx += 16)
+  {
+    __m128i block = _mm_loadu_si128((const __m128i *)(bytes + byteIdx));
+    uint32_t zeroBits = _mm_movemask_epi8(_mm_cmpeq_epi8(block, zero));
+    nonZeroMask[byteIdx >> 6] |= (uint64_t)(~zeroBits & 0xffff) << (byteIdx & 63);
+  }
+  match_nonzero_bytes_scalar(bytes, byteIdx, numBytes, nonZeroMask);
+}
+
+/* 8 signatures per step, as two vectors of 4 */
+__attribute__((target("avx2"))) static void match_signatures_avx2(const uint64_t *signatures, int firstSignature, int numSignatures, const uint64_t keys[], int numKeys, uint64_t matchMask[])
+{
+  __m256i keyVectors[MAX_MATCH_KEYS];
+  __m256i low, high;
+  __m256i lowHits, highHits;
+  uint64_t bits;
+  int signatureIdx = firstSignature;
+
+  for (int keyIdx = 0; keyIdx < numKeys; keyIdx++)
+    keyVectors[keyIdx] = _mm256_set1_epi64x((long long)keys[keyIdx]);
+
+  for (; signatureIdx + 8 <= numSignatures; signatureIdx += 8)
+  {
+    low = _mm256_loadu_si256((const __m256i *)(signatures + signatureIdx));
+    high = _mm256_loadu_si256((const __m256i *)(signatures + signatureIdx + 4));
+    lowHits = _mm256_cmpeq_epi64(_mm256_and_si256(low, keyVectors[0]), keyVectors[0]);
+    highHits = _mm256_cmpeq_epi64(_mm256_and_si256(high, keyVectors[0]), keyVectors[0]);
+    for (int keyIdx = 1; keyIdx < numKeys; keyIdx++)
+    {
+      lowHits = _mm256_or_si256(lowHits, _mm256_cmpeq_epi64(_mm256_and_si256(low, keyVectors[keyIdx]), keyVectors[keyIdx]));
+      highHits = _mm256_or_si256(highHits, _mm256_cmpeq_epi64(_mm256_and_si256(high, keyVectors[keyIdx]), keyVectors[keyIdx]));
+    }
+    bits = (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(lowHits)) |
+           (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(highHits)) << 4;
+    matchMask[signatureIdx >> 6] |= bits << (signatureIdx & 63);
+  }
+  match_signatures_scalar(signatures, signatureIdx, numSignatures, keys, numKeys, matchMask);
+}
+
+__attribute__((target("avx2"))) static void match_nonzero_bytes_avx2(const uint8_t *bytes, int firstByte, int numBytes, uint64_t nonZeroMask[])
+{
+  const __m256i zero = _mm256_setzero_si256();
+  int byteIdx = firstByte;
+
+  for (; byteIdx + 32 <= numBytes; byteIdx += 32)
+  {
+    __m256i block = _mm256_loadu_si256((const __m256i *)(bytes + byteIdx));
+    uint32_t zeroBits = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, zero));
+    nonZeroMask[byteIdx >> 6] |= (uint64_t)~zeroBits << (byteIdx & 63);
+  }
+  match_nonzero_bytes_scalar(bytes, byteIdx, numBytes, nonZeroMask);
+}
+
+#endif
@@ -0,0 +1,77 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_match.h
+  * @date 18 October 2026
+  * @brief Documentation for functions in ttweet_match.c.
+  *
+  * This header file has been created to describe the functions
+  * and declare constants in ttweet_match.c.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  */
+
+#ifndef TTWEET_MATCH_H
+#define TTWEET_MATCH_H
+
+#include <stdint.h>
+
+/* Most keys a single match_signatures() call compares against */
+#define MAX_MATCH_KEYS 8
+
+/* Words of mask needed for numBits bits */
+#define MATCH_MASK_WORDS(numBits) (((numBits) + 63) / 64)
+
+/**
+ * @brief Marks the Bloom filter signatures that may contain any of a set of keys
+ *
+ * A signature may contain a key when every bit of the key is set in it.
+ * Tests 4 signatures against every key per AVX2 step, or 2 per SSE step.
+ *
+ * @param signatures Signatures to test
+ * @param numSignatures Number of signatures
+ * @param keys Signatures of the keys; a key of 0 matches everything
+ * @param numKeys Number of keys, at most MAX_MATCH_KEYS
+ * @param matchMask Receives MATCH_MASK_WORDS(numSignatures) words; bit i is set when signatures[i] may contain a key
+ * @return int Number of bits set.
+ */
+int match_signatures(const uint64_t *signatures, int numSignatures, const uint64_t keys[], int numKeys, uint64_t matchMask[]);
+
+/**
+ * @brief Marks the non-zero bytes of an array
+ *
+ * @param bytes Bytes to scan
+ * @param numBytes Number of bytes
+ * @param nonZeroMask Receives MATCH_MASK_WORDS(numBytes) words; bit i is set when bytes[i] is not 0
+ * @return int Number of bits set.
+ */
+int match_nonzero_bytes(const uint8_t *bytes, int numBytes, uint64_t nonZeroMask[]);
+
+/**
+ * @brief Selects the instruction set used by the matchers
+ *
+ * The best level supported by the CPU is chosen on first use. Lower levels
+ * can be forced, e.g. to compare implementations.
+ *
+ * @param level SIMD_LEVEL_* to use, capped at what the CPU supports
+ * @return int Level now in use.
+ */
+int set_match_simd_level(int level);
+
+/**
+ * @brief Returns the instruction set used by the matchers
+ *
+ * @return int SIMD_LEVEL_* in use.
+ */
+int get_match_simd_level();
+
+#endif
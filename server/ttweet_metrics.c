@@ -0,0 +1,325 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_metrics.c
+  * @date 18 October 2026
+  * @brief Shared-memory metrics for ttweetsrv.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  *
+  * Every process writes to its own MetricsShard inside a MAP_SHARED region,
+  * using relaxed atomic adds so the admin process can read the shards at
+  * any time without locks. Shards are summed when metrics are rendered.
+  */
+
+#include "ttweet_metrics.h"
+#include <sys/prctl.h> /* for prctl() */
+
+/* Function prototypes */
+void metrics_init();                                              /* Creates the shared metrics region */
+void metrics_attach_worker();                                     /* Claims a metrics shard */
+void metrics_detach_worker();                                     /* Releases the claimed shard */
+void metrics_add(int metric, int64_t delta);                      /* Adds delta to a counter */
+void metrics_observe_request(int requestCode, uint64_t latencyNs); /* Records request latency */
+void metrics_observe_fanout(uint64_t recipients);                 /* Records tweet fan-out size */
+int metrics_render(char *buffer, int bufferLen);                  /* Renders Prometheus text */
+void metrics_serve_admin(unsigned short port);                    /* Starts the admin listener */
+
+/* Static helpers */
+static int render_summary(char *buffer, int bufferLen, char *name, char *labels, Histogram *histogram, double scale);
+static char *request_type_name(int requestCode);
+
+/* Global variables */
+static MetricsShard *metricsShards;      /* Shared shards, one per process */
+static MetricsShard *currentShard = NULL; /* Shard written by this process */
+
+/* Quantiles exported for every summary */
+static const double exportedQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+/** \copydoc metrics_init */
+void metrics_init()
+{
+  metricsShards = mmap(NULL, sizeof(MetricsShard) * METRICS_MAX_WORKERS, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (metricsShards == MAP_FAILED)
+    die_with_error("mmap() failed for metrics");
+  memset(metricsShards, 0, sizeof(MetricsShard) * METRICS_MAX_WORKERS);
+  metricsShards[METRICS_MAIN_SHARD].ownerPid = getpid();
+  currentShard = &metricsShards[METRICS_MAIN_SHARD];
+}
+
+/** \copydoc metrics_attach_worker */
+void metrics_attach_worker()
+{
+  int pid = getpid();
+
+  for (int shardIdx = METRICS_MAIN_SHARD + 1; shardIdx < METRICS_MAX_WORKERS; shardIdx++)
+  {
+    int owner = __atomic_load_n(&metricsShards[shardIdx].ownerPid, __ATOMIC_ACQUIRE);
+    if (owner != 0 && (kill(owner, 0) == 0 || errno != ESRCH))
+    { /* shard belongs to a live process */
+      continue;
+    }
+    if (__atomic_compare_exchange_n(&metricsShards[shardIdx].ownerPid, &owner, pid, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    { /* shard claimed */
+      currentShard = &metricsShards[shardIdx];
+      return;
+    }
+  }
+  /* All shards busy: keep sharing the inherited shard. Updates are atomic so this is still safe. */
+}
+
+/** \copydoc metrics_detach_worker */
+void metrics_detach_worker()
+{
+  if (currentShard != NULL && currentShard != &metricsShards[METRICS_MAIN_SHARD])
+  {
+    __atomic_store_n(&currentShard->ownerPid, 0, __ATOMIC_RELEASE);
+  }
+}
+
+/** \copydoc metrics_add */
+void metrics_add(int metric, int64_t delta)
+{
+  if (currentShard == NULL || metric < 0 || metric >= METRIC_COUNTERS)
+    return;
+  __atomic_fetch_add(&currentShard->counters[metric], delta, __ATOMIC_RELAXED);
+}
+
+/** \copydoc metrics_observe_request */
+void metrics_observe_request(int requestCode, uint64_t latencyNs)
+{
+  if (currentShard == NULL || requestCode < 0 || requestCode >= METRICS_REQ_TYPES)
+    return;
+  histogram_record(&currentShard->requestLatency[requestCode], latencyNs);
+}
+
+/** \copydoc metrics_observe_fanout */
+void metrics_observe_fanout(uint64_t recipients)
+{
+  if (currentShard == NULL)
+    return;
+  histogram_record(&currentShard->fanout, recipients);
+}
+
+/** \copydoc metrics_render */
+int metrics_render(char *buffer, int bufferLen)
+{
+  int written = 0;
+  int64_t counters[METRIC_COUNTERS] = {0};
+  int activeWorkers = 0;
+  char labels[64];
+  static Histogram latency[METRICS_REQ_TYPES]; /* static: too large for the stack */
+  static Histogram fanout;
+
+  memset(latency, 0, sizeof(latency));
+  memset(&fanout, 0, sizeof(fanout));
+
+  for (int shardIdx = 0; shardIdx < METRICS_MAX_WORKERS; shardIdx++)
+  { /* Sum all shards */
+    MetricsShard *shard = &metricsShards[shardIdx];
+    if (shardIdx != METRICS_MAIN_SHARD && __atomic_load_n(&shard->ownerPid, __ATOMIC_RELAXED) != 0)
+      activeWorkers++;
+    for (int metric = 0; metric < METRIC_COUNTERS; metric++)
+      counters[metric] += __atomic_load_n(&shard->counters[metric], __ATOMIC_RELAXED);
+    for (int requestCode = 0; requestCode < METRICS_REQ_TYPES; requestCode++)
+      histogram_merge(&latency[requestCode], &shard->requestLatency[requestCode]);
+    histogram_merge(&fanout, &shard->fanout);
+  }
+
+#define APPEND(...)                                                             \
+  do                                                                            \
+  {                                                                             \
+    if (written < bufferLen)                                                    \
+      written += snprintf(buffer + written, bufferLen - written, __VA_ARGS__);  \
+  } while (0)
+
+  APPEND("# HELP ttweetsrv_request_duration_seconds Time spent handling a request.\n");
+  APPEND("# TYPE ttweetsrv_request_duration_seconds summary\n");
+  for (int requestCode = 0; requestCode < METRICS_REQ_TYPES; requestCode++)
+  {
+    if (latency[requestCode].count == 0)
+      continue;
+    snprintf(labels, sizeof(labels), "type=\"%s\"", request_type_name(requestCode));
+    if (written < bufferLen)
+      written += render_summary(buffer + written, bufferLen - written, "ttweetsrv_request_duration_seconds", labels, &latency[requestCode], 1e-9);
+  }
+
+  APPEND("# HELP ttweetsrv_tweet_fanout Number of users each tweet was queued for.\n");
+  APPEND("# TYPE ttweetsrv_tweet_fanout summary\n");
+  if (written < bufferLen)
+    written += render_summary(buffer + written, bufferLen - written, "ttweetsrv_tweet_fanout", "", &fanout, 1.0);
+
+  APPEND("# HELP ttweetsrv_pending_tweets Tweets queued and not yet delivered.\n");
+  APPEND("# TYPE ttweetsrv_pending_tweets gauge\n");
+  APPEND("ttweetsrv_pending_tweets %lld\n", (long long)counters[METRIC_QUEUE_DEPTH]);
+  APPEND("# HELP ttweetsrv_spilled_tweets Pending tweets written to the spill directory and not yet read back.\n");
+  APPEND("# TYPE ttweetsrv_spilled_tweets gauge\n");
+  APPEND("ttweetsrv_spilled_tweets %lld\n", (long long)counters[METRIC_SPILLED_TWEETS]);
+  APPEND("# HELP ttweetsrv_tweets_dropped_total Tweets dropped because a queue was full.\n");
+  APPEND("# TYPE ttweetsrv_tweets_dropped_total counter\n");
+  APPEND("ttweetsrv_tweets_dropped_total %lld\n", (long long)counters[METRIC_TWEETS_DROPPED]);
+  APPEND("# HELP ttweetsrv_tweets_shed_total Oldest pending tweets dropped to make room for newer ones.\n");
+  APPEND("# TYPE ttweetsrv_tweets_shed_total counter\n");
+  APPEND("ttweetsrv_tweets_shed_total %lld\n", (long long)counters[METRIC_TWEETS_SHED]);
+  APPEND("# HELP ttweetsrv_undelivered_bytes Bytes of pending tweets across all users.\n");
+  APPEND("# TYPE ttweetsrv_undelivered_bytes gauge\n");
+  APPEND("ttweetsrv_undelivered_bytes %lld\n", (long long)counters[METRIC_UNDELIVERED_BYTES]);
+  APPEND("# HELP ttweetsrv_rate_limited_total Requests refused by a per-user or per-IP rate limit.\n");
+  APPEND("# TYPE ttweetsrv_rate_limited_total counter\n");
+  APPEND("ttweetsrv_rate_limited_total %lld\n", (long long)counters[METRIC_RATE_LIMITED]);
+  APPEND("# HELP ttweetsrv_reads_paused_total Times a connection's requests were held back by a budget.\n");
+  APPEND("# TYPE ttweetsrv_reads_paused_total counter\n");
+  APPEND("ttweetsrv_reads_paused_total %lld\n", (long long)counters[METRIC_READS_PAUSED]);
+  APPEND("# HELP ttweetsrv_received_bytes_total Bytes received from clients.\n");
+  APPEND("# TYPE ttweetsrv_received_bytes_total counter\n");
+  APPEND("ttweetsrv_received_bytes_total %lld\n", (long long)counters[METRIC_BYTES_IN]);
+  APPEND("# HELP ttweetsrv_sent_bytes_total Bytes sent to clients.\n");
+  APPEND("# TYPE ttweetsrv_sent_bytes_total counter\n");
+  APPEND("ttweetsrv_sent_bytes_total %lld\n", (long long)counters[METRIC_BYTES_OUT]);
+  APPEND("# HELP ttweetsrv_compression_input_bytes_total Bytes of responses compression was tried on.\n");
+  APPEND("# TYPE ttweetsrv_compression_input_bytes_total counter\n");
+  APPEND("ttweetsrv_compression_input_bytes_total %lld\n", (long long)counters[METRIC_COMPRESS_RAW_BYTES]);
+  APPEND("# HELP ttweetsrv_compression_output_bytes_total Bytes those responses were sent as.\n");
+  APPEND("# TYPE ttweetsrv_compression_output_bytes_total counter\n");
+  APPEND("ttweetsrv_compression_output_bytes_total %lld\n", (long long)counters[METRIC_COMPRESS_PACKED_BYTES]);
+  APPEND("# HELP ttweetsrv_compression_seconds_total Time spent compressing responses.\n");
+  APPEND("# TYPE ttweetsrv_compression_seconds_total counter\n");
+  APPEND("ttweetsrv_compression_seconds_total %.9f\n", counters[METRIC_COMPRESS_NS] * 1e-9);
+  APPEND("# HELP ttweetsrv_connections_accepted_total Connections accepted.\n");
+  APPEND("# TYPE ttweetsrv_connections_accepted_total counter\n");
+  APPEND("ttweetsrv_connections_accepted_total %lld\n", (long long)counters[METRIC_CONN_ACCEPTED]);
+  APPEND("# HELP ttweetsrv_connections_rejected_total Connections rejected because the server was full.\n");
+  APPEND("# TYPE ttweetsrv_connections_rejected_total counter\n");
+  APPEND("ttweetsrv_connections_rejected_total %lld\n", (long long)counters[METRIC_CONN_REJECTED]);
+  APPEND("# HELP ttweetsrv_mux_sessions Users validated on multiplexed connections.\n");
+  APPEND("# TYPE ttweetsrv_mux_sessions gauge\n");
+  APPEND("ttweetsrv_mux_sessions %lld\n", (long long)counters[METRIC_MUX_SESSIONS]);
+  APPEND("# HELP ttweetsrv_timeouts_total Connections and sessions ended by the login or idle deadline.\n");
+  APPEND("# TYPE ttweetsrv_timeouts_total counter\n");
+  APPEND("ttweetsrv_timeouts_total %lld\n", (long long)counters[METRIC_TIMEOUTS]);
+  APPEND("# HELP ttweetsrv_workers Child processes currently holding a metrics shard.\n");
+  APPEND("# TYPE ttweetsrv_workers gauge\n");
+  APPEND("ttweetsrv_workers %d\n", activeWorkers);
+#undef APPEND
+
+  return written < bufferLen ? written : bufferLen - 1;
+}
+
+/** \copydoc metrics_serve_admin */
+void metrics_serve_admin(unsigned short port)
+{
+  int adminSock;
+  int clntSock;
+  int bodyLen;
+  char request[512];
+  char header[128];
+  static char body[1 << 17];
+  struct sockaddr_in adminAddr;
+  struct timeval ioTimeout = {1, 0}; /* A silent or stalled scraper holds the loop this long at most */
+  pid_t processID;
+
+  if ((adminSock = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0)
+    die_with_error("socket() failed for metrics");
+
+  memset(&adminAddr, 0, sizeof(adminAddr));
+  adminAddr.sin_family = AF_INET;
+  adminAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); /* Local access only */
+  adminAddr.sin_port = htons(port);
+
+  if (bind(adminSock, (struct sockaddr *)&adminAddr, sizeof(adminAddr)) < 0)
+    die_with_error("bind() failed for metrics");
+  if (listen(adminSock, MAX_PENDING) < 0)
+    die_with_error("listen() failed for metrics");
+
+  if ((processID = fork()) < 0)
+    die_with_error("fork() failed for metrics");
+  else if (processID > 0)
+  { /* Parent keeps accepting ttweet clients */
+    close(adminSock);
+    return;
+  }
+
+  signal(SIGTERM, SIG_DFL);         /* The server's handler only sets a flag this loop never reads */
+  prctl(PR_SET_PDEATHSIG, SIGTERM); /* Exit together with the server */
+  currentShard = NULL;              /* Admin process only reads shards */
+
+  while (1)
+  {
+    if ((clntSock = accept(adminSock, NULL, NULL)) < 0)
+      continue;
+    if (setsockopt(clntSock, SOL_SOCKET, SO_RCVTIMEO, &ioTimeout, sizeof(ioTimeout)) < 0 ||
+        setsockopt(clntSock, SOL_SOCKET, SO_SNDTIMEO, &ioTimeout, sizeof(ioTimeout)) < 0)
+      persist_with_error("setsockopt() failed for metrics");
+    recv(clntSock, request, sizeof(request), 0); /* Any request gets the metrics page */
+    bodyLen = metrics_render(body, sizeof(body));
+    snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %d\r\n\r\n", bodyLen);
+    /* A scraper that resets the connection must not kill this process with SIGPIPE */
+    send(clntSock, header, strlen(header), MSG_NOSIGNAL);
+    send(clntSock, body, bodyLen, MSG_NOSIGNAL);
+    close(clntSock);
+  }
+}
+
+static int render_summary(char *buffer, int bufferLen, char *name, char *labels, Histogram *histogram, double scale)
+{
+  int written = 0;
+  char *separator = labels[0] ? "," : "";
+
+  for (unsigned int quantileIdx = 0; quantileIdx < sizeof(exportedQuantiles) / sizeof(exportedQuantiles[0]); quantileIdx++)
+  {
+    if (written < bufferLen)
+      written += snprintf(buffer + written, bufferLen - written, "%s{%s%squantile=\"%g\"} %.9g\n", name, labels, separator,
+                          exportedQuantiles[quantileIdx], histogram_quantile(histogram, exportedQuantiles[quantileIdx]) * scale);
+  }
+  if (written < bufferLen)
+    written += snprintf(buffer + written, bufferLen - written, "%s_sum%s%s%s %.9g\n%s_count%s%s%s %llu\n",
+                        name, labels[0] ? "{" : "", labels, labels[0] ? "}" : "", histogram->sum * scale,
+                        name, labels[0] ? "{" : "", labels, labels[0] ? "}" : "", (unsigned long long)histogram->count);
+  return written;
+}
+
+static char *request_type_name(int requestCode)
+{
+  switch (requestCode)
+  {
+  case REQ_INVALID:
+    return "invalid";
+  case REQ_TWEET:
+    return "tweet";
+  case REQ_SUBSCRIBE:
+    return "subscribe";
+  case REQ_UNSUBSCRIBE:
+    return "unsubscribe";
+  case REQ_TIMELINE:
+    return "timeline";
+  case REQ_EXIT:
+    return "exit";
+  case REQ_VALIDATE_USER:
+    return "validate_user";
+  case REQ_PING:
+    return "ping";
+  case REQ_SUBSCRIBE_KEYWORD:
+    return "subscribe_keyword";
+  case REQ_UNSUBSCRIBE_KEYWORD:
+    return "unsubscribe_keyword";
+  case REQ_SEARCH:
+    return "search";
+  case REQ_TRENDING:
+    return "trending";
+  case REQ_FOLLOW:
+    return "follow";
+  case REQ_UNFOLLOW:
+    return "unfollow";
+  default:
+    return "other";
+  }
+}
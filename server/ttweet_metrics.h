@@ -0,0 +1,145 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_metrics.h
+  * @date 18 October 2026
+  * @brief Documentation for functions in ttweet_metrics.c.
+  *
+  * This header file has been created to describe the functions
+  * and declare constants in ttweet_metrics.c.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  */
+
+#ifndef TTWEET_COMMON_H
+#define TTWEET_COMMON_H
+#include "../dependencies/ttweet_common.h"
+void die_with_error(char *errorMessage);
+int persist_with_error(char *errorMessage);
+int send_payload(int sock, cJSON *jobjToSend);
+int receive_response(int sock, char *objReceived);
+#endif
+
+#ifndef TTWEET_METRICS_H
+#define TTWEET_METRICS_H
+
+#include "../dependencies/ttweet_histogram.h"
+
+/* Metric shards */
+#define METRICS_MAX_WORKERS 32 /* Shards available to child processes */
+#define METRICS_MAIN_SHARD 0   /* Shard reserved for the accepting parent process */
+
+/* Request types tracked (indexed by REQ_* code) */
+#define METRICS_REQ_TYPES 16
+
+/* Counter identifiers */
+#define METRIC_BYTES_IN 0
+#define METRIC_BYTES_OUT 1
+#define METRIC_TWEETS_DROPPED 2
+#define METRIC_CONN_ACCEPTED 3
+#define METRIC_CONN_REJECTED 4
+#define METRIC_QUEUE_DEPTH 5 /* Gauge: sum of deltas across shards */
+#define METRIC_MUX_SESSIONS 6 /* Gauge: validated users on multiplexed connections */
+#define METRIC_TIMEOUTS 7     /* Connections and sessions ended by a deadline */
+#define METRIC_TWEETS_SHED 8  /* Oldest pending tweets dropped to make room */
+#define METRIC_READS_PAUSED 9 /* Times a connection's requests were held back */
+#define METRIC_UNDELIVERED_BYTES 10 /* Gauge: bytes of pending tweets */
+#define METRIC_RATE_LIMITED 11 /* Requests refused by a rate limit */
+#define METRIC_COMPRESS_RAW_BYTES 12    /* Bytes of responses compression was tried on */
+#define METRIC_COMPRESS_PACKED_BYTES 13 /* Bytes those responses were sent as */
+#define METRIC_COMPRESS_NS 14           /* Time spent compressing responses */
+#define METRIC_SPILLED_TWEETS 15        /* Gauge: pending tweets waiting on disk */
+#define METRIC_COUNTERS 16
+
+typedef struct MetricsShard
+{
+  int ownerPid; /* Process currently writing to this shard, 0 if free */
+  int64_t counters[METRIC_COUNTERS];
+  Histogram requestLatency[METRICS_REQ_TYPES]; /* Nanoseconds */
+  Histogram fanout;                            /* Recipients per tweet */
+} MetricsShard;
+
+/**
+ * @brief Creates the shared metrics region
+ *
+ * Must be called by the parent process before any fork() so that
+ * every child writes to the same shared shards.
+ *
+ * @return void
+ */
+void metrics_init();
+
+/**
+ * @brief Claims a metrics shard for the calling child process
+ *
+ * Each child writes only to its own shard, so updates never contend.
+ * Shards owned by processes that no longer exist are reclaimed. Counts
+ * accumulated in a shard are kept when it changes owner.
+ *
+ * @return void
+ */
+void metrics_attach_worker();
+
+/**
+ * @brief Releases the shard claimed by metrics_attach_worker()
+ *
+ * @return void
+ */
+void metrics_detach_worker();
+
+/**
+ * @brief Adds delta to a counter in the caller's shard
+ *
+ * @param metric Counter identifier (METRIC_*)
+ * @param delta Amount to add, may be negative for gauges
+ * @return void
+ */
+void metrics_add(int metric, int64_t delta);
+
+/**
+ * @brief Records the latency of a handled request
+ *
+ * @param requestCode REQ_* code of the request
+ * @param latencyNs Time spent handling the request in nanoseconds
+ * @return void
+ */
+void metrics_observe_request(int requestCode, uint64_t latencyNs);
+
+/**
+ * @brief Records the number of users a tweet was delivered to
+ *
+ * @param recipients Number of users the tweet was queued for
+ * @return void
+ */
+void metrics_observe_fanout(uint64_t recipients);
+
+/**
+ * @brief Renders all shards in Prometheus text exposition format
+ *
+ * @param buffer Buffer to store the rendered metrics
+ * @param bufferLen Size of buffer in bytes
+ * @return int Number of bytes written to buffer
+ */
+int metrics_render(char *buffer, int bufferLen);
+
+/**
+ * @brief Starts the admin metrics listener
+ *
+ * Forks a process which listens on 127.0.0.1:port and answers every
+ * connection with an HTTP response containing metrics_render() output.
+ *
+ * @param port Loopback port to serve metrics on
+ * @return void
+ */
+void metrics_serve_admin(unsigned short port);
+
+#endif
@@ -0,0 +1,57 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_ratelimit.c
+  * @date 18 October 2026
+  * @brief Token buckets for limiting request rates across processes.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  *
+  * Buckets live in shared memory and are updated by every connection
+  * process without locks. Tokens are counted in thousandths so that rates
+  * of less than one token per millisecond still refill smoothly.
+  */
+
+#include "ttweet_ratelimit.h"
+
+/* Function prototypes */
+int token_bucket_take(TokenBucket *bucket, int ratePerSec, int burst, uint64_t nowMs); /* Takes one token */
+
+/** \copydoc token_bucket_take */
+int token_bucket_take(TokenBucket *bucket, int ratePerSec, int burst, uint64_t nowMs)
+{
+  uint64_t capacity = (uint64_t)(burst < TOKEN_BUCKET_MAX_BURST ? burst : TOKEN_BUCKET_MAX_BURST) * TOKEN_BUCKET_SCALE;
+  uint64_t oldState = __atomic_load_n(&bucket->state, __ATOMIC_RELAXED);
+  uint64_t newState;
+  uint64_t lastMs;
+  uint64_t tokens;
+
+  if (ratePerSec <= 0)
+    return 1;
+
+  do
+  {
+    lastMs = oldState >> TOKEN_BUCKET_TOKEN_BITS;
+    tokens = oldState & TOKEN_BUCKET_TOKEN_MASK;
+    if (nowMs > lastMs)
+    { /* ratePerSec tokens per second is ratePerSec thousandths per ms */
+      tokens += (nowMs - lastMs) * ratePerSec;
+      if (tokens > capacity)
+        tokens = capacity;
+      lastMs = nowMs;
+    }
+    if (tokens < TOKEN_BUCKET_SCALE)
+      return 0;
+    newState = (lastMs << TOKEN_BUCKET_TOKEN_BITS) | (tokens - TOKEN_BUCKET_SCALE);
+  } while (!__atomic_compare_exchange_n(&bucket->state, &oldState, newState, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+  return 1;
+}
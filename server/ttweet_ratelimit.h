@@ -0,0 +1,57 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_ratelimit.h
+  * @date 18 October 2026
+  * @brief Documentation for functions in ttweet_ratelimit.c.
+  *
+  * This header file has been created to describe the functions
+  * and declare constants in ttweet_ratelimit.c.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  */
+
+#ifndef TTWEET_RATELIMIT_H
+#define TTWEET_RATELIMIT_H
+
+#include <stdint.h>
+
+/* A bucket's state packs the time of its last refill (ms) above its tokens
+ * (thousandths of a token), so it can be updated with a single CAS */
+#define TOKEN_BUCKET_TOKEN_BITS 24
+#define TOKEN_BUCKET_TOKEN_MASK ((1ULL << TOKEN_BUCKET_TOKEN_BITS) - 1)
+#define TOKEN_BUCKET_SCALE 1000
+#define TOKEN_BUCKET_MAX_BURST (TOKEN_BUCKET_TOKEN_MASK / TOKEN_BUCKET_SCALE) /* 16777 tokens */
+#define RATE_LIMIT_TYPES 14 /* Buckets per user, indexed by REQ_* code */
+
+/* Rate limiter shared between processes. An all-zero bucket is full. */
+typedef struct TokenBucket
+{
+  uint64_t state;
+} TokenBucket;
+
+/**
+ * @brief Takes one token from a bucket if it has one
+ *
+ * Lock-free: the bucket is refilled for the time since its last refill
+ * and a token taken in one compare-and-swap, retried if another process
+ * got there first.
+ *
+ * @param bucket Bucket to take from, usually in shared memory
+ * @param ratePerSec Tokens added per second; 0 disables the limit
+ * @param burst Tokens the bucket holds when full, at most TOKEN_BUCKET_MAX_BURST
+ * @param nowMs Current time in milliseconds, from a monotonic clock
+ * @return int 1 if a token was taken (or the limit is disabled); 0 otherwise.
+ */
+int token_bucket_take(TokenBucket *bucket, int ratePerSec, int burst, uint64_t nowMs);
+
+#endif
@@ -0,0 +1,523 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_search.c
+  * @date 18 October 2026
+  * @brief Inverted index of recent tweets, shared by all server processes.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  *
+  * Every term of a segment has a posting list of the tweets containing it.
+  * Lists are chunks of varint encoded gaps between tweet numbers, linked
+  * from newest to oldest. Every SEARCH_SKIP_SPAN-th chunk is a milestone,
+  * and each chunk links back to the newest milestone older than itself,
+  * so a cursor seeking backwards crosses SEARCH_SKIP_SPAN chunks per hop.
+  *
+  * A query is answered newest first, one segment at a time. The terms of
+  * an alternative are intersected by leapfrogging: each cursor seeks to the
+  * newest tweet no newer than the current candidate, and the candidate
+  * drops to whatever a cursor lands on until all cursors agree.
+  * Alternatives are merged by taking the newest of their next matches.
+  *
+  * The window slides a segment at a time: the oldest segment is cleared
+  * and reused, so nothing is ever removed from a posting list.
+  */
+
+#include "ttweet_search.h"
+#include <ctype.h>    /* for isalnum() and tolower() */
+#include <stdio.h>    /* for snprintf() */
+#include <string.h>   /* for memset() and strcmp() */
+#include <sys/mman.h> /* for mmap() */
+
+#define SEARCH_TERM_LOAD_NUM 3 /* Segments are sealed when their term table is 3/4 full */
+#define SEARCH_TERM_LOAD_DEN 4
+#define SEARCH_CHUNKS_PER_TWEET 8       /* Average budget; a segment is sealed early when it runs out */
+#define SEARCH_TEXT_BYTES_PER_TWEET 128 /* Likewise */
+#define SEARCH_CHUNK_IDS (SEARCH_CHUNK_PAYLOAD + 1) /* Each gap takes at least one byte */
+
+/* Position of a term in its posting list, from the newest tweet backwards */
+typedef struct SearchCursor
+{
+  const SearchChunk *chunks;
+  int32_t chunk;    /* Current chunk, SEARCH_NIL when the list is exhausted */
+  int numIds;       /* Ids decoded from the current chunk, 0 if not decoded yet */
+  int pos;          /* Newest decoded id not yet ruled out */
+  int32_t ids[SEARCH_CHUNK_IDS];
+} SearchCursor;
+
+/* Function prototypes */
+SearchIndex *search_index_create(int windowTweets);                                                                                  /* Creates an empty index */
+void search_index_destroy(SearchIndex *index);                                                                                       /* Releases an index */
+void search_index_add(SearchIndex *index, const char *username, const char *text, char hashtags[][MAX_HASHTAG_LEN], int numHashtags); /* Indexes a tweet */
+int search_index_query(SearchIndex *index, const char *query, char results[][MAX_TWEET_ITEM_LEN], int maxResults);                    /* Finds the newest matching tweets */
+int parse_search_query(const char *query, SearchQuery *parsed);                                                                      /* Parses a query */
+
+/* Static helpers */
+static size_t index_size(int segmentTweets, int segmentTermSlots, int segmentChunks, int segmentTextBytes);
+static uint32_t hash_term(const char *term);
+static void fold_term(char *folded, const char *term, int len, int isHashtag);
+static int add_term(char terms[][SEARCH_MAX_TERM_LEN + 1], int numTerms, const char *term, int len, int isHashtag);
+static int collect_terms(const char *text, char hashtags[][MAX_HASHTAG_LEN], int numHashtags, char terms[][SEARCH_MAX_TERM_LEN + 1]);
+static SearchTerm *find_term(SearchIndex *index, SearchSegment *segment, const char *term, uint32_t hash);
+static int has_room(SearchIndex *index, SearchSegment *segment, int numTerms, int textLen);
+static void reset_segment(SearchIndex *index, SearchSegment *segment);
+static void append_posting(SearchSegment *segment, SearchTerm *term, int32_t id);
+static int encode_gap(uint32_t gap, uint8_t *bytes);
+static int32_t cursor_seek(SearchCursor *cursor, int32_t bound);
+static int32_t clause_seek(SearchCursor *cursors, int numCursors, int32_t bound);
+static int query_segment(SearchIndex *index, SearchSegment *segment, const SearchQuery *query, char results[][MAX_TWEET_ITEM_LEN], int maxResults);
+
+/** \copydoc search_index_create */
+SearchIndex *search_index_create(int windowTweets)
+{
+  int segmentTweets = (windowTweets + SEARCH_SEGMENTS - 2) / (SEARCH_SEGMENTS - 1); /* The other segments hold the window */
+  int segmentTermSlots = 1;
+  int segmentChunks = segmentTweets * SEARCH_CHUNKS_PER_TWEET + SEARCH_MAX_TWEET_TERMS;
+  int segmentTextBytes = (segmentTweets * SEARCH_TEXT_BYTES_PER_TWEET + MAX_TWEET_ITEM_LEN + 7) & ~7; /* Keeps the next segment aligned */
+  char *region;
+  char *next;
+  SearchIndex *index;
+
+  while (segmentTermSlots * SEARCH_TERM_LOAD_NUM / SEARCH_TERM_LOAD_DEN < 2 * segmentTweets + SEARCH_MAX_TWEET_TERMS)
+    segmentTermSlots *= 2;
+  region = mmap(NULL, index_size(segmentTweets, segmentTermSlots, segmentChunks, segmentTextBytes), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (region == MAP_FAILED)
+    return NULL;
+  index = (SearchIndex *)region;
+  index->lock = 0;
+  index->current = 0;
+  index->segmentTweets = segmentTweets;
+  index->segmentTermSlots = segmentTermSlots;
+  index->segmentChunks = segmentChunks;
+  index->segmentTextBytes = segmentTextBytes;
+  index->size = index_size(segmentTweets, segmentTermSlots, segmentChunks, segmentTextBytes);
+
+  /* Anonymous memory starts zeroed, so every segment starts empty */
+  next = region + sizeof(SearchIndex);
+  for (int segmentIdx = 0; segmentIdx < SEARCH_SEGMENTS; segmentIdx++)
+  {
+    index->segments[segmentIdx].terms = (SearchTerm *)next;
+    next += sizeof(SearchTerm) * segmentTermSlots;
+    index->segments[segmentIdx].chunks = (SearchChunk *)next;
+    next += sizeof(SearchChunk) * segmentChunks;
+    index->segments[segmentIdx].tweetOffsets = (int *)next;
+    next += sizeof(int) * segmentTweets;
+    index->segments[segmentIdx].text = next;
+    next += segmentTextBytes;
+  }
+  return index;
+}
+
+/** \copydoc search_index_destroy */
+void search_index_destroy(SearchIndex *index)
+{
+  munmap(index, index->size);
+}
+
+/** \copydoc search_index_add */
+void search_index_add(SearchIndex *index, const char *username, const char *text, char hashtags[][MAX_HASHTAG_LEN], int numHashtags)
+{
+  char terms[SEARCH_MAX_TWEET_TERMS][SEARCH_MAX_TERM_LEN + 1];
+  int numTerms = collect_terms(text, hashtags, numHashtags, terms);
+  char tweet[MAX_TWEET_ITEM_LEN];
+  int textLen;
+  SearchSegment *segment;
+  SearchTerm *term;
+  uint32_t hash;
+  int32_t id;
+
+  /* Displayed like a timeline entry, but with every hashtag */
+  textLen = snprintf(tweet, sizeof(tweet), "%s: %s", username, text);
+  for (int hashtagIdx = 0; hashtagIdx < numHashtags && textLen < (int)sizeof(tweet); hashtagIdx++)
+    textLen += snprintf(tweet + textLen, sizeof(tweet) - textLen, " #%s", hashtags[hashtagIdx]);
+  if (textLen >= (int)sizeof(tweet))
+    textLen = sizeof(tweet) - 1;
+
+  spin_lock(&index->lock);
+  segment = &index->segments[index->current];
+  if (!has_room(index, segment, numTerms, textLen))
+  { /* Seal the current segment and reuse the oldest */
+    index->current = (index->current + 1) % SEARCH_SEGMENTS;
+    segment = &index->segments[index->current];
+    reset_segment(index, segment);
+  }
+
+  id = segment->numTweets++;
+  segment->tweetOffsets[id] = segment->textUsed;
+  memcpy(segment->text + segment->textUsed, tweet, textLen);
+  segment->text[segment->textUsed + textLen] = '\0';
+  segment->textUsed += textLen + 1;
+
+  for (int termIdx = 0; termIdx < numTerms; termIdx++)
+  {
+    hash = hash_term(terms[termIdx]);
+    term = find_term(index, segment, terms[termIdx], hash);
+    if (term->hash == 0)
+    { /* First use of the term in this segment */
+      term->hash = hash;
+      term->lastChunk = SEARCH_NIL;
+      term->lastMilestone = SEARCH_NIL;
+      term->numChunks = 0;
+      strcpy(term->term, terms[termIdx]);
+      segment->numTerms++;
+    }
+    append_posting(segment, term, id);
+  }
+  spin_unlock(&index->lock);
+}
+
+/** \copydoc search_index_query */
+int search_index_query(SearchIndex *index, const char *query, char results[][MAX_TWEET_ITEM_LEN], int maxResults)
+{
+  SearchQuery parsed;
+  int numResults = 0;
+  int segmentIdx;
+
+  if (!parse_search_query(query, &parsed))
+    return -1;
+  spin_lock(&index->lock);
+  for (int age = 0; age < SEARCH_SEGMENTS && numResults < maxResults; age++)
+  { /* Newest segment first */
+    segmentIdx = (index->current - age + SEARCH_SEGMENTS) % SEARCH_SEGMENTS;
+    numResults += query_segment(index, &index->segments[segmentIdx], &parsed, results + numResults, maxResults - numResults);
+  }
+  spin_unlock(&index->lock);
+  return numResults;
+}
+
+/** \copydoc parse_search_query */
+int parse_search_query(const char *query, SearchQuery *parsed)
+{
+  const char *token = query;
+  int tokenLen;
+  int isHashtag;
+  int clauseStart = 0;
+
+  parsed->numTerms = 0;
+  parsed->numClauses = 0;
+  while (1)
+  {
+    while (*token == ' ')
+      token++;
+    tokenLen = strcspn(token, " ");
+    if (tokenLen == 0 || (tokenLen == 2 && strncmp(token, "OR", 2) == 0))
+    { /* End of an alternative, which must not be empty */
+      if (parsed->numTerms == clauseStart)
+        return 0;
+      parsed->clauseEnds[parsed->numClauses++] = parsed->numTerms;
+      clauseStart = parsed->numTerms;
+      if (tokenLen == 0)
+        return 1;
+      token += tokenLen;
+      continue;
+    }
+
+    isHashtag = token[0] == '#';
+    if (tokenLen - isHashtag < 1 || tokenLen - isHashtag > MAX_HASHTAG_LEN - 1 || parsed->numTerms == SEARCH_MAX_QUERY_TERMS)
+      return 0;
+    for (int charIdx = isHashtag; charIdx < tokenLen; charIdx++)
+    {
+      if (!isalnum((unsigned char)token[charIdx]))
+        return 0;
+    }
+    fold_term(parsed->terms[parsed->numTerms], token + isHashtag, tokenLen - isHashtag, isHashtag);
+    parsed->numTerms++;
+    for (int termIdx = clauseStart; termIdx < parsed->numTerms - 1; termIdx++)
+    {
+      if (strcmp(parsed->terms[termIdx], parsed->terms[parsed->numTerms - 1]) == 0)
+      { /* Repeating a term within an alternative changes nothing */
+        parsed->numTerms--;
+        break;
+      }
+    }
+    token += tokenLen;
+  }
+}
+
+static size_t index_size(int segmentTweets, int segmentTermSlots, int segmentChunks, int segmentTextBytes)
+{
+  return sizeof(SearchIndex) + SEARCH_SEGMENTS * (sizeof(SearchTerm) * segmentTermSlots + sizeof(SearchChunk) * segmentChunks + sizeof(int) * segmentTweets + segmentTextBytes);
+}
+
+/* FNV-1a, never 0 so that 0 can mark free slots */
+static uint32_t hash_term(const char *term)
+{
+  uint32_t hash = 2166136261u;
+
+  while (*term != '\0')
+  {
+    hash ^= (unsigned char)*term++;
+    hash *= 16777619u;
+  }
+  return hash == 0 ? 1 : hash;
+}
+
+/* Writes a term in lower case, with '#' in front of a hashtag */
+static void fold_term(char *folded, const char *term, int len, int isHashtag)
+{
+  if (isHashtag)
+    *folded++ = '#';
+  for (int charIdx = 0; charIdx < len; charIdx++)
+    *folded++ = tolower((unsigned char)term[charIdx]);
+  *folded = '\0';
+}
+
+/* Appends a term unless already present or terms is full. Returns the new
+ * number of terms. */
+static int add_term(char terms[][SEARCH_MAX_TERM_LEN + 1], int numTerms, const char *term, int len, int isHashtag)
+{
+  if (numTerms == SEARCH_MAX_TWEET_TERMS)
+    return numTerms;
+  fold_term(terms[numTerms], term, len, isHashtag);
+  for (int termIdx = 0; termIdx < numTerms; termIdx++)
+  {
+    if (strcmp(terms[termIdx], terms[numTerms]) == 0)
+      return numTerms;
+  }
+  return numTerms + 1;
+}
+
+/* Hashtags first, so that a long text cannot crowd them out */
+static int collect_terms(const char *text, char hashtags[][MAX_HASHTAG_LEN], int numHashtags, char terms[][SEARCH_MAX_TERM_LEN + 1])
+{
+  int numTerms = 0;
+  int wordLen;
+
+  for (int hashtagIdx = 0; hashtagIdx < numHashtags; hashtagIdx++)
+    numTerms = add_term(terms, numTerms, hashtags[hashtagIdx], strnlen(hashtags[hashtagIdx], MAX_HASHTAG_LEN - 1), 1);
+  while (*text != '\0')
+  {
+    for (wordLen = 0; isalnum((unsigned char)text[wordLen]); wordLen++)
+      ;
+    if (wordLen == 0)
+    {
+      text++;
+      continue;
+    }
+    if (wordLen <= MAX_HASHTAG_LEN - 1) /* Longer words cannot be searched for */
+      numTerms = add_term(terms, numTerms, text, wordLen, 0);
+    text += wordLen;
+  }
+  return numTerms;
+}
+
+/* Slot holding term, or the free slot where it belongs */
+static SearchTerm *find_term(SearchIndex *index, SearchSegment *segment, const char *term, uint32_t hash)
+{
+  uint32_t mask = index->segmentTermSlots - 1;
+  uint32_t slot = hash & mask;
+
+  while (segment->terms[slot].hash != 0 && (segment->terms[slot].hash != hash || strcmp(segment->terms[slot].term, term) != 0))
+    slot = (slot + 1) & mask;
+  return &segment->terms[slot];
+}
+
+/* Room for one more tweet even if every term needs a new slot and chunk */
+static int has_room(SearchIndex *index, SearchSegment *segment, int numTerms, int textLen)
+{
+  return segment->numTweets < index->segmentTweets &&
+         segment->numChunks + numTerms <= index->segmentChunks &&
+         segment->textUsed + textLen + 1 <= index->segmentTextBytes &&
+         segment->numTerms + numTerms <= index->segmentTermSlots * SEARCH_TERM_LOAD_NUM / SEARCH_TERM_LOAD_DEN;
+}
+
+/* Chunks and text are overwritten as they are reused, so only the term
+ * table needs clearing */
+static void reset_segment(SearchIndex *index, SearchSegment *segment)
+{
+  if (segment->numTerms > 0)
+    memset(segment->terms, 0, sizeof(SearchTerm) * index->segmentTermSlots);
+  segment->numTweets = 0;
+  segment->numTerms = 0;
+  segment->numChunks = 0;
+  segment->textUsed = 0;
+}
+
+/* Ids are appended in increasing order */
+static void append_posting(SearchSegment *segment, SearchTerm *term, int32_t id)
+{
+  SearchChunk *chunk = term->lastChunk == SEARCH_NIL ? NULL : &segment->chunks[term->lastChunk];
+  uint8_t gapBytes[5];
+  int gapLen;
+
+  if (chunk != NULL)
+  {
+    gapLen = encode_gap(id - chunk->lastId, gapBytes);
+    if (chunk->used + gapLen <= SEARCH_CHUNK_PAYLOAD)
+    {
+      memcpy(chunk->payload + chunk->used, gapBytes, gapLen);
+      chunk->used += gapLen;
+      chunk->lastId = id;
+      return;
+    }
+  }
+
+  /* Start a new chunk; has_room() guaranteed there is one */
+  chunk = &segment->chunks[segment->numChunks];
+  chunk->prev = term->lastChunk;
+  chunk->skip = term->lastMilestone;
+  chunk->firstId = id;
+  chunk->lastId = id;
+  chunk->used = 0;
+  term->lastChunk = segment->numChunks++;
+  if (term->numChunks++ % SEARCH_SKIP_SPAN == 0)
+    term->lastMilestone = term->lastChunk;
+}
+
+/* LEB128: 7 bits per byte, high bit set on all but the last */
+static int encode_gap(uint32_t gap, uint8_t *bytes)
+{
+  int len = 0;
+
+  while (gap >= 0x80)
+  {
+    bytes[len++] = (gap & 0x7f) | 0x80;
+    gap >>= 7;
+  }
+  bytes[len++] = gap;
+  return len;
+}
+
+/* Newest id of the cursor's list that is at most bound, or SEARCH_NIL.
+ * Bounds must not increase between calls on the same cursor. */
+static int32_t cursor_seek(SearchCursor *cursor, int32_t bound)
+{
+  const SearchChunk *chunks = cursor->chunks;
+  const SearchChunk *chunk;
+  int32_t next;
+  int32_t id;
+  uint32_t gap;
+  int shift;
+
+  while (cursor->chunk != SEARCH_NIL && chunks[cursor->chunk].firstId > bound)
+  { /* The whole chunk is too new: leap to a milestone if it is still too new, else step */
+    next = chunks[cursor->chunk].skip;
+    if (next == SEARCH_NIL || chunks[next].firstId <= bound)
+      next = chunks[cursor->chunk].prev;
+    cursor->chunk = next;
+    cursor->numIds = 0;
+  }
+  if (cursor->chunk == SEARCH_NIL)
+    return SEARCH_NIL;
+
+  chunk = &chunks[cursor->chunk];
+  if (cursor->numIds == 0)
+  {
+    id = chunk->firstId;
+    cursor->ids[cursor->numIds++] = id;
+    for (int byteIdx = 0; byteIdx < chunk->used;)
+    {
+      gap = 0;
+      shift = 0;
+      do
+      {
+        gap |= (uint32_t)(chunk->payload[byteIdx] & 0x7f) << shift;
+        shift += 7;
+      } while (chunk->payload[byteIdx++] & 0x80);
+      id += gap;
+      cursor->ids[cursor->numIds++] = id;
+    }
+    cursor->pos = cursor->numIds - 1;
+  }
+  while (cursor->ids[cursor->pos] > bound)
+    cursor->pos--; /* Stops at ids[0] at the latest, since firstId <= bound */
+  return cursor->ids[cursor->pos];
+}
+
+/* Newest id at most bound found by every cursor, or SEARCH_NIL */
+static int32_t clause_seek(SearchCursor *cursors, int numCursors, int32_t bound)
+{
+  int32_t candidate = cursor_seek(&cursors[0], bound);
+  int32_t id;
+  int numAgreed = 1;
+
+  for (int cursorIdx = 1 % numCursors; candidate != SEARCH_NIL && numAgreed < numCursors; cursorIdx = (cursorIdx + 1) % numCursors)
+  {
+    id = cursor_seek(&cursors[cursorIdx], candidate);
+    if (id == candidate)
+    {
+      numAgreed++;
+    }
+    else
+    { /* Older, or SEARCH_NIL which ends the search */
+      candidate = id;
+      numAgreed = 1;
+    }
+  }
+  return candidate;
+}
+
+static int query_segment(SearchIndex *index, SearchSegment *segment, const SearchQuery *query, char results[][MAX_TWEET_ITEM_LEN], int maxResults)
+{
+  SearchCursor cursors[SEARCH_MAX_QUERY_TERMS];
+  SearchCursor swap;
+  int termChunks[SEARCH_MAX_QUERY_TERMS];
+  int32_t next[SEARCH_MAX_QUERY_TERMS]; /* Next match of each clause, SEARCH_NIL when exhausted */
+  int clauseStart = 0;
+  int numResults = 0;
+  int32_t newest;
+  SearchTerm *term;
+
+  if (segment->numTweets == 0)
+    return 0;
+  for (int clauseIdx = 0; clauseIdx < query->numClauses; clauseIdx++)
+  {
+    next[clauseIdx] = segment->numTweets - 1;
+    for (int termIdx = clauseStart; termIdx < query->clauseEnds[clauseIdx]; termIdx++)
+    {
+      term = find_term(index, segment, query->terms[termIdx], hash_term(query->terms[termIdx]));
+      if (term->hash == 0)
+      { /* A missing term rules out the whole clause */
+        next[clauseIdx] = SEARCH_NIL;
+        break;
+      }
+      cursors[termIdx].chunks = segment->chunks;
+      cursors[termIdx].chunk = term->lastChunk;
+      cursors[termIdx].numIds = 0;
+      termChunks[termIdx] = term->numChunks;
+      if (termChunks[termIdx] < termChunks[clauseStart])
+      { /* The rarest term goes first, so that it proposes the candidates */
+        swap = cursors[clauseStart];
+        cursors[clauseStart] = cursors[termIdx];
+        cursors[termIdx] = swap;
+        termChunks[termIdx] = termChunks[clauseStart];
+        termChunks[clauseStart] = term->numChunks;
+      }
+    }
+    if (next[clauseIdx] != SEARCH_NIL)
+      next[clauseIdx] = clause_seek(&cursors[clauseStart], query->clauseEnds[clauseIdx] - clauseStart, next[clauseIdx]);
+    clauseStart = query->clauseEnds[clauseIdx];
+  }
+
+  while (numResults < maxResults)
+  {
+    newest = SEARCH_NIL;
+    for (int clauseIdx = 0; clauseIdx < query->numClauses; clauseIdx++)
+    {
+      if (next[clauseIdx] > newest)
+        newest = next[clauseIdx];
+    }
+    if (newest == SEARCH_NIL)
+      break;
+    strcpy(results[numResults++], segment->text + segment->tweetOffsets[newest]);
+
+    /* Advance every clause that matched the same tweet */
+    clauseStart = 0;
+    for (int clauseIdx = 0; clauseIdx < query->numClauses; clauseIdx++)
+    {
+      if (next[clauseIdx] == newest)
+        next[clauseIdx] = newest == 0 ? SEARCH_NIL : clause_seek(&cursors[clauseStart], query->clauseEnds[clauseIdx] - clauseStart, newest - 1);
+      clauseStart = query->clauseEnds[clauseIdx];
+    }
+  }
+  return numResults;
+}
@@ -0,0 +1,170 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_search.h
+  * @date 18 October 2026
+  * @brief Documentation for functions in ttweet_search.c.
+  *
+  * This header file has been created to describe the functions
+  * and declare constants in ttweet_search.c.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  */
+
+#ifndef TTWEET_COMMON_H
+#define TTWEET_COMMON_H
+#include "../dependencies/ttweet_common.h"
+void die_with_error(char *errorMessage);
+int persist_with_error(char *errorMessage);
+int send_payload(int sock, cJSON *jobjToSend);
+int receive_response(int sock, char *objReceived);
+void spin_lock(int *lock);
+void spin_unlock(int *lock);
+#endif
+
+#ifndef TTWEET_SEARCH_H
+#define TTWEET_SEARCH_H
+
+#define SEARCH_NIL -1                    /* No chunk */
+#define SEARCH_SEGMENTS 8                /* The window is dropped one segment at a time */
+#define SEARCH_MAX_TERM_LEN MAX_HASHTAG_LEN /* '#' and a hashtag, or a word of up to MAX_HASHTAG_LEN - 1 chars */
+#define SEARCH_MAX_TWEET_TERMS 48        /* Distinct terms indexed per tweet, the rest are ignored */
+#define SEARCH_MAX_QUERY_TERMS 8         /* Terms in a query, over all alternatives */
+#define SEARCH_CHUNK_PAYLOAD 15          /* Bytes of gaps in a SearchChunk */
+#define SEARCH_SKIP_SPAN 16              /* Chunks between skip milestones of a posting list */
+
+/* Piece of a posting list: the tweets containing a term, in increasing
+ * order, stored as the first tweet and then varint encoded gaps. Chunks
+ * are linked newest to oldest, since searches want the newest tweets. */
+typedef struct SearchChunk
+{
+  int32_t prev;    /* Older chunk of the same term, SEARCH_NIL if none */
+  int32_t skip;    /* Newest milestone chunk older than this one, SEARCH_NIL if none */
+  int32_t firstId; /* Index of the first tweet in the segment */
+  int32_t lastId;
+  uint8_t used;    /* Bytes of payload in use */
+  uint8_t payload[SEARCH_CHUNK_PAYLOAD];
+} SearchChunk;
+
+/* Slot of the open addressing table of terms of a segment */
+typedef struct SearchTerm
+{
+  uint32_t hash;           /* 0 if the slot is free */
+  int32_t lastChunk;       /* Newest chunk of the posting list */
+  int32_t lastMilestone;   /* Newest chunk whose position is a multiple of SEARCH_SKIP_SPAN */
+  int32_t numChunks;
+  char term[SEARCH_MAX_TERM_LEN + 1];
+} SearchTerm;
+
+/* Tweets indexed together and dropped together. Tweet i of the segment is
+ * the i-th tweet added since the segment was reset. */
+typedef struct SearchSegment
+{
+  int numTweets;
+  int numTerms;
+  int numChunks;
+  int textUsed;
+  int *tweetOffsets; /* Start of each tweet in text */
+  char *text;        /* Tweets as displayed, NUL terminated */
+  SearchTerm *terms;
+  SearchChunk *chunks;
+} SearchSegment;
+
+/* Inverted index of the most recent tweets, in shared memory. New tweets go
+ * to the current segment; when it is full the oldest segment is cleared and
+ * becomes current, so between (SEARCH_SEGMENTS - 1) / SEARCH_SEGMENTS of
+ * the capacity and all of it is searchable. */
+typedef struct SearchIndex
+{
+  int lock;    /* Spinlock held by every operation */
+  int current; /* Segment receiving new tweets */
+  int segmentTweets;
+  int segmentTermSlots; /* Power of two */
+  int segmentChunks;
+  int segmentTextBytes;
+  size_t size; /* Bytes mapped */
+  SearchSegment segments[SEARCH_SEGMENTS];
+} SearchIndex;
+
+/* A parsed query: alternatives separated by OR, each a list of terms that
+ * must all occur */
+typedef struct SearchQuery
+{
+  int numTerms;
+  int numClauses;
+  int clauseEnds[SEARCH_MAX_QUERY_TERMS]; /* Clause i is terms[clauseEnds[i - 1]] to terms[clauseEnds[i] - 1] */
+  char terms[SEARCH_MAX_QUERY_TERMS][SEARCH_MAX_TERM_LEN + 1];
+} SearchQuery;
+
+/**
+ * @brief Creates an empty search index in shared memory
+ *
+ * Call before fork() so that every child indexes into and searches the
+ * same tweets.
+ *
+ * @param windowTweets Tweets that always stay searchable, at least 1
+ * @return SearchIndex* The index, or NULL if mmap() failed.
+ */
+SearchIndex *search_index_create(int windowTweets);
+
+/**
+ * @brief Releases an index from search_index_create()
+ *
+ * @param index Index to release
+ * @return void
+ */
+void search_index_destroy(SearchIndex *index);
+
+/**
+ * @brief Indexes a tweet by its hashtags and the words of its text
+ *
+ * Words are runs of letters and digits, and like hashtags are indexed in
+ * lower case. Words longer than a hashtag are not indexed.
+ *
+ * @param index Index to add to
+ * @param username Sender of the tweet
+ * @param text Text of the tweet
+ * @param hashtags Hashtags of the tweet, without '#'
+ * @param numHashtags Number of hashtags
+ * @return void
+ */
+void search_index_add(SearchIndex *index, const char *username, const char *text, char hashtags[][MAX_HASHTAG_LEN], int numHashtags);
+
+/**
+ * @brief Finds the newest tweets matching a query
+ *
+ * Posting lists are walked from their newest chunk, leaping over chunks
+ * with skip links, so the cost depends on the results wanted rather than
+ * on the size of the window.
+ *
+ * @param index Index to search
+ * @param query Query accepted by parse_search_query()
+ * @param results Receives the matching tweets as displayed, newest first
+ * @param maxResults Capacity of results
+ * @return int Number of results, or -1 if the query is invalid.
+ */
+int search_index_query(SearchIndex *index, const char *query, char results[][MAX_TWEET_ITEM_LEN], int maxResults);
+
+/**
+ * @brief Parses a search query
+ *
+ * A query is terms separated by spaces, with OR between alternatives, e.g.
+ * "outage db OR #ops" finds tweets with both outage and db, or hashtag ops.
+ * A term is a word of letters and digits or a hashtag, matched in any case.
+ *
+ * @param query Query typed by the user
+ * @param parsed Receives the terms in lower case, grouped by alternative
+ * @return int 1 if valid; 0 if empty, malformed, or with more than SEARCH_MAX_QUERY_TERMS terms.
+ */
+int parse_search_query(const char *query, SearchQuery *parsed);
+
+#endif
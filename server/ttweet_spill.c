@@ -0,0 +1,345 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_spill.c
+  * @date 18 October 2026
+  * @brief Pending tweets that overflow a user's queue, kept on disk.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  *
+  * Each shard appends the records of its users to one segment file at a
+  * time, in the order they arrive, and starts a new file every
+  * SPILL_SEGMENT_SIZE bytes. A record's header holds the position of the
+  * next record of the same queue, written when that record is appended,
+  * so a queue is a linked list through the segments and reading it back
+  * costs one read per tweet. Records are never rewritten otherwise.
+  *
+  * A queue's records all lie in or after the segment of its head. So the
+  * shard only counts the heads in each segment, and every segment before
+  * the oldest one holding a head is deleted. Memory stays the same however
+  * many tweets are spilled, and dropping a whole queue costs nothing more
+  * than moving its head away.
+  */
+
+#include "ttweet_spill.h"
+#include <dirent.h>   /* for opendir() and readdir() */
+#include <fcntl.h>    /* for open() */
+#include <stddef.h>   /* for offsetof() */
+#include <sys/mman.h> /* for mmap() */
+#include <time.h>     /* for clock_gettime() */
+#include <unistd.h>   /* for pread(), pwrite() and unlink() */
+
+#define SPILL_MAGIC 0x53505454 /* "TTPS" read little endian */
+#define SEGMENT_FDS 64          /* Segment files each process keeps open */
+#define SEGMENT_PATH_LEN (SPILL_MAX_DIR_LEN + 32)
+
+/* Function prototypes */
+SpillStore *spill_store_open(const char *dir);                                       /* Opens a spill directory */
+void spill_store_close(SpillStore *store);                                           /* Closes a store and deletes its segments */
+void spill_queue_init(SpillQueue *queue, const char *username);                      /* Starts an empty queue */
+int spill_store_append(SpillStore *store, SpillQueue *queue, const char *tweetItem); /* Writes a tweet to the end of a queue */
+int spill_store_pop(SpillStore *store, SpillQueue *queue, char *tweetItem);          /* Reads the oldest tweet of a queue */
+int64_t spill_store_clear(SpillStore *store, SpillQueue *queue);                     /* Drops every tweet of a queue */
+
+/* Start of every record, followed by the tweet item */
+typedef struct SpillRecordHeader
+{
+  uint64_t next;   /* Next record of the same queue; SPILL_NIL until it is appended */
+  uint32_t length; /* Bytes of the tweet item, NUL included */
+  uint32_t magic;  /* SPILL_MAGIC */
+} SpillRecordHeader;
+
+/* An open segment file of this process */
+typedef struct SegmentFd
+{
+  int fd; /* -1 if the entry is unused */
+  int shard;
+  uint32_t segment;
+} SegmentFd;
+
+/* Static helpers */
+static uint64_t make_ref(uint32_t segment, uint32_t offset);
+static uint32_t ref_segment(uint64_t ref);
+static uint32_t ref_offset(uint64_t ref);
+static void segment_path(SpillStore *store, int shardIdx, uint32_t segment, char *path);
+static int segment_fd(SpillStore *store, int shardIdx, uint32_t segment, int create);
+static void close_deleted_segments(SpillStore *store);
+static void delete_unused_segments(SpillStore *store, int shardIdx);
+static int link_record(SpillStore *store, SpillQueue *queue, uint64_t ref);
+
+/* Private to each process: inherited by fork(), but segments created
+ * later are opened by path in each process that needs them */
+static SegmentFd segmentFds[SEGMENT_FDS];
+
+/** \copydoc spill_store_open */
+SpillStore *spill_store_open(const char *dir)
+{
+  char path[SEGMENT_PATH_LEN];
+  struct dirent *dirEntry;
+  DIR *dirStream;
+  SpillStore *store;
+  struct timespec now;
+  unsigned int segment;
+  int shardIdx;
+
+  if (strlen(dir) >= SPILL_MAX_DIR_LEN || (dirStream = opendir(dir)) == NULL)
+    return NULL;
+  store = mmap(NULL, sizeof(SpillStore), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (store == MAP_FAILED)
+  {
+    closedir(dirStream);
+    return NULL;
+  }
+  memset(store, 0, sizeof(SpillStore));
+  strcpy(store->dir, dir);
+  clock_gettime(CLOCK_REALTIME, &now);
+  store->runId = ((uint64_t)now.tv_sec * 1000000000 + now.tv_nsec) ^ ((uint64_t)getpid() << 48);
+  while ((dirEntry = readdir(dirStream)) != NULL)
+  { /* Only names segment_path() makes */
+    if (sscanf(dirEntry->d_name, "spill-%2d-%8x.seg", &shardIdx, &segment) != 2)
+      continue;
+    segment_path(store, shardIdx, segment, path);
+    if (strcmp(path + strlen(dir) + 1, dirEntry->d_name) == 0)
+      unlink(path);
+  }
+  closedir(dirStream);
+
+  for (int fdIdx = 0; fdIdx < SEGMENT_FDS; fdIdx++)
+    segmentFds[fdIdx].fd = -1;
+  return store;
+}
+
+/** \copydoc spill_store_close */
+void spill_store_close(SpillStore *store)
+{
+  char path[SEGMENT_PATH_LEN];
+
+  for (int fdIdx = 0; fdIdx < SEGMENT_FDS; fdIdx++)
+  {
+    if (segmentFds[fdIdx].fd >= 0)
+      close(segmentFds[fdIdx].fd);
+    segmentFds[fdIdx].fd = -1;
+  }
+  for (int shardIdx = 0; shardIdx < SPILL_SHARDS; shardIdx++)
+  {
+    for (uint32_t segment = store->shards[shardIdx].oldestSegment; segment <= store->shards[shardIdx].activeSegment; segment++)
+    {
+      segment_path(store, shardIdx, segment, path);
+      unlink(path);
+    }
+  }
+  munmap(store, sizeof(SpillStore));
+}
+
+/** \copydoc spill_queue_init */
+void spill_queue_init(SpillQueue *queue, const char *username)
+{
+  uint32_t hash = 2166136261u;
+
+  while (*username)
+  { /* FNV-1a */
+    hash ^= (unsigned char)*username++;
+    hash *= 16777619u;
+  }
+  queue->head = SPILL_NIL;
+  queue->tail = SPILL_NIL;
+  queue->numRecords = 0;
+  queue->shard = hash % SPILL_SHARDS;
+}
+
+/** \copydoc spill_store_append */
+int spill_store_append(SpillStore *store, SpillQueue *queue, const char *tweetItem)
+{
+  SpillShard *shard = &store->shards[queue->shard];
+  char record[sizeof(SpillRecordHeader) + MAX_TWEET_ITEM_LEN];
+  SpillRecordHeader header;
+  int recordLen;
+  int isWritten = 0;
+  uint64_t ref;
+  int fd;
+
+  header.next = SPILL_NIL;
+  header.length = strlen(tweetItem) + 1;
+  header.magic = SPILL_MAGIC;
+  recordLen = sizeof(header) + header.length;
+  memcpy(record, &header, sizeof(header));
+  memcpy(record + sizeof(header), tweetItem, header.length);
+
+  spin_lock(&shard->lock);
+  if (shard->activeLen + recordLen > SPILL_SEGMENT_SIZE && shard->activeSegment + 1 - shard->oldestSegment < SPILL_MAX_SEGMENTS)
+  { /* Start the next segment; the one before may have no heads left */
+    shard->activeSegment++;
+    shard->activeLen = 0;
+    shard->numHeads[shard->activeSegment % SPILL_MAX_SEGMENTS] = 0;
+    delete_unused_segments(store, queue->shard);
+  }
+  ref = make_ref(shard->activeSegment, shard->activeLen);
+  if (shard->activeLen + recordLen <= SPILL_SEGMENT_SIZE &&
+      (fd = segment_fd(store, queue->shard, shard->activeSegment, 1)) >= 0 &&
+      pwrite(fd, record, recordLen, shard->activeLen) == recordLen &&
+      (queue->head == SPILL_NIL || link_record(store, queue, ref)))
+  { /* Written and reachable, so the space is taken */
+    if (queue->head == SPILL_NIL)
+    {
+      queue->head = ref;
+      shard->numHeads[shard->activeSegment % SPILL_MAX_SEGMENTS]++;
+    }
+    queue->tail = ref;
+    queue->numRecords++;
+    shard->activeLen += recordLen;
+    isWritten = 1;
+  }
+  spin_unlock(&shard->lock);
+  return isWritten;
+}
+
+/** \copydoc spill_store_pop */
+int spill_store_pop(SpillStore *store, SpillQueue *queue, char *tweetItem)
+{
+  SpillShard *shard = &store->shards[queue->shard];
+  char record[sizeof(SpillRecordHeader) + MAX_TWEET_ITEM_LEN];
+  SpillRecordHeader header;
+  ssize_t recordLen = -1;
+  uint64_t head;
+  int isRead;
+  int fd;
+
+  spin_lock(&shard->lock);
+  head = queue->head;
+  if (head == SPILL_NIL)
+  {
+    spin_unlock(&shard->lock);
+    return 0;
+  }
+  if ((fd = segment_fd(store, queue->shard, ref_segment(head), 0)) >= 0)
+    recordLen = pread(fd, record, sizeof(record), ref_offset(head));
+  if (recordLen >= (ssize_t)sizeof(header))
+    memcpy(&header, record, sizeof(header));
+  isRead = recordLen >= (ssize_t)sizeof(header) && header.magic == SPILL_MAGIC && header.length > 0 &&
+           header.length <= recordLen - sizeof(header) && record[sizeof(header) + header.length - 1] == '\0' &&
+           (head == queue->tail || header.next != SPILL_NIL);
+
+  if (!isRead)
+  { /* Left for spill_store_clear(), which also counts what is lost */
+    spin_unlock(&shard->lock);
+    return -1;
+  }
+  memcpy(tweetItem, record + sizeof(header), header.length);
+  shard->numHeads[ref_segment(head) % SPILL_MAX_SEGMENTS]--;
+  if (head == queue->tail)
+  {
+    queue->head = SPILL_NIL;
+    queue->tail = SPILL_NIL;
+  }
+  else
+  { /* The head moves on, possibly to a later segment */
+    queue->head = header.next;
+    shard->numHeads[ref_segment(queue->head) % SPILL_MAX_SEGMENTS]++;
+  }
+  queue->numRecords--;
+  delete_unused_segments(store, queue->shard);
+  spin_unlock(&shard->lock);
+  return 1;
+}
+
+/** \copydoc spill_store_clear */
+int64_t spill_store_clear(SpillStore *store, SpillQueue *queue)
+{
+  SpillShard *shard = &store->shards[queue->shard];
+  int64_t numRecords;
+
+  spin_lock(&shard->lock);
+  if (queue->head != SPILL_NIL)
+  {
+    shard->numHeads[ref_segment(queue->head) % SPILL_MAX_SEGMENTS]--;
+    delete_unused_segments(store, queue->shard);
+  }
+  numRecords = queue->numRecords;
+  queue->head = SPILL_NIL;
+  queue->tail = SPILL_NIL;
+  queue->numRecords = 0;
+  spin_unlock(&shard->lock);
+  return numRecords;
+}
+
+static uint64_t make_ref(uint32_t segment, uint32_t offset)
+{
+  return (uint64_t)segment << 32 | offset;
+}
+
+static uint32_t ref_segment(uint64_t ref)
+{
+  return ref >> 32;
+}
+
+static uint32_t ref_offset(uint64_t ref)
+{
+  return ref & 0xffffffff;
+}
+
+static void segment_path(SpillStore *store, int shardIdx, uint32_t segment, char *path)
+{
+  snprintf(path, SEGMENT_PATH_LEN, "%s/spill-%02d-%08x.seg", store->dir, shardIdx, segment);
+}
+
+/* Descriptor of a segment, opened on first use; -1 if it cannot be opened */
+static int segment_fd(SpillStore *store, int shardIdx, uint32_t segment, int create)
+{
+  SegmentFd *cached = &segmentFds[(segment * SPILL_SHARDS + shardIdx) % SEGMENT_FDS];
+  char path[SEGMENT_PATH_LEN];
+
+  if (cached->fd >= 0 && cached->shard == shardIdx && cached->segment == segment)
+    return cached->fd;
+  close_deleted_segments(store);
+  if (cached->fd >= 0)
+    close(cached->fd);
+  segment_path(store, shardIdx, segment, path);
+  cached->fd = open(path, O_RDWR | (create ? O_CREAT : 0), 0600);
+  cached->shard = shardIdx;
+  cached->segment = segment;
+  return cached->fd;
+}
+
+/* A deleted segment keeps its disk space while any process has it open */
+static void close_deleted_segments(SpillStore *store)
+{
+  for (int fdIdx = 0; fdIdx < SEGMENT_FDS; fdIdx++)
+  {
+    if (segmentFds[fdIdx].fd >= 0 && segmentFds[fdIdx].segment < __atomic_load_n(&store->shards[segmentFds[fdIdx].shard].oldestSegment, __ATOMIC_RELAXED))
+    {
+      close(segmentFds[fdIdx].fd);
+      segmentFds[fdIdx].fd = -1;
+    }
+  }
+}
+
+/* Every segment before the oldest holding a head has no record left in any queue */
+static void delete_unused_segments(SpillStore *store, int shardIdx)
+{
+  SpillShard *shard = &store->shards[shardIdx];
+  char path[SEGMENT_PATH_LEN];
+
+  while (shard->oldestSegment != shard->activeSegment && shard->numHeads[shard->oldestSegment % SPILL_MAX_SEGMENTS] == 0)
+  {
+    segment_path(store, shardIdx, shard->oldestSegment, path);
+    unlink(path);
+    shard->oldestSegment++;
+  }
+}
+
+/* Points the queue's newest record at ref */
+static int link_record(SpillStore *store, SpillQueue *queue, uint64_t ref)
+{
+  int fd = segment_fd(store, queue->shard, ref_segment(queue->tail), 0);
+
+  return fd >= 0 && pwrite(fd, &ref, sizeof(ref), ref_offset(queue->tail) + offsetof(SpillRecordHeader, next)) == sizeof(ref);
+}
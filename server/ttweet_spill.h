@@ -0,0 +1,143 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_spill.h
+  * @date 18 October 2026
+  * @brief Documentation for functions in ttweet_spill.c.
+  *
+  * This header file has been created to describe the functions
+  * and declare constants in ttweet_spill.c.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  */
+
+#ifndef TTWEET_COMMON_H
+#define TTWEET_COMMON_H
+#include "../dependencies/ttweet_common.h"
+void die_with_error(char *errorMessage);
+int persist_with_error(char *errorMessage);
+int send_payload(int sock, cJSON *jobjToSend);
+int receive_response(int sock, char *objReceived);
+void spin_lock(int *lock);
+void spin_unlock(int *lock);
+#endif
+
+#ifndef TTWEET_SPILL_H
+#define TTWEET_SPILL_H
+
+#include <stdint.h>
+
+#define SPILL_NIL UINT64_MAX          /* No record */
+#define SPILL_SHARDS 16               /* Usernames hash into this many shards, each with its own segments and lock */
+#define SPILL_SEGMENT_SIZE (16 << 20) /* Bytes of records per segment file */
+#define SPILL_MAX_SEGMENTS 256        /* Live segments per shard, so at most 64 GB of spilled tweets in all */
+#define SPILL_MAX_DIR_LEN 200
+
+/* Tweets of one user waiting on disk, oldest first. A record is named by
+ * its segment in the high 32 bits and its offset in the low 32 bits. */
+typedef struct SpillQueue
+{
+  uint64_t head; /* Oldest record, SPILL_NIL if the queue is empty */
+  uint64_t tail; /* Newest record, whose link the next record is written into */
+  int64_t numRecords;
+  int shard;
+} SpillQueue;
+
+typedef struct SpillShard
+{
+  int lock;               /* Spinlock held by every operation on the shard's queues */
+  uint32_t activeSegment; /* Segment records are appended to */
+  uint32_t oldestSegment; /* Oldest segment not deleted yet */
+  uint32_t activeLen;     /* Bytes written to activeSegment */
+  int32_t numHeads[SPILL_MAX_SEGMENTS]; /* Queues whose oldest record is in each live segment, by segment % SPILL_MAX_SEGMENTS */
+} SpillShard;
+
+/* Append-only segment files in a directory, in shared memory so that every
+ * server process appends to and reads from the same segments */
+typedef struct SpillStore
+{
+  char dir[SPILL_MAX_DIR_LEN];
+  uint64_t runId; /* Differs between opens, so a queue saved by an earlier run is never read */
+  SpillShard shards[SPILL_SHARDS];
+} SpillStore;
+
+/**
+ * @brief Opens a spill directory
+ *
+ * Segments left in the directory by an earlier run are deleted, and
+ * queues saved by it are told apart by runId. Call before fork() so that every
+ * child shares the shards.
+ *
+ * @param dir Existing directory for the segment files
+ * @return SpillStore* The store, or NULL if the directory cannot be read or mmap() failed.
+ */
+SpillStore *spill_store_open(const char *dir);
+
+/**
+ * @brief Closes a store and deletes its segments
+ *
+ * @param store Store from spill_store_open()
+ * @return void
+ */
+void spill_store_close(SpillStore *store);
+
+/**
+ * @brief Starts an empty queue
+ *
+ * @param queue Queue to start, with no records in any store
+ * @param username Owner of the queue, which picks its shard
+ * @return void
+ */
+void spill_queue_init(SpillQueue *queue, const char *username);
+
+/**
+ * @brief Writes a tweet to the end of a queue
+ *
+ * The record is appended to the active segment of the queue's shard and
+ * linked from the queue's previous record, so reading the queue back
+ * never scans other users' records.
+ *
+ * @param store Store of the queue
+ * @param queue Queue to add to
+ * @param tweetItem Tweet item, shorter than MAX_TWEET_ITEM_LEN
+ * @return int 1 if written; 0 if the shard has no room or the write failed.
+ */
+int spill_store_append(SpillStore *store, SpillQueue *queue, const char *tweetItem);
+
+/**
+ * @brief Reads and removes the oldest tweet of a queue
+ *
+ * Segments are deleted once no queue starts in them or before them. A
+ * record that cannot be read is left in place; the records after it
+ * cannot be found either, so the caller drops the queue with
+ * spill_store_clear().
+ *
+ * @param store Store of the queue
+ * @param queue Queue to read from
+ * @param tweetItem Receives the tweet item, MAX_TWEET_ITEM_LEN bytes
+ * @return int 1 if a tweet was read; 0 if the queue is empty; -1 if the oldest record cannot be read.
+ */
+int spill_store_pop(SpillStore *store, SpillQueue *queue, char *tweetItem);
+
+/**
+ * @brief Drops every tweet of a queue
+ *
+ * Costs the same however many tweets the queue holds; their space is
+ * reclaimed with the segments.
+ *
+ * @param store Store of the queue
+ * @param queue Queue to empty
+ * @return int64_t Number of tweets dropped.
+ */
+int64_t spill_store_clear(SpillStore *store, SpillQueue *queue);
+
+#endif
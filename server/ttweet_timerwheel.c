@@ -0,0 +1,228 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_timerwheel.c
+  * @date 18 October 2026
+  * @brief Hierarchical timing wheel for connection and session deadlines.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  *
+  * Timers live in doubly linked lists hanging off the slots of
+  * TIMER_WHEEL_LEVELS wheels. A timer due within TIMER_WHEEL_SLOTS ticks
+  * sits in the finest wheel at the slot of its expiry tick; later timers
+  * sit in a coarser wheel and are moved down (cascaded) when the finer
+  * wheel wraps around to them. Scheduling and cancelling are O(1), and
+  * each timer is cascaded at most TIMER_WHEEL_LEVELS - 1 times.
+  */
+
+#include "ttweet_timerwheel.h"
+#include <stddef.h> /* for NULL */
+
+/* Function prototypes */
+void timer_wheel_init(TimerWheel *wheel, uint64_t nowMs);                                  /* Prepares an empty wheel */
+void timer_init(Timer *timer, void (*callback)(Timer *timer, void *arg), void *arg);      /* Prepares a timer */
+void timer_schedule(TimerWheel *wheel, Timer *timer, uint64_t delayMs);                   /* Schedules a timer */
+void timer_cancel(TimerWheel *wheel, Timer *timer);                                       /* Cancels a timer */
+int timer_is_pending(Timer *timer);                                                       /* Checks whether a timer is scheduled */
+int timer_wheel_advance(TimerWheel *wheel, uint64_t nowMs);                               /* Runs expired timers */
+int timer_wheel_next_timeout_ms(TimerWheel *wheel, uint64_t nowMs);                       /* Time until the next tick with work */
+
+/* Static helpers */
+static void list_init(Timer *head);
+static void list_append(Timer *head, Timer *timer);
+static void list_unlink(Timer *timer);
+static void place_timer(TimerWheel *wheel, Timer *timer);
+static void cascade(TimerWheel *wheel, int level);
+
+/** \copydoc timer_wheel_init */
+void timer_wheel_init(TimerWheel *wheel, uint64_t nowMs)
+{
+  wheel->startMs = nowMs;
+  wheel->nextTick = 0;
+  wheel->numPending = 0;
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; level++)
+  {
+    for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++)
+      list_init(&wheel->slots[level][slot]);
+  }
+}
+
+/** \copydoc timer_init */
+void timer_init(Timer *timer, void (*callback)(Timer *timer, void *arg), void *arg)
+{
+  timer->next = NULL;
+  timer->prev = NULL;
+  timer->expiresTick = 0;
+  timer->callback = callback;
+  timer->arg = arg;
+}
+
+/** \copydoc timer_schedule */
+void timer_schedule(TimerWheel *wheel, Timer *timer, uint64_t delayMs)
+{
+  uint64_t delayTicks = (delayMs + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+
+  timer_cancel(wheel, timer);
+  if (delayTicks > TIMER_WHEEL_MAX_TICKS)
+    delayTicks = TIMER_WHEEL_MAX_TICKS;
+  /* nextTick is processed next, so a delay of 0 ticks fires on the next advance */
+  timer->expiresTick = wheel->nextTick + delayTicks;
+  place_timer(wheel, timer);
+  wheel->numPending++;
+}
+
+/** \copydoc timer_cancel */
+void timer_cancel(TimerWheel *wheel, Timer *timer)
+{
+  if (timer->next == NULL)
+    return;
+  list_unlink(timer);
+  wheel->numPending--;
+}
+
+/** \copydoc timer_is_pending */
+int timer_is_pending(Timer *timer)
+{
+  return timer->next != NULL;
+}
+
+/** \copydoc timer_wheel_advance */
+int timer_wheel_advance(TimerWheel *wheel, uint64_t nowMs)
+{
+  uint64_t nowTick = (nowMs - wheel->startMs) / TIMER_WHEEL_TICK_MS;
+  Timer expired;
+  Timer *timer;
+  int numExpired = 0;
+
+  while (wheel->nextTick <= nowTick)
+  {
+    int slot = wheel->nextTick & (TIMER_WHEEL_SLOTS - 1);
+
+    if (wheel->numPending == 0)
+    { /* Nothing to run or cascade, skip straight to now */
+      wheel->nextTick = nowTick + 1;
+      break;
+    }
+    if (slot == 0)
+      cascade(wheel, 1);
+
+    /* Detach the slot first so callbacks can reschedule into it */
+    list_init(&expired);
+    if (wheel->slots[0][slot].next != &wheel->slots[0][slot])
+    {
+      expired.next = wheel->slots[0][slot].next;
+      expired.prev = wheel->slots[0][slot].prev;
+      expired.next->prev = &expired;
+      expired.prev->next = &expired;
+      list_init(&wheel->slots[0][slot]);
+    }
+    wheel->nextTick++;
+
+    while ((timer = expired.next) != &expired)
+    {
+      list_unlink(timer);
+      wheel->numPending--;
+      numExpired++;
+      timer->callback(timer, timer->arg);
+    }
+  }
+  return numExpired;
+}
+
+/** \copydoc timer_wheel_next_timeout_ms */
+int timer_wheel_next_timeout_ms(TimerWheel *wheel, uint64_t nowMs)
+{
+  uint64_t tick = wheel->nextTick;
+  uint64_t dueMs;
+  int slot;
+
+  if (wheel->numPending == 0)
+    return -1;
+
+  for (int ahead = 0; ahead < TIMER_WHEEL_SLOTS; ahead++, tick++)
+  { /* First non-empty slot of the finest wheel, or the tick at which it
+     * wraps and a coarser slot cascades into it */
+    slot = tick & (TIMER_WHEEL_SLOTS - 1);
+    if (slot == 0 || wheel->slots[0][slot].next != &wheel->slots[0][slot])
+      break;
+  }
+
+  /* Tick t runs once t whole ticks have elapsed since startMs */
+  dueMs = wheel->startMs + tick * TIMER_WHEEL_TICK_MS;
+  return dueMs > nowMs ? (int)(dueMs - nowMs) : 0;
+}
+
+/* Empty circular list */
+static void list_init(Timer *head)
+{
+  head->next = head;
+  head->prev = head;
+}
+
+static void list_append(Timer *head, Timer *timer)
+{
+  timer->prev = head->prev;
+  timer->next = head;
+  head->prev->next = timer;
+  head->prev = timer;
+}
+
+static void list_unlink(Timer *timer)
+{
+  timer->prev->next = timer->next;
+  timer->next->prev = timer->prev;
+  timer->next = NULL;
+  timer->prev = NULL;
+}
+
+/* Links timer into the finest wheel that can tell its expiry apart */
+static void place_timer(TimerWheel *wheel, Timer *timer)
+{
+  uint64_t delta = timer->expiresTick - wheel->nextTick;
+  int level = 0;
+
+  if (timer->expiresTick < wheel->nextTick)
+  { /* Already due, run on the next tick */
+    timer->expiresTick = wheel->nextTick;
+    delta = 0;
+  }
+  while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ULL << (TIMER_WHEEL_BITS * (level + 1))))
+    level++;
+  list_append(&wheel->slots[level][(timer->expiresTick >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1)], timer);
+}
+
+/* Moves the timers of the current slot of a coarser wheel down a level,
+ * first cascading the next wheel up if this one has wrapped too */
+static void cascade(TimerWheel *wheel, int level)
+{
+  int slot;
+  Timer pending;
+  Timer *timer;
+
+  if (level >= TIMER_WHEEL_LEVELS)
+    return;
+  slot = (wheel->nextTick >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1);
+  if (slot == 0)
+    cascade(wheel, level + 1);
+
+  list_init(&pending);
+  while ((timer = wheel->slots[level][slot].next) != &wheel->slots[level][slot])
+  {
+    list_unlink(timer);
+    list_append(&pending, timer);
+  }
+  while ((timer = pending.next) != &pending)
+  {
+    list_unlink(timer);
+    place_timer(wheel, timer);
+  }
+}
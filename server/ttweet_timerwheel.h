@@ -0,0 +1,132 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_timerwheel.h
+  * @date 18 October 2026
+  * @brief Documentation for functions in ttweet_timerwheel.c.
+  *
+  * This header file has been created to describe the functions
+  * and declare constants in ttweet_timerwheel.c.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  */
+
+#ifndef TTWEET_TIMERWHEEL_H
+#define TTWEET_TIMERWHEEL_H
+
+#include <stdint.h>
+
+/* Wheel geometry: TIMER_WHEEL_LEVELS wheels of TIMER_WHEEL_SLOTS slots,
+ * each slot of level n spanning TIMER_WHEEL_SLOTS^n ticks */
+#define TIMER_WHEEL_TICK_MS 10
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_MAX_TICKS ((1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1) /* About 46 hours */
+
+/* A timer embedded in its owner; it is linked into at most one slot */
+typedef struct Timer
+{
+  struct Timer *next;
+  struct Timer *prev;
+  uint64_t expiresTick;
+  void (*callback)(struct Timer *timer, void *arg); /* Run once when the timer expires */
+  void *arg;
+} Timer;
+
+typedef struct TimerWheel
+{
+  uint64_t startMs;  /* Time of tick 0 */
+  uint64_t nextTick; /* First tick not yet processed */
+  int numPending;    /* Timers scheduled and not yet expired or cancelled */
+  Timer slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS]; /* List heads */
+} TimerWheel;
+
+/**
+ * @brief Prepares an empty wheel
+ *
+ * @param wheel Wheel to initialize
+ * @param nowMs Current time in milliseconds, from a monotonic clock
+ * @return void
+ */
+void timer_wheel_init(TimerWheel *wheel, uint64_t nowMs);
+
+/**
+ * @brief Prepares a timer that is not scheduled
+ *
+ * @param timer Timer to initialize
+ * @param callback Function run when the timer expires
+ * @param arg Passed to callback
+ * @return void
+ */
+void timer_init(Timer *timer, void (*callback)(Timer *timer, void *arg), void *arg);
+
+/**
+ * @brief Schedules a timer, replacing any earlier schedule
+ *
+ * Constant time. The timer fires during the first timer_wheel_advance()
+ * at least delayMs later, rounded up to a tick. Delays beyond
+ * TIMER_WHEEL_MAX_TICKS ticks are clamped.
+ *
+ * @param wheel Wheel to schedule on
+ * @param timer Timer to schedule
+ * @param delayMs Milliseconds from the wheel's current time, that of the last timer_wheel_advance()
+ * @return void
+ */
+void timer_schedule(TimerWheel *wheel, Timer *timer, uint64_t delayMs);
+
+/**
+ * @brief Cancels a timer if it is scheduled
+ *
+ * Constant time. Safe to call on timers that are not scheduled, and from
+ * a timer callback.
+ *
+ * @param wheel Wheel the timer was scheduled on
+ * @param timer Timer to cancel
+ * @return void
+ */
+void timer_cancel(TimerWheel *wheel, Timer *timer);
+
+/**
+ * @brief Checks whether a timer is scheduled
+ *
+ * @param timer Timer to check
+ * @return int 1 if scheduled; 0 otherwise.
+ */
+int timer_is_pending(Timer *timer);
+
+/**
+ * @brief Runs the callbacks of every timer that has expired by nowMs
+ *
+ * Processes each elapsed tick in turn, moving timers down from the
+ * coarser wheels whenever a finer wheel wraps around. Callbacks may
+ * schedule or cancel any timer, including their own.
+ *
+ * @param wheel Wheel to advance
+ * @param nowMs Current time in milliseconds
+ * @return int Number of timers that expired.
+ */
+int timer_wheel_advance(TimerWheel *wheel, uint64_t nowMs);
+
+/**
+ * @brief Returns how long a caller may sleep before calling timer_wheel_advance()
+ *
+ * Looks ahead at most one turn of the finest wheel, so the result may be
+ * earlier than the next expiry but never later.
+ *
+ * @param wheel Wheel to inspect
+ * @param nowMs Current time in milliseconds
+ * @return int Milliseconds to wait, or -1 if no timer is scheduled.
+ */
+int timer_wheel_next_timeout_ms(TimerWheel *wheel, uint64_t nowMs);
+
+#endif
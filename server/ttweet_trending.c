@@ -0,0 +1,219 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_trending.c
+  * @date 18 October 2026
+  * @brief Trending hashtags from a Count-Min sketch and Space-Saving candidates, shared by all server processes.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  *
+  * Each window estimates how often every hashtag was used with a
+  * Count-Min sketch: a hashtag adds to one counter per row, and its
+  * estimate is the least of them, which can only overcount. Updates are
+  * conservative, raising each counter only as far as the new estimate.
+  *
+  * The sketch cannot list hashtags, so each window also monitors the
+  * TRENDING_CANDIDATES hashtags with the highest estimates. A hashtag not
+  * monitored takes the slot of the weakest candidate once its estimate
+  * passes it, as in Space-Saving, so a hashtag that becomes popular is
+  * monitored from its first use past that point.
+  *
+  * Windows decay exponentially instead of dropping old uses: newer uses
+  * weigh more, so old counts never need updating.
+  */
+
+#include "ttweet_trending.h"
+#include <math.h>     /* for exp() and log() */
+#include <string.h>   /* for strcmp() */
+#include <sys/mman.h> /* for mmap() */
+
+/* Function prototypes */
+TrendingTracker *trending_tracker_create(uint64_t nowMs);                                                                       /* Creates an empty tracker */
+void trending_tracker_destroy(TrendingTracker *tracker);                                                                        /* Releases a tracker */
+void trending_tracker_add(TrendingTracker *tracker, char hashtags[][MAX_HASHTAG_LEN], int numHashtags, uint64_t nowMs);         /* Counts the hashtags of a tweet */
+int trending_tracker_top(TrendingTracker *tracker, int windowIdx, uint64_t nowMs, TrendingEntry entries[], int maxEntries);    /* Lists the most used hashtags */
+int trending_window_index(const char *name);                                                                                    /* Finds the window of a name */
+
+/* Static helpers */
+static uint64_t hash_hashtag(const char *hashtag);
+static double use_weight(TrendingWindow *window, uint64_t nowMs);
+static void add_to_window(TrendingWindow *window, const char *hashtag, uint64_t hash, double weight);
+
+static const char *windowNames[TRENDING_WINDOWS] = {"1m", "5m", "1h"};
+static const double windowTauMs[TRENDING_WINDOWS] = {60e3, 300e3, 3600e3};
+
+/** \copydoc trending_tracker_create */
+TrendingTracker *trending_tracker_create(uint64_t nowMs)
+{
+  TrendingTracker *tracker;
+
+  tracker = mmap(NULL, sizeof(TrendingTracker), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (tracker == MAP_FAILED)
+    return NULL;
+  /* Anonymous memory starts zeroed: empty sketches and free candidates */
+  tracker->lock = 0;
+  for (int windowIdx = 0; windowIdx < TRENDING_WINDOWS; windowIdx++)
+  {
+    tracker->windows[windowIdx].tauMs = windowTauMs[windowIdx];
+    tracker->windows[windowIdx].landmarkMs = nowMs;
+  }
+  return tracker;
+}
+
+/** \copydoc trending_tracker_destroy */
+void trending_tracker_destroy(TrendingTracker *tracker)
+{
+  munmap(tracker, sizeof(TrendingTracker));
+}
+
+/** \copydoc trending_tracker_add */
+void trending_tracker_add(TrendingTracker *tracker, char hashtags[][MAX_HASHTAG_LEN], int numHashtags, uint64_t nowMs)
+{
+  uint64_t hashes[MAX_HASHTAG_CNT];
+  double weight;
+
+  for (int hashtagIdx = 0; hashtagIdx < numHashtags && hashtagIdx < MAX_HASHTAG_CNT; hashtagIdx++)
+    hashes[hashtagIdx] = hash_hashtag(hashtags[hashtagIdx]);
+  spin_lock(&tracker->lock);
+  for (int windowIdx = 0; windowIdx < TRENDING_WINDOWS; windowIdx++)
+  {
+    weight = use_weight(&tracker->windows[windowIdx], nowMs);
+    for (int hashtagIdx = 0; hashtagIdx < numHashtags && hashtagIdx < MAX_HASHTAG_CNT; hashtagIdx++)
+      add_to_window(&tracker->windows[windowIdx], hashtags[hashtagIdx], hashes[hashtagIdx], weight);
+  }
+  spin_unlock(&tracker->lock);
+}
+
+/** \copydoc trending_tracker_top */
+int trending_tracker_top(TrendingTracker *tracker, int windowIdx, uint64_t nowMs, TrendingEntry entries[], int maxEntries)
+{
+  TrendingWindow *window = &tracker->windows[windowIdx];
+  TrendingEntry entry;
+  double scale;
+  int numEntries = 0;
+  int entryIdx;
+
+  spin_lock(&tracker->lock);
+  scale = 1 / use_weight(window, nowMs);
+  for (int candidateIdx = 0; candidateIdx < TRENDING_CANDIDATES; candidateIdx++)
+  {
+    if (window->candidates[candidateIdx].hash == 0 || window->candidates[candidateIdx].count * scale < 0.5)
+      continue; /* Free, or used less than once over the window */
+    strcpy(entry.hashtag, window->candidates[candidateIdx].hashtag);
+    entry.count = window->candidates[candidateIdx].count * scale;
+
+    /* Insertion into entries, which holds the best so far in order */
+    for (entryIdx = numEntries; entryIdx > 0 && entries[entryIdx - 1].count < entry.count; entryIdx--)
+    {
+      if (entryIdx < maxEntries)
+        entries[entryIdx] = entries[entryIdx - 1];
+    }
+    if (entryIdx < maxEntries)
+    {
+      entries[entryIdx] = entry;
+      if (numEntries < maxEntries)
+        numEntries++;
+    }
+  }
+  spin_unlock(&tracker->lock);
+  return numEntries;
+}
+
+/** \copydoc trending_window_index */
+int trending_window_index(const char *name)
+{
+  for (int windowIdx = 0; windowIdx < TRENDING_WINDOWS; windowIdx++)
+  {
+    if (strcmp(name, windowNames[windowIdx]) == 0)
+      return windowIdx;
+  }
+  return -1;
+}
+
+/* FNV-1a, then mixed so that every 16 bit slice is usable as a row index.
+ * Never 0, so that 0 can mark free candidates. */
+static uint64_t hash_hashtag(const char *hashtag)
+{
+  uint64_t hash = 14695981039346656037ull;
+
+  while (*hashtag != '\0')
+  {
+    hash ^= (unsigned char)*hashtag++;
+    hash *= 1099511628211ull;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  return hash == 0 ? 1 : hash;
+}
+
+/* Weight of a use now. Moves the landmark forward, rescaling every count,
+ * before weights grow out of range. */
+static double use_weight(TrendingWindow *window, uint64_t nowMs)
+{
+  double scale;
+
+  if (nowMs <= window->landmarkMs)
+    return 1;
+  if ((nowMs - window->landmarkMs) / window->tauMs < log(TRENDING_MAX_WEIGHT))
+    return exp((nowMs - window->landmarkMs) / window->tauMs);
+
+  scale = exp(-((nowMs - window->landmarkMs) / window->tauMs));
+  for (int row = 0; row < TRENDING_SKETCH_DEPTH; row++)
+  {
+    for (int column = 0; column < TRENDING_SKETCH_WIDTH; column++)
+      window->sketch[row][column] *= scale;
+  }
+  for (int candidateIdx = 0; candidateIdx < TRENDING_CANDIDATES; candidateIdx++)
+    window->candidates[candidateIdx].count *= scale;
+  window->landmarkMs = nowMs;
+  return 1;
+}
+
+static void add_to_window(TrendingWindow *window, const char *hashtag, uint64_t hash, double weight)
+{
+  double *counters[TRENDING_SKETCH_DEPTH];
+  double estimate = INFINITY;
+  TrendingCandidate *weakest = NULL;
+  TrendingCandidate *candidate;
+
+  for (int row = 0; row < TRENDING_SKETCH_DEPTH; row++)
+  {
+    counters[row] = &window->sketch[row][(hash >> (16 * row)) & (TRENDING_SKETCH_WIDTH - 1)];
+    if (*counters[row] < estimate)
+      estimate = *counters[row];
+  }
+  estimate += weight;
+  for (int row = 0; row < TRENDING_SKETCH_DEPTH; row++)
+  { /* Conservative update: counters already above the estimate hold other hashtags too */
+    if (*counters[row] < estimate)
+      *counters[row] = estimate;
+  }
+
+  for (int candidateIdx = 0; candidateIdx < TRENDING_CANDIDATES; candidateIdx++)
+  {
+    candidate = &window->candidates[candidateIdx];
+    if (candidate->hash == hash && strcmp(candidate->hashtag, hashtag) == 0)
+    {
+      candidate->count = estimate;
+      return;
+    }
+    if (weakest == NULL || (weakest->hash != 0 && (candidate->hash == 0 || candidate->count < weakest->count)))
+      weakest = candidate; /* Free slots are weakest of all */
+  }
+  if (weakest->hash == 0 || weakest->count < estimate)
+  {
+    weakest->hash = hash;
+    weakest->count = estimate;
+    strcpy(weakest->hashtag, hashtag);
+  }
+}
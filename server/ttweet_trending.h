@@ -0,0 +1,135 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_trending.h
+  * @date 18 October 2026
+  * @brief Documentation for functions in ttweet_trending.c.
+  *
+  * This header file has been created to describe the functions
+  * and declare constants in ttweet_trending.c.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  */
+
+#ifndef TTWEET_COMMON_H
+#define TTWEET_COMMON_H
+#include "../dependencies/ttweet_common.h"
+void die_with_error(char *errorMessage);
+int persist_with_error(char *errorMessage);
+int send_payload(int sock, cJSON *jobjToSend);
+int receive_response(int sock, char *objReceived);
+void spin_lock(int *lock);
+void spin_unlock(int *lock);
+#endif
+
+#ifndef TTWEET_TRENDING_H
+#define TTWEET_TRENDING_H
+
+#define TRENDING_WINDOWS 3          /* 1 minute, 5 minutes and 1 hour */
+#define TRENDING_SKETCH_DEPTH 4     /* Rows of the Count-Min sketch */
+#define TRENDING_SKETCH_WIDTH 2048  /* Counters per row, a power of two */
+#define TRENDING_CANDIDATES 64      /* Hashtags monitored per window, of which the top are reported */
+#define TRENDING_MAX_WEIGHT 1e30    /* Counts are rescaled before the weight of a new use passes this */
+
+/* A hashtag monitored as possibly among the most used */
+typedef struct TrendingCandidate
+{
+  uint64_t hash; /* 0 if the slot is free */
+  double count;  /* Estimated uses, weighted as in TrendingWindow */
+  char hashtag[MAX_HASHTAG_LEN];
+} TrendingCandidate;
+
+/* Exponentially decayed counts: a use at time t weighs
+ * exp((t - landmarkMs) / tauMs), so all counts decay together without
+ * being touched, and a count divided by the weight of the present is
+ * roughly the uses over the last tauMs. */
+typedef struct TrendingWindow
+{
+  double tauMs;
+  uint64_t landmarkMs;
+  double sketch[TRENDING_SKETCH_DEPTH][TRENDING_SKETCH_WIDTH];
+  TrendingCandidate candidates[TRENDING_CANDIDATES];
+} TrendingWindow;
+
+/* Heavy hitters of the hashtag stream in shared memory. Memory is fixed,
+ * whatever the number of distinct hashtags. */
+typedef struct TrendingTracker
+{
+  int lock; /* Spinlock held by every operation */
+  TrendingWindow windows[TRENDING_WINDOWS];
+} TrendingTracker;
+
+/* A hashtag reported as trending */
+typedef struct TrendingEntry
+{
+  char hashtag[MAX_HASHTAG_LEN];
+  double count; /* Estimated uses over the window */
+} TrendingEntry;
+
+/**
+ * @brief Creates an empty tracker in shared memory
+ *
+ * Call before fork() so that every child counts into the same tracker.
+ *
+ * @param nowMs Current time in milliseconds
+ * @return TrendingTracker* The tracker, or NULL if mmap() failed.
+ */
+TrendingTracker *trending_tracker_create(uint64_t nowMs);
+
+/**
+ * @brief Releases a tracker from trending_tracker_create()
+ *
+ * @param tracker Tracker to release
+ * @return void
+ */
+void trending_tracker_destroy(TrendingTracker *tracker);
+
+/**
+ * @brief Counts one use of each hashtag of a tweet in every window
+ *
+ * Each hashtag is added to the Count-Min sketch, and its estimate is
+ * compared with the monitored candidates: a hashtag already monitored is
+ * updated, and a new one replaces the weakest candidate if it now counts
+ * more, as in Space-Saving.
+ *
+ * @param tracker Tracker to count into
+ * @param hashtags Hashtags of the tweet, without '#'
+ * @param numHashtags Number of hashtags
+ * @param nowMs Current time in milliseconds, not before earlier calls
+ * @return void
+ */
+void trending_tracker_add(TrendingTracker *tracker, char hashtags[][MAX_HASHTAG_LEN], int numHashtags, uint64_t nowMs);
+
+/**
+ * @brief Lists the most used hashtags of a window
+ *
+ * Only reads the candidates, so the cost does not depend on the number of
+ * hashtags seen.
+ *
+ * @param tracker Tracker to read
+ * @param windowIdx Window, from trending_window_index()
+ * @param nowMs Current time in milliseconds
+ * @param entries Receives the hashtags, most used first
+ * @param maxEntries Capacity of entries
+ * @return int Number of entries.
+ */
+int trending_tracker_top(TrendingTracker *tracker, int windowIdx, uint64_t nowMs, TrendingEntry entries[], int maxEntries);
+
+/**
+ * @brief Finds the window of a name
+ *
+ * @param name "1m", "5m" or "1h"
+ * @return int Index of the window, or -1 if name is not one.
+ */
+int trending_window_index(const char *name);
+
+#endif
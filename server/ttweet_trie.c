@@ -0,0 +1,303 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_trie.c
+  * @date 18 October 2026
+  * @brief Radix trie of prefix subscriptions, shared by all server processes.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  *
+  * Chains of single-child nodes are collapsed into one edge label, so a key
+  * costs at most two nodes and a lookup visits at most one node per edge.
+  * Nodes and values come from fixed pools in one mmap() region, with free
+  * lists threaded through their link fields. A spinlock serialises the
+  * processes; every operation holds it for one walk of at most
+  * PREFIX_TRIE_MAX_KEY_LEN edges.
+  */
+
+#include "ttweet_trie.h"
+#include <string.h>   /* for memcmp() and memcpy() */
+#include <sys/mman.h> /* for mmap() */
+
+/* Function prototypes */
+PrefixTrie *prefix_trie_create(int maxValues);                                                                                /* Creates an empty trie */
+void prefix_trie_destroy(PrefixTrie *trie);                                                                                   /* Releases a trie */
+int prefix_trie_insert(PrefixTrie *trie, const char *key, int len, int32_t value);                                            /* Stores a value under a key */
+int prefix_trie_remove(PrefixTrie *trie, const char *key, int len, int32_t value);                                            /* Removes a value from a key */
+int prefix_trie_match(PrefixTrie *trie, const char *string, int len, void (*visit)(int32_t value, void *arg), void *arg); /* Visits values of prefixes */
+int prefix_trie_is_empty(PrefixTrie *trie);                                                                                   /* Checks for values */
+
+/* Static helpers */
+static size_t trie_size(int maxValues);
+static int32_t alloc_node(PrefixTrie *trie, const char *label, int labelLen);
+static void free_node(PrefixTrie *trie, int32_t nodeIdx);
+static int32_t *find_child_link(PrefixTrie *trie, int32_t nodeIdx, char first);
+static void merge_with_only_child(PrefixTrie *trie, int32_t nodeIdx);
+
+/** \copydoc prefix_trie_create */
+PrefixTrie *prefix_trie_create(int maxValues)
+{
+  char *region;
+  PrefixTrie *trie;
+
+  region = mmap(NULL, trie_size(maxValues), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (region == MAP_FAILED)
+    return NULL;
+  trie = (PrefixTrie *)region;
+  trie->lock = 0;
+  trie->numValues = 0;
+  trie->maxValues = maxValues;
+  trie->maxNodes = 2 * maxValues + 1; /* An insert adds at most a leaf and the node splitting an edge */
+  trie->nodes = (PrefixTrieNode *)(region + sizeof(PrefixTrie));
+  trie->values = (PrefixTrieValue *)(trie->nodes + trie->maxNodes);
+
+  trie->nodes[0].firstChild = PREFIX_TRIE_NIL;
+  trie->nodes[0].nextSibling = PREFIX_TRIE_NIL;
+  trie->nodes[0].firstValue = PREFIX_TRIE_NIL;
+  trie->nodes[0].labelLen = 0;
+  trie->freeNodes = PREFIX_TRIE_NIL;
+  for (int32_t nodeIdx = trie->maxNodes - 1; nodeIdx > 0; nodeIdx--)
+    free_node(trie, nodeIdx);
+  trie->freeValues = PREFIX_TRIE_NIL;
+  for (int32_t valueIdx = maxValues - 1; valueIdx >= 0; valueIdx--)
+  {
+    trie->values[valueIdx].next = trie->freeValues;
+    trie->freeValues = valueIdx;
+  }
+  return trie;
+}
+
+/** \copydoc prefix_trie_destroy */
+void prefix_trie_destroy(PrefixTrie *trie)
+{
+  munmap(trie, trie_size(trie->maxValues));
+}
+
+/** \copydoc prefix_trie_insert */
+int prefix_trie_insert(PrefixTrie *trie, const char *key, int len, int32_t value)
+{
+  PrefixTrieNode *nodes = trie->nodes;
+  int32_t nodeIdx = 0;
+  int32_t *link;
+  int32_t child;
+  int32_t valueIdx;
+  int pos = 0;
+  int common;
+
+  if (len < 1 || len > PREFIX_TRIE_MAX_KEY_LEN)
+    return 0;
+  spin_lock(&trie->lock);
+  if (trie->freeValues == PREFIX_TRIE_NIL)
+  { /* Full */
+    spin_unlock(&trie->lock);
+    return 0;
+  }
+
+  while (pos < len)
+  {
+    link = find_child_link(trie, nodeIdx, key[pos]);
+    if (*link == PREFIX_TRIE_NIL)
+    { /* Nothing shares the next character, the rest of the key becomes a leaf */
+      if ((child = alloc_node(trie, key + pos, len - pos)) == PREFIX_TRIE_NIL)
+        break;
+      *link = child;
+      nodeIdx = child;
+      pos = len;
+      break;
+    }
+
+    child = *link;
+    common = 0;
+    while (common < nodes[child].labelLen && pos + common < len && nodes[child].label[common] == key[pos + common])
+      common++;
+    if (common < nodes[child].labelLen)
+    { /* Key leaves the edge part way, split it so a node sits where they part */
+      int32_t split = alloc_node(trie, nodes[child].label, common);
+      if (split == PREFIX_TRIE_NIL)
+        break;
+      nodes[split].firstChild = child;
+      nodes[split].nextSibling = nodes[child].nextSibling;
+      nodes[child].nextSibling = PREFIX_TRIE_NIL;
+      memmove(nodes[child].label, nodes[child].label + common, nodes[child].labelLen - common);
+      nodes[child].labelLen -= common;
+      *link = split;
+      child = split;
+    }
+    nodeIdx = child;
+    pos += common;
+  }
+
+  if (pos < len)
+  { /* Out of nodes; cannot happen while maxNodes covers maxValues */
+    spin_unlock(&trie->lock);
+    return 0;
+  }
+  valueIdx = trie->freeValues;
+  trie->freeValues = trie->values[valueIdx].next;
+  trie->values[valueIdx].value = value;
+  trie->values[valueIdx].next = nodes[nodeIdx].firstValue;
+  nodes[nodeIdx].firstValue = valueIdx;
+  __atomic_store_n(&trie->numValues, trie->numValues + 1, __ATOMIC_RELEASE);
+  spin_unlock(&trie->lock);
+  return 1;
+}
+
+/** \copydoc prefix_trie_remove */
+int prefix_trie_remove(PrefixTrie *trie, const char *key, int len, int32_t value)
+{
+  PrefixTrieNode *nodes = trie->nodes;
+  int32_t *links[PREFIX_TRIE_MAX_KEY_LEN]; /* Link to each node on the path, root excluded */
+  int32_t *valueLink;
+  int32_t nodeIdx = 0;
+  int32_t child;
+  int32_t valueIdx;
+  int depth = 0;
+  int pos = 0;
+
+  if (len < 1 || len > PREFIX_TRIE_MAX_KEY_LEN)
+    return 0;
+  spin_lock(&trie->lock);
+  while (pos < len)
+  {
+    links[depth] = find_child_link(trie, nodeIdx, key[pos]);
+    child = *links[depth];
+    if (child == PREFIX_TRIE_NIL || nodes[child].labelLen > len - pos ||
+        memcmp(nodes[child].label, key + pos, nodes[child].labelLen) != 0)
+    { /* Key was never inserted */
+      spin_unlock(&trie->lock);
+      return 0;
+    }
+    depth++;
+    nodeIdx = child;
+    pos += nodes[child].labelLen;
+  }
+
+  valueLink = &nodes[nodeIdx].firstValue;
+  while (*valueLink != PREFIX_TRIE_NIL && trie->values[*valueLink].value != value)
+    valueLink = &trie->values[*valueLink].next;
+  if (*valueLink == PREFIX_TRIE_NIL)
+  {
+    spin_unlock(&trie->lock);
+    return 0;
+  }
+  valueIdx = *valueLink;
+  *valueLink = trie->values[valueIdx].next;
+  trie->values[valueIdx].next = trie->freeValues;
+  trie->freeValues = valueIdx;
+  __atomic_store_n(&trie->numValues, trie->numValues - 1, __ATOMIC_RELEASE);
+
+  if (nodes[nodeIdx].firstValue == PREFIX_TRIE_NIL)
+  { /* Restore the invariant: a node without values needs two children */
+    if (nodes[nodeIdx].firstChild == PREFIX_TRIE_NIL)
+    { /* Drop the leaf; its parent may be left with a single child */
+      *links[depth - 1] = nodes[nodeIdx].nextSibling;
+      free_node(trie, nodeIdx);
+      if (depth >= 2 && nodes[*links[depth - 2]].firstValue == PREFIX_TRIE_NIL)
+        merge_with_only_child(trie, *links[depth - 2]);
+    }
+    else
+    {
+      merge_with_only_child(trie, nodeIdx);
+    }
+  }
+  spin_unlock(&trie->lock);
+  return 1;
+}
+
+/** \copydoc prefix_trie_match */
+int prefix_trie_match(PrefixTrie *trie, const char *string, int len, void (*visit)(int32_t value, void *arg), void *arg)
+{
+  PrefixTrieNode *nodes = trie->nodes;
+  int32_t nodeIdx = 0;
+  int32_t child;
+  int numVisited = 0;
+  int pos = 0;
+
+  spin_lock(&trie->lock);
+  while (pos < len)
+  {
+    child = *find_child_link(trie, nodeIdx, string[pos]);
+    if (child == PREFIX_TRIE_NIL || nodes[child].labelLen > len - pos ||
+        memcmp(nodes[child].label, string + pos, nodes[child].labelLen) != 0)
+    { /* No longer key is a prefix of string */
+      break;
+    }
+    nodeIdx = child;
+    pos += nodes[child].labelLen;
+    for (int32_t valueIdx = nodes[nodeIdx].firstValue; valueIdx != PREFIX_TRIE_NIL; valueIdx = trie->values[valueIdx].next)
+    {
+      visit(trie->values[valueIdx].value, arg);
+      numVisited++;
+    }
+  }
+  spin_unlock(&trie->lock);
+  return numVisited;
+}
+
+/** \copydoc prefix_trie_is_empty */
+int prefix_trie_is_empty(PrefixTrie *trie)
+{
+  return __atomic_load_n(&trie->numValues, __ATOMIC_ACQUIRE) == 0;
+}
+
+static size_t trie_size(int maxValues)
+{
+  return sizeof(PrefixTrie) + sizeof(PrefixTrieNode) * (2 * maxValues + 1) + sizeof(PrefixTrieValue) * maxValues;
+}
+
+static int32_t alloc_node(PrefixTrie *trie, const char *label, int labelLen)
+{
+  int32_t nodeIdx = trie->freeNodes;
+
+  if (nodeIdx == PREFIX_TRIE_NIL)
+    return PREFIX_TRIE_NIL;
+  trie->freeNodes = trie->nodes[nodeIdx].nextSibling;
+  trie->nodes[nodeIdx].firstChild = PREFIX_TRIE_NIL;
+  trie->nodes[nodeIdx].nextSibling = PREFIX_TRIE_NIL;
+  trie->nodes[nodeIdx].firstValue = PREFIX_TRIE_NIL;
+  trie->nodes[nodeIdx].labelLen = labelLen;
+  memcpy(trie->nodes[nodeIdx].label, label, labelLen);
+  return nodeIdx;
+}
+
+static void free_node(PrefixTrie *trie, int32_t nodeIdx)
+{
+  trie->nodes[nodeIdx].nextSibling = trie->freeNodes;
+  trie->freeNodes = nodeIdx;
+}
+
+/* Link pointing at the child starting with first, or the NIL link ending
+ * the children if there is none */
+static int32_t *find_child_link(PrefixTrie *trie, int32_t nodeIdx, char first)
+{
+  int32_t *link = &trie->nodes[nodeIdx].firstChild;
+
+  while (*link != PREFIX_TRIE_NIL && trie->nodes[*link].label[0] != first)
+    link = &trie->nodes[*link].nextSibling;
+  return link;
+}
+
+/* Folds the only child of a node without values into the node's edge */
+static void merge_with_only_child(PrefixTrie *trie, int32_t nodeIdx)
+{
+  PrefixTrieNode *node = &trie->nodes[nodeIdx];
+  int32_t child = node->firstChild;
+
+  if (child == PREFIX_TRIE_NIL || trie->nodes[child].nextSibling != PREFIX_TRIE_NIL)
+    return;
+  /* Both labels lie on the path of one key, so they fit together */
+  memcpy(node->label + node->labelLen, trie->nodes[child].label, trie->nodes[child].labelLen);
+  node->labelLen += trie->nodes[child].labelLen;
+  node->firstChild = trie->nodes[child].firstChild;
+  node->firstValue = trie->nodes[child].firstValue;
+  free_node(trie, child);
+}
@@ -0,0 +1,146 @@
+/****************************************************************************
+ * @author: Jordan396 <https://github.com/Jordan396/trivial-twitter-v2>     *
+ *                                                                          *
+ *   You should have received a copy of the MIT License when cloning this   *
+ *   repository. If not, see <https://opensource.org/licenses/MIT>.         *
+ ****************************************************************************/
+
+/**
+  * @file ttweet_trie.h
+  * @date 18 October 2026
+  * @brief Documentation for functions in ttweet_trie.c.
+  *
+  * This header file has been created to describe the functions
+  * and declare constants in ttweet_trie.c.
+  *
+  * For an overview of what this program does, visit <https://github.com/Jordan396/trivial-twitter-v2>.
+  *
+  * Code is documented according to GNOME and Doxygen standards.
+  * <https://developer.gnome.org/programming-guidelines/stable/c-coding-style.html.en>
+  * <http://www.doxygen.nl/manual/docblocks.html>
+  */
+
+#ifndef TTWEET_COMMON_H
+#define TTWEET_COMMON_H
+#include "../dependencies/ttweet_common.h"
+void die_with_error(char *errorMessage);
+int persist_with_error(char *errorMessage);
+int send_payload(int sock, cJSON *jobjToSend);
+int receive_response(int sock, char *objReceived);
+void spin_lock(int *lock);
+void spin_unlock(int *lock);
+#endif
+
+#ifndef TTWEET_TRIE_H
+#define TTWEET_TRIE_H
+
+#include <stdint.h>
+
+#define PREFIX_TRIE_NIL -1          /* No node or value */
+#define PREFIX_TRIE_MAX_KEY_LEN 32  /* Longest key, and so longest edge label */
+
+/* A node of the trie, reached from its parent over an edge of label
+ * characters. Siblings never share a first character, and every node but
+ * the root holds values or has at least two children. */
+typedef struct PrefixTrieNode
+{
+  int32_t firstChild;  /* Index of the first child, PREFIX_TRIE_NIL if a leaf */
+  int32_t nextSibling; /* Index of the next child of the parent; links the free list */
+  int32_t firstValue;  /* Values stored under this exact prefix */
+  uint8_t labelLen;
+  char label[PREFIX_TRIE_MAX_KEY_LEN];
+} PrefixTrieNode;
+
+typedef struct PrefixTrieValue
+{
+  int32_t value;
+  int32_t next; /* Next value of the same node; links the free list */
+} PrefixTrieValue;
+
+/* Fixed capacity trie in shared memory. Links are array indices, so the
+ * trie works the same in every process that inherits the mapping. */
+typedef struct PrefixTrie
+{
+  int lock; /* Spinlock held by every operation */
+  int numValues;
+  int maxValues;
+  int maxNodes;
+  int32_t freeNodes;
+  int32_t freeValues;
+  PrefixTrieNode *nodes; /* nodes[0] is the root, with an empty label */
+  PrefixTrieValue *values;
+} PrefixTrie;
+
+/**
+ * @brief Creates an empty trie in shared memory
+ *
+ * Call before fork() so that every child sees the same trie.
+ *
+ * @param maxValues Most values stored at once; nodes are sized to match
+ * @return PrefixTrie* The trie, or NULL if mmap() failed.
+ */
+PrefixTrie *prefix_trie_create(int maxValues);
+
+/**
+ * @brief Releases a trie from prefix_trie_create()
+ *
+ * @param trie Trie to release
+ * @return void
+ */
+void prefix_trie_destroy(PrefixTrie *trie);
+
+/**
+ * @brief Stores a value under a key
+ *
+ * Splits at most one edge. The same value may be stored under many keys,
+ * and more than once under the same key.
+ *
+ * @param trie Trie to store into
+ * @param key Key characters, not NUL terminated
+ * @param len Length of key, 1 to PREFIX_TRIE_MAX_KEY_LEN
+ * @param value Value to store
+ * @return int 1 if stored; 0 if the key is too long or the trie is full.
+ */
+int prefix_trie_insert(PrefixTrie *trie, const char *key, int len, int32_t value);
+
+/**
+ * @brief Removes one copy of a value stored under a key
+ *
+ * Nodes left without values are freed or merged into their only child,
+ * so the trie stays as compact as if the key had never been inserted.
+ *
+ * @param trie Trie to remove from
+ * @param key Key characters, not NUL terminated
+ * @param len Length of key
+ * @param value Value to remove
+ * @return int 1 if removed; 0 if the value was not stored under key.
+ */
+int prefix_trie_remove(PrefixTrie *trie, const char *key, int len, int32_t value);
+
+/**
+ * @brief Visits the values of every stored key that is a prefix of a string
+ *
+ * Walks a single path from the root, so the cost depends on the length of
+ * the string and the number of values visited, not on the number of keys.
+ * The trie is locked while visit runs, so visit must not call back into it.
+ *
+ * @param trie Trie to search
+ * @param string Characters to match, not NUL terminated
+ * @param len Length of string
+ * @param visit Called once per value, with arg
+ * @param arg Passed to visit
+ * @return int Number of values visited.
+ */
+int prefix_trie_match(PrefixTrie *trie, const char *string, int len, void (*visit)(int32_t value, void *arg), void *arg);
+
+/**
+ * @brief Checks whether a trie holds any values
+ *
+ * Does not take the lock, so a concurrent insert may not be seen yet.
+ *
+ * @param trie Trie to check
+ * @return int 1 if empty; 0 otherwise.
+ */
+int prefix_trie_is_empty(PrefixTrie *trie);
+
+#endif
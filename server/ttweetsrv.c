@@ -46,37 +46,90 @@
 /* Function prototypes */
 
 /* functions to handle child processes */
-void child_exit_signal_handler(); /* Clean up zombie child processes */
+void child_exit_signal_handler();      /* Clean up zombie child processes */
+void shutdown_signal_handler(int sig); /* Requests a clean shutdown */
 
 /* functions to handle connections */
 int create_tcp_serv_socket(unsigned short port); /* Creates TCP server socket */
 int accept_tcp_connection(int servSock);         /* Accepts and maintains a TCP connection */
+int parse_int_options(char *optionString, const IntOption options[], int numOptions, void *target); /* Parses key=value options */
+int parse_socket_profile(char *profileString, SocketProfile *profile); /* Parses socket options */
+int parse_timeout_profile(char *profileString, TimeoutProfile *profile); /* Parses connection deadlines */
+int parse_admission_profile(char *profileString, AdmissionProfile *profile); /* Parses memory and bandwidth budgets */
+int parse_rate_limit_profile(char *profileString, RateLimitProfile *profile); /* Parses request rate limits */
+void apply_listener_socket_profile(int sock, SocketProfile *profile);  /* Sets listener socket options */
+void apply_connection_socket_profile(int sock, SocketProfile *profile); /* Sets accepted socket options */
+int has_pending_request(int sock);                                     /* Checks for unread requests */
 void handle_ttweet_client(int clntSocket);       /* Handles connection with client */
 void reject_ttweet_client(int clntSocket);       /* Sends a rejection message and closes connection */
+void open_client_connection(ClientConnection *conn, int clntSocket); /* Prepares connection state and timers */
+void touch_client_connection(ClientConnection *conn, int sessionId); /* Restarts timers after a request */
+int *get_request_user_idx(ClientConnection *conn, int sessionId);    /* Returns the user a request acts on */
+void login_timeout_handler(Timer *timer, void *arg);                 /* Closes connections that never log in */
+void idle_timeout_handler(Timer *timer, void *arg);                  /* Closes silent connections */
+void heartbeat_handler(Timer *timer, void *arg);                     /* Pings silent connections */
+void session_timeout_handler(Timer *timer, void *arg);               /* Ends silent sessions */
+void pause_client_reads(ClientConnection *conn, int pauseMs);        /* Stops reading requests for a while */
+void resume_reads_handler(Timer *timer, void *arg);                  /* Reads requests again */
+int is_over_output_budget(int sock);                                 /* Checks for unread responses */
+int is_over_memory_budget(int extraBytes);                           /* Checks pending tweet bytes */
+TokenBucket *get_ip_bucket(uint32_t addr);                           /* Returns the rate limit of an address */
+int is_rate_limited(int requestCode, int userIdx);                   /* Checks request rate limits */
 
 /* functions to initialize global variables */
-void initialize_user_array();   /* Initialize activeUsers array */
-void initialize_latest_tweet(); /* Initialize latestTweet */
+void allocate_user_table(int numUsers);          /* Allocates activeUsers and userTable */
+void free_user_table(int numUsers);              /* Releases activeUsers and userTable */
+uint32_t hashtag_id(const char *hashtag);        /* Identifies a hashtag in userTable */
+int prefix_subscription_len(const char *subscription); /* Detects a prefix subscription */
+uint64_t hashtag_signature(uint32_t hashtagId);  /* Bloom filter bits of a hashtag */
+void update_subscription_signature(int userIdx); /* Rebuilds a user's Bloom filter */
+void initialize_user_array();                    /* Initialize activeUsers array */
+void initialize_latest_tweet();                  /* Initialize latestTweet */
 
 /* functions to support transmission of data */
 void create_json_server_payload(cJSON *jobjToSend, int commandCode, int userIdx, char *detailedMessage); /* Creates a JSON payload to be send to client */
+int send_response(int clntSocket, cJSON *jobjToSend, int flags);                                         /* Sends a response, compressed if negotiated */
+int accept_compression(cJSON *jobjToSend, cJSON *jobjReceived);                                          /* Agrees to compress later responses */
 
 /* functions to handle client commands */
-int handle_client_response(int clntSocket, cJSON *jobjReceived, int *clientUserIdx);                               /* Handles client response */
+int handle_client_response(int clntSocket, cJSON *jobjReceived, int *clientUserIdx, int sessionId);              /* Handles client response */
+int get_session_id(cJSON *jobjReceived);                                                                           /* Reads the optional sessionId of a request */
+void end_mux_sessions(int sessionUserIdx[]);                                                                       /* Releases the users of a multiplexed connection */
+int is_valid_client_request(cJSON *jobjReceived, int requestCode, int clientUserIdx);                              /* Checks that a request is well formed */
 void handle_validate_user_request(cJSON *jobjToSend, char *senderUsername, int *clientUserIdx);                    /* Handles validate user request */
 void handle_tweet_request(cJSON *jobjToSend, cJSON *jobjReceived, char *senderUsername, int *clientUserIdx);       /* Handles tweet request */
 void handle_subscribe_request(cJSON *jobjToSend, cJSON *jobjReceived, char *senderUsername, int *clientUserIdx);   /* Handles subscribe request */
 void handle_unsubscribe_request(cJSON *jobjToSend, cJSON *jobjReceived, char *senderUsername, int *clientUserIdx); /* Handles unsubscribe request */
-void handle_timeline_request(cJSON *jobjToSend, int *clientUserIdx);                                               /* Handles timeline request */
+void handle_subscribe_keyword_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx);                 /* Handles subscribe keyword request */
+void handle_unsubscribe_keyword_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx);               /* Handles unsubscribe keyword request */
+void handle_follow_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx);                            /* Handles follow request */
+void handle_unfollow_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx);                          /* Handles unfollow request */
+void handle_timeline_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx);                            /* Handles timeline request */
+void handle_search_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx);                             /* Handles search request */
+void handle_trending_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx);                           /* Handles trending request */
 int handle_exit_request(int *userIdx);                                                                             /* Handles exit request */
-int handle_invalid_request();                                                                                      /* Handles invalid request */
+int handle_invalid_request(int *userIdx);                                                                          /* Handles invalid request */
 
 /* functions to support above handling functions */
 void handle_tweet_updates();                                                                        /* Updates tweets across all clients */
 void add_tweet_to_user(int userIdx, char *senderUsername, char *ttweetString, char *originHashtag); /* Adds a tweet to a user */
-void add_pending_tweets_to_jobj(cJSON *jobj, int userIdx);                                          /* Adds pending tweets to JSON obj */
+void shed_oldest_tweet(int userIdx);                                                                /* Drops a user's oldest pending tweet */
+void account_undelivered_bytes(int64_t delta);                                                      /* Tracks pending tweet bytes */
+void add_pending_tweets_to_jobj(cJSON *jobj, int userIdx, int64_t cursor, int maxTweets);           /* Adds pending tweets to JSON obj */
 void store_latest_tweet(cJSON *jobjReceived, char *senderUsername);                                 /* Stores to last received tweet */
 void clear_user_at_index(int *userIdx);                                                             /* Clears user space at specified index */
+void park_user_at_index(int *userIdx);                                                              /* Keeps a disconnected user for the next login */
+int save_user_mailbox(int userIdx);                                                                 /* Writes a user to the mailbox store */
+int restore_user_mailbox(int userIdx);                                                              /* Reads a user from the mailbox store */
+static void mark_fanout_candidate(int32_t userIdx, void *candidates);                               /* Collects prefix and keyword subscribers */
+static void copy_lower_case(char *destination, const char *source);                                 /* Copies a keyword in lower case */
+static int count_pending_tweets(int userIdx);                                                       /* Counts a user's pending tweets */
+static void publish_to_followers(int authorIdx);                                                    /* Collects the followers of the latest tweet's author */
+static void pull_followed_posts(int userIdx);                                                       /* Queues posts of authors fanned out on read */
+static void drop_oldest_tweets(int userIdx, int numTweets);                                         /* Clears a user's oldest pending tweets */
+static void set_subscription(int userIdx, int subscriptionIdx, const char *hashtag);                /* Stores and indexes a subscription */
+static void refill_pending_tweets(int userIdx);                                                      /* Reads spilled tweets back into the queue */
+static void drop_displaced_mailbox(Mailbox *displaced);                                             /* Releases a mailbox whose slot was taken */
 
 /* functions for debugging */
 void print_active_users();              /* Print activeUsers */
@@ -84,10 +137,89 @@ void print_latest_tweet();              /* Print latest tweet */
 void print_pending_tweets(int userIdx); /* Print pending tweets for a specified user */
 
 /* Global variables */
-unsigned int childProcCount; /* Number of child processes */
-LatestTweet *latestTweet;    /* Latest tweet */
-User *activeUsers;           /* Tracks all active users */
-
+unsigned int childProcCount;                 /* Number of child processes */
+volatile sig_atomic_t shutdownRequested = 0; /* Set by SIGTERM/SIGINT */
+LatestTweet *latestTweet;                    /* Latest tweet */
+int64_t *undeliveredBytes;                   /* Bytes of pending tweets, shared by all processes */
+TokenBucket *ipBuckets;                      /* Rate limits by client address, shared by all processes */
+TokenBucket *clientIpBucket;                 /* Bucket of this process's client, NULL if none */
+User *activeUsers;                           /* Tracks all active users */
+UserTable userTable;                         /* Fan-out fields of activeUsers */
+int maxActiveUsers = MAX_CONC_CONN;          /* Capacity of activeUsers */
+SearchIndex *searchIndex;                    /* Recent tweets by term, shared by all processes; NULL if disabled */
+int searchWindow = DEFAULT_SEARCH_WINDOW;    /* Tweets kept searchable, see -s */
+int compressMinBytes = DEFAULT_COMPRESS_MIN_BYTES; /* Smallest response compressed, see -z; 0 disables compression */
+PayloadCompressor *responseCompressor;       /* Compression of this process's responses, NULL until negotiated */
+int fanoutThreshold = DEFAULT_FANOUT_THRESHOLD; /* Followers at which an author is fanned out on read, see -F; 0 for never */
+TrendingTracker *trendingTracker;            /* Hashtag heavy hitters, shared by all processes */
+MailboxStore *mailboxStore;                  /* Mailboxes of evicted users and earlier runs, see -M; NULL if disabled */
+SpillStore *spillStore;                      /* Tweets that overflow a queue, see -S; NULL if disabled */
+SocketProfile socketProfile = {
+    .reuseAddr = 1,
+    .noDelay = 1,
+    .coalesce = 1,
+    .deferAccept = 5,
+    .keepIdle = 60,
+    .keepIntvl = 10,
+    .keepCnt = 5}; /* Socket options, see -t */
+TimeoutProfile timeoutProfile = {
+    .loginMs = 5000,
+    .idleMs = 90000,
+    .heartbeatMs = 30000,
+    .sessionMs = 0}; /* Connection deadlines, see -T */
+AdmissionProfile admissionProfile = {
+    .memoryBytes = 4 * 1024 * 1024,
+    .outputBytes = 256 * 1024,
+    .pauseMs = 100,
+    .shedOldest = 1}; /* Budgets, see -B */
+RateLimitProfile rateLimitProfile = {
+    .tweetRate = 500,
+    .tweetBurst = 1000,
+    .subscribeRate = 500,
+    .subscribeBurst = 1000,
+    .timelineRate = 2000,
+    .timelineBurst = 4000,
+    .ipRate = 0,
+    .ipBurst = 0}; /* Request rate limits, see -R */
+
+static const IntOption socketProfileKeys[] = {
+    {"reuseaddr", offsetof(SocketProfile, reuseAddr)},
+    {"nodelay", offsetof(SocketProfile, noDelay)},
+    {"coalesce", offsetof(SocketProfile, coalesce)},
+    {"defer", offsetof(SocketProfile, deferAccept)},
+    {"sndbuf", offsetof(SocketProfile, sndBuf)},
+    {"rcvbuf", offsetof(SocketProfile, rcvBuf)},
+    {"keepidle", offsetof(SocketProfile, keepIdle)},
+    {"keepintvl", offsetof(SocketProfile, keepIntvl)},
+    {"keepcnt", offsetof(SocketProfile, keepCnt)},
+};
+
+static const IntOption timeoutProfileKeys[] = {
+    {"login", offsetof(TimeoutProfile, loginMs)},
+    {"idle", offsetof(TimeoutProfile, idleMs)},
+    {"heartbeat", offsetof(TimeoutProfile, heartbeatMs)},
+    {"session", offsetof(TimeoutProfile, sessionMs)},
+};
+
+static const IntOption admissionProfileKeys[] = {
+    {"memory", offsetof(AdmissionProfile, memoryBytes)},
+    {"outbuf", offsetof(AdmissionProfile, outputBytes)},
+    {"pause", offsetof(AdmissionProfile, pauseMs)},
+    {"shed", offsetof(AdmissionProfile, shedOldest)},
+};
+
+static const IntOption rateLimitProfileKeys[] = {
+    {"tweet", offsetof(RateLimitProfile, tweetRate)},
+    {"tweetburst", offsetof(RateLimitProfile, tweetBurst)},
+    {"subscribe", offsetof(RateLimitProfile, subscribeRate)},
+    {"subscribeburst", offsetof(RateLimitProfile, subscribeBurst)},
+    {"timeline", offsetof(RateLimitProfile, timelineRate)},
+    {"timelineburst", offsetof(RateLimitProfile, timelineBurst)},
+    {"ip", offsetof(RateLimitProfile, ipRate)},
+    {"ipburst", offsetof(RateLimitProfile, ipBurst)},
+};
+
+#ifndef TTWEETSRV_NO_MAIN /* Defined when linking server functions into benchmarks */
 int main(int argc, char *argv[])
 {
   int servSock;                   /* Socket descriptor for server */
@@ -95,13 +227,71 @@ int main(int argc, char *argv[])
   unsigned short ttweetServPort;  /* Server port */
   pid_t processID;                /* Process ID from fork() */
   struct sigaction signalHandler; /* Signal handler specification structure */
+  unsigned short metricsPort = 0; /* Admin metrics port, 0 if disabled */
+  int opt;                        /* Option character from getopt() */
+  char *mailboxPath = NULL;       /* Mailbox store file, NULL if disabled */
+  char *spillDir = NULL;          /* Directory of spilled tweets, NULL if disabled */
+
+  while ((opt = getopt(argc, argv, "m:u:s:z:F:M:S:t:T:B:R:")) != -1)
+  { /* Parse optional arguments */
+    switch (opt)
+    {
+    case 'm':
+      metricsPort = atoi(optarg);
+      break;
+    case 'u':
+      maxActiveUsers = atoi(optarg);
+      if (maxActiveUsers < 1)
+        die_with_error("MaxUsers must be positive.\n");
+      break;
+    case 's':
+      searchWindow = atoi(optarg);
+      if (searchWindow < 0)
+        die_with_error("SearchWindow must not be negative.\n");
+      break;
+    case 'z':
+      compressMinBytes = atoi(optarg);
+      if (compressMinBytes < 0)
+        die_with_error("CompressMinBytes must not be negative.\n");
+      break;
+    case 'F':
+      fanoutThreshold = atoi(optarg);
+      if (fanoutThreshold < 0)
+        die_with_error("FanoutThreshold must not be negative.\n");
+      break;
+    case 'M':
+      mailboxPath = optarg;
+      break;
+    case 'S':
+      spillDir = optarg;
+      break;
+    case 't':
+      if (!parse_socket_profile(optarg, &socketProfile))
+        die_with_error("Invalid socket profile. Expected key=value pairs with keys reuseaddr, nodelay, coalesce, defer, sndbuf, rcvbuf, keepidle, keepintvl, keepcnt.\n");
+      break;
+    case 'T':
+      if (!parse_timeout_profile(optarg, &timeoutProfile))
+        die_with_error("Invalid timeouts. Expected key=value pairs in milliseconds with keys login, idle, heartbeat, session.\n");
+      break;
+    case 'B':
+      if (!parse_admission_profile(optarg, &admissionProfile))
+        die_with_error("Invalid budgets. Expected key=value pairs with keys memory, outbuf, pause, shed.\n");
+      break;
+    case 'R':
+      if (!parse_rate_limit_profile(optarg, &rateLimitProfile))
+        die_with_error("Invalid rate limits. Expected key=value pairs with keys tweet, subscribe, timeline, ip and their *burst.\n");
+      break;
+    default:
+      die_with_error("Usage: ./ttweetsrv [-m <MetricsPort>] [-u <MaxUsers>] [-s <SearchWindow>] [-z <CompressMinBytes>] [-F <FanoutThreshold>] [-M <MailboxFile>] [-S <SpillDir>] [-t <SocketProfile>] [-T <Timeouts>] [-B <Budgets>] [-R <RateLimits>] <Port>\n");
+    }
+  }
 
-  if (argc != 2) /* Test for correct number of arguments */
+  if (argc - optind != 1) /* Test for correct number of arguments */
   {
-    die_with_error("Usage: ./ttweetsrv <Port>\n");
+    die_with_error("Usage: ./ttweetsrv [-m <MetricsPort>] [-u <MaxUsers>] [-s <SearchWindow>] [-z <CompressMinBytes>] [-F <FanoutThreshold>] [-M <MailboxFile>] [-S <SpillDir>] [-t <SocketProfile>] [-T <Timeouts>] [-B <Budgets>] [-R <RateLimits>] <Port>\n");
   }
 
-  ttweetServPort = atoi(argv[1]); /* First arg:  local port */
+  ttweetServPort = atoi(argv[optind]); /* First arg:  local port */
   servSock = create_tcp_serv_socket(ttweetServPort);
 
   /* Set child_exit_signal_handler() as handler function */
@@ -115,35 +305,61 @@ int main(int argc, char *argv[])
   if (sigaction(SIGCHLD, &signalHandler, 0) < 0)
     die_with_error("sigaction() failed");
 
+  /* SIGTERM/SIGINT interrupt accept() so the server exits through exit() */
+  signalHandler.sa_handler = shutdown_signal_handler;
+  signalHandler.sa_flags = 0;
+  if (sigaction(SIGTERM, &signalHandler, 0) < 0 || sigaction(SIGINT, &signalHandler, 0) < 0)
+    die_with_error("sigaction() failed");
+
   /* Initialize child process counter */
   childProcCount = 0;
 
   /* Create shared memory space for global variables across all processes */
   latestTweet = mmap(NULL, sizeof(LatestTweet), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
-  activeUsers = mmap(NULL, sizeof(User) * MAX_CONC_CONN, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  allocate_user_table(maxActiveUsers);
+  if (mailboxPath != NULL && (mailboxStore = mailbox_store_open(mailboxPath, MAX_MAILBOXES)) == NULL)
+    die_with_error("Mailbox store could not be opened");
+  if (spillDir != NULL && (spillStore = spill_store_open(spillDir)) == NULL)
+    die_with_error("Spill directory could not be opened");
+  undeliveredBytes = mmap(NULL, sizeof(int64_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  ipBuckets = mmap(NULL, sizeof(TokenBucket) << IP_RATE_BUCKET_BITS, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (searchWindow > 0 && (searchIndex = search_index_create(searchWindow)) == NULL)
+    die_with_error("Search index allocation failed");
+  if ((trendingTracker = trending_tracker_create(histogram_now_ns() / 1000000)) == NULL)
+    die_with_error("Trending tracker allocation failed");
 
   /* Initialize global variables */
   initialize_user_array();
   initialize_latest_tweet();
 
-  while (1) /* run forever */
+  /* Shared metrics must exist before the first fork() */
+  metrics_init();
+  if (metricsPort)
+    metrics_serve_admin(metricsPort);
+
+  while (!shutdownRequested) /* run until asked to stop */
   {
     clntSock = accept_tcp_connection(servSock);
+    if (clntSock < 0)
+      continue; /* interrupted by a signal */
     /* Fork child process and report any errors */
     if ((processID = fork()) < 0)
       die_with_error("fork() failed");
     else if (processID == 0) /* If this is the child process */
     {
       close(servSock); /* Child closes parent socket file descriptor */
+      metrics_attach_worker();
       if (childProcCount < MAX_CONC_CONN)
       { /* Connection space available */
         handle_ttweet_client(clntSock);
       }
       else
       { /* Connection space unavailable */
+        metrics_add(METRIC_CONN_REJECTED, 1);
         reject_ttweet_client(clntSock);
       }
 
+      metrics_detach_worker();
       exit(0); /* Child process done */
     }
 
@@ -151,7 +367,18 @@ int main(int argc, char *argv[])
     close(clntSock);  /* Parent closes child socket descriptor */
     childProcCount++; /* Increment number of outstanding child processes */
   }
+
+  for (int userIdx = 0; userIdx < maxActiveUsers; userIdx++)
+  { /* Users still connected or parked are restored from the store after a restart */
+    if (userTable.isOccupied[userIdx])
+      save_user_mailbox(userIdx);
+  }
+  if (spillStore != NULL)
+    spill_store_close(spillStore); /* Spilled tweets are not kept across restarts */
+  close(servSock);
+  exit(0);
 }
+#endif
 
 /** \copydoc child_exit_signal_handler */
 void child_exit_signal_handler()
@@ -172,6 +399,12 @@ void child_exit_signal_handler()
   }
 }
 
+/** \copydoc shutdown_signal_handler */
+void shutdown_signal_handler(int sig)
+{
+  shutdownRequested = 1;
+}
+
 /** \copydoc create_tcp_serv_socket */
 int create_tcp_serv_socket(unsigned short port)
 {
@@ -181,6 +414,7 @@ int create_tcp_serv_socket(unsigned short port)
   /* Create socket for incoming connections */
   if ((sock = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0)
     die_with_error("socket() failed");
+  apply_listener_socket_profile(sock, &socketProfile);
 
   /* Construct local address structure */
   memset(&ttweetServAddr, 0, sizeof(ttweetServAddr)); /* Zero out structure */
@@ -212,31 +446,197 @@ int accept_tcp_connection(int servSock)
   /* Wait for a client to connect */
   if ((clntSock = accept(servSock, (struct sockaddr *)&ttweetClntAddr,
                          &clntLen)) < 0)
+  {
+    if (errno == EINTR)
+      return -1;
     die_with_error("accept() failed");
+  }
 
   /* clntSock is connected to a client! */
+  apply_connection_socket_profile(clntSock, &socketProfile);
 
   printf("Handling client %s\n", inet_ntoa(ttweetClntAddr.sin_addr));
+  metrics_add(METRIC_CONN_ACCEPTED, 1);
 
   return clntSock;
 }
 
+/** \copydoc parse_int_options */
+int parse_int_options(char *optionString, const IntOption options[], int numOptions, void *target)
+{
+  char buffer[256];
+  char *saveptr;
+  char *pair;
+  int keyIdx;
+
+  strncpy(buffer, optionString, sizeof(buffer) - 1);
+  buffer[sizeof(buffer) - 1] = '\0';
+
+  for (pair = strtok_r(buffer, ",", &saveptr); pair != NULL; pair = strtok_r(NULL, ",", &saveptr))
+  {
+    char *equals = strchr(pair, '=');
+    if (equals == NULL || atoi(equals + 1) < 0)
+      return 0;
+    *equals = '\0';
+    for (keyIdx = 0; keyIdx < numOptions; keyIdx++)
+    {
+      if (strcmp(pair, options[keyIdx].name) == 0)
+        break;
+    }
+    if (keyIdx == numOptions)
+      return 0;
+    *(int *)((char *)target + options[keyIdx].offset) = atoi(equals + 1);
+  }
+  return 1;
+}
+
+/** \copydoc parse_socket_profile */
+int parse_socket_profile(char *profileString, SocketProfile *profile)
+{
+  return parse_int_options(profileString, socketProfileKeys, sizeof(socketProfileKeys) / sizeof(socketProfileKeys[0]), profile);
+}
+
+/** \copydoc parse_timeout_profile */
+int parse_timeout_profile(char *profileString, TimeoutProfile *profile)
+{
+  return parse_int_options(profileString, timeoutProfileKeys, sizeof(timeoutProfileKeys) / sizeof(timeoutProfileKeys[0]), profile);
+}
+
+/** \copydoc parse_admission_profile */
+int parse_admission_profile(char *profileString, AdmissionProfile *profile)
+{
+  return parse_int_options(profileString, admissionProfileKeys, sizeof(admissionProfileKeys) / sizeof(admissionProfileKeys[0]), profile);
+}
+
+/** \copydoc parse_rate_limit_profile */
+int parse_rate_limit_profile(char *profileString, RateLimitProfile *profile)
+{
+  if (!parse_int_options(profileString, rateLimitProfileKeys, sizeof(rateLimitProfileKeys) / sizeof(rateLimitProfileKeys[0]), profile))
+    return 0;
+  /* An empty bucket with a rate would refuse every request */
+  if (profile->tweetBurst == 0)
+    profile->tweetBurst = profile->tweetRate;
+  if (profile->subscribeBurst == 0)
+    profile->subscribeBurst = profile->subscribeRate;
+  if (profile->timelineBurst == 0)
+    profile->timelineBurst = profile->timelineRate;
+  if (profile->ipBurst == 0)
+    profile->ipBurst = profile->ipRate;
+  return 1;
+}
+
+/** \copydoc apply_listener_socket_profile */
+void apply_listener_socket_profile(int sock, SocketProfile *profile)
+{
+  if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &profile->reuseAddr, sizeof(int)) < 0)
+    persist_with_error("setsockopt(SO_REUSEADDR) failed");
+  if (profile->deferAccept && setsockopt(sock, IPPROTO_TCP, TCP_DEFER_ACCEPT, &profile->deferAccept, sizeof(int)) < 0)
+    persist_with_error("setsockopt(TCP_DEFER_ACCEPT) failed");
+  if (profile->sndBuf && setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &profile->sndBuf, sizeof(int)) < 0)
+    persist_with_error("setsockopt(SO_SNDBUF) failed");
+  if (profile->rcvBuf && setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &profile->rcvBuf, sizeof(int)) < 0)
+    persist_with_error("setsockopt(SO_RCVBUF) failed");
+}
+
+/** \copydoc apply_connection_socket_profile */
+void apply_connection_socket_profile(int sock, SocketProfile *profile)
+{
+  int keepAlive = profile->keepIdle > 0;
+
+  if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &profile->noDelay, sizeof(int)) < 0)
+    persist_with_error("setsockopt(TCP_NODELAY) failed");
+  if (setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &keepAlive, sizeof(int)) < 0)
+    persist_with_error("setsockopt(SO_KEEPALIVE) failed");
+  if (keepAlive && (setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &profile->keepIdle, sizeof(int)) < 0 ||
+                    setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &profile->keepIntvl, sizeof(int)) < 0 ||
+                    setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &profile->keepCnt, sizeof(int)) < 0))
+    persist_with_error("setsockopt(TCP_KEEP*) failed");
+}
+
+/** \copydoc has_pending_request */
+int has_pending_request(int sock)
+{
+  int pendingBytes = 0;
+
+  return ioctl(sock, FIONREAD, &pendingBytes) == 0 && pendingBytes > 0;
+}
+
 /** \copydoc handle_ttweet_client */
 void handle_ttweet_client(int clntSocket)
 {
   char objReceived[MAX_RESP_LEN];
-  int clientUserIdx = INVALID_USER_INDEX;
+  static ClientConnection conn; /* static: the timer wheel is too large for the stack */
+  struct pollfd pollFd;
+  int *userIdx;
+  int sessionId;
+  int ready;
   int loop = 1;
 
-  while (loop)
+  open_client_connection(&conn, clntSocket);
+  pollFd.fd = clntSocket;
+  pollFd.events = POLLIN;
+
+  while (loop && !conn.closing && !shutdownRequested)
   { /* loop continuously to exchange messages with client */
     // print_active_users();
-    cJSON *jobjReceived = cJSON_CreateObject();
-    receive_response(clntSocket, objReceived);
-    jobjReceived = cJSON_Parse(objReceived);
-    loop = handle_client_response(clntSocket, jobjReceived, &clientUserIdx);
+    if (!conn.readsPaused && is_over_output_budget(clntSocket))
+    { /* Client is not reading its responses, stop producing more */
+      pause_client_reads(&conn, TIMER_WHEEL_TICK_MS);
+    }
+    pollFd.events = conn.readsPaused ? 0 : POLLIN;
+    ready = poll(&pollFd, 1, timer_wheel_next_timeout_ms(&conn.wheel, histogram_now_ns() / 1000000));
+    if (ready < 0 && errno != EINTR)
+      die_with_error("poll() failed");
+    /* Deadlines that passed while waiting apply before the next request */
+    timer_wheel_advance(&conn.wheel, histogram_now_ns() / 1000000);
+    if (ready <= 0 || conn.closing)
+      continue;
+
+    int bytesReceived = receive_response(clntSocket, objReceived);
+    if (!bytesReceived)
+      break; /* Client went away without sending exit */
+    metrics_add(METRIC_BYTES_IN, RCV_BUF_SIZE + bytesReceived);
+    cJSON *jobjReceived = cJSON_Parse(objReceived);
+    cJSON *jobjRequestCode = cJSON_GetObjectItemCaseSensitive(jobjReceived, "requestCode");
+    sessionId = get_session_id(jobjReceived);
+    touch_client_connection(&conn, sessionId);
+
+    if (cJSON_IsNumber(jobjRequestCode) && jobjRequestCode->valueint == REQ_PING)
+    { /* Keepalive only, nothing to answer */
+      metrics_observe_request(REQ_PING, 0);
+    }
+    else if (sessionId == INVALID_SESSION_ID)
+    { /* Malformed sessionId, treated like any malformed request */
+      loop = handle_client_response(clntSocket, NULL, &conn.clientUserIdx, NO_SESSION_ID);
+    }
+    else
+    { /* One user per connection, or the session's own user */
+      userIdx = get_request_user_idx(&conn, sessionId);
+      loop = handle_client_response(clntSocket, jobjReceived, userIdx, sessionId);
+      if (*userIdx != INVALID_USER_INDEX)
+        timer_cancel(&conn.wheel, &conn.loginTimer);
+      else if (sessionId != NO_SESSION_ID)
+        timer_cancel(&conn.wheel, &conn.sessionTimers[sessionId]);
+      if (cJSON_IsNumber(jobjRequestCode) && jobjRequestCode->valueint == REQ_TWEET && is_over_memory_budget(0))
+      { /* Readers are behind, slow the tweeter down instead of queueing more */
+        pause_client_reads(&conn, admissionProfile.pauseMs);
+      }
+    }
     cJSON_Delete(jobjReceived);
   }
+
+  if (loop)
+  { /* Disconnected or timed out rather than through exit */
+    handle_exit_request(&conn.clientUserIdx);
+  }
+  if (conn.sessionUserIdx != NULL)
+  { /* Sessions end with their connection */
+    end_mux_sessions(conn.sessionUserIdx);
+    free(conn.sessionUserIdx);
+    free(conn.sessionTimers);
+  }
+  free(responseCompressor);
+  responseCompressor = NULL;
   close(clntSocket); /* Close client socket */
 }
 
@@ -244,33 +644,259 @@ void handle_ttweet_client(int clntSocket)
 void reject_ttweet_client(int clntSocket)
 {
   char objReceived[MAX_RESP_LEN];
-  int clientUserIdx = INVALID_USER_INDEX;
-
-  cJSON *jobjReceived = cJSON_CreateObject();
-  receive_response(clntSocket, objReceived);
-  jobjReceived = cJSON_Parse(objReceived);
-  handle_client_response(clntSocket, jobjReceived, &clientUserIdx);
-  cJSON_Delete(jobjReceived);
+  struct timeval loginTimeout = {timeoutProfile.loginMs / 1000, (timeoutProfile.loginMs % 1000) * 1000};
+
+  /* A client that never sends its username does not hold the process */
+  if (setsockopt(clntSocket, SOL_SOCKET, SO_RCVTIMEO, &loginTimeout, sizeof(loginTimeout)) < 0)
+    persist_with_error("setsockopt(SO_RCVTIMEO) failed");
+  if (receive_response(clntSocket, objReceived))
+  { /* Validating would take a slot, perhaps a parked user's, that no process would ever give back */
+    cJSON *jobjToSend = cJSON_CreateObject();
+    create_json_server_payload(jobjToSend, RES_USER_INVALID, INVALID_USER_INDEX, "All connections occupied.");
+    send_response(clntSocket, jobjToSend, 0);
+    cJSON_Delete(jobjToSend);
+  }
 
   close(clntSocket); /* Close client socket */
 }
 
+/** \copydoc open_client_connection */
+void open_client_connection(ClientConnection *conn, int clntSocket)
+{
+  struct timeval idleTimeout = {timeoutProfile.idleMs / 1000, (timeoutProfile.idleMs % 1000) * 1000};
+  struct sockaddr_in peerAddr;
+  socklen_t peerLen = sizeof(peerAddr);
+
+  conn->sock = clntSocket;
+  conn->clientUserIdx = INVALID_USER_INDEX;
+  conn->sessionUserIdx = NULL;
+  conn->sessionTimers = NULL;
+  conn->closing = 0;
+  conn->readsPaused = 0;
+  timer_wheel_init(&conn->wheel, histogram_now_ns() / 1000000);
+  timer_init(&conn->loginTimer, login_timeout_handler, conn);
+  timer_init(&conn->idleTimer, idle_timeout_handler, conn);
+  timer_init(&conn->heartbeatTimer, heartbeat_handler, conn);
+  timer_init(&conn->resumeTimer, resume_reads_handler, conn);
+  if (getpeername(clntSocket, (struct sockaddr *)&peerAddr, &peerLen) == 0)
+    clientIpBucket = get_ip_bucket(peerAddr.sin_addr.s_addr);
+
+  if (timeoutProfile.loginMs)
+    timer_schedule(&conn->wheel, &conn->loginTimer, timeoutProfile.loginMs);
+  touch_client_connection(conn, NO_SESSION_ID);
+
+  /* poll() only waits for the start of a request; this bounds the rest,
+   * and a client that stops reading cannot block a response forever */
+  if (timeoutProfile.idleMs && (setsockopt(clntSocket, SOL_SOCKET, SO_RCVTIMEO, &idleTimeout, sizeof(idleTimeout)) < 0 ||
+                                setsockopt(clntSocket, SOL_SOCKET, SO_SNDTIMEO, &idleTimeout, sizeof(idleTimeout)) < 0))
+    persist_with_error("setsockopt(SO_RCVTIMEO/SO_SNDTIMEO) failed");
+}
+
+/** \copydoc touch_client_connection */
+void touch_client_connection(ClientConnection *conn, int sessionId)
+{
+  if (timeoutProfile.idleMs)
+    timer_schedule(&conn->wheel, &conn->idleTimer, timeoutProfile.idleMs);
+  if (timeoutProfile.heartbeatMs)
+    timer_schedule(&conn->wheel, &conn->heartbeatTimer, timeoutProfile.heartbeatMs);
+  if (sessionId >= 0 && timeoutProfile.sessionMs)
+  {
+    get_request_user_idx(conn, sessionId);
+    timer_schedule(&conn->wheel, &conn->sessionTimers[sessionId], timeoutProfile.sessionMs);
+  }
+}
+
+/** \copydoc get_request_user_idx */
+int *get_request_user_idx(ClientConnection *conn, int sessionId)
+{
+  if (sessionId == NO_SESSION_ID)
+    return &conn->clientUserIdx;
+
+  if (conn->sessionUserIdx == NULL)
+  {
+    if ((conn->sessionUserIdx = malloc(sizeof(int) * MAX_MUX_SESSIONS)) == NULL ||
+        (conn->sessionTimers = malloc(sizeof(Timer) * MAX_MUX_SESSIONS)) == NULL)
+      die_with_error("malloc() failed");
+    for (int i = 0; i < MAX_MUX_SESSIONS; i++)
+    {
+      conn->sessionUserIdx[i] = INVALID_USER_INDEX;
+      timer_init(&conn->sessionTimers[i], session_timeout_handler, conn);
+    }
+  }
+  return &conn->sessionUserIdx[sessionId];
+}
+
+/** \copydoc login_timeout_handler */
+void login_timeout_handler(Timer *timer, void *arg)
+{
+  ClientConnection *conn = arg;
+
+  printf("Client did not log in within %d ms, closing connection.\n", timeoutProfile.loginMs);
+  metrics_add(METRIC_TIMEOUTS, 1);
+  conn->closing = 1;
+}
+
+/** \copydoc idle_timeout_handler */
+void idle_timeout_handler(Timer *timer, void *arg)
+{
+  ClientConnection *conn = arg;
+
+  printf("Client idle for %d ms, closing connection.\n", timeoutProfile.idleMs);
+  metrics_add(METRIC_TIMEOUTS, 1);
+  conn->closing = 1;
+}
+
+/** \copydoc heartbeat_handler */
+void heartbeat_handler(Timer *timer, void *arg)
+{
+  ClientConnection *conn = arg;
+  cJSON *jobjToSend = cJSON_CreateObject();
+
+  create_json_server_payload(jobjToSend, RES_PING, INVALID_USER_INDEX, "");
+  send_response(conn->sock, jobjToSend, 0);
+  cJSON_Delete(jobjToSend);
+  /* Pings continue until the client speaks or the idle deadline passes */
+  timer_schedule(&conn->wheel, timer, timeoutProfile.heartbeatMs);
+}
+
+/** \copydoc session_timeout_handler */
+void session_timeout_handler(Timer *timer, void *arg)
+{
+  ClientConnection *conn = arg;
+  int sessionId = timer - conn->sessionTimers;
+  cJSON *jobjToSend;
+
+  if (conn->sessionUserIdx[sessionId] == INVALID_USER_INDEX)
+    return;
+  handle_exit_request(&conn->sessionUserIdx[sessionId]);
+  conn->sessionUserIdx[sessionId] = INVALID_USER_INDEX;
+  metrics_add(METRIC_MUX_SESSIONS, -1);
+  metrics_add(METRIC_TIMEOUTS, 1);
+
+  jobjToSend = cJSON_CreateObject();
+  create_json_server_payload(jobjToSend, RES_EXIT, INVALID_USER_INDEX, "Session timed out.\n");
+  cJSON_AddItemToObject(jobjToSend, "sessionId", cJSON_CreateNumber(sessionId));
+  send_response(conn->sock, jobjToSend, 0);
+  cJSON_Delete(jobjToSend);
+}
+
+/** \copydoc pause_client_reads */
+void pause_client_reads(ClientConnection *conn, int pauseMs)
+{
+  conn->readsPaused = 1;
+  timer_schedule(&conn->wheel, &conn->resumeTimer, pauseMs);
+  metrics_add(METRIC_READS_PAUSED, 1);
+}
+
+/** \copydoc resume_reads_handler */
+void resume_reads_handler(Timer *timer, void *arg)
+{
+  ClientConnection *conn = arg;
+
+  conn->readsPaused = 0;
+}
+
+/** \copydoc is_over_output_budget */
+int is_over_output_budget(int sock)
+{
+  int unsentBytes = 0;
+
+  return admissionProfile.outputBytes && ioctl(sock, SIOCOUTQ, &unsentBytes) == 0 &&
+         unsentBytes > admissionProfile.outputBytes;
+}
+
+/** \copydoc is_over_memory_budget */
+int is_over_memory_budget(int extraBytes)
+{
+  return admissionProfile.memoryBytes &&
+         __atomic_load_n(undeliveredBytes, __ATOMIC_RELAXED) + extraBytes > admissionProfile.memoryBytes;
+}
+
+/** \copydoc get_ip_bucket */
+TokenBucket *get_ip_bucket(uint32_t addr)
+{
+  if (ipBuckets == NULL)
+    return NULL;
+  return &ipBuckets[(addr * 2654435761u) >> (32 - IP_RATE_BUCKET_BITS)];
+}
+
+/** \copydoc is_rate_limited */
+int is_rate_limited(int requestCode, int userIdx)
+{
+  uint64_t nowMs = histogram_now_ns() / 1000000;
+  TokenBucket *userBucket;
+
+  if (requestCode == REQ_EXIT || requestCode == REQ_INVALID)
+    return 0;
+  if (clientIpBucket != NULL && !token_bucket_take(clientIpBucket, rateLimitProfile.ipRate, rateLimitProfile.ipBurst, nowMs))
+    return 1;
+  if (userIdx < 0 || userIdx >= maxActiveUsers)
+    return 0; /* Not validated yet, only the address is limited */
+
+  userBucket = &activeUsers[userIdx].requestBuckets[requestCode];
+  switch (requestCode)
+  {
+  case REQ_TWEET:
+    return !token_bucket_take(userBucket, rateLimitProfile.tweetRate, rateLimitProfile.tweetBurst, nowMs);
+  case REQ_SUBSCRIBE:
+  case REQ_UNSUBSCRIBE:
+  case REQ_SUBSCRIBE_KEYWORD:
+  case REQ_UNSUBSCRIBE_KEYWORD:
+  case REQ_FOLLOW:
+  case REQ_UNFOLLOW:
+    userBucket = &activeUsers[userIdx].requestBuckets[REQ_SUBSCRIBE];
+    return !token_bucket_take(userBucket, rateLimitProfile.subscribeRate, rateLimitProfile.subscribeBurst, nowMs);
+  case REQ_TIMELINE:
+  case REQ_SEARCH:
+  case REQ_TRENDING:
+    userBucket = &activeUsers[userIdx].requestBuckets[REQ_TIMELINE];
+    return !token_bucket_take(userBucket, rateLimitProfile.timelineRate, rateLimitProfile.timelineBurst, nowMs);
+  default:
+    return 0;
+  }
+}
+
 /** \copydoc handle_client_response */
-int handle_client_response(int clntSocket, cJSON *jobjReceived, int *clientUserIdx)
+int handle_client_response(int clntSocket, cJSON *jobjReceived, int *clientUserIdx, int sessionId)
 {
   int requestCode;
   char *senderUsername;
-  char *receiverUsername;
+  int keepConnection = 1;
+  int wasValidated = *clientUserIdx != INVALID_USER_INDEX;
+  int compressionAccepted = 0;
+  uint64_t startNs = histogram_now_ns();
   cJSON *jobjToSend = cJSON_CreateObject();
 
   /* Extract requestCode and username */
-  requestCode = cJSON_GetObjectItemCaseSensitive(jobjReceived, "requestCode")->valueint;
-  senderUsername = cJSON_GetObjectItemCaseSensitive(jobjReceived, "username")->valuestring;
+  cJSON *jobjRequestCode = cJSON_GetObjectItemCaseSensitive(jobjReceived, "requestCode");
+  cJSON *jobjUsername = cJSON_GetObjectItemCaseSensitive(jobjReceived, "username");
+  if (!cJSON_IsNumber(jobjRequestCode) || !cJSON_IsString(jobjUsername) ||
+      !is_valid_client_request(jobjReceived, jobjRequestCode->valueint, *clientUserIdx))
+  { /* Malformed request */
+    requestCode = REQ_INVALID;
+    senderUsername = "";
+  }
+  else
+  {
+    requestCode = jobjRequestCode->valueint;
+    senderUsername = jobjUsername->valuestring;
+  }
+
+  if (is_rate_limited(requestCode, *clientUserIdx))
+  { /* Refused before doing any work; the client may retry later */
+    requestCode = REQ_RATE_LIMITED;
+    metrics_add(METRIC_RATE_LIMITED, 1);
+  }
 
   switch (requestCode)
   { /* Handles client request according to requestCode */
+  case REQ_RATE_LIMITED:
+    create_json_server_payload(jobjToSend, RES_RATE_LIMITED, INVALID_USER_INDEX, "Rate limit exceeded. Please slow down.\n");
+    break;
   case REQ_VALIDATE_USER:
     handle_validate_user_request(jobjToSend, senderUsername, clientUserIdx);
+    if (sessionId == NO_SESSION_ID && *clientUserIdx != INVALID_USER_INDEX)
+      compressionAccepted = accept_compression(jobjToSend, jobjReceived);
     break;
   case REQ_TWEET:
     handle_tweet_request(jobjToSend, jobjReceived, senderUsername, clientUserIdx);
@@ -281,65 +907,232 @@ int handle_client_response(int clntSocket, cJSON *jobjReceived, int *clientUserI
   case REQ_UNSUBSCRIBE:
     handle_unsubscribe_request(jobjToSend, jobjReceived, senderUsername, clientUserIdx);
     break;
+  case REQ_SUBSCRIBE_KEYWORD:
+    handle_subscribe_keyword_request(jobjToSend, jobjReceived, clientUserIdx);
+    break;
+  case REQ_UNSUBSCRIBE_KEYWORD:
+    handle_unsubscribe_keyword_request(jobjToSend, jobjReceived, clientUserIdx);
+    break;
+  case REQ_FOLLOW:
+    handle_follow_request(jobjToSend, jobjReceived, clientUserIdx);
+    break;
+  case REQ_UNFOLLOW:
+    handle_unfollow_request(jobjToSend, jobjReceived, clientUserIdx);
+    break;
   case REQ_TIMELINE:
-    handle_timeline_request(jobjToSend, clientUserIdx);
+    handle_timeline_request(jobjToSend, jobjReceived, clientUserIdx);
+    break;
+  case REQ_SEARCH:
+    handle_search_request(jobjToSend, jobjReceived, clientUserIdx);
+    break;
+  case REQ_TRENDING:
+    handle_trending_request(jobjToSend, jobjReceived, clientUserIdx);
     break;
   case REQ_EXIT:
-    return handle_exit_request(clientUserIdx);
+    keepConnection = handle_exit_request(clientUserIdx);
+    if (sessionId != NO_SESSION_ID)
+    { /* Only the session ends, other sessions keep the connection */
+      create_json_server_payload(jobjToSend, RES_EXIT, INVALID_USER_INDEX, "Session closed.\n");
+      *clientUserIdx = INVALID_USER_INDEX;
+      keepConnection = 1;
+    }
     break;
   case REQ_INVALID:
   default:
-    return handle_invalid_request(clientUserIdx);
+    requestCode = REQ_INVALID;
+    keepConnection = handle_invalid_request(clientUserIdx);
+    if (sessionId != NO_SESSION_ID)
+    { /* As for exit, but the session is told why */
+      create_json_server_payload(jobjToSend, RES_INVALID, INVALID_USER_INDEX, "Invalid request. Session closed.\n");
+      *clientUserIdx = INVALID_USER_INDEX;
+      keepConnection = 1;
+    }
+    break;
+  }
+
+  if (sessionId != NO_SESSION_ID)
+  { /* Responses are matched to sessions by sessionId */
+    cJSON_AddItemToObject(jobjToSend, "sessionId", cJSON_CreateNumber(sessionId));
+    metrics_add(METRIC_MUX_SESSIONS, (*clientUserIdx != INVALID_USER_INDEX) - wasValidated);
+  }
+
+  if (keepConnection)
+  { /* Send payload to client */
+    send_response(clntSocket, jobjToSend, socketProfile.coalesce && has_pending_request(clntSocket) ? MSG_MORE : 0);
+  }
+  if (compressionAccepted)
+  { /* The client reads the login response as it is, and later ones through the codec */
+    if ((responseCompressor = malloc(sizeof(PayloadCompressor))) == NULL)
+      die_with_error("malloc() failed");
+    compress_stream_reset(&responseCompressor->stream);
+    responseCompressor->minBytes = compressMinBytes;
+    responseCompressor->rawBytes = 0;
+    responseCompressor->packedBytes = 0;
+    responseCompressor->compressNs = 0;
   }
-  /* Send payload to client */
-  send_payload(clntSocket, jobjToSend);
 
   /* Clear cJSON object */
   cJSON_Delete(jobjToSend);
-  return 1;
+  metrics_observe_request(requestCode, histogram_now_ns() - startNs);
+  return keepConnection;
 }
 
-/** \copydoc handle_validate_user_request */
-void handle_validate_user_request(cJSON *jobjToSend, char *senderUsername, int *clientUserIdx)
+/** \copydoc get_session_id */
+int get_session_id(cJSON *jobjReceived)
 {
-  int isUserValid = 1;
-  int isSpaceAvailable = 0;
+  cJSON *jobjSessionId = cJSON_GetObjectItemCaseSensitive(jobjReceived, "sessionId");
+
+  if (jobjSessionId == NULL)
+    return NO_SESSION_ID;
+  if (!cJSON_IsNumber(jobjSessionId) || jobjSessionId->valuedouble != jobjSessionId->valueint ||
+      jobjSessionId->valueint < 0 || jobjSessionId->valueint >= MAX_MUX_SESSIONS)
+    return INVALID_SESSION_ID;
+  return jobjSessionId->valueint;
+}
 
-  for (int userIdx = 0; userIdx < MAX_CONC_CONN; userIdx++)
+/** \copydoc end_mux_sessions */
+void end_mux_sessions(int sessionUserIdx[])
+{
+  for (int sessionId = 0; sessionId < MAX_MUX_SESSIONS; sessionId++)
   {
-    if (activeUsers[userIdx].isOccupied)
+    if (sessionUserIdx[sessionId] != INVALID_USER_INDEX)
     {
-      if (strcmp(activeUsers[userIdx].username, senderUsername) == 0)
-      { /* username already taken */
-        create_json_server_payload(jobjToSend, RES_USER_INVALID, INVALID_USER_INDEX, "Username already taken.");
-        isUserValid = 0;
-        return;
-      }
+      handle_exit_request(&sessionUserIdx[sessionId]);
+      sessionUserIdx[sessionId] = INVALID_USER_INDEX;
+      metrics_add(METRIC_MUX_SESSIONS, -1);
     }
-    else
-    { /* Space is available in activeUsers */
-      isSpaceAvailable = 1;
+  }
+}
+
+/** \copydoc is_valid_client_request */
+int is_valid_client_request(cJSON *jobjReceived, int requestCode, int clientUserIdx)
+{
+  char *username = cJSON_GetObjectItemCaseSensitive(jobjReceived, "username")->valuestring;
+  cJSON *jobjField;
+  cJSON *jobjHashtag;
+  TextView hashtags[MAX_HASHTAG_CNT];
+  int numHashtags = 0;
+
+  if (!is_valid_username(username, strnlen(username, MAX_USERNAME_LEN)))
+    return 0;
+
+  if (requestCode == REQ_VALIDATE_USER)
+  { /* A connection validates exactly one username */
+    return clientUserIdx == INVALID_USER_INDEX;
+  }
+  if (requestCode == REQ_EXIT)
+    return 1;
+
+  if (clientUserIdx < 0 || clientUserIdx >= maxActiveUsers || strcmp(activeUsers[clientUserIdx].username, username) != 0)
+  { /* Not validated, or speaking for another user */
+    return 0;
+  }
+
+  switch (requestCode)
+  {
+  case REQ_TWEET:
+    jobjField = cJSON_GetObjectItemCaseSensitive(jobjReceived, "ttweetString");
+    if (!cJSON_IsString(jobjField) || !is_valid_tweet_text(jobjField->valuestring, strnlen(jobjField->valuestring, MAX_TWEET_LEN + 1)))
+      return 0;
+    jobjField = cJSON_GetObjectItemCaseSensitive(jobjReceived, "ttweetHashtags");
+    if (!cJSON_IsArray(jobjField) || cJSON_GetArraySize(jobjField) < 1 || cJSON_GetArraySize(jobjField) > MAX_HASHTAG_CNT)
+      return 0;
+    cJSON_ArrayForEach(jobjHashtag, jobjField)
+    {
+      if (!cJSON_IsString(jobjHashtag))
+        return 0;
+      hashtags[numHashtags].start = jobjHashtag->valuestring;
+      hashtags[numHashtags].len = strnlen(jobjHashtag->valuestring, MAX_HASHTAG_LEN);
+      if (!is_valid_hashtag(hashtags[numHashtags].start, hashtags[numHashtags].len))
+        return 0;
+      numHashtags++;
     }
+    return !has_duplicate_view(hashtags, numHashtags);
+  case REQ_SUBSCRIBE:
+  case REQ_UNSUBSCRIBE:
+    jobjField = cJSON_GetObjectItemCaseSensitive(jobjReceived, "subscriptionHashtag");
+    return cJSON_IsString(jobjField) && is_valid_subscription(jobjField->valuestring, strnlen(jobjField->valuestring, MAX_HASHTAG_LEN));
+  case REQ_SUBSCRIBE_KEYWORD:
+  case REQ_UNSUBSCRIBE_KEYWORD:
+    jobjField = cJSON_GetObjectItemCaseSensitive(jobjReceived, "subscriptionKeyword");
+    return cJSON_IsString(jobjField) && is_valid_hashtag(jobjField->valuestring, strnlen(jobjField->valuestring, MAX_HASHTAG_LEN));
+  case REQ_FOLLOW:
+  case REQ_UNFOLLOW:
+    jobjField = cJSON_GetObjectItemCaseSensitive(jobjReceived, "followUsername");
+    return cJSON_IsString(jobjField) && is_valid_username(jobjField->valuestring, strnlen(jobjField->valuestring, MAX_USERNAME_LEN));
+  case REQ_TIMELINE:
+    jobjField = cJSON_GetObjectItemCaseSensitive(jobjReceived, "timelineCursor");
+    if (jobjField != NULL && !(cJSON_IsNumber(jobjField) && jobjField->valuedouble >= 0 && jobjField->valuedouble < 0x1p53 && jobjField->valuedouble == (int64_t)jobjField->valuedouble))
+      return 0;
+    jobjField = cJSON_GetObjectItemCaseSensitive(jobjReceived, "timelineMaxTweets");
+    return jobjField == NULL || (cJSON_IsNumber(jobjField) && jobjField->valuedouble >= 1 && jobjField->valuedouble <= MAX_TWEET_QUEUE);
+  case REQ_SEARCH:
+    jobjField = cJSON_GetObjectItemCaseSensitive(jobjReceived, "searchQuery");
+    return cJSON_IsString(jobjField) && strnlen(jobjField->valuestring, MAX_SEARCH_QUERY_LEN + 1) <= MAX_SEARCH_QUERY_LEN;
+  case REQ_TRENDING:
+    jobjField = cJSON_GetObjectItemCaseSensitive(jobjReceived, "trendingWindow");
+    return cJSON_IsString(jobjField) && trending_window_index(jobjField->valuestring) >= 0;
+  default:
+    return 0;
   }
+}
+
+/** \copydoc handle_validate_user_request */
+void handle_validate_user_request(cJSON *jobjToSend, char *senderUsername, int *clientUserIdx)
+{
+  int freeIdx = INVALID_USER_INDEX;   /* First slot without a user */
+  int parkedIdx = INVALID_USER_INDEX; /* Slot of the user parked the longest */
 
-  if (isUserValid && isSpaceAvailable)
-  { /* Proceed to add user to activeUsers */
-    for (int userIdx = 0; userIdx < MAX_CONC_CONN; userIdx++)
+  for (int userIdx = 0; userIdx < maxActiveUsers; userIdx++)
+  {
+    if (userTable.isOccupied[userIdx])
     {
-      if (!activeUsers[userIdx].isOccupied)
-      {                                      /* Stop at the first available space and save user */
-        activeUsers[userIdx].isOccupied = 1; /* mark index as occupied */
-        strcpy(activeUsers[userIdx].username, senderUsername);
+      if (strcmp(activeUsers[userIdx].username, senderUsername) == 0)
+      {
+        if (activeUsers[userIdx].isConnected)
+        { /* username already taken */
+          create_json_server_payload(jobjToSend, RES_USER_INVALID, INVALID_USER_INDEX, "Username already taken.");
+          return;
+        }
+        /* Parked: everything is where the user left it, rate limits included */
+        activeUsers[userIdx].isConnected = 1;
         *clientUserIdx = userIdx;
         create_json_server_payload(jobjToSend, RES_USER_VALID, userIdx, "Username is valid.");
-        break;
+        return;
       }
+      if (!activeUsers[userIdx].isConnected &&
+          (parkedIdx == INVALID_USER_INDEX || activeUsers[userIdx].disconnectedMs < activeUsers[parkedIdx].disconnectedMs))
+        parkedIdx = userIdx;
+    }
+    else if (freeIdx == INVALID_USER_INDEX)
+    { /* Space is available in activeUsers */
+      freeIdx = userIdx;
     }
   }
-  else if (isUserValid && !isSpaceAvailable)
+
+  if (freeIdx == INVALID_USER_INDEX && parkedIdx == INVALID_USER_INDEX)
   { /* all connections are active */
     create_json_server_payload(jobjToSend, RES_USER_INVALID, INVALID_USER_INDEX, "All connections occupied.");
+    return;
+  }
+  if (freeIdx == INVALID_USER_INDEX)
+  { /* The user parked the longest makes room, its mailbox kept in the store */
+    if (save_user_mailbox(parkedIdx))
+      spill_queue_init(&activeUsers[parkedIdx].spilledTweets, ""); /* Its spilled tweets now belong to the mailbox */
+    clear_user_at_index(&parkedIdx);
+    freeIdx = parkedIdx;
   }
+
+  userTable.isOccupied[freeIdx] = 1; /* mark index as occupied */
+  strcpy(activeUsers[freeIdx].username, senderUsername);
+  spill_queue_init(&activeUsers[freeIdx].spilledTweets, senderUsername);
+  activeUsers[freeIdx].isConnected = 1;
+  if (!restore_user_mailbox(freeIdx))
+    activeUsers[freeIdx].lastTweetSeq = latestTweet->tweetID; /* Above any number this username had before */
+  activeUsers[freeIdx].followAccount = follow_graph_login(userTable.follows, senderUsername, freeIdx);
+  activeUsers[freeIdx].lastPostSeq = follow_graph_last_post_seq(userTable.follows);
+  *clientUserIdx = freeIdx;
+  create_json_server_payload(jobjToSend, RES_USER_VALID, freeIdx, "Username is valid.");
 }
 
 /** \copydoc handle_tweet_request */
@@ -347,6 +1140,7 @@ void handle_tweet_request(cJSON *jobjToSend, cJSON *jobjReceived, char *senderUs
 {
   store_latest_tweet(jobjReceived, senderUsername);
   //print_latest_tweet();
+  publish_to_followers(*clientUserIdx);
   handle_tweet_updates();
   create_json_server_payload(jobjToSend, RES_TWEET, *clientUserIdx, "Tweeted successfully.\n");
 }
@@ -387,11 +1181,7 @@ void handle_subscribe_request(cJSON *jobjToSend, cJSON *jobjReceived, char *send
     {
       if (strcmp(activeUsers[*clientUserIdx].subscriptions[subscriptionIdx], "") == 0)
       { /* found an empty slot for subscription */
-        strcpy(activeUsers[*clientUserIdx].subscriptions[subscriptionIdx], subscriptionHashtag);
-        if (strcmp(subscriptionHashtag, "ALL") == 0)
-        { /* user is subscribing to ALL */
-          activeUsers[*clientUserIdx].isSubscribedAll = 1;
-        }
+        set_subscription(*clientUserIdx, subscriptionIdx, subscriptionHashtag);
         break;
       }
     }
@@ -403,6 +1193,7 @@ void handle_subscribe_request(cJSON *jobjToSend, cJSON *jobjReceived, char *send
 void handle_unsubscribe_request(cJSON *jobjToSend, cJSON *jobjReceived, char *senderUsername, int *clientUserIdx)
 {
   int isSubscriptionExists = 0;
+  int prefixLen;
   char *subscriptionHashtag = cJSON_GetObjectItemCaseSensitive(jobjReceived, "subscriptionHashtag")->valuestring;
 
   for (int subscriptionIdx = 0; subscriptionIdx < MAX_SUBSCRIPTIONS; subscriptionIdx++)
@@ -412,11 +1203,15 @@ void handle_unsubscribe_request(cJSON *jobjToSend, cJSON *jobjReceived, char *se
       if (strcmp(activeUsers[*clientUserIdx].subscriptions[subscriptionIdx], subscriptionHashtag) == 0)
       { /* subscription hashtag exists */
         isSubscriptionExists = 1;
+        if ((prefixLen = prefix_subscription_len(subscriptionHashtag)) > 0)
+          prefix_trie_remove(userTable.prefixSubscriptions, subscriptionHashtag, prefixLen, *clientUserIdx);
         strcpy(activeUsers[*clientUserIdx].subscriptions[subscriptionIdx], "");
+        userTable.subscriptionIds[*clientUserIdx][subscriptionIdx] = 0;
         if (strcmp(subscriptionHashtag, "ALL") == 0)
         {
-          activeUsers[*clientUserIdx].isSubscribedAll = 0;
+          userTable.isSubscribedAll[*clientUserIdx] = 0;
         }
+        update_subscription_signature(*clientUserIdx);
         break;
       }
     }
@@ -431,62 +1226,306 @@ void handle_unsubscribe_request(cJSON *jobjToSend, cJSON *jobjReceived, char *se
   }
 }
 
+/** \copydoc handle_subscribe_keyword_request */
+void handle_subscribe_keyword_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx)
+{
+  char keyword[MAX_HASHTAG_LEN];
+  int keywordIdx = MAX_KEYWORD_SUBSCRIPTIONS;
+  char(*keywords)[MAX_HASHTAG_LEN] = activeUsers[*clientUserIdx].keywords;
+
+  copy_lower_case(keyword, cJSON_GetObjectItemCaseSensitive(jobjReceived, "subscriptionKeyword")->valuestring);
+  for (int i = MAX_KEYWORD_SUBSCRIPTIONS - 1; i >= 0; i--)
+  { /* Find the first empty slot, and any slot already holding keyword */
+    if (strcmp(keywords[i], keyword) == 0)
+    {
+      create_json_server_payload(jobjToSend, RES_SUBSCRIBE, *clientUserIdx, "Keyword subscription already exists.\n");
+      return;
+    }
+    if (strcmp(keywords[i], "") == 0)
+      keywordIdx = i;
+  }
+
+  if (keywordIdx == MAX_KEYWORD_SUBSCRIPTIONS)
+  {
+    create_json_server_payload(jobjToSend, RES_SUBSCRIBE, *clientUserIdx, "Keyword list full. Please unsubscribe to a keyword first!\n");
+    return;
+  }
+  strcpy(keywords[keywordIdx], keyword);
+  keyword_matcher_insert(userTable.keywordSubscriptions, keyword, strlen(keyword), *clientUserIdx);
+  create_json_server_payload(jobjToSend, RES_SUBSCRIBE, *clientUserIdx, "Successfully subscribed to keyword.\n");
+}
+
+/** \copydoc handle_unsubscribe_keyword_request */
+void handle_unsubscribe_keyword_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx)
+{
+  char keyword[MAX_HASHTAG_LEN];
+  char(*keywords)[MAX_HASHTAG_LEN] = activeUsers[*clientUserIdx].keywords;
+
+  copy_lower_case(keyword, cJSON_GetObjectItemCaseSensitive(jobjReceived, "subscriptionKeyword")->valuestring);
+  for (int keywordIdx = 0; keywordIdx < MAX_KEYWORD_SUBSCRIPTIONS; keywordIdx++)
+  {
+    if (strcmp(keywords[keywordIdx], keyword) == 0)
+    {
+      keyword_matcher_remove(userTable.keywordSubscriptions, keyword, strlen(keyword), *clientUserIdx);
+      strcpy(keywords[keywordIdx], "");
+      create_json_server_payload(jobjToSend, RES_UNSUBSCRIBE, *clientUserIdx, "Successfully unsubscribed from keyword.\n");
+      return;
+    }
+  }
+  create_json_server_payload(jobjToSend, RES_UNSUBSCRIBE, *clientUserIdx, "You were not subscribed to that keyword.\n");
+}
+
+/** \copydoc handle_follow_request */
+void handle_follow_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx)
+{
+  char *followUsername = cJSON_GetObjectItemCaseSensitive(jobjReceived, "followUsername")->valuestring;
+  char detailedMessage[MAX_USERNAME_LEN + 64];
+  int result;
+
+  if (strcmp(followUsername, activeUsers[*clientUserIdx].username) == 0)
+  {
+    create_json_server_payload(jobjToSend, RES_SUBSCRIBE, *clientUserIdx, "You cannot follow yourself.\n");
+    return;
+  }
+  result = activeUsers[*clientUserIdx].followAccount == FOLLOW_NIL ? -1 : follow_graph_follow(userTable.follows, activeUsers[*clientUserIdx].followAccount, followUsername);
+  if (result > 0)
+    snprintf(detailedMessage, sizeof(detailedMessage), "Now following %s.\n", followUsername);
+  else if (result == 0)
+    snprintf(detailedMessage, sizeof(detailedMessage), "You already follow %s.\n", followUsername);
+  else
+    snprintf(detailedMessage, sizeof(detailedMessage), "No room for more follows on this server.\n");
+  create_json_server_payload(jobjToSend, RES_SUBSCRIBE, *clientUserIdx, detailedMessage);
+}
+
+/** \copydoc handle_unfollow_request */
+void handle_unfollow_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx)
+{
+  char *followUsername = cJSON_GetObjectItemCaseSensitive(jobjReceived, "followUsername")->valuestring;
+  char detailedMessage[MAX_USERNAME_LEN + 64];
+
+  if (activeUsers[*clientUserIdx].followAccount != FOLLOW_NIL &&
+      follow_graph_unfollow(userTable.follows, activeUsers[*clientUserIdx].followAccount, followUsername))
+    snprintf(detailedMessage, sizeof(detailedMessage), "Stopped following %s.\n", followUsername);
+  else
+    snprintf(detailedMessage, sizeof(detailedMessage), "You were not following %s.\n", followUsername);
+  create_json_server_payload(jobjToSend, RES_UNSUBSCRIBE, *clientUserIdx, detailedMessage);
+}
+
 /** \copydoc handle_timeline_request */
-void handle_timeline_request(cJSON *jobjToSend, int *clientUserIdx)
+void handle_timeline_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx)
 {
+  cJSON *jobjCursor = cJSON_GetObjectItemCaseSensitive(jobjReceived, "timelineCursor");
+  cJSON *jobjMaxTweets = cJSON_GetObjectItemCaseSensitive(jobjReceived, "timelineMaxTweets");
+  int64_t cursor = jobjCursor != NULL ? (int64_t)jobjCursor->valuedouble : NO_TIMELINE_CURSOR;
+  int maxTweets = jobjMaxTweets != NULL ? jobjMaxTweets->valueint : MAX_TWEET_QUEUE;
+
   create_json_server_payload(jobjToSend, RES_TIMELINE, *clientUserIdx, "");
+  pull_followed_posts(*clientUserIdx);
+  add_pending_tweets_to_jobj(jobjToSend, *clientUserIdx, cursor, maxTweets);
+}
+
+/** \copydoc handle_search_request */
+void handle_search_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx)
+{
+  char *searchQuery = cJSON_GetObjectItemCaseSensitive(jobjReceived, "searchQuery")->valuestring;
+  char results[MAX_SEARCH_RESULTS][MAX_TWEET_ITEM_LEN];
+  char detailedMessage[64];
+  int numResults;
+  cJSON *jarray;
+
+  if (searchIndex == NULL)
+  {
+    create_json_server_payload(jobjToSend, RES_SEARCH, *clientUserIdx, "Search is disabled on this server.\n");
+    return;
+  }
+  numResults = search_index_query(searchIndex, searchQuery, results, MAX_SEARCH_RESULTS);
+  if (numResults < 0)
+  { /* A bad query is the user's typo, not a protocol error */
+    create_json_server_payload(jobjToSend, RES_SEARCH, *clientUserIdx, "Invalid search query. Use words and #hashtags, with OR between alternatives.\n");
+    return;
+  }
+
+  snprintf(detailedMessage, sizeof(detailedMessage), "%d tweets found.\n", numResults);
+  create_json_server_payload(jobjToSend, RES_SEARCH, *clientUserIdx, detailedMessage);
+  jarray = cJSON_CreateArray();
+  for (int resultIdx = 0; resultIdx < numResults; resultIdx++)
+    cJSON_AddItemToArray(jarray, cJSON_CreateString(results[resultIdx]));
+  cJSON_AddItemToObject(jobjToSend, "searchResults", jarray);
+}
+
+/** \copydoc handle_trending_request */
+void handle_trending_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx)
+{
+  char *trendingWindow = cJSON_GetObjectItemCaseSensitive(jobjReceived, "trendingWindow")->valuestring;
+  TrendingEntry entries[MAX_TRENDING_RESULTS];
+  char detailedMessage[64];
+  int numEntries;
+  cJSON *jarray;
+  cJSON *jobjEntry;
+
+  numEntries = trending_tracker_top(trendingTracker, trending_window_index(trendingWindow), histogram_now_ns() / 1000000, entries, MAX_TRENDING_RESULTS);
+  if (numEntries == 0)
+    snprintf(detailedMessage, sizeof(detailedMessage), "No hashtags used over the last %s.\n", trendingWindow);
+  else
+    snprintf(detailedMessage, sizeof(detailedMessage), "Trending over the last %s:\n", trendingWindow);
+  create_json_server_payload(jobjToSend, RES_TRENDING, *clientUserIdx, detailedMessage);
+
+  jarray = cJSON_CreateArray();
+  for (int entryIdx = 0; entryIdx < numEntries; entryIdx++)
+  { /* Estimates are fractional, but uses are whole */
+    jobjEntry = cJSON_CreateObject();
+    cJSON_AddItemToObject(jobjEntry, "hashtag", cJSON_CreateString(entries[entryIdx].hashtag));
+    cJSON_AddItemToObject(jobjEntry, "count", cJSON_CreateNumber((long)(entries[entryIdx].count + 0.5)));
+    cJSON_AddItemToArray(jarray, jobjEntry);
+  }
+  cJSON_AddItemToObject(jobjToSend, "trendingHashtags", jarray);
 }
 
 /** \copydoc handle_exit_request */
 int handle_exit_request(int *userIdx)
 {
-  /* mark space as unoccupied */
-  clear_user_at_index(userIdx);
+  park_user_at_index(userIdx);
   printf("Client at index %d disconnected.\n", *userIdx);
   return 0;
 }
 
 /** \copydoc handle_invalid_request */
-int handle_invalid_request()
+int handle_invalid_request(int *userIdx)
 {
+  if (*userIdx != INVALID_USER_INDEX)
+    printf("Client at index %d sent an invalid request.\n", *userIdx);
+  park_user_at_index(userIdx);
   return 0;
 }
 
 /** \copydoc handle_tweet_updates */
 void handle_tweet_updates()
 {
-  for (int userIdx = 0; userIdx < MAX_CONC_CONN; userIdx++)
+  int recipients = 0;
+  int numHashtags = latestTweet->numValidHashtags;
+  uint32_t hashtagIds[MAX_HASHTAG_CNT];
+  uint64_t hashtagSignatures[MAX_HASHTAG_CNT];
+  uint64_t allMask[MATCH_MASK_WORDS(FANOUT_BLOCK_USERS)];  /* Users of a block subscribed to ALL */
+  uint64_t userMask[MATCH_MASK_WORDS(FANOUT_BLOCK_USERS)]; /* Users of a block that may receive the tweet */
+  uint64_t exactMask[MATCH_MASK_WORDS(FANOUT_BLOCK_USERS)]; /* Users of a block with a keyword in the text, or following the author */
+  uint64_t *prefixWords;
+  uint64_t *keywordWords;
+  uint64_t *followWords;
+  int hasKeywords = userTable.numKeywordCandidates > 0;
+  int hasFollowers = userTable.numFollowCandidates > 0;
+  int isDelivered;
+  int hasPrefixes = !prefix_trie_is_empty(userTable.prefixSubscriptions);
+  int numUsers;
+  int userIdx;
+  int prefixLen;
+
+  for (int hashtagIdx = 0; hashtagIdx < numHashtags; hashtagIdx++)
   {
+    hashtagIds[hashtagIdx] = hashtag_id(latestTweet->hashtags[hashtagIdx]);
+    hashtagSignatures[hashtagIdx] = hashtag_signature(hashtagIds[hashtagIdx]);
+    if (hasPrefixes)
+    { /* One walk per hashtag, however many prefixes are subscribed */
+      prefix_trie_match(userTable.prefixSubscriptions, latestTweet->hashtags[hashtagIdx], strlen(latestTweet->hashtags[hashtagIdx]),
+                        mark_fanout_candidate, userTable.prefixCandidates);
+    }
+  }
 
-    if (activeUsers[userIdx].isOccupied)
-    { /* if User array element is not occupied, there's no need to check it */
-      if (activeUsers[userIdx].isSubscribedAll)
-      { /* User is subscribed to ALL - simply add tweet and take first hashtag */
-        add_tweet_to_user(userIdx, latestTweet->username, latestTweet->ttweetString, latestTweet->hashtags[0]);
+  for (int firstUser = 0; firstUser < maxActiveUsers; firstUser += FANOUT_BLOCK_USERS)
+  { /* Narrow each block down to users subscribed to ALL or whose signature may hold a hashtag */
+    numUsers = maxActiveUsers - firstUser < FANOUT_BLOCK_USERS ? maxActiveUsers - firstUser : FANOUT_BLOCK_USERS;
+    match_nonzero_bytes(&userTable.isSubscribedAll[firstUser], numUsers, allMask);
+    match_signatures(&userTable.subscriptionSignatures[firstUser], numUsers, hashtagSignatures, numHashtags, userMask);
+    if (hasPrefixes)
+    { /* Blocks are whole words, so the block's prefix candidates start on a word */
+      prefixWords = &userTable.prefixCandidates[firstUser / 64];
+      for (int wordIdx = 0; wordIdx < MATCH_MASK_WORDS(numUsers); wordIdx++)
+      {
+        userMask[wordIdx] |= prefixWords[wordIdx];
+        prefixWords[wordIdx] = 0;
       }
-      else
-      { /* User is not subscribed to ALL - check if any subscriptions and hashtags match */
+    }
+    if (hasKeywords || hasFollowers)
+    { /* Keyword matches and followers are exact, kept apart so they need no confirmation */
+      keywordWords = &userTable.keywordCandidates[firstUser / 64];
+      followWords = &userTable.followCandidates[firstUser / 64];
+      for (int wordIdx = 0; wordIdx < MATCH_MASK_WORDS(numUsers); wordIdx++)
+      {
+        exactMask[wordIdx] = keywordWords[wordIdx] | followWords[wordIdx];
+        userMask[wordIdx] |= exactMask[wordIdx];
+        keywordWords[wordIdx] = 0;
+        followWords[wordIdx] = 0;
+      }
+    }
+
+    for (int wordIdx = 0; wordIdx < MATCH_MASK_WORDS(numUsers); wordIdx++)
+    {
+      for (uint64_t bits = userMask[wordIdx] | allMask[wordIdx]; bits != 0; bits &= bits - 1)
+      { /* Candidates in index order, as a full scan would visit them */
+        userIdx = firstUser + wordIdx * 64 + __builtin_ctzll(bits);
+        if (!userTable.isOccupied[userIdx])
+          continue;
+        if (userTable.authorOnRead != FOLLOW_NIL &&
+            follow_graph_is_following(userTable.follows, activeUsers[userIdx].followAccount, userTable.authorOnRead))
+          continue; /* Merged from the author's log at the user's next timeline instead */
+        if (userTable.isSubscribedAll[userIdx])
+        { /* User is subscribed to ALL - simply add tweet and take first hashtag */
+          add_tweet_to_user(userIdx, latestTweet->username, latestTweet->ttweetString, latestTweet->hashtags[0]);
+          recipients++;
+          continue;
+        }
+        isDelivered = 0;
         for (int subscriptionIdx = 0; subscriptionIdx < MAX_SUBSCRIPTIONS; subscriptionIdx++)
-        { /* Iterate over current user's subscriptions */
-          for (int hashtagIdx = 0; hashtagIdx < latestTweet->numValidHashtags; hashtagIdx++)
+        { /* Signatures can pass falsely - iterate over current user's subscriptions */
+          for (int hashtagIdx = 0; hashtagIdx < numHashtags; hashtagIdx++)
           { /* Iterate over lastest tweet's hashtags */
-            if (strcmp(activeUsers[userIdx].subscriptions[subscriptionIdx], latestTweet->hashtags[hashtagIdx]) == 0)
-            { /* user is subscribed to hashtag */
+            if (userTable.subscriptionIds[userIdx][subscriptionIdx] == hashtagIds[hashtagIdx]
+                    ? strcmp(activeUsers[userIdx].subscriptions[subscriptionIdx], latestTweet->hashtags[hashtagIdx]) == 0
+                    : userTable.subscriptionIds[userIdx][subscriptionIdx] == 0 &&
+                          (prefixLen = prefix_subscription_len(activeUsers[userIdx].subscriptions[subscriptionIdx])) > 0 &&
+                          strncmp(activeUsers[userIdx].subscriptions[subscriptionIdx], latestTweet->hashtags[hashtagIdx], prefixLen) == 0)
+            { /* user is subscribed to hashtag (identifiers match, confirmed on the strings) or to a prefix of it */
               add_tweet_to_user(userIdx, latestTweet->username, latestTweet->ttweetString, latestTweet->hashtags[hashtagIdx]);
+              recipients++;
+              isDelivered = 1;
               subscriptionIdx = MAX_SUBSCRIPTIONS + 1;
               hashtagIdx = MAX_HASHTAG_CNT + 1;
             }
           }
         }
+        if (!isDelivered && (hasKeywords || hasFollowers) && (exactMask[wordIdx] >> (userIdx % 64) & 1))
+        { /* No hashtag matched, but a keyword is in the text or the user follows the author - take first hashtag */
+          add_tweet_to_user(userIdx, latestTweet->username, latestTweet->ttweetString, latestTweet->hashtags[0]);
+          recipients++;
+        }
       }
     }
   }
+  userTable.numKeywordCandidates = 0;
+  userTable.numFollowCandidates = 0;
+  userTable.authorOnRead = FOLLOW_NIL;
+  metrics_observe_fanout(recipients);
+}
+
+/* Sets the bit of a user found by prefix_trie_match() or keyword_matcher_scan() */
+static void mark_fanout_candidate(int32_t userIdx, void *candidates)
+{
+  ((uint64_t *)candidates)[userIdx / 64] |= 1ULL << (userIdx % 64);
+}
+
+/* Keywords are validated as hashtags, so source fits in MAX_HASHTAG_LEN */
+static void copy_lower_case(char *destination, const char *source)
+{
+  while ((*destination++ = tolower((unsigned char)*source++)) != '\0')
+    ;
 }
 
 /** \copydoc add_tweet_to_user */
 void add_tweet_to_user(int userIdx, char *senderUsername, char *ttweetString, char *originHashtag)
 {
   char tweetItem[MAX_TWEET_ITEM_LEN];
+  int itemBytes;
+  int pendingTweetIdx;
+  int isFull;
 
   /* Format a tweetItem object */
   strcpy(tweetItem, activeUsers[userIdx].username);
@@ -496,34 +1535,289 @@ void add_tweet_to_user(int userIdx, char *senderUsername, char *ttweetString, ch
   strcat(tweetItem, ttweetString);
   strcat(tweetItem, " #");
   strcat(tweetItem, originHashtag);
+  itemBytes = strlen(tweetItem) + 1;
 
-  for (int pendingTweetIdx = 0; pendingTweetIdx < MAX_TWEET_QUEUE; pendingTweetIdx++)
+  for (pendingTweetIdx = 0; pendingTweetIdx < MAX_TWEET_QUEUE; pendingTweetIdx++)
   {
     if (strcmp(activeUsers[userIdx].pendingTweets[pendingTweetIdx], "") == 0)
-    { /* spot available */
-      strcpy(activeUsers[userIdx].pendingTweets[pendingTweetIdx], tweetItem);
+      break; /* spot available */
+  }
+
+  isFull = pendingTweetIdx == MAX_TWEET_QUEUE || (pendingTweetIdx > 0 && is_over_memory_budget(itemBytes));
+  if (spillStore != NULL && (isFull || activeUsers[userIdx].spilledTweets.numRecords > 0))
+  { /* Behind tweets already spilled, even if the queue has room again */
+    if (spill_store_append(spillStore, &activeUsers[userIdx].spilledTweets, tweetItem))
+    {
+      activeUsers[userIdx].lastTweetSeq++;
+      metrics_add(METRIC_SPILLED_TWEETS, 1);
+      return;
+    }
+    if (activeUsers[userIdx].spilledTweets.numRecords > 0)
+    { /* Queued in memory, it would be read before the spilled tweets */
+      printf("Client %s: Spill full. Tweet was not stored.\n", senderUsername);
+      metrics_add(METRIC_TWEETS_DROPPED, 1);
+      return;
+    }
+  }
+
+  if (isFull)
+  { /* A slow reader gives up its oldest tweet, so its queue does not grow */
+    if (!admissionProfile.shedOldest)
+    {
+      printf("Client %s: Queue full. Tweet was not stored.\n", senderUsername);
+      metrics_add(METRIC_TWEETS_DROPPED, 1);
       return;
     }
+    shed_oldest_tweet(userIdx);
+    pendingTweetIdx--;
   }
 
-  /* Cannot add tweetItem as queue is full */
-  printf("Client %s: Queue full. Tweet was not stored.\n", senderUsername);
+  strcpy(activeUsers[userIdx].pendingTweets[pendingTweetIdx], tweetItem);
+  activeUsers[userIdx].lastTweetSeq++;
+  metrics_add(METRIC_QUEUE_DEPTH, 1);
+  account_undelivered_bytes(itemBytes);
+}
+
+/** \copydoc shed_oldest_tweet */
+void shed_oldest_tweet(int userIdx)
+{
+  drop_oldest_tweets(userIdx, 1);
+  metrics_add(METRIC_TWEETS_SHED, 1);
+}
+
+/* Later tweets move to the front, keeping their sequence numbers */
+static void drop_oldest_tweets(int userIdx, int numTweets)
+{
+  char(*pendingTweets)[MAX_TWEET_ITEM_LEN] = activeUsers[userIdx].pendingTweets;
+
+  for (int pendingTweetIdx = 0; pendingTweetIdx < numTweets; pendingTweetIdx++)
+    account_undelivered_bytes(-(int64_t)(strlen(pendingTweets[pendingTweetIdx]) + 1));
+  memmove(pendingTweets[0], pendingTweets[numTweets], (MAX_TWEET_QUEUE - numTweets) * MAX_TWEET_ITEM_LEN);
+  for (int pendingTweetIdx = MAX_TWEET_QUEUE - numTweets; pendingTweetIdx < MAX_TWEET_QUEUE; pendingTweetIdx++)
+    strcpy(pendingTweets[pendingTweetIdx], "");
+  metrics_add(METRIC_QUEUE_DEPTH, -numTweets);
+}
+
+/* Spilled tweets move up into the free slots, oldest first */
+static void refill_pending_tweets(int userIdx)
+{
+  SpillQueue *spilledTweets = &activeUsers[userIdx].spilledTweets;
+  int numRefilled = 0;
+  int64_t numLost;
+  int isRead = 0;
+
+  if (spillStore == NULL || spilledTweets->numRecords == 0)
+    return;
+  for (int pendingTweetIdx = count_pending_tweets(userIdx); pendingTweetIdx < MAX_TWEET_QUEUE; pendingTweetIdx++)
+  {
+    if ((isRead = spill_store_pop(spillStore, spilledTweets, activeUsers[userIdx].pendingTweets[pendingTweetIdx])) <= 0)
+      break;
+    account_undelivered_bytes(strlen(activeUsers[userIdx].pendingTweets[pendingTweetIdx]) + 1);
+    numRefilled++;
+  }
+  metrics_add(METRIC_QUEUE_DEPTH, numRefilled);
+  metrics_add(METRIC_SPILLED_TWEETS, -numRefilled);
+  if (isRead < 0)
+  { /* Nothing after an unreadable record can be found; later tweets take the lost numbers */
+    numLost = spill_store_clear(spillStore, spilledTweets);
+    activeUsers[userIdx].lastTweetSeq -= numLost;
+    printf("Client %s: Spilled tweets could not be read. %lld tweets were lost.\n", activeUsers[userIdx].username, (long long)numLost);
+    metrics_add(METRIC_SPILLED_TWEETS, -numLost);
+    metrics_add(METRIC_TWEETS_DROPPED, numLost);
+  }
+}
+
+/* Stores a subscription in an empty slot and indexes it for fan-out */
+static void set_subscription(int userIdx, int subscriptionIdx, const char *hashtag)
+{
+  int prefixLen;
+
+  strcpy(activeUsers[userIdx].subscriptions[subscriptionIdx], hashtag);
+  if ((prefixLen = prefix_subscription_len(hashtag)) > 0)
+  { /* Prefixes are found through the trie, not the signature */
+    prefix_trie_insert(userTable.prefixSubscriptions, hashtag, prefixLen, userIdx);
+    userTable.subscriptionIds[userIdx][subscriptionIdx] = 0;
+  }
+  else
+  {
+    userTable.subscriptionIds[userIdx][subscriptionIdx] = hashtag_id(hashtag);
+  }
+  if (strcmp(hashtag, "ALL") == 0)
+  { /* user is subscribing to ALL */
+    userTable.isSubscribedAll[userIdx] = 1;
+  }
+  update_subscription_signature(userIdx);
+}
+
+/* Followers of an author fanned out on write become candidates of the fan-out */
+static void publish_to_followers(int authorIdx)
+{
+  int32_t author = activeUsers[authorIdx].followAccount;
+  int numVisited;
+
+  userTable.authorOnRead = FOLLOW_NIL;
+  if (author == FOLLOW_NIL)
+    return;
+  numVisited = follow_graph_publish(userTable.follows, author, latestTweet->ttweetString, latestTweet->hashtags[0],
+                                    mark_fanout_candidate, userTable.followCandidates);
+  if (numVisited == FOLLOW_ON_READ)
+    userTable.authorOnRead = author;
+  else
+    userTable.numFollowCandidates = numVisited;
+}
+
+/* Pulled posts are numbered after the tweets already pending, as if they had just arrived */
+static void pull_followed_posts(int userIdx)
+{
+  FollowPost posts[MAX_TWEET_QUEUE]; /* Without -S, more would only shed each other */
+  int numPosts;
+
+  if (activeUsers[userIdx].followAccount == FOLLOW_NIL)
+    return;
+  if (spillStore == NULL)
+  { /* Only the newest fit the queue */
+    numPosts = follow_graph_pull(userTable.follows, activeUsers[userIdx].followAccount, &activeUsers[userIdx].lastPostSeq, posts, MAX_TWEET_QUEUE);
+    for (int postIdx = 0; postIdx < numPosts; postIdx++)
+      add_tweet_to_user(userIdx, posts[postIdx].username, posts[postIdx].ttweetString, posts[postIdx].hashtag);
+    return;
+  }
+  do
+  { /* The rest of the queue spills, so every post is queued, oldest first, a queue's worth at a time */
+    numPosts = follow_graph_pull_oldest(userTable.follows, activeUsers[userIdx].followAccount, &activeUsers[userIdx].lastPostSeq, posts, MAX_TWEET_QUEUE);
+    for (int postIdx = 0; postIdx < numPosts; postIdx++)
+      add_tweet_to_user(userIdx, posts[postIdx].username, posts[postIdx].ttweetString, posts[postIdx].hashtag);
+  } while (numPosts == MAX_TWEET_QUEUE);
+}
+
+static int count_pending_tweets(int userIdx)
+{
+  int numPending = 0;
+
+  while (numPending < MAX_TWEET_QUEUE && strcmp(activeUsers[userIdx].pendingTweets[numPending], "") != 0)
+    numPending++;
+  return numPending;
+}
+
+/** \copydoc account_undelivered_bytes */
+void account_undelivered_bytes(int64_t delta)
+{
+  __atomic_fetch_add(undeliveredBytes, delta, __ATOMIC_RELAXED);
+  metrics_add(METRIC_UNDELIVERED_BYTES, delta);
+}
+
+/** \copydoc allocate_user_table */
+void allocate_user_table(int numUsers)
+{
+  size_t flagsSize = (numUsers + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+  size_t signaturesSize = sizeof(uint64_t) * flagsSize;
+  char *hotFields;
+
+  activeUsers = mmap(NULL, sizeof(User) * numUsers, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  /* One page aligned region, each array rounded up to whole cache lines */
+  hotFields = mmap(NULL, 2 * flagsSize + signaturesSize + sizeof(uint32_t) * MAX_SUBSCRIPTIONS * numUsers,
+                   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (activeUsers == MAP_FAILED || hotFields == MAP_FAILED)
+    die_with_error("mmap() failed");
+  userTable.isOccupied = (uint8_t *)hotFields;
+  userTable.isSubscribedAll = (uint8_t *)(hotFields + flagsSize);
+  userTable.subscriptionSignatures = (uint64_t *)(hotFields + 2 * flagsSize);
+  userTable.subscriptionIds = (uint32_t(*)[MAX_SUBSCRIPTIONS])(hotFields + 2 * flagsSize + signaturesSize);
+  userTable.prefixSubscriptions = prefix_trie_create(numUsers * MAX_SUBSCRIPTIONS);
+  userTable.prefixCandidates = calloc(MATCH_MASK_WORDS(numUsers), sizeof(uint64_t)); /* Private, each process fans out alone */
+  userTable.keywordSubscriptions = keyword_matcher_create(numUsers * MAX_KEYWORD_SUBSCRIPTIONS, MAX_HASHTAG_LEN - 1);
+  userTable.keywordCandidates = calloc(MATCH_MASK_WORDS(numUsers), sizeof(uint64_t));
+  userTable.numKeywordCandidates = 0;
+  userTable.follows = follow_graph_create(MAX_FOLLOW_ACCOUNTS, MAX_FOLLOWS, fanoutThreshold);
+  userTable.followCandidates = calloc(MATCH_MASK_WORDS(numUsers), sizeof(uint64_t));
+  userTable.numFollowCandidates = 0;
+  userTable.authorOnRead = FOLLOW_NIL;
+  if (userTable.prefixSubscriptions == NULL || userTable.prefixCandidates == NULL ||
+      userTable.keywordSubscriptions == NULL || userTable.keywordCandidates == NULL ||
+      userTable.follows == NULL || userTable.followCandidates == NULL)
+    die_with_error("Prefix, keyword and follow allocation failed");
+}
+
+/** \copydoc free_user_table */
+void free_user_table(int numUsers)
+{
+  size_t flagsSize = (numUsers + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+
+  munmap(activeUsers, sizeof(User) * numUsers);
+  munmap(userTable.isOccupied, 2 * flagsSize + sizeof(uint64_t) * flagsSize + sizeof(uint32_t) * MAX_SUBSCRIPTIONS * numUsers);
+  prefix_trie_destroy(userTable.prefixSubscriptions);
+  free(userTable.prefixCandidates);
+  keyword_matcher_destroy(userTable.keywordSubscriptions);
+  free(userTable.keywordCandidates);
+  follow_graph_destroy(userTable.follows);
+  free(userTable.followCandidates);
+}
+
+/** \copydoc hashtag_id */
+uint32_t hashtag_id(const char *hashtag)
+{
+  uint32_t hash = 2166136261u;
+
+  while (*hashtag)
+  {
+    hash ^= (unsigned char)*hashtag++;
+    hash *= 16777619u;
+  }
+  return hash ? hash : 1; /* 0 marks an empty subscription */
+}
+
+/** \copydoc prefix_subscription_len */
+int prefix_subscription_len(const char *subscription)
+{
+  int len = strlen(subscription);
+
+  return len >= 2 && subscription[len - 1] == PREFIX_WILDCARD ? len - 1 : 0;
+}
+
+/** \copydoc hashtag_signature */
+uint64_t hashtag_signature(uint32_t hashtagId)
+{
+  /* FNV-1a mixes its last bytes into the high bits best */
+  return 1ULL << (hashtagId >> 26) | 1ULL << ((hashtagId >> 20) & 63);
+}
+
+/** \copydoc update_subscription_signature */
+void update_subscription_signature(int userIdx)
+{
+  uint64_t signature = 0;
+
+  for (int subscriptionIdx = 0; subscriptionIdx < MAX_SUBSCRIPTIONS; subscriptionIdx++)
+  {
+    if (userTable.subscriptionIds[userIdx][subscriptionIdx] != 0)
+      signature |= hashtag_signature(userTable.subscriptionIds[userIdx][subscriptionIdx]);
+  }
+  userTable.subscriptionSignatures[userIdx] = signature;
 }
 
 /** \copydoc initialize_user_array */
 void initialize_user_array()
 {
-  for (int i = 0; i < MAX_CONC_CONN; i++)
+  for (int i = 0; i < maxActiveUsers; i++)
   {
-    (activeUsers + i)->isOccupied = 0;
-    (activeUsers + i)->isSubscribedAll = 0;
+    userTable.isOccupied[i] = 0;
+    userTable.isSubscribedAll[i] = 0;
+    userTable.subscriptionSignatures[i] = 0;
     strcpy((activeUsers + i)->username, "");
     for (int j = 0; j < MAX_SUBSCRIPTIONS; j++)
     {
       strcpy((activeUsers + i)->subscriptions[j], "");
+      userTable.subscriptionIds[i][j] = 0;
     }
-
-    for (int j = 0; j < MAX_TWEET_QUEUE - 1; j++)
+    for (int j = 0; j < MAX_KEYWORD_SUBSCRIPTIONS; j++)
+      strcpy((activeUsers + i)->keywords[j], "");
+    memset((activeUsers + i)->requestBuckets, 0, sizeof((activeUsers + i)->requestBuckets));
+    (activeUsers + i)->lastTweetSeq = 0;
+    (activeUsers + i)->followAccount = FOLLOW_NIL;
+    (activeUsers + i)->lastPostSeq = 0;
+    (activeUsers + i)->isConnected = 0;
+    (activeUsers + i)->disconnectedMs = 0;
+    spill_queue_init(&(activeUsers + i)->spilledTweets, "");
+
+    for (int j = 0; j < MAX_TWEET_QUEUE; j++)
     {
       strcpy((activeUsers + i)->pendingTweets[j], "");
     }
@@ -554,29 +1848,91 @@ void create_json_server_payload(cJSON *jobjToSend, int commandCode, int userIdx,
   switch (commandCode)
   { /* Add additional fields to JSON obj according to request code */
   case RES_TIMELINE:
-    add_pending_tweets_to_jobj(jobjToSend, userIdx);
-    break;
+    break; /* handle_timeline_request() adds the tweets */
   case RES_SUBSCRIBE:
   case RES_UNSUBSCRIBE:
   case RES_TWEET:
-  case RES_EXIT:
   case RES_USER_VALID:
+  case RES_SEARCH:
+  case RES_TRENDING:
     cJSON_AddItemToObject(jobjToSend, "username", cJSON_CreateString(activeUsers[userIdx].username)); /*Add username to JSON object*/
     break;
   case RES_USER_INVALID:
     cJSON_AddItemToObject(jobjToSend, "username", cJSON_CreateString("Invalid username.")); /*Add username to JSON object*/
     break;
+  case RES_EXIT:
+  case RES_INVALID:
+    break; /* Only sent to sessions of a multiplexed connection, whose user is gone */
+  case RES_PING:
+  case RES_RATE_LIMITED:
+    break; /* Not tied to a user */
   default:
     die_with_error("Error! create_json_server_payload() received an invalid request.");
     break;
   }
 }
 
+/** \copydoc send_response */
+int send_response(int clntSocket, cJSON *jobjToSend, int flags)
+{
+  int bytesSent = send_payload_compressed(clntSocket, jobjToSend, flags, responseCompressor);
+
+  metrics_add(METRIC_BYTES_OUT, bytesSent);
+  if (responseCompressor != NULL && responseCompressor->rawBytes > 0)
+  { /* Moved to the metrics shard as they accumulate */
+    metrics_add(METRIC_COMPRESS_RAW_BYTES, responseCompressor->rawBytes);
+    metrics_add(METRIC_COMPRESS_PACKED_BYTES, responseCompressor->packedBytes);
+    metrics_add(METRIC_COMPRESS_NS, responseCompressor->compressNs);
+    responseCompressor->rawBytes = 0;
+    responseCompressor->packedBytes = 0;
+    responseCompressor->compressNs = 0;
+  }
+  return bytesSent;
+}
+
+/** \copydoc accept_compression */
+int accept_compression(cJSON *jobjToSend, cJSON *jobjReceived)
+{
+  cJSON *jobjCompression = cJSON_GetObjectItemCaseSensitive(jobjReceived, "compression");
+
+  if (compressMinBytes == 0 || responseCompressor != NULL || !cJSON_IsString(jobjCompression) ||
+      strcmp(jobjCompression->valuestring, COMPRESS_CODEC_NAME) != 0)
+    return 0; /* Disabled, already on, or a codec this server does not have */
+  cJSON_AddItemToObject(jobjToSend, "compression", cJSON_CreateString(COMPRESS_CODEC_NAME));
+  return 1;
+}
+
 /** \copydoc add_pending_tweets_to_jobj */
-void add_pending_tweets_to_jobj(cJSON *jobj, int userIdx)
+void add_pending_tweets_to_jobj(cJSON *jobj, int userIdx, int64_t cursor, int maxTweets)
 {
   cJSON *jarray = cJSON_CreateArray(); /*Creating a json array*/
 
+  refill_pending_tweets(userIdx);
+  if (cursor != NO_TIMELINE_CURSOR)
+  {
+    int numInMemory = count_pending_tweets(userIdx);
+    int64_t numPending = numInMemory + activeUsers[userIdx].spilledTweets.numRecords;
+    uint64_t firstTweetSeq = activeUsers[userIdx].lastTweetSeq - numPending + 1;
+    int numSent;
+
+    while ((uint64_t)cursor >= firstTweetSeq && numInMemory > 0)
+    { /* The client has seen these, so they need not be kept; spilled tweets move up behind them */
+      int numAcknowledged = (uint64_t)cursor - firstTweetSeq + 1 < (uint64_t)numInMemory ? (int)((uint64_t)cursor - firstTweetSeq + 1) : numInMemory;
+      drop_oldest_tweets(userIdx, numAcknowledged);
+      refill_pending_tweets(userIdx);
+      numInMemory = count_pending_tweets(userIdx);
+      numPending = numInMemory + activeUsers[userIdx].spilledTweets.numRecords;
+      firstTweetSeq = activeUsers[userIdx].lastTweetSeq - numPending + 1;
+    }
+    numSent = numInMemory < maxTweets ? numInMemory : maxTweets;
+    for (int pendingTweetIdx = 0; pendingTweetIdx < numSent; pendingTweetIdx++)
+      cJSON_AddItemToArray(jarray, cJSON_CreateString(activeUsers[userIdx].pendingTweets[pendingTweetIdx]));
+    cJSON_AddItemToObject(jobj, "storedTweets", jarray);
+    cJSON_AddItemToObject(jobj, "firstTweetSeq", cJSON_CreateNumber(firstTweetSeq));
+    cJSON_AddItemToObject(jobj, "moreTweets", cJSON_CreateNumber(numPending - numSent));
+    return;
+  }
+
   if (strcmp(activeUsers[userIdx].pendingTweets[0], "") == 0)
   { /* no pending tweets */
     cJSON_AddItemToArray(jarray, cJSON_CreateString("No tweets available"));
@@ -592,7 +1948,9 @@ void add_pending_tweets_to_jobj(cJSON *jobj, int userIdx)
       else
       { /* Add pending tweet to array and clear from memory */
         cJSON_AddItemToArray(jarray, cJSON_CreateString(activeUsers[userIdx].pendingTweets[pendingTweetIdx]));
+        account_undelivered_bytes(-(int64_t)(strlen(activeUsers[userIdx].pendingTweets[pendingTweetIdx]) + 1));
         strcpy(activeUsers[userIdx].pendingTweets[pendingTweetIdx], "");
+        metrics_add(METRIC_QUEUE_DEPTH, -1);
       }
     }
   }
@@ -615,23 +1973,38 @@ void store_latest_tweet(cJSON *jobjReceived, char *senderUsername)
   {
     strcpy(latestTweet->hashtags[i], cJSON_GetArrayItem(jarray, i)->valuestring);
   }
+  if (trendingTracker != NULL)
+    trending_tracker_add(trendingTracker, latestTweet->hashtags, latestTweet->numValidHashtags, histogram_now_ns() / 1000000);
+  if (searchIndex != NULL)
+    search_index_add(searchIndex, senderUsername, latestTweet->ttweetString, latestTweet->hashtags, latestTweet->numValidHashtags);
+  if (!keyword_matcher_is_empty(userTable.keywordSubscriptions))
+  { /* One pass over the text, however many keywords are subscribed */
+    userTable.numKeywordCandidates = keyword_matcher_scan(userTable.keywordSubscriptions, latestTweet->ttweetString, strlen(latestTweet->ttweetString),
+                                                          mark_fanout_candidate, userTable.keywordCandidates);
+  }
 }
 
 /** \copydoc print_active_users */
 void print_active_users()
 {
   printf("Active users:\n");
-  for (int userIdx = 0; userIdx < MAX_CONC_CONN; userIdx++)
+  for (int userIdx = 0; userIdx < maxActiveUsers; userIdx++)
   {
     printf("User index %d:\n", userIdx);
-    printf("isOccupied: %d\n", activeUsers[userIdx].isOccupied);
+    printf("isOccupied: %d\n", userTable.isOccupied[userIdx]);
     printf("username: %s\n", activeUsers[userIdx].username);
-    printf("isSubscribedAll: %d\n", activeUsers[userIdx].isSubscribedAll);
+    printf("isConnected: %d\n", activeUsers[userIdx].isConnected);
+    printf("isSubscribedAll: %d\n", userTable.isSubscribedAll[userIdx]);
     printf("Subscriptions:\n");
     for (int subscriptionIdx = 0; subscriptionIdx < MAX_SUBSCRIPTIONS; subscriptionIdx++)
     {
       printf("%s\n", activeUsers[userIdx].subscriptions[subscriptionIdx]);
     }
+    printf("Keywords:\n");
+    for (int keywordIdx = 0; keywordIdx < MAX_KEYWORD_SUBSCRIPTIONS; keywordIdx++)
+    {
+      printf("%s\n", activeUsers[userIdx].keywords[keywordIdx]);
+    }
     printf("\nPending Tweets:\n");
     print_pending_tweets(userIdx);
   }
@@ -663,16 +2036,151 @@ void print_pending_tweets(int userIdx)
 /** \copydoc clear_user_at_index */
 void clear_user_at_index(int *userIdx)
 {
-  activeUsers[*userIdx].isOccupied = 0;
-  activeUsers[*userIdx].isSubscribedAll = 0;
+  int64_t numLost;
+  int prefixLen;
+
+  if (*userIdx < 0 || *userIdx >= maxActiveUsers)
+  { /* Client never validated a username */
+    return;
+  }
+  userTable.isOccupied[*userIdx] = 0;
+  activeUsers[*userIdx].isConnected = 0;
+  userTable.isSubscribedAll[*userIdx] = 0;
+  userTable.subscriptionSignatures[*userIdx] = 0;
   strcpy(activeUsers[*userIdx].username, "");
   for (int j = 0; j < MAX_SUBSCRIPTIONS; j++)
   {
+    if ((prefixLen = prefix_subscription_len(activeUsers[*userIdx].subscriptions[j])) > 0)
+      prefix_trie_remove(userTable.prefixSubscriptions, activeUsers[*userIdx].subscriptions[j], prefixLen, *userIdx);
     strcpy(activeUsers[*userIdx].subscriptions[j], "");
+    userTable.subscriptionIds[*userIdx][j] = 0;
+  }
+  for (int j = 0; j < MAX_KEYWORD_SUBSCRIPTIONS; j++)
+  {
+    if (strcmp(activeUsers[*userIdx].keywords[j], "") != 0)
+      keyword_matcher_remove(userTable.keywordSubscriptions, activeUsers[*userIdx].keywords[j], strlen(activeUsers[*userIdx].keywords[j]), *userIdx);
+    strcpy(activeUsers[*userIdx].keywords[j], "");
+  }
+  memset(activeUsers[*userIdx].requestBuckets, 0, sizeof(activeUsers[*userIdx].requestBuckets)); /* The next username's; this one's are in its mailbox */
+  if (activeUsers[*userIdx].followAccount != FOLLOW_NIL)
+  { /* Follows are kept for the next login */
+    follow_graph_logout(userTable.follows, activeUsers[*userIdx].followAccount);
+    activeUsers[*userIdx].followAccount = FOLLOW_NIL;
   }
 
-  for (int j = 0; j < MAX_TWEET_QUEUE - 1; j++)
+  for (int j = 0; j < MAX_TWEET_QUEUE; j++)
   {
+    if (strcmp(activeUsers[*userIdx].pendingTweets[j], "") != 0)
+    {
+      metrics_add(METRIC_QUEUE_DEPTH, -1);
+      account_undelivered_bytes(-(int64_t)(strlen(activeUsers[*userIdx].pendingTweets[j]) + 1));
+    }
     strcpy(activeUsers[*userIdx].pendingTweets[j], "");
   }
-}
\ No newline at end of file
+  if (spillStore != NULL && activeUsers[*userIdx].spilledTweets.numRecords > 0)
+  { /* Not handed to a mailbox, so they are lost */
+    numLost = spill_store_clear(spillStore, &activeUsers[*userIdx].spilledTweets);
+    metrics_add(METRIC_SPILLED_TWEETS, -numLost);
+    metrics_add(METRIC_TWEETS_DROPPED, numLost);
+  }
+}
+
+/** \copydoc park_user_at_index */
+void park_user_at_index(int *userIdx)
+{
+  if (*userIdx < 0 || *userIdx >= maxActiveUsers)
+  { /* Client never validated a username */
+    return;
+  }
+  activeUsers[*userIdx].isConnected = 0;
+  activeUsers[*userIdx].disconnectedMs = histogram_now_ns() / 1000000;
+  save_user_mailbox(*userIdx);
+}
+
+/** \copydoc save_user_mailbox */
+int save_user_mailbox(int userIdx)
+{
+  Mailbox mailbox;
+  Mailbox displaced;
+
+  if (mailboxStore == NULL)
+    return 0;
+  strcpy(mailbox.username, activeUsers[userIdx].username);
+  memcpy(mailbox.subscriptions, activeUsers[userIdx].subscriptions, sizeof(mailbox.subscriptions));
+  memcpy(mailbox.keywords, activeUsers[userIdx].keywords, sizeof(mailbox.keywords));
+  mailbox.lastTweetSeq = activeUsers[userIdx].lastTweetSeq;
+  mailbox.spilledTweets = activeUsers[userIdx].spilledTweets;
+  mailbox.spillRunId = spillStore != NULL ? spillStore->runId : 0;
+  memcpy(mailbox.requestBuckets, activeUsers[userIdx].requestBuckets, sizeof(mailbox.requestBuckets));
+  mailbox.numTweets = count_pending_tweets(userIdx);
+  memcpy(mailbox.pendingTweets, activeUsers[userIdx].pendingTweets, sizeof(mailbox.pendingTweets));
+  if (mailbox_store_save(mailboxStore, &mailbox, &displaced) < 0)
+  {
+    printf("Client %s: Mailbox could not be saved.\n", mailbox.username);
+    return 0;
+  }
+  if (strcmp(displaced.username, "") != 0)
+    drop_displaced_mailbox(&displaced);
+  return 1;
+}
+
+/* A user still in activeUsers is saved again when parked or evicted; any other loses its mailbox */
+static void drop_displaced_mailbox(Mailbox *displaced)
+{
+  int64_t numLost = displaced->numTweets + displaced->spilledTweets.numRecords;
+
+  for (int userIdx = 0; userIdx < maxActiveUsers; userIdx++)
+  {
+    if (userTable.isOccupied[userIdx] && strcmp(activeUsers[userIdx].username, displaced->username) == 0)
+      return;
+  }
+  if (spillStore != NULL && displaced->spillRunId == spillStore->runId && displaced->spilledTweets.numRecords > 0)
+    metrics_add(METRIC_SPILLED_TWEETS, -spill_store_clear(spillStore, &displaced->spilledTweets));
+  printf("Client %s: Mailbox was displaced. %lld tweets were lost.\n", displaced->username, (long long)numLost);
+  metrics_add(METRIC_TWEETS_DROPPED, numLost);
+}
+
+/** \copydoc restore_user_mailbox */
+int restore_user_mailbox(int userIdx)
+{
+  uint64_t nowMs = histogram_now_ns() / 1000000;
+  Mailbox mailbox;
+
+  if (mailboxStore == NULL || !mailbox_store_load(mailboxStore, activeUsers[userIdx].username, &mailbox))
+    return 0;
+  for (int subscriptionIdx = 0; subscriptionIdx < MAX_SUBSCRIPTIONS; subscriptionIdx++)
+  {
+    if (strcmp(mailbox.subscriptions[subscriptionIdx], "") != 0)
+      set_subscription(userIdx, subscriptionIdx, mailbox.subscriptions[subscriptionIdx]);
+  }
+  for (int keywordIdx = 0; keywordIdx < MAX_KEYWORD_SUBSCRIPTIONS; keywordIdx++)
+  {
+    if (strcmp(mailbox.keywords[keywordIdx], "") == 0)
+      continue;
+    strcpy(activeUsers[userIdx].keywords[keywordIdx], mailbox.keywords[keywordIdx]);
+    keyword_matcher_insert(userTable.keywordSubscriptions, mailbox.keywords[keywordIdx], strlen(mailbox.keywords[keywordIdx]), userIdx);
+  }
+  for (int pendingTweetIdx = 0; pendingTweetIdx < mailbox.numTweets; pendingTweetIdx++)
+  {
+    strcpy(activeUsers[userIdx].pendingTweets[pendingTweetIdx], mailbox.pendingTweets[pendingTweetIdx]);
+    metrics_add(METRIC_QUEUE_DEPTH, 1);
+    account_undelivered_bytes(strlen(mailbox.pendingTweets[pendingTweetIdx]) + 1);
+  }
+  activeUsers[userIdx].lastTweetSeq = mailbox.lastTweetSeq;
+  if (spillStore != NULL && mailbox.spillRunId == spillStore->runId)
+  { /* Spilled tweets follow the restored ones, numbered after them */
+    activeUsers[userIdx].spilledTweets = mailbox.spilledTweets;
+  }
+  else if (mailbox.spilledTweets.numRecords > 0)
+  { /* Saved by an earlier run, whose segments were deleted; later tweets take the lost numbers */
+    activeUsers[userIdx].lastTweetSeq -= mailbox.spilledTweets.numRecords;
+    printf("Client %s: Spilled tweets of an earlier run are gone. %lld tweets were lost.\n", mailbox.username, (long long)mailbox.spilledTweets.numRecords);
+    metrics_add(METRIC_TWEETS_DROPPED, mailbox.spilledTweets.numRecords);
+  }
+  for (int bucketIdx = 0; bucketIdx < RATE_LIMIT_TYPES; bucketIdx++)
+  { /* A refill time ahead of the clock was saved before a reboot and would stop refills until then */
+    if ((mailbox.requestBuckets[bucketIdx].state >> TOKEN_BUCKET_TOKEN_BITS) <= nowMs)
+      activeUsers[userIdx].requestBuckets[bucketIdx] = mailbox.requestBuckets[bucketIdx];
+  }
+  return 1;
+}
@@ -30,9 +30,97 @@
 void die_with_error(char *errorMessage);
 int persist_with_error(char *errorMessage);
 int send_payload(int sock, cJSON *jobjToSend);
-void receive_response(int sock, char *objReceived);
+int send_payload_flags(int sock, cJSON *jobjToSend, int flags);
+int receive_response(int sock, char *objReceived);
 #endif
 
+#include "ttweet_metrics.h"
+#include "ttweet_timerwheel.h"
+#include "ttweet_ratelimit.h"
+#include "ttweet_match.h"
+#include "ttweet_trie.h"
+#include "ttweet_keyword.h"
+#include "ttweet_search.h"
+#include "ttweet_trending.h"
+#include "ttweet_follow.h"
+#include "ttweet_mailbox.h"
+#include "ttweet_spill.h"
+#include "../dependencies/ttweet_validate.h"
+#include <stddef.h>        /* for offsetof() */
+#include <netinet/tcp.h>   /* for TCP_NODELAY and TCP_DEFER_ACCEPT */
+#include <sys/ioctl.h>     /* for ioctl() */
+#include <poll.h>          /* for poll() */
+#include <sys/time.h>      /* for struct timeval */
+#include <linux/sockios.h> /* for SIOCOUTQ */
+
+/* Integer option in a key=value list, stored at offset in its struct */
+typedef struct IntOption
+{
+  char *name;
+  size_t offset;
+} IntOption;
+
+/* Socket options applied unless overridden with -t */
+typedef struct SocketProfile
+{
+  int reuseAddr;   /* SO_REUSEADDR, so a restarted server can bind while old connections are in TIME_WAIT */
+  int noDelay;     /* TCP_NODELAY, responses leave without waiting for an ACK */
+  int coalesce;    /* MSG_MORE on responses while further requests are already buffered */
+  int deferAccept; /* TCP_DEFER_ACCEPT seconds: accept() waits for the first request, 0 to disable */
+  int sndBuf;      /* SO_SNDBUF bytes, 0 for the kernel default */
+  int rcvBuf;      /* SO_RCVBUF bytes, 0 for the kernel default */
+  int keepIdle;    /* Idle seconds before keepalive probes, 0 disables SO_KEEPALIVE */
+  int keepIntvl;   /* Seconds between keepalive probes */
+  int keepCnt;     /* Unanswered probes before the connection is dropped */
+} SocketProfile;
+
+/* Deadlines in milliseconds, applied unless overridden with -T; 0 disables one */
+typedef struct TimeoutProfile
+{
+  int loginMs;     /* Time allowed from connecting to validating a username */
+  int idleMs;      /* Connection closed after this long without a request */
+  int heartbeatMs; /* RES_PING sent after this long without a request */
+  int sessionMs;   /* Multiplexed session ended after this long without a request of its own */
+} TimeoutProfile;
+
+/* Memory and bandwidth budgets, applied unless overridden with -B; 0 disables a budget */
+typedef struct AdmissionProfile
+{
+  int memoryBytes; /* Pending tweet bytes across all users; beyond it tweeters are paused and queues shed */
+  int outputBytes; /* Unacknowledged response bytes per connection; beyond it requests are not read */
+  int pauseMs;     /* How long a tweeter is paused while memoryBytes is exceeded */
+  int shedOldest;  /* 1: a full queue drops its oldest tweet; 0: the new tweet is dropped */
+} AdmissionProfile;
+
+/* Requests per second and burst sizes, applied unless overridden with -R; a rate of 0 disables a limit */
+typedef struct RateLimitProfile
+{
+  int tweetRate;      /* Per user */
+  int tweetBurst;
+  int subscribeRate;  /* Per user, subscribe, unsubscribe, follow and unfollow together */
+  int subscribeBurst;
+  int timelineRate;   /* Per user */
+  int timelineBurst;
+  int ipRate;         /* Per client address, all requests but exit */
+  int ipBurst;
+} RateLimitProfile;
+
+/* State of one client connection, owned by the child process serving it */
+typedef struct ClientConnection
+{
+  int sock;
+  int clientUserIdx;    /* User of requests without a sessionId */
+  int *sessionUserIdx;  /* Users by sessionId, allocated on first use */
+  Timer *sessionTimers; /* Idle timer of each session, allocated with sessionUserIdx */
+  int closing;          /* Set by a timer to end the connection */
+  int readsPaused;      /* Requests are left unread until resumeTimer fires */
+  TimerWheel wheel;
+  Timer loginTimer;
+  Timer idleTimer;
+  Timer heartbeatTimer;
+  Timer resumeTimer;
+} ClientConnection;
+
 typedef struct LatestTweet
 {
   int tweetID;
@@ -42,16 +130,62 @@ typedef struct LatestTweet
   int numValidHashtags;
 } LatestTweet;
 
+/* Rate limiting */
+#define IP_RATE_BUCKET_BITS 12   /* Addresses hash into 2^bits shared buckets */
+#define REQ_RATE_LIMITED -1      /* Internal: request refused by a rate limit */
+
+#define CACHE_LINE_SIZE 64
+#define DEFAULT_SEARCH_WINDOW 65536 /* Recent tweets kept searchable, see -s */
+#define DEFAULT_COMPRESS_MIN_BYTES 512 /* Smallest response compressed for clients that ask, see -z */
+#define FANOUT_BLOCK_USERS 512 /* Users filtered per match_signatures() call */
+#define DEFAULT_FANOUT_THRESHOLD 1000 /* Followers at which an author is fanned out on read, see -F */
+#define MAX_FOLLOW_ACCOUNTS 65536     /* Usernames the follow graph can hold */
+#define MAX_FOLLOWS (1 << 20)         /* Follows the follow graph can hold, over all accounts */
+#define MAX_MAILBOXES 65536           /* Usernames the mailbox store can hold, see -M */
+#define NO_TIMELINE_CURSOR -1 /* Timeline request without a cursor: send and clear every pending tweet */
+
+/* Per-user fields read only by the user's own requests */
 typedef struct User
 {
-  int isOccupied;
   char username[MAX_USERNAME_LEN];
   char pendingTweets[MAX_TWEET_QUEUE][MAX_TWEET_ITEM_LEN];
   int pendingTweetsSize;
+  SpillQueue spilledTweets; /* Tweets queued after pendingTweets filled up, see -S; empty while pendingTweets has room */
+  uint64_t lastTweetSeq;    /* Sequence number of the newest tweet queued; pendingTweets then spilledTweets are numbered consecutively up to it */
   char subscriptions[MAX_SUBSCRIPTIONS][MAX_HASHTAG_LEN];
-  int isSubscribedAll;
+  char keywords[MAX_KEYWORD_SUBSCRIPTIONS][MAX_HASHTAG_LEN]; /* Lower case */
+  int32_t followAccount; /* Account in UserTable.follows, FOLLOW_NIL if it had no room */
+  uint64_t lastPostSeq;  /* Newest post of an author fanned out on read already queued, see follow_graph_pull() */
+  TokenBucket requestBuckets[RATE_LIMIT_TYPES]; /* Full for a new username; kept while parked and in the mailbox, so logging in again does not refill them */
+  int isConnected;        /* 0 once parked: the slot still receives tweets until the user is back or evicted */
+  int64_t disconnectedMs; /* When the user was parked; the earliest parked user is evicted first */
 } User;
 
+/* Per-user fields read by every fan-out pass, one dense array per field
+ * (indexed like activeUsers), each starting on its own cache line. A scan
+ * reads 9 bytes per user (the ALL flag and the signature) instead of
+ * pulling in the user's tweet queue; the rest is read only on a hit..
+ * Prefix subscriptions cannot be hashed into a signature, so they are
+ * kept in a trie that a fan-out walks once per hashtag instead, and
+ * keywords in an automaton that reads each tweet once. Followers are
+ * found from the author through the follow graph. */
+typedef struct UserTable
+{
+  uint8_t *isOccupied;
+  uint8_t *isSubscribedAll;
+  uint64_t *subscriptionSignatures;               /* Bloom filter of the user's subscriptions, see hashtag_signature() */
+  uint32_t (*subscriptionIds)[MAX_SUBSCRIPTIONS]; /* hashtag_id() of each of User.subscriptions, 0 if empty or a prefix */
+  PrefixTrie *prefixSubscriptions;                /* User indices under each prefix subscription, e.g. "deploy" for deploy* */
+  uint64_t *prefixCandidates;                     /* Per-process bitmap of users found in prefixSubscriptions by a fan-out */
+  KeywordMatcher *keywordSubscriptions;           /* User indices under each keyword of User.keywords */
+  uint64_t *keywordCandidates;                    /* Per-process bitmap of users whose keywords are in the latest tweet */
+  int numKeywordCandidates;                       /* Bits set in keywordCandidates, 0 once a fan-out consumed them */
+  FollowGraph *follows;                           /* Who follows whom, by username, and the logs of authors fanned out on read */
+  uint64_t *followCandidates;                     /* Per-process bitmap of logged in followers of the latest tweet's author */
+  int numFollowCandidates;                        /* Bits set in followCandidates, 0 once a fan-out consumed them */
+  int32_t authorOnRead;                           /* Account of the latest tweet's author if fanned out on read, FOLLOW_NIL otherwise */
+} UserTable;
+
 /**
  * @brief Clean up zombie child processes
  *
@@ -62,6 +196,19 @@ typedef struct User
  */
 void child_exit_signal_handler();
 
+/**
+ * @brief Requests a clean shutdown
+ *
+ * Installed for SIGTERM and SIGINT. The accept loop stops and the server
+ * leaves through exit(), so buffered output and profiling data are flushed.
+ * Child processes blocked in receive_response() are interrupted and exit
+ * as if their client had disconnected.
+ *
+ * @param sig Signal number
+ * @return void
+ */
+void shutdown_signal_handler(int sig);
+
 /**
  * @brief Creates TCP server socket
  *
@@ -70,6 +217,102 @@ void child_exit_signal_handler();
  */
 int create_tcp_serv_socket(unsigned short port);
 
+/**
+ * @brief Parses a list of integer options such as "idle=90000,login=5000"
+ *
+ * Keys not given keep their current value.
+ *
+ * @param optionString Comma separated key=value pairs with non-negative values
+ * @param options Recognized keys and where each value is stored
+ * @param numOptions Number of options
+ * @param target Struct the offsets refer to
+ * @return int 1 if valid, 0 otherwise
+ */
+int parse_int_options(char *optionString, const IntOption options[], int numOptions, void *target);
+
+/**
+ * @brief Parses a socket profile such as "nodelay=1,sndbuf=262144"
+ *
+ * Keys are reuseaddr, nodelay, coalesce, defer, sndbuf, rcvbuf, keepidle,
+ * keepintvl and keepcnt (see SocketProfile). Keys not given keep their
+ * current value.
+ *
+ * @param profileString Comma separated key=value pairs
+ * @param profile Profile to update
+ * @return int 1 if valid, 0 otherwise
+ */
+int parse_socket_profile(char *profileString, SocketProfile *profile);
+
+/**
+ * @brief Parses connection deadlines such as "idle=60000,heartbeat=20000"
+ *
+ * Keys are login, idle, heartbeat and session, in milliseconds (see
+ * TimeoutProfile). Keys not given keep their current value.
+ *
+ * @param profileString Comma separated key=value pairs
+ * @param profile Profile to update
+ * @return int 1 if valid, 0 otherwise
+ */
+int parse_timeout_profile(char *profileString, TimeoutProfile *profile);
+
+/**
+ * @brief Parses budgets such as "memory=1048576,outbuf=65536"
+ *
+ * Keys are memory, outbuf, pause and shed (see AdmissionProfile). Keys not
+ * given keep their current value.
+ *
+ * @param profileString Comma separated key=value pairs
+ * @param profile Profile to update
+ * @return int 1 if valid, 0 otherwise
+ */
+int parse_admission_profile(char *profileString, AdmissionProfile *profile);
+
+/**
+ * @brief Parses rate limits such as "tweet=10,tweetburst=20,ip=500"
+ *
+ * Keys are tweet, subscribe, timeline and ip in requests per second, each
+ * with a matching *burst key (see RateLimitProfile). Keys not given keep
+ * their current value. A burst of 0 becomes the rate, so "ip=500" alone
+ * allows 500 requests at once.
+ *
+ * @param profileString Comma separated key=value pairs
+ * @param profile Profile to update
+ * @return int 1 if valid, 0 otherwise
+ */
+int parse_rate_limit_profile(char *profileString, RateLimitProfile *profile);
+
+/**
+ * @brief Applies the listener part of a socket profile
+ *
+ * Called between socket() and bind(). Buffer sizes are set here so that
+ * accepted sockets inherit them and the window scale is chosen to match.
+ *
+ * @param sock Listening socket
+ * @param profile Socket profile
+ * @return void
+ */
+void apply_listener_socket_profile(int sock, SocketProfile *profile);
+
+/**
+ * @brief Applies the per-connection part of a socket profile
+ *
+ * @param sock Accepted socket
+ * @param profile Socket profile
+ * @return void
+ */
+void apply_connection_socket_profile(int sock, SocketProfile *profile);
+
+/**
+ * @brief Checks whether the client has already sent more data
+ *
+ * A pipelining client will be answered again shortly, so the current
+ * response can be sent with MSG_MORE and share segments with the next.
+ *
+ * @param sock Socket of the connection
+ * @return int 1 if unread bytes are waiting; 0 otherwise.
+ */
+int has_pending_request(int sock);
+
 /**
  * @brief Accepts and maintains a TCP connection 
  *
@@ -77,7 +320,7 @@ int create_tcp_serv_socket(unsigned short port);
  * a persistent TCP connection with the client.
  *
  * @param servSock Server socket which was assigned to run the server program
- * @return int Server socket after accepting the connection
+ * @return int Server socket after accepting the connection, -1 if interrupted by a signal
  */
 int accept_tcp_connection(int servSock);
 
@@ -88,6 +331,11 @@ int accept_tcp_connection(int servSock);
  * concurrent connections. This function delegates work to other functions according to the request 
  * sent by the client. It loops continuously to perform the sending and receiving of data with the client.
  *
+ * Between requests the child waits in poll() for the next deadline on the
+ * connection's timer wheel (see TimeoutProfile): a connection that has not
+ * validated a username in time, or stays silent through heartbeats, is
+ * closed and its users released.
+ *
  * @param clntSocket Server socket after accepting the connection
  * @return void
  */
@@ -105,6 +353,196 @@ void handle_ttweet_client(int clntSocket);
  */
 void reject_ttweet_client(int clntSocket);
 
+/**
+ * @brief Prepares connection state and starts its login, idle and heartbeat timers
+ *
+ * @param conn Connection state
+ * @param clntSocket Server socket after accepting the connection
+ * @return void
+ */
+void open_client_connection(ClientConnection *conn, int clntSocket);
+
+/**
+ * @brief Restarts the idle and heartbeat timers after a request
+ *
+ * @param conn Connection state
+ * @param sessionId Session of the request, NO_SESSION_ID if it has none
+ * @return void
+ */
+void touch_client_connection(ClientConnection *conn, int sessionId);
+
+/**
+ * @brief Returns the user index a request acts on
+ *
+ * @param conn Connection state
+ * @param sessionId Session of the request, NO_SESSION_ID if it has none
+ * @return int* The connection's own user index or that of the session.
+ */
+int *get_request_user_idx(ClientConnection *conn, int sessionId);
+
+/**
+ * @brief Closes the connection when no username was validated in time
+ *
+ * @param timer Login timer of the connection
+ * @param arg Connection state
+ * @return void
+ */
+void login_timeout_handler(Timer *timer, void *arg);
+
+/**
+ * @brief Closes a connection that has been silent for too long
+ *
+ * @param timer Idle timer of the connection
+ * @param arg Connection state
+ * @return void
+ */
+void idle_timeout_handler(Timer *timer, void *arg);
+
+/**
+ * @brief Sends RES_PING to a silent connection and schedules the next one
+ *
+ * @param timer Heartbeat timer of the connection
+ * @param arg Connection state
+ * @return void
+ */
+void heartbeat_handler(Timer *timer, void *arg);
+
+/**
+ * @brief Ends a multiplexed session that has been silent for too long
+ *
+ * The session's user is released and the session is told with RES_EXIT.
+ *
+ * @param timer Idle timer of the session
+ * @param arg Connection state
+ * @return void
+ */
+void session_timeout_handler(Timer *timer, void *arg);
+
+/**
+ * @brief Stops reading requests from a connection for a while
+ *
+ * Responses already due are still sent; the client's next requests wait
+ * in the socket until resume_reads_handler() runs.
+ *
+ * @param conn Connection state
+ * @param pauseMs How long to stop reading
+ * @return void
+ */
+void pause_client_reads(ClientConnection *conn, int pauseMs);
+
+/**
+ * @brief Reads requests from a paused connection again
+ *
+ * @param timer Resume timer of the connection
+ * @param arg Connection state
+ * @return void
+ */
+void resume_reads_handler(Timer *timer, void *arg);
+
+/**
+ * @brief Checks whether a client has left too many responses unacknowledged
+ *
+ * Bytes still in the socket's send queue are those the client has not
+ * read (or the network has not carried) yet.
+ *
+ * @param sock Client socket
+ * @return int 1 if over the outbuf budget; 0 otherwise.
+ */
+int is_over_output_budget(int sock);
+
+/**
+ * @brief Checks whether pending tweets exceed the memory budget
+ *
+ * @param extraBytes Bytes about to be added
+ * @return int 1 if adding extraBytes would exceed the budget; 0 otherwise.
+ */
+int is_over_memory_budget(int extraBytes);
+
+/**
+ * @brief Returns the shared rate limit bucket of a client address
+ *
+ * Addresses hash into 2^IP_RATE_BUCKET_BITS buckets; addresses that
+ * collide share a limit.
+ *
+ * @param addr IPv4 address in network byte order
+ * @return TokenBucket* The bucket, or NULL if per-address limits are not set up.
+ */
+TokenBucket *get_ip_bucket(uint32_t addr);
+
+/**
+ * @brief Checks a request against the rate limits of its user and address
+ *
+ * Takes a token from each bucket that applies. exit and invalid requests
+ * are never limited, so a client can always leave.
+ *
+ * @param requestCode REQ_* code of a well formed request
+ * @param userIdx Index of the requesting user, INVALID_USER_INDEX before validation
+ * @return int 1 if the request must be refused; 0 otherwise.
+ */
+int is_rate_limited(int requestCode, int userIdx);
+
+/**
+ * @brief Allocates activeUsers and userTable in shared memory
+ *
+ * Must be called before any fork() so that every child sees the same users.
+ *
+ * @param numUsers Capacity of the table
+ * @return void
+ */
+void allocate_user_table(int numUsers);
+
+/**
+ * @brief Releases memory from allocate_user_table()
+ *
+ * @param numUsers Capacity passed to allocate_user_table()
+ * @return void
+ */
+void free_user_table(int numUsers);
+
+/**
+ * @brief Returns the identifier stored in UserTable.subscriptionIds for a hashtag
+ *
+ * Equal hashtags have equal identifiers; distinct ones may collide, so a
+ * match is confirmed against the hashtag itself.
+ *
+ * @param hashtag NUL terminated hashtag without '#'
+ * @return uint32_t FNV-1a hash of the hashtag, never 0.
+ */
+uint32_t hashtag_id(const char *hashtag);
+
+/**
+ * @brief Returns the length of the prefix a subscription stands for
+ *
+ * @param subscription NUL terminated subscription without '#'
+ * @return int Length without the trailing PREFIX_WILDCARD, or 0 if subscription is a plain hashtag.
+ */
+int prefix_subscription_len(const char *subscription);
+
+/**
+ * @brief Returns the bits a hashtag sets in UserTable.subscriptionSignatures
+ *
+ * Two bits of a 64-bit signature, taken from the high bits of the
+ * identifier. A user can only be subscribed to a hashtag if every one of
+ * its bits is set in the user's signature; with MAX_SUBSCRIPTIONS
+ * subscriptions a hashtag the user does not follow passes about 1% of
+ * the time.
+ *
+ * @param hashtagId Result of hashtag_id()
+ * @return uint64_t Signature with one or two bits set.
+ */
+uint64_t hashtag_signature(uint32_t hashtagId);
+
+/**
+ * @brief Rebuilds a user's subscription signature from its identifiers
+ *
+ * A Bloom filter cannot forget a member, so the signature is recomputed
+ * from scratch whenever a subscription is added or removed.
+ *
+ * @param userIdx Index of the user in activeUsers
+ * @return void
+ */
+void update_subscription_signature(int userIdx);
+
 /**
  * @brief Initialize activeUsers array
  *
@@ -138,18 +576,85 @@ void initialize_latest_tweet();
  */
 void create_json_server_payload(cJSON *jobjToSend, int commandCode, int userIdx, char *detailedMessage);
 
+/**
+ * @brief Sends a response to this process's client
+ *
+ * Responses are compressed once accept_compression() has agreed to it,
+ * and the bytes and time compression took or saved are added to metrics.
+ *
+ * @param clntSocket Server socket after accepting the connection
+ * @param jobjToSend cJSON object to be sent
+ * @param flags Flags for send_payload_flags(), e.g. MSG_MORE
+ * @return int 0 if error occurred, number of bytes sent otherwise.
+ */
+int send_response(int clntSocket, cJSON *jobjToSend, int flags);
+
+/**
+ * @brief Agrees to compress responses if a login asked for it
+ *
+ * A login without a sessionId may ask for COMPRESS_CODEC_NAME in its
+ * "compression" field. The login response is sent as it is and names the
+ * codec; every later response of the connection is then compressed by
+ * send_response() when it reaches the -z threshold.
+ *
+ * @param jobjToSend Login response, receives the "compression" field
+ * @param jobjReceived Login request
+ * @return int 1 if compression starts after jobjToSend is sent; 0 otherwise.
+ */
+int accept_compression(cJSON *jobjToSend, cJSON *jobjReceived);
+
 /**
  * @brief Handles client response
  *
  * Handles response to the client by calling the handler 
  * functions corresponding to the client's request code.
  *
+ * With a sessionId, the request acts on one session of a multiplexed
+ * connection: the response echoes the sessionId, and exit or an invalid
+ * request ends only that session (answered with RES_EXIT or RES_INVALID)
+ * instead of closing the connection.
+ *
  * @param clntSocket Server socket after accepting the connection
  * @param jobjReceived cJSON object received
- * @param clientUserIdx Client user index
+ * @param clientUserIdx Client user index of the connection or session
+ * @param sessionId Session of the request, NO_SESSION_ID if it has none
  * @return int 0 for requests leading to server shutting down connection; 1 otherwise.
  */
-int handle_client_response(int clntSocket, cJSON *jobjReceived, int *clientUserIdx);
+int handle_client_response(int clntSocket, cJSON *jobjReceived, int *clientUserIdx, int sessionId);
+
+/**
+ * @brief Reads the optional sessionId of a request
+ *
+ * Requests carrying a sessionId belong to one of many users sharing the
+ * connection. Each session validates its own username.
+ *
+ * @param jobjReceived cJSON object received
+ * @return int The sessionId, NO_SESSION_ID if absent, or INVALID_SESSION_ID if not an integer in [0, MAX_MUX_SESSIONS).
+ */
+int get_session_id(cJSON *jobjReceived);
+
+/**
+ * @brief Releases the users of a multiplexed connection
+ *
+ * @param sessionUserIdx User index of each session, INVALID_USER_INDEX if unused
+ * @return void
+ */
+void end_mux_sessions(int sessionUserIdx[]);
+
+/**
+ * @brief Checks that a request is well formed before it is handled
+ *
+ * Every field the handlers read must be present with the right type and
+ * satisfy the same rules the client enforces (ttweet_validate.h). Apart
+ * from validation and exit, the connection must own a validated username
+ * and the request must carry that username.
+ *
+ * @param jobjReceived cJSON object received
+ * @param requestCode Request code of jobjReceived
+ * @param clientUserIdx Client user index
+ * @return int 1 if the request may be handled, 0 otherwise.
+ */
+int is_valid_client_request(cJSON *jobjReceived, int requestCode, int clientUserIdx);
 
 /**
  * @brief  Handles validate user request
@@ -158,6 +663,11 @@ int handle_client_response(int clntSocket, cJSON *jobjReceived, int *clientUserI
  * If so, it creates a payload with a flag indicating valid.
  * Otherwise, it creates a payload with a flag indicating invalid.
  *
+ * A username that is parked takes its slot back as it was left, tweets
+ * queued since included. Otherwise it takes a free slot, or the slot of
+ * the user parked the longest, and its mailbox is restored from the
+ * store if it has one. A username is only refused while it is connected.
+ *
  * @param jobjToSend cJSON object to be sent
  * @param senderUsername Client username
  * @param clientUserIdx Client user index
@@ -201,18 +711,103 @@ void handle_subscribe_request(cJSON *jobjToSend, cJSON *jobjReceived, char *send
  */
 void handle_unsubscribe_request(cJSON *jobjToSend, cJSON *jobjReceived, char *senderUsername, int *clientUserIdx);
 
+/**
+ * @brief Handles subscribe keyword request
+ *
+ * The keyword is stored in lower case and added to
+ * UserTable.keywordSubscriptions, so every later tweet whose text
+ * contains it, in any case, is delivered to the user.
+ *
+ * @param jobjToSend cJSON object to be sent
+ * @param jobjReceived cJSON object received
+ * @param clientUserIdx Client user index
+ * @return void
+ */
+void handle_subscribe_keyword_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx);
+
+/**
+ * @brief Handles unsubscribe keyword request
+ *
+ * @param jobjToSend cJSON object to be sent
+ * @param jobjReceived cJSON object received
+ * @param clientUserIdx Client user index
+ * @return void
+ */
+void handle_unsubscribe_keyword_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx);
+
+/**
+ * @brief Handles follow request
+ *
+ * The user follows followUsername, who need not be logged in. Later
+ * tweets of that username are delivered to the user whatever their
+ * hashtags, see handle_tweet_updates().
+ *
+ * @param jobjToSend cJSON object to be sent
+ * @param jobjReceived cJSON object received
+ * @param clientUserIdx Client user index
+ * @return void
+ */
+void handle_follow_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx);
+
+/**
+ * @brief Handles unfollow request
+ *
+ * @param jobjToSend cJSON object to be sent
+ * @param jobjReceived cJSON object received
+ * @param clientUserIdx Client user index
+ * @return void
+ */
+void handle_unfollow_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx);
+
 /**
  * @brief Handles timeline request
  *
+ * A request with a timelineCursor acknowledges every tweet up to that
+ * sequence number and receives at most timelineMaxTweets of the tweets
+ * after it, see add_pending_tweets_to_jobj(). A request without one
+ * receives, and clears, every pending tweet.
+ *
+ * Either way, the posts of followed authors that are fanned out on read
+ * are first merged into the user's pending tweets.
+ *
+ * @param jobjToSend cJSON object to be sent
+ * @param jobjReceived cJSON object received
+ * @param clientUserIdx Client user index
+ * @return void
+ */
+void handle_timeline_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx);
+
+/**
+ * @brief Handles search request
+ *
+ * Answers with the newest MAX_SEARCH_RESULTS tweets of the search window
+ * that match searchQuery, as described by parse_search_query().
+ *
+ * @param jobjToSend cJSON object to be sent
+ * @param jobjReceived cJSON object received
+ * @param clientUserIdx Client user index
+ * @return void
+ */
+void handle_search_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx);
+
+/**
+ * @brief Handles trending request
+ *
+ * Answers with the MAX_TRENDING_RESULTS most used hashtags over the
+ * window named by trendingWindow, with their estimated uses.
+ *
  * @param jobjToSend cJSON object to be sent
+ * @param jobjReceived cJSON object received
  * @param clientUserIdx Client user index
  * @return void
  */
-void handle_timeline_request(cJSON *jobjToSend, int *clientUserIdx);
+void handle_trending_request(cJSON *jobjToSend, cJSON *jobjReceived, int *clientUserIdx);
 
 /**
  * @brief Handles exit request
  *
+ * The user is parked rather than cleared, see park_user_at_index().
+ *
  * @param userIdx Client user index
  * @return 0
  */
@@ -221,15 +816,26 @@ int handle_exit_request(int *userIdx);
 /**
  * @brief Handles invalid request
  *
+ * The connection is closed and the user is parked.
+ *
+ * @param userIdx Client user index
  * @return 0
  */
-int handle_invalid_request();
+int handle_invalid_request(int *userIdx);
 
 /**
  * @brief Updates tweets across all clients
  *
  * This function updates pendingTweets in all clients that
  * are subscribed to a hashtag in the latest tweet received.
+ * Users are filtered FANOUT_BLOCK_USERS at a time with match_signatures(),
+ * and only those whose signatures pass are compared on the identifiers
+ * and then the strings.
+ *
+ * Logged in followers of the author also receive the tweet, unless the
+ * author is fanned out on read. Then no follower is visited, and
+ * subscribers who follow the author are skipped too, as they will find
+ * the tweet in the author's log.
  *
  * @return int 0 if error occurred, 1 otherwise.
  */
@@ -238,7 +844,12 @@ void handle_tweet_updates();
 /**
  * @brief Adds a tweet to a user
  *
- * Adds the latest tweet to the user at userIdx.
+ * Adds the latest tweet to the user at userIdx. When the user's queue is
+ * full, or the memory budget is exceeded and the user has tweets waiting,
+ * the oldest pending tweet is shed to make room (or, with shed=0, the new
+ * tweet is dropped). With a spill directory, the tweet is written to disk
+ * instead, and so is every later tweet until the queue has drained them,
+ * so that tweets stay in order.
  *
  * @param userIdx Client user index
  * @param senderUsername Client username
@@ -248,22 +859,53 @@ void handle_tweet_updates();
  */
 void add_tweet_to_user(int userIdx, char *senderUsername, char *ttweetString, char *originHashtag);
 
+/**
+ * @brief Drops the oldest pending tweet of a user
+ *
+ * @param userIdx Index of user in activeUsers array
+ * @return void
+ */
+void shed_oldest_tweet(int userIdx);
+
+/**
+ * @brief Tracks bytes of pending tweets against the memory budget
+ *
+ * @param delta Bytes queued (positive) or delivered and dropped (negative)
+ * @return void
+ */
+void account_undelivered_bytes(int64_t delta);
+
 /**
  * @brief Adds pending tweets to JSON obj
  *
- * While transferring tweets to a JSON obj, the user's
- * list of pending tweets are cleared.
+ * Without a cursor, the user's list of pending tweets is cleared while
+ * transferring tweets to a JSON obj.
+ *
+ * With a cursor, tweets up to and including the cursor have been seen by
+ * the client and are cleared, and the tweets after it are sent but kept
+ * until a later cursor acknowledges them. Pending tweets are numbered
+ * consecutively, so the response carries only firstTweetSeq, the number
+ * of the first tweet sent, and moreTweets, the number still pending after
+ * the last one. A lost response is sent again on the next request.
+ *
+ * Spilled tweets are read back into the queue as it empties, so at most
+ * MAX_TWEET_QUEUE tweets are sent per request, and moreTweets counts the
+ * spilled ones too.
  *
  * @param jobj A cJSON object
  * @param userIdx Client user index
+ * @param cursor Sequence number of the newest tweet the client has seen, or NO_TIMELINE_CURSOR
+ * @param maxTweets Most tweets to send when cursor is given
  * @return void
  */
-void add_pending_tweets_to_jobj(cJSON *jobj, int userIdx);
+void add_pending_tweets_to_jobj(cJSON *jobj, int userIdx, int64_t cursor, int maxTweets);
 
 /**
  * @brief Stores to last received tweet 
  *
- * Saves the latest tweet to the globla latestTweet variable.
+ * Saves the latest tweet to the globla latestTweet variable, and marks
+ * the users with a keyword in its text in UserTable.keywordCandidates
+ * for the fan-out that follows.
  * 
  * @param jobjReceived cJSON object received
  * @param senderUsername Client username
@@ -274,11 +916,60 @@ void store_latest_tweet(cJSON *jobjReceived, char *senderUsername);
 /**
  * @brief Clears user space at specified index
  *
+ * Called when a parked user is evicted, after its mailbox was saved.
+ * Spilled tweets still in the slot were not handed to the mailbox and
+ * count as dropped.
+ *
  * @param userIdx Client user index
  * @return void
  */
 void clear_user_at_index(int *userIdx);
 
+/**
+ * @brief Keeps a disconnected user's slot for the next login
+ *
+ * Subscriptions, keywords, follows and pending tweets stay in place, and
+ * fan-out keeps queueing tweets for the user, so a client that reconnects
+ * loses nothing and its timeline cursor stays valid. The mailbox is also
+ * written to the store, so it survives the slot being evicted or the
+ * server restarting.
+ *
+ * Mailboxes are only written here, on eviction and on a clean shutdown.
+ * If the server is killed or crashes, tweets that reached a user after it
+ * was parked are lost, and so is everything a connected user changed
+ * since it last logged out.
+ *
+ * @param userIdx Client user index
+ * @return void
+ */
+void park_user_at_index(int *userIdx);
+
+/**
+ * @brief Writes a user's subscriptions, keywords, pending tweets and rate limits to the mailbox store
+ *
+ * Does nothing if the server runs without -M. Spilled tweets stay on
+ * disk and the mailbox records where their queue starts, so an evicted
+ * user gets them back at its next login. They do not outlive the server:
+ * a mailbox saved by an earlier run restores only the tweets it holds.
+ * A mailbox whose slot is given to a new username is dropped, with its
+ * spilled tweets, unless its user is still in activeUsers.
+ *
+ * @param userIdx Index of the user in activeUsers
+ * @return int 1 if saved; 0 if the server runs without -M or the write failed.
+ */
+int save_user_mailbox(int userIdx);
+
+/**
+ * @brief Restores a user's subscriptions, keywords, pending tweets and rate limits from the mailbox store
+ *
+ * The slot must be freshly occupied by the user. Pending tweets keep the
+ * sequence numbers they had when saved.
+ *
+ * @param userIdx Index of the user in activeUsers
+ * @return int 1 if a mailbox was restored; 0 if the username has none.
+ */
+int restore_user_mailbox(int userIdx);
+
 /**
  * @brief Prints activeUsers
  *